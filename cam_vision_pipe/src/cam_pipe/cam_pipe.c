@@ -1,21 +1,23 @@
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include "nnet_lib/utility/profiling.h"
+#include "nnet_lib/utility/thread_pool.h"
 #include "kernels/pipe_stages.h"
+#include "kernels/streaming_isp.h"
 #include "utility/load_cam_model.h"
 #include "utility/cam_pipe_utility.h"
 #ifdef DMA_MODE
 #include "gem5_harness.h"
 #endif
+#include "cam_pipe.h"
 
 ///////////////////////////////////////////////////////////////
 // Camera Model Parameters
 ///////////////////////////////////////////////////////////////
 
-// Path to the camera model to be used
-char cam_model_path[100];
-
 // White balance index (select white balance from transform file)
 // The first white balance in the file has a wb_index of 1
 // For more information on model format see the readme
@@ -24,6 +26,52 @@ int wb_index = 6;
 // Number of control points
 int num_ctrl_pts = 3702;
 
+// Dataflow used to run the ISP stages.
+isp_dataflow_t isp_dataflow = IspFrameDataflow;
+
+// Layout of the input frames, and the significant bits of a RawBayer16
+// sample.
+raw_format_t raw_format = RawRgbPlanes;
+int raw_bit_depth = 16;
+
+// Gamut map implementation, and the LUT configuration if one is used.
+gamut_map_impl_t gamut_map_impl = GamutMapExact;
+int gamut_lut_size = 33;
+lut_interp_t gamut_lut_interp = LutTetrahedral;
+
+// Memory budget of the gamut map caches of a context, in KB, with
+// GamutMapMemo. It is split evenly between the bands.
+int gamut_cache_kb = 4096;
+
+// Stages run by the ISP, in order. By default, every stage runs with the
+// exact kernel.
+isp_graph_t isp_graph = {
+  6,
+  { { IspStageDemosaic, IspImplExact },
+    { IspStageDenoise, IspImplExact },
+    { IspStageResize, IspImplExact },
+    { IspStageTransform, IspImplExact },
+    { IspStageGamutMap, IspImplExact },
+    { IspStageToneMap, IspImplExact } },
+};
+
+// Crop and resize stage between denoise and the color stages.
+resize_cfg_t isp_resize = { ResizeNone };
+
+// Nonzero to run transform, gamut map, tone map and descale as a single pass
+// in the frame dataflow.
+int isp_fuse_color = 0;
+
+// Fractional bits of the samples of the fixed-point dataflow.
+int isp_frac_bits = 12;
+
+// Nonzero to collect 3A statistics of every frame while it is transformed.
+int isp_collect_stats = 0;
+
+// Window of the denoise median. Windows larger than 3x3 use the sliding
+// histogram median of kernels/median_hist.h, in the streaming dataflow.
+int isp_denoise_size = 3;
+
 void load_cam_params_hw(float *host_TsTw, float *host_ctrl_pts,
                         float *host_weights, float *host_coefs,
                         float *host_tone_map, float *acc_TsTw,
@@ -38,104 +86,513 @@ void load_cam_params_hw(float *host_TsTw, float *host_ctrl_pts,
 }
 
 void isp_hw(uint8_t *host_input, uint8_t *host_result, int row_size,
-            int col_size, uint8_t *acc_input, uint8_t *acc_result,
+            int col_size, raw_format_t input_format, int raw_bit_depth,
+            isp_graph_t graph, resize_cfg_t resize, int fuse_color,
+            uint8_t *acc_input, uint8_t *acc_result,
             float *acc_input_scaled, float *acc_result_scaled, float *acc_TsTw,
             float *acc_ctrl_pts, float *acc_weights, float *acc_coefs,
             float *acc_tone_map, float *acc_l2_dist) {
   dmaLoad(acc_input, host_input,
-          row_size * col_size * CHAN_SIZE * sizeof(uint8_t));
-  isp_hw_impl(row_size, col_size, acc_input, acc_result,
+          get_raw_frame_bytes(input_format, row_size, col_size) *
+              sizeof(uint8_t));
+  isp_hw_impl(row_size, col_size, input_format, raw_bit_depth, graph, resize,
+              fuse_color, acc_input, acc_result,
               acc_input_scaled, acc_result_scaled,
               acc_TsTw, acc_ctrl_pts, acc_weights,
               acc_coefs, acc_tone_map, acc_l2_dist);
   dmaStore(host_result, acc_result,
-           row_size * col_size * CHAN_SIZE * sizeof(uint8_t));
+           get_resize_out_rows(&resize, row_size) *
+               get_resize_out_cols(&resize, col_size) * CHAN_SIZE *
+               sizeof(uint8_t));
 }
 
-void cam_pipe(uint8_t *host_input, uint8_t *host_result, int row_size,
-              int col_size) {
-  uint8_t *acc_input, *acc_result;
-  float *acc_input_scaled, *acc_result_scaled;
-  float *host_TsTw, *host_ctrl_pts, *host_weights, *host_coefs, *host_tone_map;
-  float *acc_TsTw, *acc_ctrl_pts, *acc_weights, *acc_coefs, *acc_tone_map, *acc_l2_dist;
-
-  const char* cava_home = getenv("CAVA_HOME");
-  if (cava_home == NULL) {
-      fprintf(stderr, "CAVA_HOME returned NULL\n");
-      exit(1);
-  }
-  strcat(cam_model_path, cava_home);
-  strcat(cam_model_path, "/cam_vision_pipe/cam_models/NikonD7000/");
-
-  host_TsTw = get_TsTw(cam_model_path, wb_index);
-  float *trans = transpose_mat(host_TsTw, CHAN_SIZE, CHAN_SIZE);
-  free(host_TsTw);
-  host_TsTw = trans;
-  host_ctrl_pts = get_ctrl_pts(cam_model_path, num_ctrl_pts);
-  host_weights = get_weights(cam_model_path, num_ctrl_pts);
-  host_coefs = get_coefs(cam_model_path, num_ctrl_pts);
-  host_tone_map = get_tone_map(cam_model_path);
-
-  acc_input = malloc_aligned(sizeof(uint8_t) * row_size * col_size * CHAN_SIZE);
-  acc_result = malloc_aligned(sizeof(uint8_t) * row_size * col_size * CHAN_SIZE);
-  acc_input_scaled = malloc_aligned(sizeof(float) * row_size * col_size * CHAN_SIZE);
-  acc_result_scaled = malloc_aligned(sizeof(float) * row_size * col_size * CHAN_SIZE);
-  acc_TsTw = malloc_aligned(sizeof(float) * 9);
-  acc_ctrl_pts = malloc_aligned(sizeof(float) * num_ctrl_pts * CHAN_SIZE);
-  acc_weights = malloc_aligned(sizeof(float) * num_ctrl_pts * CHAN_SIZE);
-  acc_coefs = malloc_aligned(sizeof(float) * 12);
-  acc_tone_map = malloc_aligned(sizeof(float) * 256 * CHAN_SIZE);
-  acc_l2_dist = malloc_aligned(sizeof(float) * num_ctrl_pts);
-
-  // Load camera model parameters for the ISP
-  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_TsTw", host_TsTw,
+// Load the camera model parameters into the ISP accelerator. This only needs
+// to happen once per context.
+static void isp_context_load_params(isp_context_t *ctx) {
+  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_TsTw", ctx->TsTw,
                      sizeof(float) * 9);
-  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_ctrl_pts", host_ctrl_pts,
+  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_ctrl_pts", ctx->ctrl_pts,
                      sizeof(float) * num_ctrl_pts * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_weights", host_weights,
+  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_weights", ctx->weights,
                      sizeof(float) * num_ctrl_pts * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_coefs", host_coefs,
+  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_coefs", ctx->coefs,
                      sizeof(float) * 4 * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_tone_map", host_tone_map,
+  MAP_ARRAY_TO_ACCEL(LD_PARAMS, "host_tone_map", ctx->tone_map,
                      sizeof(float) * 256 * CHAN_SIZE);
-  INVOKE_KERNEL(LD_PARAMS, load_cam_params_hw, host_TsTw, host_ctrl_pts, host_weights,
-                host_coefs, host_tone_map, acc_TsTw, acc_ctrl_pts, acc_weights,
-                acc_coefs, acc_tone_map);
+  INVOKE_KERNEL(LD_PARAMS, load_cam_params_hw, ctx->TsTw, ctx->ctrl_pts,
+                ctx->weights, ctx->coefs, ctx->tone_map, ctx->acc_TsTw,
+                ctx->acc_ctrl_pts, ctx->acc_weights, ctx->acc_coefs,
+                ctx->acc_tone_map);
+}
 
-  // Invoke the ISP
-  MAP_ARRAY_TO_ACCEL(ISP, "host_TsTw", host_TsTw,
+// Runs the ISP accelerator over the whole frame.
+static void isp_process_frame_accel(isp_context_t *ctx, uint8_t *host_input,
+                                    uint8_t *host_result) {
+  int row_size = ctx->row_size;
+  int col_size = ctx->col_size;
+  MAP_ARRAY_TO_ACCEL(ISP, "host_TsTw", ctx->TsTw,
                      sizeof(float) * 9);
-  MAP_ARRAY_TO_ACCEL(ISP, "host_ctrl_pts", host_ctrl_pts,
+  MAP_ARRAY_TO_ACCEL(ISP, "host_ctrl_pts", ctx->ctrl_pts,
                      sizeof(float) * num_ctrl_pts * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(ISP, "host_weights", host_weights,
+  MAP_ARRAY_TO_ACCEL(ISP, "host_weights", ctx->weights,
                      sizeof(float) * num_ctrl_pts * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(ISP, "host_coefs", host_coefs,
+  MAP_ARRAY_TO_ACCEL(ISP, "host_coefs", ctx->coefs,
                      sizeof(float) * 4 * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(ISP, "host_tone_map", host_tone_map,
+  MAP_ARRAY_TO_ACCEL(ISP, "host_tone_map", ctx->tone_map,
                      sizeof(float) * 256 * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(ISP, "host_input", host_input,
-                     sizeof(uint8_t) * row_size * col_size * CHAN_SIZE);
-  MAP_ARRAY_TO_ACCEL(ISP, "host_result", host_result,
-                     sizeof(uint8_t) * row_size * col_size * CHAN_SIZE);
+  MAP_ARRAY_TO_ACCEL(
+      ISP, "host_input", host_input,
+      sizeof(uint8_t) *
+          get_raw_frame_bytes(ctx->raw_format, row_size, col_size));
+  MAP_ARRAY_TO_ACCEL(
+      ISP, "host_result", host_result,
+      sizeof(uint8_t) * ctx->out_row_size * ctx->out_col_size * CHAN_SIZE);
   INVOKE_KERNEL(ISP, isp_hw, host_input, host_result, row_size, col_size,
-                acc_input, acc_result, acc_input_scaled, acc_result_scaled,
-                acc_TsTw, acc_ctrl_pts, acc_weights, acc_coefs, acc_tone_map,
-                acc_l2_dist);
-
-  free(acc_input);
-  free(acc_result);
-  free(acc_input_scaled);
-  free(acc_result_scaled);
-  free(host_TsTw);
-  free(host_ctrl_pts);
-  free(host_weights);
-  free(host_coefs);
-  free(host_tone_map);
-  free(acc_TsTw);
-  free(acc_ctrl_pts);
-  free(acc_weights);
-  free(acc_coefs);
-  free(acc_tone_map);
-  free(acc_l2_dist);
+                ctx->raw_format, ctx->raw_bit_depth, ctx->graph, ctx->resize,
+                ctx->fuse_color, ctx->acc_input,
+                ctx->acc_result, ctx->acc_input_scaled, ctx->acc_result_scaled,
+                ctx->acc_TsTw, ctx->acc_ctrl_pts, ctx->acc_weights,
+                ctx->acc_coefs, ctx->acc_tone_map, ctx->acc_l2_dist);
 }
 
+typedef struct _isp_band_args {
+  isp_context_t *ctx;
+  int band;
+  uint8_t *host_input;
+  uint8_t *host_result;
+  uint16_t *dnn_input;
+  int dnn_align_pad;
+} isp_band_args;
+
+// Runs the streaming dataflow over one band of the frame.
+static void *isp_process_band(void *args) {
+  isp_band_args *a = (isp_band_args *)args;
+  isp_context_t *ctx = a->ctx;
+  int band_rows = FRAC_CEIL(ctx->out_row_size, ctx->num_bands);
+  int row_begin = min(a->band * band_rows, ctx->out_row_size);
+  int row_end = min(row_begin + band_rows, ctx->out_row_size);
+  isp_hw_impl_streaming(
+      ctx->row_size, ctx->col_size, ctx->raw_format, ctx->raw_bit_depth,
+      &ctx->graph, a->host_input, a->host_result, row_begin, row_end,
+      &ctx->line_buffers[a->band * get_streaming_line_buffer_size(
+                                       ctx->col_size, ctx->denoise_size)],
+      ctx->denoise_hists ? ctx->denoise_hists[a->band] : NULL,
+      ctx->resize_plan,
+      ctx->resize_plan ? &ctx->resize_rings[a->band * get_resize_ring_size(
+                                                          ctx->resize_plan)]
+                       : NULL,
+      ctx->TsTw, ctx->ctrl_pts, ctx->weights, ctx->coefs, ctx->tone_map,
+      &ctx->l2_dist[a->band * num_ctrl_pts], ctx->gamut_map_impl,
+      ctx->gamut_lut, ctx->gamut_caches ? ctx->gamut_caches[a->band] : NULL,
+      a->dnn_input, a->dnn_align_pad,
+      ctx->band_stats ? &ctx->band_stats[a->band] : NULL,
+      &ctx->stage_times[a->band * NumIspStages]);
+  return NULL;
+}
+
+// Runs the streaming dataflow in software. This works directly on the host
+// copies of the frame and the camera model. Each band is dispatched to the
+// thread pool, unless there is only one.
+static void isp_process_frame_streaming(isp_context_t *ctx,
+                                        uint8_t *host_input,
+                                        uint8_t *host_result,
+                                        uint16_t *dnn_input,
+                                        int dnn_align_pad) {
+  isp_band_args args[ctx->num_bands];
+  for (int i = 0; i < ctx->num_bands; i++) {
+    args[i] = (isp_band_args){ ctx, i, host_input, host_result, dnn_input,
+                               dnn_align_pad };
+  }
+  if (ctx->num_bands == 1) {
+    isp_process_band(&args[0]);
+    return;
+  }
+  for (int i = 0; i < ctx->num_bands; i++)
+    thread_dispatch(isp_process_band, &args[i]);
+  thread_pool_join();
+}
+
+// Runs the half-precision frame dataflow in software, on the host copies of
+// the frame and the camera model.
+static void isp_process_frame_half(isp_context_t *ctx, uint8_t *host_input,
+                                   uint8_t *host_result) {
+  isp_hw_impl_fp16(ctx->row_size, ctx->col_size, ctx->raw_format,
+                   ctx->raw_bit_depth, &ctx->graph, host_input, host_result,
+                   ctx->half_frames, ctx->line_buffers, ctx->resize_plan,
+                   ctx->resize_rings, ctx->TsTw, ctx->ctrl_pts, ctx->weights,
+                   ctx->coefs, ctx->tone_map, ctx->l2_dist,
+                   ctx->gamut_map_impl, ctx->gamut_lut,
+                   ctx->gamut_caches ? ctx->gamut_caches[0] : NULL,
+                   ctx->band_stats);
+}
+
+// Runs the fixed-point dataflow in software, on the host copy of the frame.
+static void isp_process_frame_fixed(isp_context_t *ctx, uint8_t *host_input,
+                                    uint8_t *host_result) {
+  isp_hw_impl_fixed(ctx->row_size, ctx->col_size, ctx->raw_format,
+                    ctx->raw_bit_depth, &ctx->graph, host_input, host_result,
+                    ctx->q_frames, ctx->q_resize_temp, ctx->q_params);
+}
+
+// Create a gamut map cache for every band. The gamut map may run before the
+// resize stage, so each one holds rows of the input width.
+static void isp_context_create_gamut_caches(isp_context_t *ctx) {
+  size_t band_bytes = (size_t)gamut_cache_kb * 1024 / ctx->num_bands;
+  ctx->gamut_caches = malloc(sizeof(gamut_cache_t *) * ctx->num_bands);
+  for (int i = 0; i < ctx->num_bands; i++)
+    ctx->gamut_caches[i] = create_gamut_cache(band_bytes, ctx->col_size);
+}
+
+// Returns the transposed TsTw of white balance preset wb_index. It points into
+// the compiled camera model if there is one, and is allocated otherwise.
+static float *isp_context_get_TsTw(isp_context_t *ctx, int wb_index) {
+  if (ctx->cam_model)
+    return cam_model_TsTw(ctx->cam_model, wb_index);
+  float *TsTw = get_TsTw(ctx->cam_model_path, wb_index);
+  float *TsTw_tran = transpose_mat(TsTw, CHAN_SIZE, CHAN_SIZE);
+  free(TsTw);
+  return TsTw_tran;
+}
+
+// Allocate the partial statistics of every band, and load the white balance
+// matrices of every preset.
+static void isp_context_create_stats(isp_context_t *ctx) {
+  ctx->band_stats = malloc_aligned(sizeof(isp_stats_t) * ctx->num_bands);
+  clear_isp_stats(&ctx->stats);
+  const int mat_size = CHAN_SIZE * CHAN_SIZE;
+  if (ctx->cam_model) {
+    ctx->num_wb_presets = ctx->cam_model->header->num_wb_presets;
+    ctx->wb_presets =
+        malloc_aligned(sizeof(float) * ctx->num_wb_presets * mat_size);
+    memcpy(ctx->wb_presets, cam_model_Tw(ctx->cam_model, 1),
+           sizeof(float) * ctx->num_wb_presets * mat_size);
+  } else {
+    ctx->num_wb_presets = get_num_wb_presets(ctx->cam_model_path);
+    ctx->wb_presets =
+        malloc_aligned(sizeof(float) * ctx->num_wb_presets * mat_size);
+    for (int i = 0; i < ctx->num_wb_presets; i++) {
+      float *Tw = get_Tw(ctx->cam_model_path, i + 1);
+      memcpy(&ctx->wb_presets[i * mat_size], Tw, sizeof(float) * mat_size);
+      free(Tw);
+    }
+  }
+}
+
+isp_context_t *isp_context_create(int row_size, int col_size) {
+  assert((isp_dataflow != IspFrameDataflow ||
+          gamut_map_impl == GamutMapExact) &&
+         "Only the exact gamut map is supported by the frame dataflow!");
+  assert((isp_dataflow != IspFrameDataflow ||
+          find_isp_graph_impl(&isp_graph, IspImplSimd) < 0) &&
+         "The frame dataflow only runs the scalar demosaic and denoise!");
+  assert(check_raw_format(raw_format, col_size) == 0 &&
+         "The frame width is not a whole number of packed pixel groups!");
+  assert((raw_format != RawBayer16 ||
+          (raw_bit_depth >= 1 && raw_bit_depth <= 16)) &&
+         "RawBayer16 samples have between 1 and 16 bits!");
+  assert(check_resize_cfg(&isp_resize, row_size, col_size) == 0 &&
+         "The resize crop does not fit the frame, or the output is larger "
+         "than the crop!");
+  assert((isp_resize.method == ResizeNone ||
+          find_isp_graph_stage(&isp_graph, IspStageResize) >= 0) &&
+         "The frame is resized, but the ISP graph has no resize stage!");
+  assert((!isp_collect_stats || isp_dataflow == IspStreamingDataflow ||
+          isp_dataflow == IspHalfFrameDataflow) &&
+         "Only the streaming and half-precision frame dataflows collect 3A "
+         "statistics!");
+  assert((isp_denoise_size == 3 || isp_dataflow == IspStreamingDataflow) &&
+         "Only the streaming dataflow has denoise windows larger than 3x3!");
+  assert(isp_denoise_size % 2 == 1 && isp_denoise_size >= 3 &&
+         isp_denoise_size <= MEDIAN_HIST_MAX_SIZE &&
+         "The denoise window must be odd, from 3 to MEDIAN_HIST_MAX_SIZE!");
+  assert((isp_dataflow != IspStreamingDataflow ||
+          check_isp_graph_order(&isp_graph) == 0) &&
+         "The streaming dataflow only runs the ISP stages in the default "
+         "order!");
+  isp_context_t *ctx = malloc(sizeof(isp_context_t));
+  memset(ctx, 0, sizeof(isp_context_t));
+  ctx->row_size = row_size;
+  ctx->col_size = col_size;
+  ctx->dataflow = isp_dataflow;
+  ctx->raw_format = raw_format;
+  ctx->raw_bit_depth = raw_bit_depth;
+  ctx->gamut_map_impl = gamut_map_impl;
+  ctx->graph = isp_graph;
+  ctx->resize = isp_resize;
+  ctx->fuse_color = isp_fuse_color;
+  ctx->denoise_size = isp_denoise_size;
+  ctx->wb_index = wb_index;
+  ctx->out_row_size = get_resize_out_rows(&isp_resize, row_size);
+  ctx->out_col_size = get_resize_out_cols(&isp_resize, col_size);
+
+  const char* cava_home = getenv("CAVA_HOME");
+  if (cava_home == NULL) {
+      fprintf(stderr, "CAVA_HOME returned NULL\n");
+      exit(1);
+  }
+  int len = snprintf(ctx->cam_model_path, sizeof(ctx->cam_model_path),
+                     "%s/cam_vision_pipe/cam_models/NikonD7000/", cava_home);
+  if (len >= (int)sizeof(ctx->cam_model_path)) {
+      fprintf(stderr, "The camera model path under %s is too long!\n",
+              cava_home);
+      exit(1);
+  }
+
+  // Use the compiled camera model if there is one, and parse the text files
+  // otherwise.
+  char bin_path[sizeof(ctx->cam_model_path) + sizeof(CAM_MODEL_BIN_NAME)];
+  snprintf(bin_path, sizeof(bin_path), "%s%s", ctx->cam_model_path,
+           CAM_MODEL_BIN_NAME);
+  ctx->cam_model = map_cam_model(bin_path);
+  if (ctx->cam_model) {
+    if (ctx->cam_model->header->num_ctrl_pts != num_ctrl_pts) {
+      fprintf(stderr, "%s has %d control points, but %d are expected!\n",
+              bin_path, ctx->cam_model->header->num_ctrl_pts, num_ctrl_pts);
+      exit(1);
+    }
+    ctx->TsTw = isp_context_get_TsTw(ctx, wb_index);
+    ctx->ctrl_pts = cam_model_ctrl_pts(ctx->cam_model);
+    ctx->weights = cam_model_weights(ctx->cam_model);
+    ctx->coefs = cam_model_coefs(ctx->cam_model);
+    ctx->tone_map = cam_model_tone_map(ctx->cam_model);
+  } else {
+    ctx->TsTw = isp_context_get_TsTw(ctx, wb_index);
+    ctx->ctrl_pts = get_ctrl_pts(ctx->cam_model_path, num_ctrl_pts);
+    ctx->weights = get_weights(ctx->cam_model_path, num_ctrl_pts);
+    ctx->coefs = get_coefs(ctx->cam_model_path, num_ctrl_pts);
+    ctx->tone_map = get_tone_map(ctx->cam_model_path);
+  }
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  if (ctx->dataflow == IspStreamingDataflow) {
+    // Every band needs at least one output row of its own.
+    ctx->num_bands = min(max(thread_pool.num_threads, 1), ctx->out_row_size);
+    ctx->line_buffers = malloc_aligned(
+        sizeof(float) * ctx->num_bands *
+        get_streaming_line_buffer_size(col_size, ctx->denoise_size));
+    if (ctx->denoise_size > 3) {
+      ctx->denoise_hists = malloc(sizeof(median_hist_t *) * ctx->num_bands);
+      for (int i = 0; i < ctx->num_bands; i++) {
+        ctx->denoise_hists[i] =
+            create_median_hist(ctx->denoise_size, col_size);
+      }
+    }
+    ctx->l2_dist =
+        malloc_aligned(sizeof(float) * ctx->num_bands * num_ctrl_pts);
+    ctx->stage_times = calloc(ctx->num_bands * NumIspStages, sizeof(double));
+    if (ctx->resize.method != ResizeNone) {
+      ctx->resize_plan = build_resize_plan(ctx->resize);
+      ctx->resize_rings =
+          malloc_aligned(sizeof(float) * ctx->num_bands *
+                         get_resize_ring_size(ctx->resize_plan));
+    }
+    if (ctx->gamut_map_impl == GamutMapLut) {
+      ctx->gamut_lut =
+          build_gamut_lut(gamut_lut_size, gamut_lut_interp, ctx->ctrl_pts,
+                          ctx->weights, ctx->coefs, ctx->TsTw);
+    }
+    if (ctx->gamut_map_impl == GamutMapMemo)
+      isp_context_create_gamut_caches(ctx);
+    if (isp_collect_stats)
+      isp_context_create_stats(ctx);
+  } else if (ctx->dataflow == IspHalfFrameDataflow) {
+    ctx->num_bands = 1;
+    ctx->half_frames = malloc_aligned(sizeof(uint16_t) * 2 * frame_size);
+    ctx->line_buffers =
+        malloc_aligned(sizeof(float) * get_fp16_isp_row_buffer_size(col_size));
+    ctx->l2_dist = malloc_aligned(sizeof(float) * num_ctrl_pts);
+    if (ctx->resize.method != ResizeNone) {
+      ctx->resize_plan = build_resize_plan(ctx->resize);
+      ctx->resize_rings =
+          malloc_aligned(sizeof(float) * get_resize_ring_size(ctx->resize_plan));
+    }
+    if (ctx->gamut_map_impl == GamutMapLut) {
+      ctx->gamut_lut =
+          build_gamut_lut(gamut_lut_size, gamut_lut_interp, ctx->ctrl_pts,
+                          ctx->weights, ctx->coefs, ctx->TsTw);
+    }
+    if (ctx->gamut_map_impl == GamutMapMemo)
+      isp_context_create_gamut_caches(ctx);
+    if (isp_collect_stats)
+      isp_context_create_stats(ctx);
+  } else if (ctx->dataflow == IspFixedPointDataflow) {
+    if (ctx->resize.method != ResizeNone)
+      ctx->resize_plan = build_resize_plan(ctx->resize);
+    ctx->gamut_lut =
+        build_gamut_lut(gamut_lut_size, gamut_lut_interp, ctx->ctrl_pts,
+                        ctx->weights, ctx->coefs, ctx->TsTw);
+    ctx->q_params = build_isp_q_params(isp_frac_bits, ctx->TsTw, ctx->tone_map,
+                                       ctx->gamut_lut, ctx->resize_plan);
+    ctx->q_frames = malloc_aligned(sizeof(isp_q_t) * 2 * frame_size);
+    int temp_size = get_fixed_isp_resize_temp_size(ctx->q_params);
+    if (temp_size > 0)
+      ctx->q_resize_temp = malloc_aligned(sizeof(isp_q_t) * temp_size);
+  } else {
+    ctx->acc_input = malloc_aligned(
+        sizeof(uint8_t) *
+        get_raw_frame_bytes(ctx->raw_format, row_size, col_size));
+    ctx->acc_result = malloc_aligned(sizeof(uint8_t) * frame_size);
+    ctx->acc_input_scaled = malloc_aligned(sizeof(float) * frame_size);
+    ctx->acc_result_scaled = malloc_aligned(sizeof(float) * frame_size);
+    ctx->acc_TsTw = malloc_aligned(sizeof(float) * 9);
+    ctx->acc_ctrl_pts = malloc_aligned(sizeof(float) * num_ctrl_pts * CHAN_SIZE);
+    ctx->acc_weights = malloc_aligned(sizeof(float) * num_ctrl_pts * CHAN_SIZE);
+    ctx->acc_coefs = malloc_aligned(sizeof(float) * 12);
+    ctx->acc_tone_map = malloc_aligned(sizeof(float) * 256 * CHAN_SIZE);
+    ctx->acc_l2_dist = malloc_aligned(sizeof(float) * num_ctrl_pts);
+    isp_context_load_params(ctx);
+  }
+  return ctx;
+}
+
+void isp_process_frame_dnn(isp_context_t *ctx, uint8_t *host_input,
+                           uint8_t *host_result, uint16_t *dnn_input,
+                           int dnn_align_pad) {
+  begin_profiling(__func__, ISP_PROFILING_LAYER);
+  if (ctx->band_stats) {
+    for (int i = 0; i < ctx->num_bands; i++)
+      clear_isp_stats(&ctx->band_stats[i]);
+  }
+  if (ctx->dataflow == IspStreamingDataflow) {
+    isp_process_frame_streaming(ctx, host_input, host_result, dnn_input,
+                                dnn_align_pad);
+  } else {
+    if (ctx->dataflow == IspHalfFrameDataflow)
+      isp_process_frame_half(ctx, host_input, host_result);
+    else if (ctx->dataflow == IspFixedPointDataflow)
+      isp_process_frame_fixed(ctx, host_input, host_result);
+    else
+      isp_process_frame_accel(ctx, host_input, host_result);
+    if (dnn_input) {
+      write_dnn_input_fxp(host_result, ctx->out_row_size, ctx->out_col_size,
+                          dnn_align_pad, dnn_input);
+    }
+  }
+  if (ctx->band_stats) {
+    clear_isp_stats(&ctx->stats);
+    for (int i = 0; i < ctx->num_bands; i++)
+      merge_isp_stats(&ctx->stats, &ctx->band_stats[i]);
+  }
+  end_profiling();
+  ctx->num_frames++;
+}
+
+void isp_process_frame(isp_context_t *ctx, uint8_t *host_input,
+                       uint8_t *host_result) {
+  isp_process_frame_dnn(ctx, host_input, host_result, NULL, 0);
+}
+
+void isp_context_print_stage_times(isp_context_t *ctx) {
+  if (ctx->gamut_caches) {
+    printf("Gamut map cache, %d frames:\n", ctx->num_frames);
+    for (int band = 0; band < ctx->num_bands; band++) {
+      char name[32];
+      snprintf(name, sizeof(name), "thread %d", band);
+      print_gamut_cache_stats(ctx->gamut_caches[band], name);
+    }
+  }
+  if (ctx->dataflow != IspStreamingDataflow || ctx->num_frames == 0)
+    return;
+  printf("ISP stage time per frame (ms), %d x %d to %d x %d, %d frames:\n",
+         ctx->row_size, ctx->col_size, ctx->out_row_size, ctx->out_col_size,
+         ctx->num_frames);
+  printf("  %-10s", "thread");
+  for (int stage = 0; stage < NumIspStages; stage++)
+    printf(" %10s", isp_stage_names[stage]);
+  printf(" %10s\n", "total");
+  ARRAY_2D(double, _stage_times, ctx->stage_times, NumIspStages);
+  for (int band = 0; band < ctx->num_bands; band++) {
+    double total = 0;
+    printf("  %-10d", band);
+    for (int stage = 0; stage < NumIspStages; stage++) {
+      double time = _stage_times[band][stage] / ctx->num_frames;
+      printf(" %10.3f", time * 1e3);
+      total += time;
+    }
+    printf(" %10.3f\n", total * 1e3);
+  }
+}
+
+isp_stats_t *isp_context_get_stats(isp_context_t *ctx) {
+  return ctx->band_stats ? &ctx->stats : NULL;
+}
+
+int isp_context_pick_wb_index(isp_context_t *ctx) {
+  if (!ctx->band_stats)
+    return 0;
+  return pick_wb_preset(&ctx->stats, ctx->wb_presets, ctx->num_wb_presets);
+}
+
+void isp_context_set_wb_index(isp_context_t *ctx, int wb_index) {
+  if (wb_index == ctx->wb_index)
+    return;
+  if (!ctx->cam_model)
+    free(ctx->TsTw);
+  ctx->TsTw = isp_context_get_TsTw(ctx, wb_index);
+  ctx->wb_index = wb_index;
+  // The accelerator and the fixed-point dataflow keep their own copies.
+  if (ctx->acc_TsTw)
+    isp_context_load_params(ctx);
+  if (ctx->q_params) {
+    int frac_bits = ctx->q_params->frac_bits;
+    free_isp_q_params(ctx->q_params);
+    ctx->q_params = build_isp_q_params(frac_bits, ctx->TsTw, ctx->tone_map,
+                                       ctx->gamut_lut, ctx->resize_plan);
+  }
+}
+
+void isp_context_destroy(isp_context_t *ctx) {
+  if (ctx->cam_model) {
+    unmap_cam_model(ctx->cam_model);
+  } else {
+    free(ctx->TsTw);
+    free(ctx->ctrl_pts);
+    free(ctx->weights);
+    free(ctx->coefs);
+    free(ctx->tone_map);
+  }
+  // free(NULL) is a no-op, so this covers the buffers of either dataflow.
+  free(ctx->line_buffers);
+  free(ctx->l2_dist);
+  free(ctx->stage_times);
+  free(ctx->band_stats);
+  free(ctx->wb_presets);
+  if (ctx->gamut_lut)
+    free_gamut_lut(ctx->gamut_lut);
+  if (ctx->gamut_caches) {
+    for (int i = 0; i < ctx->num_bands; i++)
+      free_gamut_cache(ctx->gamut_caches[i]);
+    free(ctx->gamut_caches);
+  }
+  if (ctx->denoise_hists) {
+    for (int i = 0; i < ctx->num_bands; i++)
+      free_median_hist(ctx->denoise_hists[i]);
+    free(ctx->denoise_hists);
+  }
+  if (ctx->resize_plan)
+    free_resize_plan(ctx->resize_plan);
+  free(ctx->resize_rings);
+  free(ctx->half_frames);
+  if (ctx->q_params)
+    free_isp_q_params(ctx->q_params);
+  free(ctx->q_frames);
+  free(ctx->q_resize_temp);
+  free(ctx->acc_input);
+  free(ctx->acc_result);
+  free(ctx->acc_input_scaled);
+  free(ctx->acc_result_scaled);
+  free(ctx->acc_TsTw);
+  free(ctx->acc_ctrl_pts);
+  free(ctx->acc_weights);
+  free(ctx->acc_coefs);
+  free(ctx->acc_tone_map);
+  free(ctx->acc_l2_dist);
+  free(ctx);
+}
+
+void cam_pipe(uint8_t *host_input, uint8_t *host_result, int row_size,
+              int col_size) {
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  isp_process_frame(ctx, host_input, host_result);
+  isp_context_destroy(ctx);
+}
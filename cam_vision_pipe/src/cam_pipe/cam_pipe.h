@@ -1,6 +1,183 @@
 #ifndef _CAM_PIPE_H_
 #define _CAM_PIPE_H_
 
+#include "kernels/isp_fixed.h"
+#include "kernels/isp_fp16.h"
+#include "kernels/streaming_isp.h"
+#include "utility/cam_model_bin.h"
+
+// How data flows between the ISP stages.
+//
+// IspFrameDataflow: Every stage runs over the whole frame before the next one
+//   starts, ping-ponging two full-frame float buffers. This is the dataflow
+//   of the ISP accelerator.
+// IspStreamingDataflow: Rows are pushed through all stages using small
+//   rolling line buffers (see kernels/streaming_isp.h). This runs in software
+//   and keeps the working set proportional to the frame width.
+// IspHalfFrameDataflow: Like IspFrameDataflow, but the two frame buffers hold
+//   fp16 (see kernels/isp_fp16.h). This runs in software, and its output
+//   differs slightly from the other two.
+// IspFixedPointDataflow: Like IspFrameDataflow, but every stage computes on
+//   int16 Q-format samples with isp_frac_bits fractional bits (see
+//   kernels/isp_fixed.h). This runs in software, always interpolates the
+//   gamut map LUT, and its output differs slightly from the float dataflows.
+typedef enum _isp_dataflow_t {
+  IspFrameDataflow,
+  IspStreamingDataflow,
+  IspHalfFrameDataflow,
+  IspFixedPointDataflow,
+} isp_dataflow_t;
+
+extern isp_dataflow_t isp_dataflow;
+extern raw_format_t raw_format;
+extern int raw_bit_depth;
+extern gamut_map_impl_t gamut_map_impl;
+extern int gamut_lut_size;
+extern lut_interp_t gamut_lut_interp;
+extern int gamut_cache_kb;
+extern isp_graph_t isp_graph;
+extern resize_cfg_t isp_resize;
+extern int isp_fuse_color;
+extern int isp_frac_bits;
+extern int isp_collect_stats;
+extern int isp_denoise_size;
+
+// A persistent ISP context for processing a stream of frames.
+//
+// Creating a context loads the camera model and allocates every buffer the
+// selected dataflow needs, using the configuration globals above at the time
+// of creation. Each frame after that only costs the pixel work, so the same
+// context should be reused for every frame of a video.
+typedef struct _isp_context_t {
+  int row_size;
+  int col_size;
+  isp_dataflow_t dataflow;
+  raw_format_t raw_format;
+  int raw_bit_depth;
+  gamut_map_impl_t gamut_map_impl;
+  isp_graph_t graph;
+  resize_cfg_t resize;
+  // Whether the frame dataflow fuses the color stages (see color_pipe_fxp),
+  // when they are the last ones in the graph.
+  int fuse_color;
+  // Window of the denoise median, in rows and columns.
+  int denoise_size;
+  // Size of the output frames, after the resize stage.
+  int out_row_size;
+  int out_col_size;
+  // Number of frames processed so far.
+  int num_frames;
+  // The white balance preset TsTw comes from, counting from 1.
+  int wb_index;
+  char cam_model_path[256];
+
+  // Host copies of the camera model. TsTw is stored transposed. If the model
+  // has been compiled, these point into the mapped cam_model.
+  cam_model_t *cam_model;
+  float *TsTw;
+  float *ctrl_pts;
+  float *weights;
+  float *coefs;
+  float *tone_map;
+
+  // Streaming dataflow scratch space. Frames are split into num_bands bands
+  // of rows, each with its own line buffers and l2_dist. The half-precision
+  // frame dataflow uses a single band.
+  int num_bands;
+  float *line_buffers;
+  float *l2_dist;
+  gamut_lut_t *gamut_lut;
+  // A gamut map cache per band, with GamutMapMemo. They keep their colors
+  // from one frame to the next.
+  gamut_cache_t **gamut_caches;
+  // The column histograms of each band, if the denoise window is larger than
+  // 3x3.
+  median_hist_t **denoise_hists;
+  // The resize taps, and a resize ring per band, if the frame is resized.
+  resize_plan_t *resize_plan;
+  float *resize_rings;
+  // Seconds spent in each stage by each band, as [num_bands][NumIspStages],
+  // over every frame so far.
+  double *stage_times;
+  // If the context collects 3A statistics, the partial statistics of each
+  // band, and the merged statistics of the last frame. The white balance
+  // matrices of every preset, as [num_wb_presets][3][3], are kept for
+  // choosing the next preset.
+  isp_stats_t *band_stats;
+  isp_stats_t stats;
+  int num_wb_presets;
+  float *wb_presets;
+
+  // The two fp16 frames of the half-precision frame dataflow. Its row
+  // scratch space is line_buffers.
+  uint16_t *half_frames;
+
+  // The quantized parameters, the two frames and the resize scratch space of
+  // the fixed-point dataflow.
+  isp_q_params_t *q_params;
+  isp_q_t *q_frames;
+  isp_q_t *q_resize_temp;
+
+  // Accelerator buffers for the frame dataflow. The camera model is loaded
+  // into these once, when the context is created.
+  uint8_t *acc_input;
+  uint8_t *acc_result;
+  float *acc_input_scaled;
+  float *acc_result_scaled;
+  float *acc_TsTw;
+  float *acc_ctrl_pts;
+  float *acc_weights;
+  float *acc_coefs;
+  float *acc_tone_map;
+  float *acc_l2_dist;
+} isp_context_t;
+
+// Create an ISP context for row_size x col_size frames.
+//
+// With the streaming dataflow, if the thread pool has been initialized with
+// more than one thread, each frame is split into one band of rows per thread
+// and the bands are processed in parallel.
+isp_context_t *isp_context_create(int row_size, int col_size);
+
+// Run one frame through the ISP. host_input holds a frame in the raw_format
+// of the context, which is get_raw_frame_bytes() bytes. host_result receives
+// the CHW output frame of out_row_size * out_col_size * CHAN_SIZE bytes.
+void isp_process_frame(isp_context_t *ctx, uint8_t *host_input,
+                       uint8_t *host_result);
+
+// Like isp_process_frame, but also write the output frame to dnn_input in
+// the input layout of the first convolution of an SMV network: fp16 NHWC,
+// with dnn_align_pad padding channels per pixel (see kernels/dnn_handoff.h).
+// dnn_input must hold out_row_size * out_col_size * (CHAN_SIZE +
+// dnn_align_pad) fp16 values.
+//
+// The streaming dataflow writes each row as soon as it has been tone mapped.
+// The frame dataflows still convert the whole output frame afterwards, in a
+// separate pass, as the accelerator they model only produces the uint8 frame.
+void isp_process_frame_dnn(isp_context_t *ctx, uint8_t *host_input,
+                           uint8_t *host_result, uint16_t *dnn_input,
+                           int dnn_align_pad);
+
+// Print the average time per frame spent in each stage by each thread. This
+// is only tracked for the streaming dataflow. Also print the hit rate of the
+// gamut map caches, if there are any.
+void isp_context_print_stage_times(isp_context_t *ctx);
+
+// Returns the 3A statistics of the last frame, or NULL if the context does
+// not collect them. They are only collected by the streaming and
+// half-precision frame dataflows, when isp_collect_stats is set.
+isp_stats_t *isp_context_get_stats(isp_context_t *ctx);
+
+// Returns the white balance preset that makes the last frame the most
+// neutral (see pick_wb_preset), or 0 if there are no statistics.
+int isp_context_pick_wb_index(isp_context_t *ctx);
+
+// Use white balance preset wb_index, counting from 1, from the next frame on.
+void isp_context_set_wb_index(isp_context_t *ctx, int wb_index);
+
+void isp_context_destroy(isp_context_t *ctx);
+
+// Run a single frame through a temporary ISP context.
 void cam_pipe(uint8_t *host_input, uint8_t *host_result, int row_size,
               int col_size);
 
@@ -0,0 +1,169 @@
+#include <string.h>
+#include "isp_simd.h"
+#include "demosaic_simd.h"
+
+// Demosaic ISP_VECTOR_SIZE pixels of an even (G R) row starting at col.
+// is_green has the lanes of the green (even) columns set.
+static inline void demosaic_even_vec(float *above, float *input, float *below,
+                                     int plane_size, int col, float *result,
+                                     int result_plane_size,
+                                     isp_ivec_t is_green) {
+  ARRAY_2D(float, _above, above, plane_size);
+  ARRAY_2D(float, _input, input, plane_size);
+  ARRAY_2D(float, _below, below, plane_size);
+  ARRAY_2D(float, _result, result, result_plane_size);
+
+  // Green pixel: R from the left and right, B from above and below.
+  isp_vec_t green_r =
+      (VEC_AT(&_input[0][col - 1]) + VEC_AT(&_input[0][col + 1])) / 2;
+  isp_vec_t green_g = VEC_AT(&_input[1][col]) * 2;
+  isp_vec_t green_b =
+      (VEC_AT(&_above[2][col]) + VEC_AT(&_below[2][col])) / 2;
+  // Red pixel: G from the four neighbours, B from the four diagonals.
+  isp_vec_t red_r = VEC_AT(&_input[0][col]);
+  isp_vec_t red_g = (VEC_AT(&_above[1][col]) + VEC_AT(&_below[1][col]) +
+                     VEC_AT(&_input[1][col - 1]) +
+                     VEC_AT(&_input[1][col + 1])) / 2;
+  isp_vec_t red_b = (VEC_AT(&_above[2][col - 1]) +
+                     VEC_AT(&_above[2][col + 1]) +
+                     VEC_AT(&_below[2][col - 1]) +
+                     VEC_AT(&_below[2][col + 1])) / 4;
+
+  VEC_AT(&_result[0][col]) = VEC_SELECT(is_green, green_r, red_r);
+  VEC_AT(&_result[1][col]) = VEC_SELECT(is_green, green_g, red_g);
+  VEC_AT(&_result[2][col]) = VEC_SELECT(is_green, green_b, red_b);
+}
+
+// Demosaic ISP_VECTOR_SIZE pixels of an odd (B G) row starting at col.
+// is_blue has the lanes of the blue (even) columns set.
+static inline void demosaic_odd_vec(float *above, float *input, float *below,
+                                    int plane_size, int col, float *result,
+                                    int result_plane_size,
+                                    isp_ivec_t is_blue) {
+  ARRAY_2D(float, _above, above, plane_size);
+  ARRAY_2D(float, _input, input, plane_size);
+  ARRAY_2D(float, _below, below, plane_size);
+  ARRAY_2D(float, _result, result, result_plane_size);
+
+  // Blue pixel: R from the four diagonals, G from the four neighbours.
+  isp_vec_t blue_r = (VEC_AT(&_above[0][col - 1]) +
+                      VEC_AT(&_below[0][col - 1]) +
+                      VEC_AT(&_above[0][col + 1]) +
+                      VEC_AT(&_below[0][col + 1])) / 4;
+  isp_vec_t blue_g = (VEC_AT(&_above[1][col]) + VEC_AT(&_below[1][col]) +
+                      VEC_AT(&_input[1][col - 1]) +
+                      VEC_AT(&_input[1][col + 1])) / 2;
+  isp_vec_t blue_b = VEC_AT(&_input[2][col]);
+  // Bottom green pixel: R from above and below, B from the left and right.
+  isp_vec_t green_r =
+      (VEC_AT(&_above[0][col]) + VEC_AT(&_below[0][col])) / 2;
+  isp_vec_t green_g = VEC_AT(&_input[1][col]) * 2;
+  isp_vec_t green_b =
+      (VEC_AT(&_input[2][col - 1]) + VEC_AT(&_input[2][col + 1])) / 2;
+
+  VEC_AT(&_result[0][col]) = VEC_SELECT(is_blue, blue_r, green_r);
+  VEC_AT(&_result[1][col]) = VEC_SELECT(is_blue, blue_g, green_g);
+  VEC_AT(&_result[2][col]) = VEC_SELECT(is_blue, blue_b, green_b);
+}
+
+// Scalar fallback for rows narrower than a vector.
+static void demosaic_row_scalar(float *above, float *input, float *below,
+                                int plane_size, int row, int col_size,
+                                float *result, int result_plane_size) {
+  ARRAY_2D(float, _above, above, plane_size);
+  ARRAY_2D(float, _input, input, plane_size);
+  ARRAY_2D(float, _below, below, plane_size);
+  ARRAY_2D(float, _result, result, result_plane_size);
+
+  for (int col = 1; col < col_size - 1; col++) {
+    if (row % 2 == 0 && col % 2 == 0) {
+      _result[0][col] = (_input[0][col - 1] + _input[0][col + 1]) / 2;
+      _result[1][col] = _input[1][col] * 2;
+      _result[2][col] = (_above[2][col] + _below[2][col]) / 2;
+    } else if (row % 2 == 0) {
+      _result[0][col] = _input[0][col];
+      _result[1][col] = (_above[1][col] + _below[1][col] +
+                         _input[1][col - 1] + _input[1][col + 1]) / 2;
+      _result[2][col] = (_above[2][col - 1] + _above[2][col + 1] +
+                         _below[2][col - 1] + _below[2][col + 1]) / 4;
+    } else if (col % 2 == 0) {
+      _result[0][col] = (_above[0][col - 1] + _below[0][col - 1] +
+                         _above[0][col + 1] + _below[0][col + 1]) / 4;
+      _result[1][col] = (_above[1][col] + _below[1][col] +
+                         _input[1][col - 1] + _input[1][col + 1]) / 2;
+      _result[2][col] = _input[2][col];
+    } else {
+      _result[0][col] = (_above[0][col] + _below[0][col]) / 2;
+      _result[1][col] = _input[1][col] * 2;
+      _result[2][col] = (_input[2][col - 1] + _input[2][col + 1]) / 2;
+    }
+  }
+}
+
+void demosaic_row_simd(float *above, float *input, float *below,
+                       int plane_size, int row, int col_size, float *result,
+                       int result_plane_size) {
+  ARRAY_2D(float, _result, result, result_plane_size);
+
+  dm_simd_border:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    _result[chan][0] = 0;
+    _result[chan][col_size - 1] = 0;
+  }
+
+  int last = col_size - 1 - ISP_VECTOR_SIZE;
+  if (last < 1) {
+    demosaic_row_scalar(above, input, below, plane_size, row, col_size, result,
+                        result_plane_size);
+    return;
+  }
+
+  // Lanes of the even columns of a vector starting at an odd or even column.
+  isp_ivec_t even_from_odd, even_from_even;
+  for (int i = 0; i < ISP_VECTOR_SIZE; i++) {
+    even_from_odd[i] = i % 2 == 1 ? -1 : 0;
+    even_from_even[i] = ~even_from_odd[i];
+  }
+
+  // Vectors start at column 1, so they all start at an odd column. The last
+  // one is moved back to end at the last interior column; it overlaps the
+  // previous vector and rewrites the same values.
+  if (row % 2 == 0) {
+    dm_simd_even_col:
+    for (int col = 1; col < last; col += ISP_VECTOR_SIZE) {
+      demosaic_even_vec(above, input, below, plane_size, col, result,
+                        result_plane_size, even_from_odd);
+    }
+    demosaic_even_vec(above, input, below, plane_size, last, result,
+                      result_plane_size,
+                      last % 2 == 1 ? even_from_odd : even_from_even);
+  } else {
+    dm_simd_odd_col:
+    for (int col = 1; col < last; col += ISP_VECTOR_SIZE) {
+      demosaic_odd_vec(above, input, below, plane_size, col, result,
+                       result_plane_size, even_from_odd);
+    }
+    demosaic_odd_vec(above, input, below, plane_size, last, result,
+                     result_plane_size,
+                     last % 2 == 1 ? even_from_odd : even_from_even);
+  }
+}
+
+void demosaic_simd_fxp(float *input, int row_size, int col_size,
+                       float *result) {
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(float, _result, result, row_size, col_size);
+  int plane_size = row_size * col_size;
+
+  dm_simd_border_row:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    memset(_result[chan][0], 0, sizeof(float) * col_size);
+    memset(_result[chan][row_size - 1], 0, sizeof(float) * col_size);
+  }
+  dm_simd_row:
+  for (int row = 1; row < row_size - 1; row++) {
+    demosaic_row_simd(&_input[0][row - 1][0], &_input[0][row][0],
+                      &_input[0][row + 1][0], plane_size, row, col_size,
+                      &_result[0][row][0], plane_size);
+  }
+}
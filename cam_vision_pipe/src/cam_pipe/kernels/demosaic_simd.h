@@ -0,0 +1,34 @@
+#ifndef _DEMOSAIC_SIMD_H_
+#define _DEMOSAIC_SIMD_H_
+
+#include "pipe_stages.h"
+
+// Vectorized demosaic of one row.
+//
+// The GRBG pattern only depends on the parity of the row and column, so even
+// and odd rows run separate specialized loops. Within a row, both candidate
+// formulas are evaluated for ISP_VECTOR_SIZE columns and blended with a fixed
+// even/odd lane mask, so there is no per-pixel branch. Each output pixel uses
+// the same arithmetic as demosaic_fxp, so the results are identical. The first
+// and last columns are set to zero.
+//
+// Args:
+//   above, input, below: The rows above, at and below the output row. The
+//      channels of each are plane_size floats apart.
+//   row: The index of the output row, which must not be the first or last
+//      row of the frame.
+//   result: The output row, with channels result_plane_size floats apart.
+void demosaic_row_simd(float* above,
+                       float* input,
+                       float* below,
+                       int plane_size,
+                       int row,
+                       int col_size,
+                       float* result,
+                       int result_plane_size);
+
+// Vectorized version of demosaic_fxp, for CHW images. The outermost rows and
+// columns are set to zero.
+void demosaic_simd_fxp(float* input, int row_size, int col_size, float* result);
+
+#endif
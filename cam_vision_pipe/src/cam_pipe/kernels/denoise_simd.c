@@ -0,0 +1,82 @@
+#include <string.h>
+#include "isp_simd.h"
+#include "denoise_simd.h"
+
+// Number of output pixels whose column sorts are buffered at once.
+#define DN_CHUNK_SIZE 256
+
+void median3x3_row_simd(float *above, float *input, float *below,
+                        int col_size, float *result) {
+  float lo[DN_CHUNK_SIZE + 2], mid[DN_CHUNK_SIZE + 2], hi[DN_CHUNK_SIZE + 2];
+
+  result[0] = input[0];
+  result[col_size - 1] = input[col_size - 1];
+
+  dn_simd_chunk:
+  for (int start = 1; start < col_size - 1; start += DN_CHUNK_SIZE) {
+    int num_outputs = min(DN_CHUNK_SIZE, col_size - 1 - start);
+    int num_cols = num_outputs + 2;
+
+    // Sort each column of the windows, starting from the one left of start.
+    int i = 0;
+    dn_simd_sort_cols:
+    for (; i + ISP_VECTOR_SIZE <= num_cols; i += ISP_VECTOR_SIZE) {
+      isp_vec_t a = VEC_AT(&above[start - 1 + i]);
+      isp_vec_t b = VEC_AT(&input[start - 1 + i]);
+      isp_vec_t c = VEC_AT(&below[start - 1 + i]);
+      SORT3(a, b, c, VEC_MIN, VEC_MAX);
+      VEC_AT(&lo[i]) = a;
+      VEC_AT(&mid[i]) = b;
+      VEC_AT(&hi[i]) = c;
+    }
+    dn_simd_sort_cols_tail:
+    for (; i < num_cols; i++) {
+      float a = above[start - 1 + i];
+      float b = input[start - 1 + i];
+      float c = below[start - 1 + i];
+      SORT3(a, b, c, min, max);
+      lo[i] = a;
+      mid[i] = b;
+      hi[i] = c;
+    }
+
+    // Combine the three columns of each window.
+    int j = 0;
+    dn_simd_median:
+    for (; j + ISP_VECTOR_SIZE <= num_outputs; j += ISP_VECTOR_SIZE) {
+      isp_vec_t lo_max = VEC_MAX(VEC_MAX(VEC_AT(&lo[j]), VEC_AT(&lo[j + 1])),
+                                 VEC_AT(&lo[j + 2]));
+      isp_vec_t hi_min = VEC_MIN(VEC_MIN(VEC_AT(&hi[j]), VEC_AT(&hi[j + 1])),
+                                 VEC_AT(&hi[j + 2]));
+      isp_vec_t mid_med = MED3(VEC_AT(&mid[j]), VEC_AT(&mid[j + 1]),
+                               VEC_AT(&mid[j + 2]), VEC_MIN, VEC_MAX);
+      VEC_AT(&result[start + j]) =
+          MED3(lo_max, mid_med, hi_min, VEC_MIN, VEC_MAX);
+    }
+    dn_simd_median_tail:
+    for (; j < num_outputs; j++) {
+      float lo_max = max(max(lo[j], lo[j + 1]), lo[j + 2]);
+      float hi_min = min(min(hi[j], hi[j + 1]), hi[j + 2]);
+      float mid_med = MED3(mid[j], mid[j + 1], mid[j + 2], min, max);
+      result[start + j] = MED3(lo_max, mid_med, hi_min, min, max);
+    }
+  }
+}
+
+void denoise_simd_fxp(float *input, int row_size, int col_size,
+                      float *result) {
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(float, _result, result, row_size, col_size);
+
+  dn_simd_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    memcpy(_result[chan][0], _input[chan][0], sizeof(float) * col_size);
+    memcpy(_result[chan][row_size - 1], _input[chan][row_size - 1],
+           sizeof(float) * col_size);
+    dn_simd_row:
+    for (int row = 1; row < row_size - 1; row++) {
+      median3x3_row_simd(_input[chan][row - 1], _input[chan][row],
+                         _input[chan][row + 1], col_size, _result[chan][row]);
+    }
+  }
+}
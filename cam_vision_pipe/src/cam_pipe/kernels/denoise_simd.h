@@ -0,0 +1,31 @@
+#ifndef _DENOISE_SIMD_H_
+#define _DENOISE_SIMD_H_
+
+#include "pipe_stages.h"
+
+// Vectorized 3x3 median filter for one channel of one row.
+//
+// Rather than sorting every window, each column of three pixels is sorted
+// once into (lo, mid, hi) and shared by the three windows that overlap it.
+// The median of a window is then
+//
+//   med3(max(lo[j-1..j+1]), med3(mid[j-1..j+1]), min(hi[j-1..j+1]))
+//
+// which is the min/max network of the classic 19 operation median-of-9, but
+// branch-free and evaluated for ISP_VECTOR_SIZE output pixels at a time. The
+// first and last pixels are copied from the input, like denoise_fxp does for
+// the border, so the output matches denoise_fxp exactly.
+//
+// Args:
+//   above, input, below: The rows above, at and below the output row.
+//   result: The output row. Must not alias the inputs.
+void median3x3_row_simd(float* above,
+                        float* input,
+                        float* below,
+                        int col_size,
+                        float* result);
+
+// Vectorized version of denoise_fxp, for CHW images.
+void denoise_simd_fxp(float* input, int row_size, int col_size, float* result);
+
+#endif
@@ -0,0 +1,33 @@
+#include "fp16.h"
+#include "dnn_handoff.h"
+
+void init_dnn_fp16_lut(uint16_t lut[256]) {
+  for (int i = 0; i < 256; i++)
+    lut[i] = fp16_ieee_from_fp32_value(i);
+}
+
+void write_dnn_input_row(uint8_t *input, int row, int row_size, int col_size,
+                         int align_pad, uint16_t *fp16_lut, uint16_t *result) {
+  ARRAY_3D(uint8_t, _input, input, row_size, col_size);
+  ARRAY_3D(uint16_t, _result, result, col_size, CHAN_SIZE + align_pad);
+  dnn_col:
+  for (int col = 0; col < col_size; col++) {
+    dnn_chan:
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      _result[row][col][chan] = fp16_lut[_input[chan][row][col]];
+    dnn_pad:
+    for (int chan = CHAN_SIZE; chan < CHAN_SIZE + align_pad; chan++)
+      _result[row][col][chan] = 0;
+  }
+}
+
+void write_dnn_input_fxp(uint8_t *input, int row_size, int col_size,
+                         int align_pad, uint16_t *result) {
+  uint16_t fp16_lut[256];
+  init_dnn_fp16_lut(fp16_lut);
+  dnn_row:
+  for (int row = 0; row < row_size; row++) {
+    write_dnn_input_row(input, row, row_size, col_size, align_pad, fp16_lut,
+                        result);
+  }
+}
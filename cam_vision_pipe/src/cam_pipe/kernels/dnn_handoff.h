@@ -0,0 +1,35 @@
+#ifndef _DNN_HANDOFF_H_
+#define _DNN_HANDOFF_H_
+
+#include "pipe_stages.h"
+
+// Writing the ISP output straight into the input of a DNN.
+//
+// The first convolution of an SMV network reads fp16 activations in NHWC
+// order, where the CHAN_SIZE channels of every pixel are followed by
+// align_pad zeros. Its input values are the uint8 pixel values, not the
+// scaled ones. These kernels produce that buffer from the descaled ISP output,
+// so the network does not need to convert the image itself.
+//
+// fp16 values are stored as their raw bits.
+
+// Fill lut with the fp16 bits of every uint8 value.
+void init_dnn_fp16_lut(uint16_t lut[256]);
+
+// Write row of the CHW uint8 frame input to the fp16 NHWC frame result.
+void write_dnn_input_row(uint8_t* input,
+                         int row,
+                         int row_size,
+                         int col_size,
+                         int align_pad,
+                         uint16_t* fp16_lut,
+                         uint16_t* result);
+
+// Write the whole CHW uint8 frame input to the fp16 NHWC frame result.
+void write_dnn_input_fxp(uint8_t* input,
+                         int row_size,
+                         int col_size,
+                         int align_pad,
+                         uint16_t* result);
+
+#endif
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "gamut_map_cache.h"
+#include "gamut_map_simd.h"
+
+// Slots whose first key word has this value are empty. It is the bit pattern
+// of a NaN, which no transformed color has. Such a color would just never be
+// cached.
+#define GAMUT_CACHE_EMPTY 0xffffffffu
+
+gamut_cache_t *create_gamut_cache(size_t max_bytes, int max_cols) {
+  gamut_cache_t *cache = malloc(sizeof(gamut_cache_t));
+  memset(cache, 0, sizeof(gamut_cache_t));
+  cache->num_slots = GAMUT_CACHE_PROBES;
+  while (cache->num_slots * 2 * sizeof(gamut_cache_entry_t) <= max_bytes)
+    cache->num_slots *= 2;
+  cache->slots =
+      malloc_aligned(sizeof(gamut_cache_entry_t) * cache->num_slots);
+  memset(cache->slots, 0xff, sizeof(gamut_cache_entry_t) * cache->num_slots);
+  cache->max_cols = max_cols;
+  cache->miss_cols = malloc_aligned(sizeof(int) * max_cols);
+  cache->miss_input = malloc_aligned(sizeof(float) * CHAN_SIZE * max_cols);
+  cache->miss_result = malloc_aligned(sizeof(float) * CHAN_SIZE * max_cols);
+  return cache;
+}
+
+void free_gamut_cache(gamut_cache_t *cache) {
+  free(cache->slots);
+  free(cache->miss_cols);
+  free(cache->miss_input);
+  free(cache->miss_result);
+  free(cache);
+}
+
+static inline uint32_t hash_key(uint32_t *key) {
+  uint32_t hash = key[0] * 0x9e3779b1u;
+  hash = (hash ^ key[1]) * 0x85ebca77u;
+  hash = (hash ^ key[2]) * 0xc2b2ae3du;
+  return hash ^ (hash >> 16);
+}
+
+static inline int key_equals(uint32_t *a, uint32_t *b) {
+  return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+// Returns the entry of key, or NULL if it is not cached.
+static inline gamut_cache_entry_t *find_entry(gamut_cache_t *cache,
+                                              uint32_t *key) {
+  uint32_t mask = cache->num_slots - 1;
+  uint32_t slot = hash_key(key) & mask;
+  for (int i = 0; i < GAMUT_CACHE_PROBES; i++) {
+    gamut_cache_entry_t *entry = &cache->slots[(slot + i) & mask];
+    if (key_equals(entry->key, key))
+      return entry;
+    if (entry->key[0] == GAMUT_CACHE_EMPTY)
+      return NULL;
+  }
+  return NULL;
+}
+
+static void insert_entry(gamut_cache_t *cache, uint32_t *key, float *value) {
+  if (key[0] == GAMUT_CACHE_EMPTY)
+    return;
+  uint32_t mask = cache->num_slots - 1;
+  uint32_t slot = hash_key(key) & mask;
+  gamut_cache_entry_t *entry = NULL;
+  for (int i = 0; i < GAMUT_CACHE_PROBES; i++) {
+    gamut_cache_entry_t *probe = &cache->slots[(slot + i) & mask];
+    if (key_equals(probe->key, key)) {
+      // A color that missed twice in the same row.
+      return;
+    }
+    if (probe->key[0] == GAMUT_CACHE_EMPTY) {
+      entry = probe;
+      cache->num_entries++;
+      break;
+    }
+  }
+  if (!entry) {
+    // Every probed slot holds another color: replace the one in the first.
+    entry = &cache->slots[slot];
+    cache->evictions++;
+  }
+  memcpy(entry->key, key, sizeof(entry->key));
+  memcpy(entry->value, value, sizeof(entry->value));
+}
+
+void gamut_map_cached_row(gamut_cache_t *cache, float *input, int col_size,
+                          float *result, float *ctrl_pts, float *weights,
+                          float *coefs) {
+  ARRAY_2D(float, _input, input, col_size);
+  ARRAY_2D(float, _result, result, col_size);
+  int num_misses = 0;
+  gmc_lookup:
+  for (int col = 0; col < col_size; col++) {
+    uint32_t key[CHAN_SIZE];
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      memcpy(&key[chan], &_input[chan][col], sizeof(float));
+    gamut_cache_entry_t *entry = find_entry(cache, key);
+    if (!entry) {
+      cache->miss_cols[num_misses++] = col;
+      continue;
+    }
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      _result[chan][col] = entry->value[chan];
+  }
+  cache->lookups += col_size;
+  cache->hits += col_size - num_misses;
+  if (num_misses == 0)
+    return;
+
+  // Evaluate the misses as a row of their own.
+  ARRAY_2D(float, _miss_input, cache->miss_input, num_misses);
+  ARRAY_2D(float, _miss_result, cache->miss_result, num_misses);
+  gmc_gather:
+  for (int i = 0; i < num_misses; i++) {
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      _miss_input[chan][i] = _input[chan][cache->miss_cols[i]];
+  }
+  gamut_map_simd_row_fxp(cache->miss_input, num_misses, cache->miss_result,
+                         ctrl_pts, weights, coefs);
+  gmc_insert:
+  for (int i = 0; i < num_misses; i++) {
+    int col = cache->miss_cols[i];
+    uint32_t key[CHAN_SIZE];
+    float value[CHAN_SIZE];
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      memcpy(&key[chan], &_input[chan][col], sizeof(float));
+      value[chan] = _miss_result[chan][i];
+      _result[chan][col] = value[chan];
+    }
+    insert_entry(cache, key, value);
+  }
+}
+
+void print_gamut_cache_stats(gamut_cache_t *cache, const char *name) {
+  printf("  %-10s %d of %d colors (%.1f KB), %.1f%% of %lu lookups hit, "
+         "%lu evictions\n",
+         name, cache->num_entries, cache->num_slots,
+         sizeof(gamut_cache_entry_t) * cache->num_slots / 1024.0,
+         cache->lookups ? 100.0 * cache->hits / cache->lookups : 0.0,
+         cache->lookups, cache->evictions);
+}
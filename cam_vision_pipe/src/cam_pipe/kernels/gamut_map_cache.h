@@ -0,0 +1,64 @@
+#ifndef _GAMUT_MAP_CACHE_H_
+#define _GAMUT_MAP_CACHE_H_
+
+#include "pipe_stages.h"
+
+// Memoizing the exact gamut map.
+//
+// Natural images contain far fewer distinct colors than pixels, so instead of
+// evaluating the RBF for every pixel, the result for each post-transform
+// color is kept in an open-addressing hash table and reused by every later
+// pixel of that color, in the same frame or in any later frame of the stream.
+// The key is the bit pattern of the three float channels, so a hit returns
+// exactly what the RBF would. Misses are evaluated with
+// gamut_map_simd_row_fxp, and the output is the same as GamutMapSimd.
+//
+// The number of slots is fixed when the cache is created, from a memory
+// budget. A color is looked up in the GAMUT_CACHE_PROBES consecutive slots
+// starting at its hash. If all of them hold other colors when it is
+// inserted, it always replaces the color in its first slot, whether or not
+// that color is still in use. This keeps the entries small and a hit free of
+// writes. Replacing the least recently used of the probed colors instead
+// took an extra word per entry and hit less often on test_gamut_cache.
+#define GAMUT_CACHE_PROBES 8
+
+typedef struct _gamut_cache_entry_t {
+  uint32_t key[CHAN_SIZE];
+  float value[CHAN_SIZE];
+} gamut_cache_entry_t;
+
+typedef struct _gamut_cache_t {
+  // A power of two.
+  int num_slots;
+  gamut_cache_entry_t* slots;
+  // Scratch space for the misses of a row of up to max_cols pixels.
+  int max_cols;
+  int* miss_cols;
+  float* miss_input;
+  float* miss_result;
+  // Statistics since the cache was created.
+  int num_entries;
+  uint64_t lookups;
+  uint64_t hits;
+  uint64_t evictions;
+} gamut_cache_t;
+
+// Create an empty cache with as many slots as fit in max_bytes, for rows of
+// up to max_cols pixels. The row scratch space is not part of the budget.
+gamut_cache_t* create_gamut_cache(size_t max_bytes, int max_cols);
+
+void free_gamut_cache(gamut_cache_t* cache);
+
+// Gamut map a CHW row, looking up every color in cache first.
+void gamut_map_cached_row(gamut_cache_t* cache,
+                          float* input,
+                          int col_size,
+                          float* result,
+                          float* ctrl_pts,
+                          float* weights,
+                          float* coefs);
+
+// Print the size and hit rate of cache, prefixed with name.
+void print_gamut_cache_stats(gamut_cache_t* cache, const char* name);
+
+#endif
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdbool.h>
+#include "common/utility.h"
+#include "gamut_map_lut.h"
+
+// Number of random colors used to measure the error of the LUT.
+#define LUT_ERROR_SAMPLES 4096
+
+// The largest value of each channel that demosaic_fxp produces from samples
+// in [0, 1]. It doubles the green samples.
+static const float kDemosaicMax[CHAN_SIZE] = { 1, 2, 1 };
+
+// Evaluate the exact RBF for one color. The result is not clamped to zero.
+static void rbf_eval(float *color, float *result, float *ctrl_pts,
+                     float *weights, float *coefs, float *l2_dist) {
+  ARRAY_2D(float, _ctrl_pts, ctrl_pts, 3);
+  ARRAY_2D(float, _weights, weights, 3);
+  ARRAY_2D(float, _coefs, coefs, 3);
+
+  for (int cp = 0; cp < num_ctrl_pts; cp++) {
+    l2_dist[cp] = sqrt((color[0] - _ctrl_pts[cp][0]) *
+                           (color[0] - _ctrl_pts[cp][0]) +
+                       (color[1] - _ctrl_pts[cp][1]) *
+                           (color[1] - _ctrl_pts[cp][1]) +
+                       (color[2] - _ctrl_pts[cp][2]) *
+                           (color[2] - _ctrl_pts[cp][2]));
+  }
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    float chan_val = 0.0;
+    for (int cp = 0; cp < num_ctrl_pts; cp++)
+      chan_val += l2_dist[cp] * _weights[cp][chan];
+    chan_val += _coefs[0][chan] + _coefs[1][chan] * color[0] +
+                _coefs[2][chan] * color[1] + _coefs[3][chan] * color[2];
+    result[chan] = chan_val;
+  }
+}
+
+// Look up a color in the LUT. The result is not clamped to zero.
+static inline void lut_lookup(gamut_lut_t *lut, float *color, float *result) {
+  const int grid = lut->grid_size;
+  // Distance between neighbouring grid points along each channel.
+  const int stride[CHAN_SIZE] = { grid * grid * CHAN_SIZE, grid * CHAN_SIZE,
+                                  CHAN_SIZE };
+  int base = 0;
+  float frac[CHAN_SIZE];
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    float pos = (color[chan] - lut->lo[chan]) * lut->scale[chan];
+    pos = min(max(pos, 0), grid - 1);
+    int idx = min((int)pos, grid - 2);
+    frac[chan] = pos - idx;
+    base += idx * stride[chan];
+  }
+  float *c000 = &lut->table[base];
+
+  if (lut->interp == LutTrilinear) {
+    float *c100 = c000 + stride[0];
+    float *c010 = c000 + stride[1];
+    float *c001 = c000 + stride[2];
+    float *c110 = c100 + stride[1];
+    float *c101 = c100 + stride[2];
+    float *c011 = c010 + stride[2];
+    float *c111 = c110 + stride[2];
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      float c00 = c000[chan] + (c001[chan] - c000[chan]) * frac[2];
+      float c01 = c010[chan] + (c011[chan] - c010[chan]) * frac[2];
+      float c10 = c100[chan] + (c101[chan] - c100[chan]) * frac[2];
+      float c11 = c110[chan] + (c111[chan] - c110[chan]) * frac[2];
+      float c0 = c00 + (c01 - c00) * frac[1];
+      float c1 = c10 + (c11 - c10) * frac[1];
+      result[chan] = c0 + (c1 - c0) * frac[0];
+    }
+  } else {
+    // Order the channels by decreasing fraction. The point then lies in the
+    // tetrahedron c000 -> (step along a) -> (step along a, b) -> c111.
+    int a = 0, b = 1, c = 2, tmp;
+    if (frac[a] < frac[b]) { tmp = a; a = b; b = tmp; }
+    if (frac[b] < frac[c]) { tmp = b; b = c; c = tmp; }
+    if (frac[a] < frac[b]) { tmp = a; a = b; b = tmp; }
+    float *c1 = c000 + stride[a];
+    float *c2 = c1 + stride[b];
+    float *c3 = c2 + stride[c];
+    float w0 = 1 - frac[a];
+    float w1 = frac[a] - frac[b];
+    float w2 = frac[b] - frac[c];
+    float w3 = frac[c];
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      result[chan] = w0 * c000[chan] + w1 * c1[chan] + w2 * c2[chan] +
+                     w3 * c3[chan];
+  }
+}
+
+// Returns a random color for measuring the error of the LUT. With TsTw_tran,
+// this is the transform of a random demosaiced color, clamped to zero like
+// transform_fxp does. Otherwise it is uniform over the grid.
+static void random_lut_color(gamut_lut_t *lut, float *TsTw_tran,
+                             unsigned *seed, float *color) {
+  if (!TsTw_tran) {
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      color[chan] = lut->lo[chan] + (lut->hi[chan] - lut->lo[chan]) *
+                                        rand_r(seed) / RAND_MAX;
+    }
+    return;
+  }
+  ARRAY_2D(float, _TsTw_tran, TsTw_tran, CHAN_SIZE);
+  float pixel[CHAN_SIZE];
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    pixel[chan] = kDemosaicMax[chan] * rand_r(seed) / RAND_MAX;
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    color[chan] = max(pixel[0] * _TsTw_tran[0][chan] +
+                          pixel[1] * _TsTw_tran[1][chan] +
+                          pixel[2] * _TsTw_tran[2][chan],
+                      0);
+  }
+}
+
+gamut_lut_t *build_gamut_lut(int grid_size, lut_interp_t interp,
+                             float *ctrl_pts, float *weights, float *coefs,
+                             float *TsTw_tran) {
+  assert(grid_size >= 2 && "The gamut map LUT needs at least 2 grid points!");
+  ARRAY_2D(float, _ctrl_pts, ctrl_pts, 3);
+  gamut_lut_t *lut = malloc(sizeof(gamut_lut_t));
+  lut->grid_size = grid_size;
+  lut->interp = interp;
+
+  // The transform stage clamps its output to zero. Cover [0, 1], extended to
+  // cover all of the control points and, with TsTw_tran, the largest value
+  // the transform can produce.
+  ARRAY_2D(float, _TsTw_tran, TsTw_tran, CHAN_SIZE);
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    lut->lo[chan] = 0;
+    lut->hi[chan] = 1;
+    for (int cp = 0; cp < num_ctrl_pts; cp++)
+      lut->hi[chan] = max(lut->hi[chan], _ctrl_pts[cp][chan]);
+    if (TsTw_tran) {
+      float transform_max = 0;
+      for (int i = 0; i < CHAN_SIZE; i++)
+        transform_max += max(_TsTw_tran[i][chan], 0) * kDemosaicMax[i];
+      lut->hi[chan] = max(lut->hi[chan], transform_max);
+    }
+    lut->scale[chan] = (grid_size - 1) / (lut->hi[chan] - lut->lo[chan]);
+  }
+
+  float *l2_dist = malloc_aligned(sizeof(float) * num_ctrl_pts);
+  lut->table = malloc_aligned(sizeof(float) * grid_size * grid_size *
+                              grid_size * CHAN_SIZE);
+  ARRAY_4D(float, _table, lut->table, grid_size, grid_size, CHAN_SIZE);
+  for (int r = 0; r < grid_size; r++) {
+    for (int g = 0; g < grid_size; g++) {
+      for (int b = 0; b < grid_size; b++) {
+        float color[CHAN_SIZE] = { lut->lo[0] + r / lut->scale[0],
+                                   lut->lo[1] + g / lut->scale[1],
+                                   lut->lo[2] + b / lut->scale[2] };
+        rbf_eval(color, _table[r][g][b], ctrl_pts, weights, coefs, l2_dist);
+      }
+    }
+  }
+
+  // Measure the error of the outputs clamped to [0, 1], which is what the rest
+  // of the pipeline sees: the gamut map clamps to zero, and the tone map uses
+  // its last entry for everything from 1 up.
+  unsigned seed = 1;
+  double total_error = 0;
+  int num_clamped = 0;
+  lut->max_error = 0;
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    lut->sample_hi[chan] = 0;
+  for (int i = 0; i < LUT_ERROR_SAMPLES; i++) {
+    float color[CHAN_SIZE], exact[CHAN_SIZE], approx[CHAN_SIZE];
+    random_lut_color(lut, TsTw_tran, &seed, color);
+    bool clamped = false;
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      lut->sample_hi[chan] = max(lut->sample_hi[chan], color[chan]);
+      clamped |= color[chan] < lut->lo[chan] || color[chan] > lut->hi[chan];
+    }
+    num_clamped += clamped;
+    rbf_eval(color, exact, ctrl_pts, weights, coefs, l2_dist);
+    lut_lookup(lut, color, approx);
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      float error = fabsf(min(max(exact[chan], 0), 1) -
+                          min(max(approx[chan], 0), 1));
+      lut->max_error = max(lut->max_error, error);
+      total_error += error;
+    }
+  }
+  lut->mean_error = total_error / (LUT_ERROR_SAMPLES * CHAN_SIZE);
+  lut->clamped_fraction = (float)num_clamped / LUT_ERROR_SAMPLES;
+  free(l2_dist);
+  return lut;
+}
+
+void print_gamut_lut_error(gamut_lut_t *lut) {
+  printf("Gamut map LUT: %d^3 grid, %s interpolation. Max error: %f, "
+         "mean error: %f.\n",
+         lut->grid_size,
+         lut->interp == LutTrilinear ? "trilinear" : "tetrahedral",
+         lut->max_error, lut->mean_error);
+  printf("  Sampled colors up to (%.3f, %.3f, %.3f). The grid covers up to "
+         "(%.3f, %.3f, %.3f), and clamped %.1f%% of them.\n",
+         lut->sample_hi[0], lut->sample_hi[1], lut->sample_hi[2], lut->hi[0],
+         lut->hi[1], lut->hi[2], lut->clamped_fraction * 100);
+}
+
+void free_gamut_lut(gamut_lut_t *lut) {
+  free(lut->table);
+  free(lut);
+}
+
+void gamut_map_lut_fxp(float *input, int row_size, int col_size, float *result,
+                       gamut_lut_t *lut) {
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(float, _result, result, row_size, col_size);
+
+  gm_lut_row:
+  for (int row = 0; row < row_size; row++)
+    gm_lut_col:
+    for (int col = 0; col < col_size; col++) {
+      float color[CHAN_SIZE] = { _input[0][row][col], _input[1][row][col],
+                                 _input[2][row][col] };
+      float mapped[CHAN_SIZE];
+      lut_lookup(lut, color, mapped);
+      gm_lut_chan:
+      for (int chan = 0; chan < CHAN_SIZE; chan++)
+        _result[chan][row][col] = max(mapped[chan], 0);
+    }
+}
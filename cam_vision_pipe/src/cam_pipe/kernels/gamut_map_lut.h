@@ -0,0 +1,68 @@
+#ifndef _GAMUT_MAP_LUT_H_
+#define _GAMUT_MAP_LUT_H_
+
+#include "pipe_stages.h"
+
+// Interpolation schemes for looking up the gamut map LUT.
+typedef enum _lut_interp_t {
+  // Blend the 8 corners of the enclosing cell.
+  LutTrilinear,
+  // Blend the 4 corners of the tetrahedron of the cell containing the point.
+  LutTetrahedral,
+} lut_interp_t;
+
+// A precomputed 3D color LUT approximating the RBF gamut map.
+//
+// The RBF is sampled on a grid_size^3 lattice spanning [lo, hi] on each input
+// channel. Inputs outside of that range are clamped to it, so they get the
+// RBF at the nearest point on the surface of the grid, and the error grows
+// with their distance from it. The grid covers everything the transform stage
+// can produce for the white balance the LUT was built with, but not for other
+// white balances.
+typedef struct _gamut_lut_t {
+  int grid_size;
+  lut_interp_t interp;
+  float lo[CHAN_SIZE];
+  float hi[CHAN_SIZE];
+  // Grid cells per unit of input, per channel.
+  float scale[CHAN_SIZE];
+  // RBF outputs (before clamping to zero), as [r][g][b][CHAN_SIZE].
+  float* table;
+  // Error against the exact RBF, measured when the LUT is built.
+  float max_error;
+  float mean_error;
+  // The largest sampled color, per channel, and the fraction of the samples
+  // that were clamped to the grid.
+  float sample_hi[CHAN_SIZE];
+  float clamped_fraction;
+} gamut_lut_t;
+
+// Build a LUT from the camera model's control points, weights and coefs.
+//
+// This evaluates the exact RBF at every grid point, then measures the max and
+// mean absolute error of the LUT over a fixed set of random colors. With
+// TsTw_tran, the transposed color transform that feeds the gamut map, the
+// grid is extended to cover every color the transform can produce, and those
+// colors are random outputs of the transform stage. Without it, the grid
+// covers [0, 1] and the control points, and the colors are random within it.
+gamut_lut_t* build_gamut_lut(int grid_size,
+                             lut_interp_t interp,
+                             float* ctrl_pts,
+                             float* weights,
+                             float* coefs,
+                             float* TsTw_tran);
+
+void free_gamut_lut(gamut_lut_t* lut);
+
+// Print the grid size, interpolation and measured error of a LUT, along with
+// the range the error was sampled over and how much of it was clamped.
+void print_gamut_lut_error(gamut_lut_t* lut);
+
+// LUT version of gamut_map_fxp, for CHW images.
+void gamut_map_lut_fxp(float* input,
+                       int row_size,
+                       int col_size,
+                       float* result,
+                       gamut_lut_t* lut);
+
+#endif
@@ -0,0 +1,133 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "nnet_lib/utility/thread_pool.h"
+#include "isp_simd.h"
+#include "gamut_map_simd.h"
+
+// Number of pixel vectors swept over each block of control points.
+#define GM_TILE_VECS 8
+#define GM_TILE_SIZE (GM_TILE_VECS * ISP_VECTOR_SIZE)
+// Control points (and their weights) per block: 6KB, so a block stays in L1
+// while every vector of the tile is swept over it.
+#define GM_CP_BLOCK 256
+
+typedef struct _gamut_map_simd_args {
+  float* input;
+  float* result;
+  int plane_size;
+  int start;
+  int end;
+  float* ctrl_pts;
+  float* weights;
+  float* coefs;
+} gamut_map_simd_args;
+
+// Gamut map pixels [start, end) of CHW planes of plane_size pixels.
+static void gamut_map_simd_range(float *input, float *result, int plane_size,
+                                 int start, int end, float *ctrl_pts,
+                                 float *weights, float *coefs) {
+  ARRAY_2D(float, _input, input, plane_size);
+  ARRAY_2D(float, _result, result, plane_size);
+  ARRAY_2D(float, _ctrl_pts, ctrl_pts, 3);
+  ARRAY_2D(float, _weights, weights, 3);
+  ARRAY_2D(float, _coefs, coefs, 3);
+
+  isp_vec_t pixels[CHAN_SIZE][GM_TILE_VECS];
+  isp_vec_t acc[CHAN_SIZE][GM_TILE_VECS];
+  float *_pixels = (float *)pixels;
+  float *_acc = (float *)acc;
+
+  gm_simd_tile:
+  for (int tile = start; tile < end; tile += GM_TILE_SIZE) {
+    int tile_size = min(GM_TILE_SIZE, end - tile);
+    int tile_vecs = FRAC_CEIL(tile_size, ISP_VECTOR_SIZE);
+    // Gather the tile into vectors, padding the last one with zeros.
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      for (int i = 0; i < GM_TILE_SIZE; i++) {
+        _pixels[chan * GM_TILE_SIZE + i] =
+            i < tile_size ? _input[chan][tile + i] : 0;
+      }
+      for (int v = 0; v < GM_TILE_VECS; v++)
+        acc[chan][v] = (isp_vec_t){ 0 };
+    }
+
+    gm_simd_cp_block:
+    for (int block = 0; block < num_ctrl_pts; block += GM_CP_BLOCK) {
+      int block_end = min(block + GM_CP_BLOCK, num_ctrl_pts);
+      gm_simd_vec:
+      for (int v = 0; v < tile_vecs; v++) {
+        isp_vec_t r = pixels[0][v], g = pixels[1][v], b = pixels[2][v];
+        isp_vec_t acc0 = acc[0][v], acc1 = acc[1][v], acc2 = acc[2][v];
+        gm_simd_cp:
+        for (int cp = block; cp < block_end; cp++) {
+          isp_vec_t dr = r - _ctrl_pts[cp][0];
+          isp_vec_t dg = g - _ctrl_pts[cp][1];
+          isp_vec_t db = b - _ctrl_pts[cp][2];
+          isp_vec_t l2_dist = VEC_SQRT(dr * dr + dg * dg + db * db);
+          acc0 += l2_dist * _weights[cp][0];
+          acc1 += l2_dist * _weights[cp][1];
+          acc2 += l2_dist * _weights[cp][2];
+        }
+        acc[0][v] = acc0;
+        acc[1][v] = acc1;
+        acc[2][v] = acc2;
+      }
+    }
+
+    // Add on the biases for the RBF and clamp to zero.
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      for (int v = 0; v < tile_vecs; v++) {
+        isp_vec_t chan_val =
+            acc[chan][v] + (_coefs[0][chan] + _coefs[1][chan] * pixels[0][v] +
+                            _coefs[2][chan] * pixels[1][v] +
+                            _coefs[3][chan] * pixels[2][v]);
+        acc[chan][v] = VEC_RELU(chan_val);
+      }
+      for (int i = 0; i < tile_size; i++)
+        _result[chan][tile + i] = _acc[chan * GM_TILE_SIZE + i];
+    }
+  }
+}
+
+static void *gamut_map_simd_worker(void *args) {
+  gamut_map_simd_args *a = (gamut_map_simd_args *)args;
+  gamut_map_simd_range(a->input, a->result, a->plane_size, a->start, a->end,
+                       a->ctrl_pts, a->weights, a->coefs);
+  return NULL;
+}
+
+void gamut_map_simd_row_fxp(float *input, int col_size, float *result,
+                            float *ctrl_pts, float *weights, float *coefs) {
+  gamut_map_simd_range(input, result, col_size, 0, col_size, ctrl_pts, weights,
+                       coefs);
+}
+
+void gamut_map_simd_fxp(float *input, int row_size, int col_size,
+                        float *result, float *ctrl_pts, float *weights,
+                        float *coefs) {
+  int plane_size = row_size * col_size;
+  int num_threads = thread_pool.num_threads;
+  if (num_threads <= 1) {
+    gamut_map_simd_range(input, result, plane_size, 0, plane_size, ctrl_pts,
+                         weights, coefs);
+    return;
+  }
+
+  // Hand each worker one contiguous chunk, rounded up to whole rows when
+  // there are enough of them to go around.
+  int chunk = FRAC_CEIL(plane_size, num_threads);
+  if (row_size >= num_threads)
+    chunk = FRAC_CEIL(row_size, num_threads) * col_size;
+  gamut_map_simd_args *args =
+      malloc(sizeof(gamut_map_simd_args) * num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    args[i] = (gamut_map_simd_args){ input, result, plane_size,
+                                     min(i * chunk, plane_size),
+                                     min((i + 1) * chunk, plane_size),
+                                     ctrl_pts, weights, coefs };
+    thread_dispatch(gamut_map_simd_worker, &args[i]);
+  }
+  thread_pool_join();
+  free(args);
+}
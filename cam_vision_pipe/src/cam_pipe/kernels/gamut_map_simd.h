@@ -0,0 +1,34 @@
+#ifndef _GAMUT_MAP_SIMD_H_
+#define _GAMUT_MAP_SIMD_H_
+
+#include "pipe_stages.h"
+
+// Vectorized version of gamut_map_fxp, for CHW images.
+//
+// This evaluates the exact RBF, ISP_VECTOR_SIZE pixels at a time (16
+// with AVX-512, 8 with AVX, 4 otherwise). Control points are processed in
+// blocks small enough to stay in L1 while a tile of pixels is swept over
+// them. If the thread pool has been initialized, the pixels are split into
+// contiguous chunks (whole rows for a frame) across its worker threads.
+//
+// Each pixel still accumulates the control points in order with IEEE square
+// roots, so the results are bit-identical to gamut_map_fxp unless the compiler
+// is allowed to contract the arithmetic into FMAs (e.g. with -mavx512f).
+void gamut_map_simd_fxp(float* input,
+                        int row_size,
+                        int col_size,
+                        float* result,
+                        float* ctrl_pts,
+                        float* weights,
+                        float* coefs);
+
+// gamut_map_simd_fxp for a single CHW row, on the calling thread only. This
+// is for callers that are already running on the thread pool.
+void gamut_map_simd_row_fxp(float* input,
+                            int col_size,
+                            float* result,
+                            float* ctrl_pts,
+                            float* weights,
+                            float* coefs);
+
+#endif
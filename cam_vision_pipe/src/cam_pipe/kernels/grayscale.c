@@ -0,0 +1,130 @@
+#include <float.h>
+#include <math.h>
+
+#include "isp_simd.h"
+#include "grayscale.h"
+
+typedef uint8_t gray_u8vec_t
+        __attribute__((__vector_size__(ISP_VECTOR_SIZE), __aligned__(1)));
+
+static double srgb_to_linear(double x) {
+  if (x < 0.04045)
+    return x / 12.92;
+  return pow((x + 0.055) / 1.055, 2.4);
+}
+
+void init_gray_lut(gray_lut_t *lut) {
+  for (int i = 0; i < 256; i++)
+    lut->linear[i] = srgb_to_linear(i / 255.0);
+  // Value v is reached where the exact encoding is v - 0.5.
+  lut->thresholds[0] = 0;
+  for (int v = 1; v < 256; v++)
+    lut->thresholds[v] = srgb_to_linear((v - 0.5) / 255.0);
+  lut->thresholds[256] = FLT_MAX;
+  int value = 0;
+  for (int i = 0; i < GRAY_ENCODE_SIZE; i++) {
+    float y = (float)i / GRAY_ENCODE_SIZE;
+    while (y >= lut->thresholds[value + 1])
+      value++;
+    lut->encode[i] = value;
+  }
+}
+
+// Load the ISP_VECTOR_SIZE values at base[index[0...]].
+static inline isp_vec_t gather_vec(float *base, isp_ivec_t index) {
+#if defined(__AVX512F__)
+  return (isp_vec_t)_mm512_i32gather_ps((__m512i)index, base, 4);
+#elif defined(__AVX2__)
+  return (isp_vec_t)_mm256_i32gather_ps(base, (__m256i)index, 4);
+#else
+  isp_vec_t result;
+  for (int i = 0; i < ISP_VECTOR_SIZE; i++)
+    result[i] = base[index[i]];
+  return result;
+#endif
+}
+
+static inline isp_ivec_t gather_ivec(int *base, isp_ivec_t index) {
+#if defined(__AVX512F__)
+  return (isp_ivec_t)_mm512_i32gather_epi32((__m512i)index, base, 4);
+#elif defined(__AVX2__)
+  return (isp_ivec_t)_mm256_i32gather_epi32(base, (__m256i)index, 4);
+#else
+  isp_ivec_t result;
+  for (int i = 0; i < ISP_VECTOR_SIZE; i++)
+    result[i] = base[index[i]];
+  return result;
+#endif
+}
+
+static inline isp_vec_t linearize_vec(gray_lut_t *lut, uint8_t *input) {
+  return gather_vec(lut->linear, __builtin_convertvector(
+                                     *(gray_u8vec_t *)input, isp_ivec_t));
+}
+
+// Returns the gray values of the ISP_VECTOR_SIZE pixels whose channels start
+// at r, g and b.
+static inline isp_ivec_t gray_vec(gray_lut_t *lut, uint8_t *r, uint8_t *g,
+                                  uint8_t *b) {
+  isp_vec_t y = 0.2126f * linearize_vec(lut, r) +
+                0.7152f * linearize_vec(lut, g) +
+                0.0722f * linearize_vec(lut, b);
+  // y is at least 0, so truncating rounds down.
+  isp_ivec_t bucket = __builtin_convertvector(
+      VEC_MIN(y * (float)GRAY_ENCODE_SIZE,
+              (isp_vec_t){} + (float)(GRAY_ENCODE_SIZE - 1)),
+      isp_ivec_t);
+  isp_ivec_t value = gather_ivec(lut->encode, bucket);
+  // The comparison is -1 where y reaches the next value.
+  return value - (y >= gather_vec(lut->thresholds, value + 1));
+}
+
+static inline int gray_pixel(gray_lut_t *lut, uint8_t r, uint8_t g,
+                             uint8_t b) {
+  float y = 0.2126f * lut->linear[r] + 0.7152f * lut->linear[g] +
+            0.0722f * lut->linear[b];
+  int bucket = min((int)(y * GRAY_ENCODE_SIZE), GRAY_ENCODE_SIZE - 1);
+  int value = lut->encode[bucket];
+  return value + (y >= lut->thresholds[value + 1]);
+}
+
+void convert_to_gray_simd(uint8_t *input, int row_size, int col_size,
+                          gray_lut_t *lut, uint8_t *result) {
+  int size = row_size * col_size;
+  ARRAY_2D(uint8_t, _input, input, size);
+  int vec_end = size - size % ISP_VECTOR_SIZE;
+  gray_simd:
+  for (int i = 0; i < vec_end; i += ISP_VECTOR_SIZE) {
+    *(gray_u8vec_t *)&result[i] = __builtin_convertvector(
+        gray_vec(lut, &_input[0][i], &_input[1][i], &_input[2][i]),
+        gray_u8vec_t);
+  }
+  gray_tail:
+  for (int i = vec_end; i < size; i++)
+    result[i] = gray_pixel(lut, _input[0][i], _input[1][i], _input[2][i]);
+}
+
+void write_gray_dnn_input(uint8_t *input, int row_size, int col_size,
+                          int align_pad, gray_lut_t *lut, float *result) {
+  ARRAY_3D(uint8_t, _input, input, row_size, col_size);
+  ARRAY_2D(float, _result, result, col_size + align_pad);
+  int vec_end = col_size - col_size % ISP_VECTOR_SIZE;
+  gray_dnn_row:
+  for (int row = 0; row < row_size; row++) {
+    gray_dnn_simd:
+    for (int col = 0; col < vec_end; col += ISP_VECTOR_SIZE) {
+      VEC_AT(&_result[row][col]) = __builtin_convertvector(
+          gray_vec(lut, &_input[0][row][col], &_input[1][row][col],
+                   &_input[2][row][col]),
+          isp_vec_t);
+    }
+    gray_dnn_tail:
+    for (int col = vec_end; col < col_size; col++) {
+      _result[row][col] = gray_pixel(lut, _input[0][row][col],
+                                     _input[1][row][col], _input[2][row][col]);
+    }
+    gray_dnn_pad:
+    for (int col = col_size; col < col_size + align_pad; col++)
+      _result[row][col] = 0;
+  }
+}
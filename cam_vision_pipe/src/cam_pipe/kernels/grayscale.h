@@ -0,0 +1,49 @@
+#ifndef _GRAYSCALE_H_
+#define _GRAYSCALE_H_
+
+#include "pipe_stages.h"
+
+// Converting the ISP output to grayscale.
+//
+// The gray value of a pixel is the sRGB encoding of its relative luminance,
+// 0.2126 R + 0.7152 G + 0.0722 B of the linearized channels, rounded to
+// uint8. Instead of calling pow() per channel, the channels are linearized
+// with a 256-entry table. The luminance is encoded with a GRAY_ENCODE_SIZE
+// table, which gives the encoded value at the start of each bucket, and one
+// compare against the luminance at which the next value starts. The sRGB
+// curve rises by less than one uint8 step per bucket, so this rounds exactly
+// like the pow() based conversion, apart from float rounding of the ties.
+
+#define GRAY_ENCODE_SIZE 4096
+
+typedef struct _gray_lut_t {
+  // The linear value of every uint8 sRGB value.
+  float linear[256];
+  // The encoded value of luminance i / (GRAY_ENCODE_SIZE - 1).
+  int encode[GRAY_ENCODE_SIZE];
+  // The lowest luminance that rounds to each value, and FLT_MAX past the
+  // last one.
+  float thresholds[257];
+} gray_lut_t;
+
+void init_gray_lut(gray_lut_t* lut);
+
+// Write the gray value of every pixel of the CHW uint8 frame input to the
+// row_size x col_size plane result, which may be the first channel of input.
+void convert_to_gray_simd(uint8_t* input,
+                          int row_size,
+                          int col_size,
+                          gray_lut_t* lut,
+                          uint8_t* result);
+
+// Write the gray values of the CHW uint8 frame input straight into the input
+// of a single-channel network, as float rows of col_size values followed by
+// align_pad zeros.
+void write_gray_dnn_input(uint8_t* input,
+                          int row_size,
+                          int col_size,
+                          int align_pad,
+                          gray_lut_t* lut,
+                          float* result);
+
+#endif
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+
+#include "common/utility.h"
+#include "utility/load_cam_model.h"
+#include "isp_simd.h"
+#include "streaming_isp.h"
+#include "inverse_isp.h"
+
+typedef uint16_t inv_u16vec_t
+        __attribute__((__vector_size__(ISP_VECTOR_SIZE * sizeof(uint16_t)),
+                       __aligned__(sizeof(uint16_t))));
+
+inverse_isp_t *create_inverse_isp(char *cam_model_path, int wb_index,
+                                  int gamut_lut_size,
+                                  lut_interp_t gamut_lut_interp,
+                                  raw_format_t format, int bit_depth) {
+  inverse_isp_t *isp = malloc(sizeof(inverse_isp_t));
+  isp->format = format;
+  isp->bit_depth = bit_depth;
+  isp->max_value = get_raw_max_value(format, bit_depth);
+  isp->tone_map = get_inverse_tone_map(cam_model_path);
+  isp->ctrl_pts = get_inverse_ctrl_pts(cam_model_path, num_ctrl_pts);
+  isp->weights = get_inverse_weights(cam_model_path, num_ctrl_pts);
+  isp->coefs = get_inverse_coefs(cam_model_path, num_ctrl_pts);
+  isp->gamut_lut = NULL;
+  if (gamut_lut_size > 0) {
+    isp->gamut_lut =
+        build_gamut_lut(gamut_lut_size, gamut_lut_interp, isp->ctrl_pts,
+                        isp->weights, isp->coefs, NULL);
+  }
+  float *TsTw_inv = get_inverse_TsTw(cam_model_path, wb_index);
+  isp->TsTw_inv_tran = malloc_aligned(sizeof(float) * 9);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++)
+      isp->TsTw_inv_tran[j * 3 + i] = TsTw_inv[i * 3 + j];
+  }
+  free(TsTw_inv);
+  return isp;
+}
+
+void free_inverse_isp(inverse_isp_t *isp) {
+  free(isp->tone_map);
+  free(isp->ctrl_pts);
+  free(isp->weights);
+  free(isp->coefs);
+  if (isp->gamut_lut)
+    free_gamut_lut(isp->gamut_lut);
+  free(isp->TsTw_inv_tran);
+  free(isp);
+}
+
+int get_inverse_isp_buffer_size(int col_size) {
+  // Two CHW rows to ping-pong between, and the uint16 samples of the
+  // mosaiced row, rounded up to floats.
+  return 2 * CHAN_SIZE * col_size + FRAC_CEIL(col_size, 2);
+}
+
+// Look up every 8-bit level of an HWC row in the inverse response functions,
+// into a CHW row.
+static void inverse_tone_map_row(uint8_t *input, int col_size,
+                                 float *tone_map, float *result) {
+  ARRAY_2D(uint8_t, _input, input, CHAN_SIZE);
+  ARRAY_2D(float, _tone_map, tone_map, CHAN_SIZE);
+  ARRAY_2D(float, _result, result, col_size);
+  itm_col:
+  for (int col = 0; col < col_size; col++) {
+    itm_chan:
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      _result[chan][col] = _tone_map[_input[col][chan]][chan];
+  }
+}
+
+// Keep the channel of the Bayer site of every pixel of a CHW row, halving
+// green, and scale it to a sample of at most max_value.
+static void mosaic_row(float *input, int row, int col_size, int max_value,
+                       uint16_t *samples) {
+  ARRAY_2D(float, _input, input, col_size);
+  // G R on even rows, B G on odd ones.
+  int even_chan = row % 2 == 0 ? 1 : 2;
+  int odd_chan = row % 2 == 0 ? 0 : 1;
+  float even_scale = even_chan == 1 ? max_value * 0.5f : max_value;
+  float odd_scale = odd_chan == 1 ? max_value * 0.5f : max_value;
+
+  isp_ivec_t is_even;
+  isp_vec_t scale;
+  isp_vec_t max_vec = (isp_vec_t){} + (float)max_value;
+  for (int i = 0; i < ISP_VECTOR_SIZE; i++) {
+    is_even[i] = i % 2 == 0 ? -1 : 0;
+    scale[i] = i % 2 == 0 ? even_scale : odd_scale;
+  }
+  int col = 0;
+  mr_simd:
+  for (; col + ISP_VECTOR_SIZE <= col_size; col += ISP_VECTOR_SIZE) {
+    isp_vec_t value = VEC_SELECT(is_even, VEC_AT(&_input[even_chan][col]),
+                                 VEC_AT(&_input[odd_chan][col]));
+    isp_ivec_t sample =
+        __builtin_convertvector(VEC_MIN(value * scale, max_vec), isp_ivec_t);
+    *(inv_u16vec_t *)&samples[col] =
+        __builtin_convertvector(sample, inv_u16vec_t);
+  }
+  mr_scalar:
+  for (; col < col_size; col++) {
+    float value = col % 2 == 0 ? _input[even_chan][col] * even_scale
+                               : _input[odd_chan][col] * odd_scale;
+    samples[col] = min(value, max_value);
+  }
+}
+
+void inverse_isp_row(inverse_isp_t *isp, uint8_t *input, int row,
+                     int col_size, float *buffers, uint8_t *result) {
+  float *buf0 = buffers;
+  float *buf1 = &buffers[CHAN_SIZE * col_size];
+  uint16_t *samples = (uint16_t *)&buffers[2 * CHAN_SIZE * col_size];
+
+  inverse_tone_map_row(input, col_size, isp->tone_map, buf0);
+  if (isp->gamut_lut) {
+    gamut_map_lut_fxp(buf0, 1, col_size, buf1, isp->gamut_lut);
+  } else {
+    gamut_map_simd_row_fxp(buf0, col_size, buf1, isp->ctrl_pts, isp->weights,
+                           isp->coefs);
+  }
+  transform_row(buf1, col_size, buf0, isp->TsTw_inv_tran);
+  mosaic_row(buf0, row, col_size, isp->max_value, samples);
+
+  if (isp->format != RawRgbPlanes) {
+    pack_raw_row(samples, isp->format, col_size, result);
+    return;
+  }
+  ARRAY_2D(uint8_t, _result, result, CHAN_SIZE);
+  int even_chan = row % 2 == 0 ? 1 : 2;
+  int odd_chan = row % 2 == 0 ? 0 : 1;
+  ir_rgb_col:
+  for (int col = 0; col < col_size; col++) {
+    int site = col % 2 == 0 ? even_chan : odd_chan;
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      _result[col][chan] = chan == site ? samples[col] : 0;
+  }
+}
+
+void inverse_isp_frame(inverse_isp_t *isp, uint8_t *input, int row_size,
+                       int col_size, float *buffers, uint8_t *result) {
+  int row_bytes = isp->format == RawRgbPlanes
+                          ? col_size * CHAN_SIZE
+                          : get_raw_row_bytes(isp->format, col_size);
+  if_row:
+  for (int row = 0; row < row_size; row++) {
+    inverse_isp_row(isp, &input[row * col_size * CHAN_SIZE], row, col_size,
+                    buffers, &result[row * row_bytes]);
+  }
+}
@@ -0,0 +1,83 @@
+#ifndef _INVERSE_ISP_H_
+#define _INVERSE_ISP_H_
+
+#include "pipe_stages.h"
+#include "gamut_map_lut.h"
+#include "raw_unpack.h"
+
+// Inverse camera pipeline, from processed 8-bit RGB images back to raw
+// sensor frames, for generating synthetic raw datasets.
+//
+// This uses the jpg2raw_* files of the camera model and follows
+// convert_image_to_raw of scripts/convert_image.py, one row at a time:
+//
+// 1. Inverse tone map: each 8-bit level is looked up in the inverse response
+//    functions, which also scales it to a linear value.
+// 2. Inverse gamut map: the jpg2raw RBF, either exact (evaluated by
+//    gamut_map_simd_row_fxp) or interpolated from a gamut_lut_t built from
+//    it. The exact RBF costs thousands of operations per pixel, so the LUT is
+//    what makes large datasets practical.
+// 3. Inverse color transform: the inverse of TsTw for the white balance
+//    preset, clamped to zero like transform_row.
+// 4. Mosaic and descale: only the channel of each Bayer site (G R / B G) is
+//    kept, with green halved, as demosaic_fxp doubles it at green sites. The
+//    sample is scaled to the largest value of the output format and
+//    truncated.
+//
+// The output is one of the raw_format_t layouts read by the ISP. RawRgbPlanes
+// is written as HWC uint8 with the other two channels of each pixel zero,
+// like the images read by read_image_from_binary. The single-plane formats
+// are packed as described in raw_unpack.h.
+//
+// An inverse_isp_t is read-only once created, so any number of threads can
+// convert frames with it at once, each with its own row buffers.
+typedef struct _inverse_isp_t {
+  raw_format_t format;
+  int bit_depth;
+  int max_value;
+  // Linear value of each 8-bit level, as [256][CHAN_SIZE].
+  float* tone_map;
+  float* ctrl_pts;
+  float* weights;
+  float* coefs;
+  // NULL to evaluate the exact RBF.
+  gamut_lut_t* gamut_lut;
+  // The inverse of TsTw, transposed for transform_row.
+  float* TsTw_inv_tran;
+} inverse_isp_t;
+
+// Load the inverse camera model from cam_model_path for white balance preset
+// wb_index. If gamut_lut_size is not zero, the inverse gamut map is
+// interpolated from a LUT of that many grid points per channel.
+inverse_isp_t* create_inverse_isp(char* cam_model_path,
+                                  int wb_index,
+                                  int gamut_lut_size,
+                                  lut_interp_t gamut_lut_interp,
+                                  raw_format_t format,
+                                  int bit_depth);
+
+void free_inverse_isp(inverse_isp_t* isp);
+
+// Returns the number of floats in the row buffers for frames col_size pixels
+// wide.
+int get_inverse_isp_buffer_size(int col_size);
+
+// Convert row row of an HWC uint8 image into a raw row: the
+// get_raw_row_bytes() bytes of a single-plane format, or an HWC row of
+// col_size * CHAN_SIZE bytes for RawRgbPlanes.
+void inverse_isp_row(inverse_isp_t* isp,
+                     uint8_t* input,
+                     int row,
+                     int col_size,
+                     float* buffers,
+                     uint8_t* result);
+
+// Convert a whole HWC uint8 image into a get_raw_frame_bytes() raw frame.
+void inverse_isp_frame(inverse_isp_t* isp,
+                       uint8_t* input,
+                       int row_size,
+                       int col_size,
+                       float* buffers,
+                       uint8_t* result);
+
+#endif
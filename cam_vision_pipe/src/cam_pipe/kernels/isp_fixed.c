@@ -0,0 +1,613 @@
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "common/utility.h"
+#include "nnet_lib/utility/profiling.h"
+#include "isp_simd.h"
+#include "isp_fixed.h"
+
+// Every kernel runs over CHW frames of isp_q_t. The columns are processed
+// ISP_QVEC_SIZE at a time, and those left over by a scalar loop with the same
+// integer semantics, so the output does not depend on the vector width.
+
+static inline isp_q_t q_sat(int value) {
+  return min(max(value, SHRT_MIN), SHRT_MAX);
+}
+
+static inline isp_q_t q_adds(int a, int b) { return q_sat(a + b); }
+
+// Returns (a * b) >> shift, saturated, for 1 <= shift <= 15.
+static inline isp_q_t q_mul(int a, int b, int shift) {
+  return q_sat((a * b) >> shift);
+}
+
+// Vectorized q_mul. The 32-bit products are put back together from their
+// high and low halves, and the result saturates exactly when the high half
+// does not fit in its top 16 - shift bits.
+static inline isp_qvec_t qvec_mul(isp_qvec_t a, isp_qvec_t b, int shift) {
+  isp_qvec_t hi = QVEC_MULHI(a, b);
+  isp_qvec_t lo = a * b;
+  isp_qvec_t value =
+      (hi << (16 - shift)) | (isp_qvec_t)((isp_uqvec_t)lo >> shift);
+  isp_qvec_t limit = QVEC_SET1(1 << (shift - 1));
+  value = QVEC_SELECT(hi >= limit, QVEC_SET1(SHRT_MAX), value);
+  return QVEC_SELECT(hi < -limit, QVEC_SET1(SHRT_MIN), value);
+}
+
+// Returns the first column of the scalar tail of the columns [begin, end).
+static inline int get_vec_end(int begin, int end) {
+  int size = max(end - begin, 0);
+  return begin + size - size % ISP_QVEC_SIZE;
+}
+
+// Returns x in Q frac_bits.
+static inline isp_q_t float_to_q(float x, int frac_bits) {
+  return q_sat(lrintf(min(max(x * (1 << frac_bits), SHRT_MIN), SHRT_MAX)));
+}
+
+isp_q_params_t *build_isp_q_params(int frac_bits, float *TsTw,
+                                   float *tone_map, gamut_lut_t *gamut_lut,
+                                   resize_plan_t *resize) {
+  assert(frac_bits >= ISP_Q_MIN_FRAC_BITS &&
+         frac_bits <= ISP_Q_MAX_FRAC_BITS &&
+         "Unsupported number of fractional bits!");
+  isp_q_params_t *params = malloc(sizeof(isp_q_params_t));
+  memset(params, 0, sizeof(isp_q_params_t));
+  params->frac_bits = frac_bits;
+  for (int i = 0; i < CHAN_SIZE * CHAN_SIZE; i++)
+    params->TsTw[i] = float_to_q(TsTw[i], ISP_Q_COEF_BITS);
+  for (int i = 0; i < 256 * CHAN_SIZE; i++)
+    params->tone_map[i] = float_to_q(tone_map[i], frac_bits);
+
+  int grid = gamut_lut->grid_size;
+  int table_size = grid * grid * grid * CHAN_SIZE;
+  params->lut_size = grid;
+  params->lut_interp = gamut_lut->interp;
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    params->lut_lo[chan] = float_to_q(gamut_lut->lo[chan], frac_bits);
+    params->lut_scale[chan] =
+        float_to_q(gamut_lut->scale[chan], ISP_Q_LUT_SCALE_BITS);
+  }
+  params->lut_table = malloc_aligned(sizeof(isp_q_t) * table_size);
+  for (int i = 0; i < table_size; i++)
+    params->lut_table[i] = float_to_q(gamut_lut->table[i], frac_bits);
+
+  if (resize) {
+    int row_taps = resize->rows.max_taps * resize->cfg.out_rows;
+    int col_taps = resize->cols.max_taps * resize->cfg.out_cols;
+    params->resize = resize;
+    params->resize_row_weights = malloc_aligned(sizeof(isp_q_t) * row_taps);
+    params->resize_col_weights = malloc_aligned(sizeof(isp_q_t) * col_taps);
+    for (int i = 0; i < row_taps; i++) {
+      params->resize_row_weights[i] =
+          float_to_q(resize->rows.weights[i], ISP_Q_WEIGHT_BITS);
+    }
+    for (int i = 0; i < col_taps; i++) {
+      params->resize_col_weights[i] =
+          float_to_q(resize->cols.weights[i], ISP_Q_WEIGHT_BITS);
+    }
+  }
+  return params;
+}
+
+void free_isp_q_params(isp_q_params_t *params) {
+  free(params->lut_table);
+  free(params->resize_row_weights);
+  free(params->resize_col_weights);
+  free(params);
+}
+
+int get_fixed_isp_resize_temp_size(isp_q_params_t *params) {
+  if (!params->resize)
+    return 0;
+  resize_cfg_t *cfg = &params->resize->cfg;
+  return CHAN_SIZE * cfg->crop_rows * cfg->out_cols;
+}
+
+// Scale stage for RawRgbPlanes. x / 255 is computed as
+// (x * 2^(frac_bits + 8) / 255) >> 8, where the constant is rounded.
+static void scale_q(uint8_t *input, int size, int frac_bits, isp_q_t *result) {
+  int scale = ((1 << (frac_bits + 8)) + 127) / 255;
+  int vec_end = get_vec_end(0, size);
+  int i = 0;
+  scq_simd:
+  for (; i < vec_end; i += ISP_QVEC_SIZE) {
+    QVEC_AT(&result[i]) =
+        qvec_mul(QVEC_LOAD_U8(&input[i]), QVEC_SET1(scale), 8);
+  }
+  scq_tail:
+  for (; i < size; i++)
+    result[i] = q_mul(input[i], scale, 8);
+}
+
+// Demosaic ISP_QVEC_SIZE pixels of row starting at col. is_odd has the lanes
+// of the odd columns set. The sums follow the order of demosaic_fxp, and
+// saturate.
+static inline void demosaic_q_vec(isp_q_t *above, isp_q_t *input,
+                                  isp_q_t *below, int plane_size, int row,
+                                  int col, isp_qvec_t is_odd,
+                                  isp_q_t *result) {
+  ARRAY_2D(isp_q_t, _above, above, plane_size);
+  ARRAY_2D(isp_q_t, _input, input, plane_size);
+  ARRAY_2D(isp_q_t, _below, below, plane_size);
+  ARRAY_2D(isp_q_t, _result, result, plane_size);
+  isp_qvec_t ab0 = QVEC_AT(&_above[0][col]), be0 = QVEC_AT(&_below[0][col]);
+  isp_qvec_t ab1 = QVEC_AT(&_above[1][col]), be1 = QVEC_AT(&_below[1][col]);
+  isp_qvec_t ab2 = QVEC_AT(&_above[2][col]), be2 = QVEC_AT(&_below[2][col]);
+  // G from the four neighbours, and G at a green pixel.
+  isp_qvec_t cross_g =
+      QVEC_ADDS(QVEC_ADDS(QVEC_ADDS(ab1, be1), QVEC_AT(&_input[1][col - 1])),
+                QVEC_AT(&_input[1][col + 1])) >> 1;
+  isp_qvec_t green_g = QVEC_ADDS(QVEC_AT(&_input[1][col]),
+                                 QVEC_AT(&_input[1][col]));
+  if (row % 2 == 0) {
+    // Green pixels on the even columns, red pixels on the odd ones.
+    isp_qvec_t green_r = QVEC_ADDS(QVEC_AT(&_input[0][col - 1]),
+                                   QVEC_AT(&_input[0][col + 1])) >> 1;
+    isp_qvec_t green_b = QVEC_ADDS(ab2, be2) >> 1;
+    isp_qvec_t red_b =
+        QVEC_ADDS(QVEC_ADDS(QVEC_ADDS(QVEC_AT(&_above[2][col - 1]),
+                                      QVEC_AT(&_above[2][col + 1])),
+                            QVEC_AT(&_below[2][col - 1])),
+                  QVEC_AT(&_below[2][col + 1])) >> 2;
+    QVEC_AT(&_result[0][col]) =
+        QVEC_SELECT(is_odd, QVEC_AT(&_input[0][col]), green_r);
+    QVEC_AT(&_result[1][col]) = QVEC_SELECT(is_odd, cross_g, green_g);
+    QVEC_AT(&_result[2][col]) = QVEC_SELECT(is_odd, red_b, green_b);
+  } else {
+    // Blue pixels on the even columns, green pixels on the odd ones.
+    isp_qvec_t blue_r =
+        QVEC_ADDS(QVEC_ADDS(QVEC_ADDS(QVEC_AT(&_above[0][col - 1]),
+                                      QVEC_AT(&_below[0][col - 1])),
+                            QVEC_AT(&_above[0][col + 1])),
+                  QVEC_AT(&_below[0][col + 1])) >> 2;
+    isp_qvec_t green_r = QVEC_ADDS(ab0, be0) >> 1;
+    isp_qvec_t green_b = QVEC_ADDS(QVEC_AT(&_input[2][col - 1]),
+                                   QVEC_AT(&_input[2][col + 1])) >> 1;
+    QVEC_AT(&_result[0][col]) = QVEC_SELECT(is_odd, green_r, blue_r);
+    QVEC_AT(&_result[1][col]) = QVEC_SELECT(is_odd, green_g, cross_g);
+    QVEC_AT(&_result[2][col]) =
+        QVEC_SELECT(is_odd, green_b, QVEC_AT(&_input[2][col]));
+  }
+}
+
+// Scalar demosaic_q_vec for a single pixel.
+static inline void demosaic_q_pixel(isp_q_t *above, isp_q_t *input,
+                                    isp_q_t *below, int plane_size, int row,
+                                    int col, isp_q_t *result) {
+  ARRAY_2D(isp_q_t, _above, above, plane_size);
+  ARRAY_2D(isp_q_t, _input, input, plane_size);
+  ARRAY_2D(isp_q_t, _below, below, plane_size);
+  ARRAY_2D(isp_q_t, _result, result, plane_size);
+  int cross_g = q_adds(q_adds(q_adds(_above[1][col], _below[1][col]),
+                              _input[1][col - 1]),
+                       _input[1][col + 1]) >> 1;
+  int green_g = q_adds(_input[1][col], _input[1][col]);
+  int is_odd = col % 2;
+  if (row % 2 == 0) {
+    if (is_odd) {
+      _result[0][col] = _input[0][col];
+      _result[1][col] = cross_g;
+      _result[2][col] =
+          q_adds(q_adds(q_adds(_above[2][col - 1], _above[2][col + 1]),
+                        _below[2][col - 1]),
+                 _below[2][col + 1]) >> 2;
+    } else {
+      _result[0][col] = q_adds(_input[0][col - 1], _input[0][col + 1]) >> 1;
+      _result[1][col] = green_g;
+      _result[2][col] = q_adds(_above[2][col], _below[2][col]) >> 1;
+    }
+  } else {
+    if (is_odd) {
+      _result[0][col] = q_adds(_above[0][col], _below[0][col]) >> 1;
+      _result[1][col] = green_g;
+      _result[2][col] = q_adds(_input[2][col - 1], _input[2][col + 1]) >> 1;
+    } else {
+      _result[0][col] =
+          q_adds(q_adds(q_adds(_above[0][col - 1], _below[0][col - 1]),
+                        _above[0][col + 1]),
+                 _below[0][col + 1]) >> 2;
+      _result[1][col] = cross_g;
+      _result[2][col] = _input[2][col];
+    }
+  }
+}
+
+static void demosaic_q(isp_q_t *input, int row_size, int col_size,
+                       isp_q_t *result) {
+  int plane_size = row_size * col_size;
+  int vec_end = get_vec_end(1, col_size - 1);
+  // The odd column lanes of a vector starting at an even and an odd column.
+  isp_qvec_t is_odd[2];
+  for (int i = 0; i < ISP_QVEC_SIZE; i++) {
+    is_odd[0][i] = i % 2 ? -1 : 0;
+    is_odd[1][i] = ~is_odd[0][i];
+  }
+
+  // The outermost rows and columns are set to zero, like demosaic_fxp does.
+  memset(result, 0, sizeof(isp_q_t) * CHAN_SIZE * plane_size);
+  dmq_row:
+  for (int row = 1; row < row_size - 1; row++) {
+    isp_q_t *center = &input[row * col_size];
+    isp_q_t *out = &result[row * col_size];
+    int col = 1;
+    dmq_simd:
+    for (; col < vec_end; col += ISP_QVEC_SIZE) {
+      demosaic_q_vec(center - col_size, center, center + col_size, plane_size,
+                     row, col, is_odd[col % 2], out);
+    }
+    dmq_tail:
+    for (; col < col_size - 1; col++) {
+      demosaic_q_pixel(center - col_size, center, center + col_size,
+                       plane_size, row, col, out);
+    }
+  }
+}
+
+// 3x3 median filter. The outermost rows and columns are copied, like
+// denoise_fxp does. As in median3x3_row_simd, the three values of each column
+// are sorted once per chunk of DNQ_CHUNK_SIZE output pixels, and each window
+// combines the sorted columns on either side of it.
+#define DNQ_CHUNK_SIZE 256
+static void denoise_q(isp_q_t *input, int row_size, int col_size,
+                      isp_q_t *result) {
+  isp_q_t lo[DNQ_CHUNK_SIZE + 2], mid[DNQ_CHUNK_SIZE + 2],
+      hi[DNQ_CHUNK_SIZE + 2];
+  memcpy(result, input, sizeof(isp_q_t) * CHAN_SIZE * row_size * col_size);
+  dnq_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    dnq_row:
+    for (int row = 1; row < row_size - 1; row++) {
+      isp_q_t *center = &input[(chan * row_size + row) * col_size];
+      isp_q_t *above = center - col_size;
+      isp_q_t *below = center + col_size;
+      isp_q_t *out = &result[(chan * row_size + row) * col_size];
+      dnq_chunk:
+      for (int start = 1; start < col_size - 1; start += DNQ_CHUNK_SIZE) {
+        int num_outputs = min(DNQ_CHUNK_SIZE, col_size - 1 - start);
+        int num_cols = num_outputs + 2;
+
+        // Sort each column of the windows, starting from the one left of
+        // start.
+        int i = 0;
+        int sort_end = get_vec_end(0, num_cols);
+        dnq_sort_simd:
+        for (; i < sort_end; i += ISP_QVEC_SIZE) {
+          isp_qvec_t a = QVEC_AT(&above[start - 1 + i]);
+          isp_qvec_t b = QVEC_AT(&center[start - 1 + i]);
+          isp_qvec_t c = QVEC_AT(&below[start - 1 + i]);
+          SORT3(a, b, c, QVEC_MIN, QVEC_MAX);
+          QVEC_AT(&lo[i]) = a;
+          QVEC_AT(&mid[i]) = b;
+          QVEC_AT(&hi[i]) = c;
+        }
+        dnq_sort_tail:
+        for (; i < num_cols; i++) {
+          isp_q_t a = above[start - 1 + i];
+          isp_q_t b = center[start - 1 + i];
+          isp_q_t c = below[start - 1 + i];
+          SORT3(a, b, c, min, max);
+          lo[i] = a;
+          mid[i] = b;
+          hi[i] = c;
+        }
+
+        // Combine the three columns of each window.
+        int j = 0;
+        int median_end = get_vec_end(0, num_outputs);
+        dnq_median_simd:
+        for (; j < median_end; j += ISP_QVEC_SIZE) {
+          isp_qvec_t lo_max =
+              QVEC_MAX(QVEC_MAX(QVEC_AT(&lo[j]), QVEC_AT(&lo[j + 1])),
+                       QVEC_AT(&lo[j + 2]));
+          isp_qvec_t hi_min =
+              QVEC_MIN(QVEC_MIN(QVEC_AT(&hi[j]), QVEC_AT(&hi[j + 1])),
+                       QVEC_AT(&hi[j + 2]));
+          isp_qvec_t mid_med = MED3(QVEC_AT(&mid[j]), QVEC_AT(&mid[j + 1]),
+                                    QVEC_AT(&mid[j + 2]), QVEC_MIN, QVEC_MAX);
+          QVEC_AT(&out[start + j]) =
+              MED3(lo_max, mid_med, hi_min, QVEC_MIN, QVEC_MAX);
+        }
+        dnq_median_tail:
+        for (; j < num_outputs; j++) {
+          isp_q_t lo_max = max(max(lo[j], lo[j + 1]), lo[j + 2]);
+          isp_q_t hi_min = min(min(hi[j], hi[j + 1]), hi[j + 2]);
+          isp_q_t mid_med = MED3(mid[j], mid[j + 1], mid[j + 2], min, max);
+          out[start + j] = MED3(lo_max, mid_med, hi_min, min, max);
+        }
+      }
+    }
+  }
+}
+
+// Crops and resizes the frame. Every row of the crop is resampled
+// horizontally into temp, then the output rows are resampled vertically from
+// temp. Each tap is multiplied and accumulated with saturation.
+static void resize_q(isp_q_t *input, int row_size, int col_size,
+                     isp_q_params_t *params, isp_q_t *temp, isp_q_t *result) {
+  resize_plan_t *plan = params->resize;
+  resize_cfg_t *cfg = &plan->cfg;
+  int out_rows = cfg->out_rows;
+  int out_cols = cfg->out_cols;
+  ARRAY_3D(isp_q_t, _input, input, row_size, col_size);
+  ARRAY_3D(isp_q_t, _temp, temp, cfg->crop_rows, out_cols);
+  ARRAY_3D(isp_q_t, _result, result, out_rows, out_cols);
+  ARRAY_2D(int, _col_index, plan->cols.index, out_cols);
+  ARRAY_2D(isp_q_t, _col_weights, params->resize_col_weights, out_cols);
+  ARRAY_2D(int, _row_index, plan->rows.index, out_rows);
+  ARRAY_2D(isp_q_t, _row_weights, params->resize_row_weights, out_rows);
+  int vec_end = get_vec_end(0, out_cols);
+
+  rsq_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    rsq_cols_row:
+    for (int row = 0; row < cfg->crop_rows; row++) {
+      isp_q_t *in = &_input[chan][cfg->crop_row + row][cfg->crop_col];
+      rsq_cols_col:
+      for (int col = 0; col < out_cols; col++) {
+        isp_q_t sum = 0;
+        for (int tap = 0; tap < plan->cols.max_taps; tap++) {
+          sum = q_adds(sum, q_mul(in[_col_index[tap][col]],
+                                  _col_weights[tap][col], ISP_Q_WEIGHT_BITS));
+        }
+        _temp[chan][row][col] = sum;
+      }
+    }
+    rsq_rows_row:
+    for (int row = 0; row < out_rows; row++) {
+      int col = 0;
+      rsq_rows_simd:
+      for (; col < vec_end; col += ISP_QVEC_SIZE) {
+        isp_qvec_t sum = {};
+        for (int tap = 0; tap < plan->rows.max_taps; tap++) {
+          isp_qvec_t value = QVEC_AT(&_temp[chan][_row_index[tap][row]][col]);
+          sum = QVEC_ADDS(sum, qvec_mul(value,
+                                        QVEC_SET1(_row_weights[tap][row]),
+                                        ISP_Q_WEIGHT_BITS));
+        }
+        QVEC_AT(&_result[chan][row][col]) = sum;
+      }
+      rsq_rows_tail:
+      for (; col < out_cols; col++) {
+        isp_q_t sum = 0;
+        for (int tap = 0; tap < plan->rows.max_taps; tap++) {
+          sum = q_adds(sum, q_mul(_temp[chan][_row_index[tap][row]][col],
+                                  _row_weights[tap][row], ISP_Q_WEIGHT_BITS));
+        }
+        _result[chan][row][col] = sum;
+      }
+    }
+  }
+}
+
+static void transform_q(isp_q_t *input, int size, isp_q_params_t *params,
+                        isp_q_t *result) {
+  ARRAY_2D(isp_q_t, _input, input, size);
+  ARRAY_2D(isp_q_t, _result, result, size);
+  ARRAY_2D(isp_q_t, _TsTw_tran, params->TsTw, CHAN_SIZE);
+  const int kBits = ISP_Q_COEF_BITS;
+  int vec_end = get_vec_end(0, size);
+
+  trq_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    int c0 = _TsTw_tran[0][chan];
+    int c1 = _TsTw_tran[1][chan];
+    int c2 = _TsTw_tran[2][chan];
+    int i = 0;
+    trq_simd:
+    for (; i < vec_end; i += ISP_QVEC_SIZE) {
+      isp_qvec_t sum =
+          QVEC_ADDS(QVEC_ADDS(qvec_mul(QVEC_AT(&_input[0][i]), QVEC_SET1(c0),
+                                       kBits),
+                              qvec_mul(QVEC_AT(&_input[1][i]), QVEC_SET1(c1),
+                                       kBits)),
+                    qvec_mul(QVEC_AT(&_input[2][i]), QVEC_SET1(c2), kBits));
+      QVEC_AT(&_result[chan][i]) = QVEC_MAX(sum, QVEC_SET1(0));
+    }
+    trq_tail:
+    for (; i < size; i++) {
+      isp_q_t sum = q_adds(q_adds(q_mul(_input[0][i], c0, kBits),
+                                  q_mul(_input[1][i], c1, kBits)),
+                           q_mul(_input[2][i], c2, kBits));
+      _result[chan][i] = max(sum, 0);
+    }
+  }
+}
+
+// Integer version of lut_lookup in gamut_map_lut.c. The interpolation
+// weights are in Q frac_bits.
+static void gamut_map_q(isp_q_t *input, int size, isp_q_params_t *params,
+                        isp_q_t *result) {
+  ARRAY_2D(isp_q_t, _input, input, size);
+  ARRAY_2D(isp_q_t, _result, result, size);
+  const int kBits = params->frac_bits;
+  const int grid = params->lut_size;
+  const int stride[CHAN_SIZE] = { grid * grid * CHAN_SIZE, grid * CHAN_SIZE,
+                                  CHAN_SIZE };
+
+  gmq_pixel:
+  for (int i = 0; i < size; i++) {
+    int base = 0;
+    int frac[CHAN_SIZE];
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      int pos = ((_input[chan][i] - params->lut_lo[chan]) *
+                 params->lut_scale[chan]) >> ISP_Q_LUT_SCALE_BITS;
+      pos = min(max(pos, 0), (grid - 1) << kBits);
+      int idx = min(pos >> kBits, grid - 2);
+      frac[chan] = pos - (idx << kBits);
+      base += idx * stride[chan];
+    }
+    isp_q_t *c000 = &params->lut_table[base];
+    int value[CHAN_SIZE];
+
+    if (params->lut_interp == LutTrilinear) {
+      isp_q_t *c100 = c000 + stride[0];
+      isp_q_t *c010 = c000 + stride[1];
+      isp_q_t *c001 = c000 + stride[2];
+      isp_q_t *c110 = c100 + stride[1];
+      isp_q_t *c101 = c100 + stride[2];
+      isp_q_t *c011 = c010 + stride[2];
+      isp_q_t *c111 = c110 + stride[2];
+      for (int chan = 0; chan < CHAN_SIZE; chan++) {
+        int c00 = c000[chan] + (((c001[chan] - c000[chan]) * frac[2]) >> kBits);
+        int c01 = c010[chan] + (((c011[chan] - c010[chan]) * frac[2]) >> kBits);
+        int c10 = c100[chan] + (((c101[chan] - c100[chan]) * frac[2]) >> kBits);
+        int c11 = c110[chan] + (((c111[chan] - c110[chan]) * frac[2]) >> kBits);
+        int c0 = c00 + (((c01 - c00) * frac[1]) >> kBits);
+        int c1 = c10 + (((c11 - c10) * frac[1]) >> kBits);
+        value[chan] = c0 + (((c1 - c0) * frac[0]) >> kBits);
+      }
+    } else {
+      int a = 0, b = 1, c = 2, tmp;
+      if (frac[a] < frac[b]) { tmp = a; a = b; b = tmp; }
+      if (frac[b] < frac[c]) { tmp = b; b = c; c = tmp; }
+      if (frac[a] < frac[b]) { tmp = a; a = b; b = tmp; }
+      isp_q_t *c1 = c000 + stride[a];
+      isp_q_t *c2 = c1 + stride[b];
+      isp_q_t *c3 = c2 + stride[c];
+      int w0 = (1 << kBits) - frac[a];
+      int w1 = frac[a] - frac[b];
+      int w2 = frac[b] - frac[c];
+      int w3 = frac[c];
+      for (int chan = 0; chan < CHAN_SIZE; chan++) {
+        value[chan] = (w0 * c000[chan] + w1 * c1[chan] + w2 * c2[chan] +
+                       w3 * c3[chan]) >> kBits;
+      }
+    }
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      _result[chan][i] = max(q_sat(value[chan]), 0);
+  }
+}
+
+// The index is (x * 255) >> frac_bits, saturated to [0, 255] like the index
+// of tone_map_fxp.
+static void tone_map_q(isp_q_t *input, int size, isp_q_params_t *params,
+                       isp_q_t *result) {
+  ARRAY_2D(isp_q_t, _input, input, size);
+  ARRAY_2D(isp_q_t, _result, result, size);
+  ARRAY_2D(isp_q_t, _tone_map, params->tone_map, CHAN_SIZE);
+  tmq_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    tmq_col:
+    for (int i = 0; i < size; i++) {
+      int x = min(max((_input[chan][i] * 255) >> params->frac_bits, 0), 255);
+      _result[chan][i] = _tone_map[x][chan];
+    }
+  }
+}
+
+// tone_map_approx, evaluated on the samples instead of on x = 255 * sample:
+// the breakpoints and offsets are divided by 255 instead.
+static void tone_map_approx_q(isp_q_t *input, int size, int frac_bits,
+                              isp_q_t *result) {
+  const int one = 1 << frac_bits;
+  // The smallest samples with x >= 32 and x >= 128.
+  const int knee_lo = ((32 << frac_bits) + 254) / 255;
+  const int knee_hi = ((128 << frac_bits) + 254) / 255;
+  const int offset_mid = ((96 << frac_bits) + 127) / 255;
+  const int offset_hi = ((192 << frac_bits) + 127) / 255;
+  int vec_end = get_vec_end(0, size);
+  int i = 0;
+  tmq_apx_simd:
+  for (; i < vec_end; i += ISP_QVEC_SIZE) {
+    isp_qvec_t s = QVEC_MAX(QVEC_AT(&input[i]), QVEC_SET1(0));
+    isp_qvec_t y = QVEC_SELECT(
+        s < QVEC_SET1(knee_lo), s << 2,
+        QVEC_SELECT(s < QVEC_SET1(knee_hi), s + QVEC_SET1(offset_mid),
+                    (s >> 2) + QVEC_SET1(offset_hi)));
+    QVEC_AT(&result[i]) = QVEC_MIN(y, QVEC_SET1(one));
+  }
+  tmq_apx_tail:
+  for (; i < size; i++) {
+    int s = max(input[i], 0);
+    int y;
+    if (s < knee_lo)
+      y = s << 2;
+    else if (s < knee_hi)
+      y = s + offset_mid;
+    else
+      y = (s >> 2) + offset_hi;
+    result[i] = min(y, one);
+  }
+}
+
+static void descale_q(isp_q_t *input, int size, int frac_bits,
+                      uint8_t *result) {
+  int vec_end = get_vec_end(0, size);
+  int i = 0;
+  dsq_simd:
+  for (; i < vec_end; i += ISP_QVEC_SIZE) {
+    isp_qvec_t value = qvec_mul(QVEC_AT(&input[i]), QVEC_SET1(255), frac_bits);
+    value = QVEC_MIN(QVEC_MAX(value, QVEC_SET1(0)), QVEC_SET1(255));
+    QVEC_STORE_U8(&result[i], value);
+  }
+  dsq_tail:
+  for (; i < size; i++)
+    result[i] = min(max(q_mul(input[i], 255, frac_bits), 0), 255);
+}
+
+void isp_hw_impl_fixed(int row_size,
+                       int col_size,
+                       raw_format_t input_format,
+                       int raw_bit_depth,
+                       isp_graph_t* graph,
+                       uint8_t* input,
+                       uint8_t* result,
+                       isp_q_t* frames,
+                       isp_q_t* resize_temp,
+                       isp_q_params_t* params) {
+  int frac_bits = params->frac_bits;
+  isp_q_t *frame = frames;
+  isp_q_t *next_frame = frames + row_size * col_size * CHAN_SIZE;
+
+  begin_profiling(isp_stage_names[IspStageScale], ISP_PROFILING_LAYER);
+  if (input_format == RawRgbPlanes) {
+    scale_q(input, row_size * col_size * CHAN_SIZE, frac_bits, frame);
+  } else {
+    scale_raw_q(input, input_format, raw_bit_depth, row_size, col_size,
+                frac_bits, frame);
+  }
+  end_profiling();
+  // The stages after a resize only see the resized frame.
+  int rows = row_size;
+  int cols = col_size;
+  for (int i = 0; i < graph->num_stages; i++) {
+    isp_graph_stage_t stage = graph->stages[i];
+    if (stage.type == IspStageResize && !params->resize)
+      continue;
+    begin_profiling(isp_stage_names[stage.type], ISP_PROFILING_LAYER);
+    switch (stage.type) {
+      case IspStageDemosaic:
+        demosaic_q(frame, rows, cols, next_frame);
+        break;
+      case IspStageDenoise:
+        denoise_q(frame, rows, cols, next_frame);
+        break;
+      case IspStageResize:
+        resize_q(frame, rows, cols, params, resize_temp, next_frame);
+        rows = params->resize->cfg.out_rows;
+        cols = params->resize->cfg.out_cols;
+        break;
+      case IspStageTransform:
+        transform_q(frame, rows * cols, params, next_frame);
+        break;
+      case IspStageGamutMap:
+        gamut_map_q(frame, rows * cols, params, next_frame);
+        break;
+      default:
+        if (stage.impl == IspImplApprox) {
+          tone_map_approx_q(frame, rows * cols * CHAN_SIZE, frac_bits,
+                            next_frame);
+        } else {
+          tone_map_q(frame, rows * cols, params, next_frame);
+        }
+        break;
+    }
+    SWAP_PTRS(frame, next_frame);
+    end_profiling();
+  }
+  begin_profiling(isp_stage_names[IspStageDescale], ISP_PROFILING_LAYER);
+  descale_q(frame, rows * cols * CHAN_SIZE, frac_bits, result);
+  end_profiling();
+}
@@ -0,0 +1,96 @@
+#ifndef _ISP_FIXED_H_
+#define _ISP_FIXED_H_
+
+#include "pipe_stages.h"
+#include "gamut_map_lut.h"
+#include "resize.h"
+
+// Integer fixed-point frame dataflow.
+//
+// Every sample is an int16 in Q format: x is stored as x * 2^frac_bits,
+// rounded, which leaves 15 - frac_bits integer bits of headroom for the
+// stages that amplify their input. All arithmetic is on integers and
+// saturates instead of wrapping, the way the datapath of the ISP accelerator
+// would be built, and the kernels process ISP_QVEC_SIZE samples per
+// instruction, twice as many as the float kernels.
+//
+// Parameters use their own Q formats, as their range differs from the
+// samples: ISP_Q_COEF_BITS for the transform matrix, ISP_Q_WEIGHT_BITS for
+// the resize weights and ISP_Q_LUT_SCALE_BITS for the gamut LUT grid scale.
+// The gamut map always interpolates a LUT, quantized from a gamut_lut_t, as
+// an exact RBF would need a wider intermediate format than the samples. Tone
+// mapping indexes its table with the integer (x * 255) >> frac_bits,
+// saturated to [0, 255], so samples above 1 use the last entry.
+//
+// The output differs slightly from the float dataflows. test_isp_fixed
+// reports the PSNR of the difference.
+
+typedef short isp_q_t;
+
+// Supported range of frac_bits. Demosaic adds up four samples, so scaled
+// inputs of up to 1 need two integer bits.
+#define ISP_Q_MIN_FRAC_BITS 8
+#define ISP_Q_MAX_FRAC_BITS 13
+
+#define ISP_Q_COEF_BITS 12
+#define ISP_Q_WEIGHT_BITS 14
+#define ISP_Q_LUT_SCALE_BITS 8
+
+// The camera model, gamut LUT and resize weights, quantized for the
+// fixed-point dataflow.
+typedef struct _isp_q_params_t {
+  int frac_bits;
+  // TsTw, stored transposed, in Q ISP_Q_COEF_BITS.
+  isp_q_t TsTw[CHAN_SIZE * CHAN_SIZE];
+  // As [256][CHAN_SIZE], in Q frac_bits.
+  isp_q_t tone_map[256 * CHAN_SIZE];
+  // The gamut LUT. lo and table are in Q frac_bits, and scale is in Q
+  // ISP_Q_LUT_SCALE_BITS.
+  int lut_size;
+  lut_interp_t lut_interp;
+  isp_q_t lut_lo[CHAN_SIZE];
+  isp_q_t lut_scale[CHAN_SIZE];
+  isp_q_t* lut_table;
+  // If not NULL, the resize stage resamples the frame with the taps of this
+  // plan, whose weights are stored here in Q ISP_Q_WEIGHT_BITS.
+  resize_plan_t* resize;
+  isp_q_t* resize_row_weights;
+  isp_q_t* resize_col_weights;
+} isp_q_params_t;
+
+// Quantize the camera model and the gamut LUT to frac_bits fractional bits.
+// resize may be NULL. It is not owned by the result, and must outlive it.
+isp_q_params_t* build_isp_q_params(int frac_bits,
+                                   float* TsTw,
+                                   float* tone_map,
+                                   gamut_lut_t* gamut_lut,
+                                   resize_plan_t* resize);
+
+void free_isp_q_params(isp_q_params_t* params);
+
+// Returns the number of isp_q_t of scratch space the resize stage needs, or
+// 0 if params has no resize.
+int get_fixed_isp_resize_temp_size(isp_q_params_t* params);
+
+// Fixed-point version of isp_hw_impl, which runs in software.
+//
+// Args:
+//   input_format, raw_bit_depth: As for isp_hw_impl_streaming.
+//   graph: The stages to run, in any order. Demosaic and denoise have a
+//      single integer kernel, whatever their impl.
+//   input: The input frame, of get_raw_frame_bytes() bytes.
+//   result: The CHW uint8 output frame.
+//   frames: Two frames of row_size * col_size * CHAN_SIZE isp_q_t each.
+//   resize_temp: Scratch space of get_fixed_isp_resize_temp_size() isp_q_t.
+void isp_hw_impl_fixed(int row_size,
+                       int col_size,
+                       raw_format_t input_format,
+                       int raw_bit_depth,
+                       isp_graph_t* graph,
+                       uint8_t* input,
+                       uint8_t* result,
+                       isp_q_t* frames,
+                       isp_q_t* resize_temp,
+                       isp_q_params_t* params);
+
+#endif
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <string.h>
+#include "common/utility.h"
+#include "nnet_lib/utility/fp16_utils.h"
+#include "nnet_lib/utility/profiling.h"
+#include "isp_fp16.h"
+#include "demosaic_simd.h"
+#include "denoise_simd.h"
+#include "gamut_map_simd.h"
+
+// Each stage reads rows of its input frame into fp32 rows stored as
+// [CHAN_SIZE][col_size], and stores its fp32 output row into the other frame.
+// Stencil stages keep the rows above, at and below their output row in a ring
+// of STREAMING_STENCIL_ROWS rows.
+
+// The 256-bit conversions are emulated one value at a time without F16C, and
+// on gem5, which lacks them. The scalar conversions round the same way.
+#if defined(__F16C__) && !defined(GEM5)
+#define FP16_ISP_VECTOR_SIZE 8
+#else
+#define FP16_ISP_VECTOR_SIZE 1
+#endif
+
+int get_fp16_isp_row_buffer_size(int col_size) {
+  // Stencil ring + an output row.
+  return (STREAMING_STENCIL_ROWS + 1) * CHAN_SIZE * col_size;
+}
+
+void fp16_to_fp32_row(uint16_t *input, int size, float *result) {
+  int i = 0;
+#if FP16_ISP_VECTOR_SIZE == 8
+  for (; i + FP16_ISP_VECTOR_SIZE <= size; i += FP16_ISP_VECTOR_SIZE) {
+    __m256 value = _CVT_PH_PS_256(_mm_loadu_si128((__m128i *)&input[i]));
+    _mm256_storeu_ps(&result[i], value);
+  }
+#endif
+  for (; i < size; i++)
+    result[i] = _CVT_SH_SS(input[i]);
+}
+
+void fp32_to_fp16_row(float *input, int size, uint16_t *result) {
+  int i = 0;
+#if FP16_ISP_VECTOR_SIZE == 8
+  for (; i + FP16_ISP_VECTOR_SIZE <= size; i += FP16_ISP_VECTOR_SIZE) {
+    __m128i value = _CVT_PS_PH_256(_mm256_loadu_ps(&input[i]),
+                                   _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128((__m128i *)&result[i], value);
+  }
+#endif
+  for (; i < size; i++)
+    result[i] = _CVT_SS_SH(input[i], _MM_FROUND_TO_NEAREST_INT);
+}
+
+// Convert row of the CHW fp16 frame to fp32.
+static void load_row(uint16_t *frame, int row, int row_size, int col_size,
+                     float *result) {
+  ARRAY_3D(uint16_t, _frame, frame, row_size, col_size);
+  ARRAY_2D(float, _result, result, col_size);
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    fp16_to_fp32_row(&_frame[chan][row][0], col_size, &_result[chan][0]);
+}
+
+// Convert an fp32 row to row of the CHW fp16 frame.
+static void store_row(float *input, int row, int row_size, int col_size,
+                      uint16_t *frame) {
+  ARRAY_2D(float, _input, input, col_size);
+  ARRAY_3D(uint16_t, _frame, frame, row_size, col_size);
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    fp32_to_fp16_row(&_input[chan][0], col_size, &_frame[chan][row][0]);
+}
+
+static void scale_fp16(uint8_t *input, raw_format_t input_format,
+                       int raw_bit_depth, int row_size, int col_size,
+                       float *row_buffer, uint16_t *result) {
+  ARRAY_3D(uint8_t, _input, input, row_size, col_size);
+  ARRAY_2D(float, _row, row_buffer, col_size);
+  int raw_row_bytes = get_raw_row_bytes(input_format, col_size);
+  for (int row = 0; row < row_size; row++) {
+    if (input_format == RawRgbPlanes) {
+      for (int chan = 0; chan < CHAN_SIZE; chan++)
+        for (int col = 0; col < col_size; col++)
+          _row[chan][col] = _input[chan][row][col] * 1.0 / 255;
+    } else {
+      scale_raw_row_simd(&input[row * raw_row_bytes], input_format,
+                         raw_bit_depth, row, col_size, row_buffer);
+    }
+    store_row(row_buffer, row, row_size, col_size, result);
+  }
+}
+
+// Runs a 3x3 stencil stage over the frame. The outermost rows are zeroed for
+// demosaic and copied for denoise, like demosaic_fxp and denoise_fxp do.
+static void stencil_fp16(isp_stage_t stage, uint16_t *input, int row_size,
+                         int col_size, float *row_buffers, uint16_t *result) {
+  const int kRows = STREAMING_STENCIL_ROWS;
+  int row_floats = CHAN_SIZE * col_size;
+  ARRAY_2D(float, _ring, row_buffers, row_floats);
+  float *output = &_ring[kRows][0];
+  load_row(input, 0, row_size, col_size, &_ring[0][0]);
+  for (int row = 0; row < row_size; row++) {
+    if (row + 1 < row_size)
+      load_row(input, row + 1, row_size, col_size, &_ring[(row + 1) % kRows][0]);
+    if (row == 0 || row == row_size - 1) {
+      if (stage == IspStageDemosaic)
+        memset(output, 0, sizeof(float) * row_floats);
+      else
+        memcpy(output, &_ring[row % kRows][0], sizeof(float) * row_floats);
+    } else {
+      float *above = &_ring[(row + kRows - 1) % kRows][0];
+      float *center = &_ring[row % kRows][0];
+      float *below = &_ring[(row + 1) % kRows][0];
+      if (stage == IspStageDemosaic) {
+        demosaic_row_simd(above, center, below, col_size, row, col_size,
+                          output, col_size);
+      } else {
+        for (int chan = 0; chan < CHAN_SIZE; chan++) {
+          median3x3_row_simd(&above[chan * col_size], &center[chan * col_size],
+                             &below[chan * col_size], col_size,
+                             &output[chan * col_size]);
+        }
+      }
+    }
+    store_row(output, row, row_size, col_size, result);
+  }
+}
+
+// Crops and resizes the frame. Every row of the crop is resampled
+// horizontally into the resize ring, and each output row is resampled
+// vertically as soon as its last input row is there.
+static void resize_fp16(uint16_t *input, int row_size, int col_size,
+                        resize_plan_t *resize, float *resize_ring,
+                        float *row_buffers, uint16_t *result) {
+  resize_cfg_t *cfg = &resize->cfg;
+  int ring_floats = CHAN_SIZE * cfg->out_cols;
+  float *input_row = row_buffers;
+  float *output_row = row_buffers + CHAN_SIZE * col_size;
+  int out_row = 0;
+  for (int crop_row = 0; crop_row < cfg->crop_rows; crop_row++) {
+    load_row(input, cfg->crop_row + crop_row, row_size, col_size, input_row);
+    resize_cols_simd(
+        resize, input_row, col_size,
+        &resize_ring[(crop_row % resize->ring_rows) * ring_floats]);
+    for (; out_row < cfg->out_rows &&
+           resize->rows.last[out_row] == crop_row;
+         out_row++) {
+      resize_rows_simd(resize, out_row, resize_ring, output_row);
+      store_row(output_row, out_row, cfg->out_rows, cfg->out_cols, result);
+    }
+  }
+}
+
+static void descale_fp16(uint16_t *input, int row_size, int col_size,
+                         float *row_buffer, uint8_t *result) {
+  ARRAY_2D(float, _row, row_buffer, col_size);
+  ARRAY_3D(uint8_t, _result, result, row_size, col_size);
+  for (int row = 0; row < row_size; row++) {
+    load_row(input, row, row_size, col_size, row_buffer);
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      for (int col = 0; col < col_size; col++)
+        _result[chan][row][col] = min(max(_row[chan][col] * 255, 0), 255);
+  }
+}
+
+void isp_hw_impl_fp16(int row_size,
+                      int col_size,
+                      raw_format_t input_format,
+                      int raw_bit_depth,
+                      isp_graph_t* graph,
+                      uint8_t* input,
+                      uint8_t* result,
+                      uint16_t* frames,
+                      float* row_buffers,
+                      resize_plan_t* resize,
+                      float* resize_ring,
+                      float* TsTw,
+                      float* ctrl_pts,
+                      float* weights,
+                      float* coefs,
+                      float* tone_map,
+                      float* l2_dist,
+                      gamut_map_impl_t gamut_impl,
+                      gamut_lut_t* gamut_lut,
+                      gamut_cache_t* gamut_cache,
+                      isp_stats_t* stats) {
+  uint16_t *frame = frames;
+  uint16_t *next_frame = frames + row_size * col_size * CHAN_SIZE;
+  float *row = row_buffers;
+  float *next_row = row_buffers + CHAN_SIZE * col_size;
+
+  begin_profiling(isp_stage_names[IspStageScale], ISP_PROFILING_LAYER);
+  scale_fp16(input, input_format, raw_bit_depth, row_size, col_size, row,
+             frame);
+  end_profiling();
+  // The stages after a resize only see the resized frame.
+  int rows = row_size;
+  int cols = col_size;
+  for (int i = 0; i < graph->num_stages; i++) {
+    isp_graph_stage_t stage = graph->stages[i];
+    if (stage.type == IspStageResize && !resize)
+      continue;
+    begin_profiling(isp_stage_names[stage.type], ISP_PROFILING_LAYER);
+    switch (stage.type) {
+      case IspStageDemosaic:
+      case IspStageDenoise:
+        stencil_fp16(stage.type, frame, rows, cols, row_buffers, next_frame);
+        break;
+      case IspStageResize:
+        resize_fp16(frame, rows, cols, resize, resize_ring, row_buffers,
+                    next_frame);
+        rows = resize->cfg.out_rows;
+        cols = resize->cfg.out_cols;
+        break;
+      default:
+        for (int r = 0; r < rows; r++) {
+          load_row(frame, r, rows, cols, row);
+          if (stage.type == IspStageTransform) {
+            if (stats)
+              transform_stats_row(row, cols, next_row, TsTw, stats);
+            else
+              transform_row(row, cols, next_row, TsTw);
+          } else if (stage.type == IspStageGamutMap) {
+            // A row is just a CHW image with a single row.
+            if (gamut_impl == GamutMapLut) {
+              gamut_map_lut_fxp(row, 1, cols, next_row, gamut_lut);
+            } else if (gamut_impl == GamutMapMemo) {
+              gamut_map_cached_row(gamut_cache, row, cols, next_row, ctrl_pts,
+                                   weights, coefs);
+            } else if (gamut_impl == GamutMapSimd) {
+              gamut_map_simd_row_fxp(row, cols, next_row, ctrl_pts, weights,
+                                     coefs);
+            } else {
+              gamut_map_row(row, cols, next_row, ctrl_pts, weights, coefs,
+                            l2_dist);
+            }
+          } else if (stage.impl == IspImplApprox) {
+            tone_map_approx_row(row, cols, next_row);
+          } else {
+            tone_map_row(row, cols, tone_map, next_row);
+          }
+          store_row(next_row, r, rows, cols, next_frame);
+        }
+        break;
+    }
+    SWAP_PTRS(frame, next_frame);
+    end_profiling();
+  }
+  begin_profiling(isp_stage_names[IspStageDescale], ISP_PROFILING_LAYER);
+  descale_fp16(frame, rows, cols, row, result);
+  end_profiling();
+}
@@ -0,0 +1,69 @@
+#ifndef _ISP_FP16_H_
+#define _ISP_FP16_H_
+
+#include "pipe_stages.h"
+#include "gamut_map_lut.h"
+#include "resize.h"
+#include "streaming_isp.h"
+
+// Frame dataflow with half-precision frame buffers.
+//
+// Like isp_hw_impl, every stage of the graph runs over the whole frame before
+// the next one starts, but the two frames it ping-pongs between hold fp16
+// instead of float, which halves their footprint and the memory traffic of
+// every stage. Each stage converts the rows it reads to fp32 with vcvtph2ps,
+// runs the same fp32 row kernels as the streaming dataflow on them, and
+// converts its output rows back with vcvtps2ph, 8 values at a time.
+//
+// Rounding every intermediate to fp16 makes the output differ slightly from
+// the fp32 dataflows. test_isp_fp16 reports the PSNR of the difference.
+
+// Returns the number of floats of row scratch space needed for frames that
+// are col_size pixels wide.
+int get_fp16_isp_row_buffer_size(int col_size);
+
+// Convert size fp16 values to float, and back.
+void fp16_to_fp32_row(uint16_t* input, int size, float* result);
+void fp32_to_fp16_row(float* input, int size, uint16_t* result);
+
+// Half-precision version of isp_hw_impl, which runs in software.
+//
+// Args:
+//   input_format, raw_bit_depth: As for isp_hw_impl_streaming.
+//   graph: The stages to run, in any order.
+//   input: The input frame, of get_raw_frame_bytes() bytes.
+//   result: The CHW uint8 output frame.
+//   frames: Two fp16 frames of row_size * col_size * CHAN_SIZE values each.
+//   row_buffers: Scratch space of get_fp16_isp_row_buffer_size(col_size)
+//      floats.
+//   resize: If not NULL, the resize stage crops and resizes the frame with
+//      this plan, and the output frame has its size.
+//   resize_ring: Scratch space of get_resize_ring_size() floats, if resize is
+//      not NULL.
+//   l2_dist: Scratch space of num_ctrl_pts floats for the gamut map.
+//   gamut_impl, gamut_lut, gamut_cache: Implementation of the gamut map
+//      stage, as for isp_hw_impl_streaming.
+//   stats: If not NULL, the transform stage adds every row it reads to it.
+void isp_hw_impl_fp16(int row_size,
+                      int col_size,
+                      raw_format_t input_format,
+                      int raw_bit_depth,
+                      isp_graph_t* graph,
+                      uint8_t* input,
+                      uint8_t* result,
+                      uint16_t* frames,
+                      float* row_buffers,
+                      resize_plan_t* resize,
+                      float* resize_ring,
+                      float* TsTw,
+                      float* ctrl_pts,
+                      float* weights,
+                      float* coefs,
+                      float* tone_map,
+                      float* l2_dist,
+                      gamut_map_impl_t gamut_impl,
+                      gamut_lut_t* gamut_lut,
+                      gamut_cache_t* gamut_cache,
+                      isp_stats_t* stats);
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _ISP_SIMD_H_
+#define _ISP_SIMD_H_
+
+#include <x86intrin.h>
+
+// Vector types shared by the software ISP kernels.
+//
+// ISP_VECTOR_SIZE floats are processed per instruction: 16 with AVX-512, 8
+// with AVX and 4 otherwise. isp_vec_t is only 4-byte aligned, so it can be
+// loaded from and stored to any float in a row with a plain dereference.
+#if defined(__AVX512F__)
+#define ISP_VECTOR_SIZE 16
+#define VEC_SQRT(x) ((isp_vec_t)_mm512_sqrt_ps((__m512)(x)))
+#define VEC_MIN(a, b) ((isp_vec_t)_mm512_min_ps((__m512)(a), (__m512)(b)))
+#define VEC_MAX(a, b) ((isp_vec_t)_mm512_max_ps((__m512)(a), (__m512)(b)))
+#elif defined(__AVX__)
+#define ISP_VECTOR_SIZE 8
+#define VEC_SQRT(x) ((isp_vec_t)_mm256_sqrt_ps((__m256)(x)))
+#define VEC_MIN(a, b) ((isp_vec_t)_mm256_min_ps((__m256)(a), (__m256)(b)))
+#define VEC_MAX(a, b) ((isp_vec_t)_mm256_max_ps((__m256)(a), (__m256)(b)))
+#else
+#define ISP_VECTOR_SIZE 4
+#define VEC_SQRT(x) ((isp_vec_t)_mm_sqrt_ps((__m128)(x)))
+#define VEC_MIN(a, b) ((isp_vec_t)_mm_min_ps((__m128)(a), (__m128)(b)))
+#define VEC_MAX(a, b) ((isp_vec_t)_mm_max_ps((__m128)(a), (__m128)(b)))
+#endif
+
+typedef float isp_vec_t
+        __attribute__((__vector_size__(ISP_VECTOR_SIZE * sizeof(float)),
+                       __aligned__(sizeof(float))));
+typedef int isp_ivec_t
+        __attribute__((__vector_size__(ISP_VECTOR_SIZE * sizeof(int)),
+                       __aligned__(sizeof(int))));
+
+// Access the ISP_VECTOR_SIZE floats starting at ptr.
+#define VEC_AT(ptr) (*(isp_vec_t*)(ptr))
+
+// Pick the lanes of a where mask is set and the lanes of b elsewhere.
+#define VEC_SELECT(mask, a, b)                                                 \
+  ((isp_vec_t)(((mask) & (isp_ivec_t)(a)) | (~(mask) & (isp_ivec_t)(b))))
+
+// Zero out the negative lanes of x.
+#define VEC_RELU(x) ((isp_vec_t)((isp_ivec_t)(x) & ((x) > 0)))
+
+// Median of three values, in four min/max operations. MIN and MAX may be the
+// scalar or the vector ones.
+#define MED3(a, b, c, MIN, MAX) MAX(MIN(a, b), MIN(MAX(a, b), c))
+
+// Sort a, b and c in place so that a <= b <= c.
+#define SORT3(a, b, c, MIN, MAX)                                               \
+  do {                                                                         \
+    __typeof__(a) _t = MIN(a, b);                                              \
+    b = MAX(a, b);                                                             \
+    a = _t;                                                                    \
+    _t = MIN(b, c);                                                            \
+    c = MAX(b, c);                                                             \
+    b = _t;                                                                    \
+    _t = MIN(a, b);                                                            \
+    b = MAX(a, b);                                                             \
+    a = _t;                                                                    \
+  } while (0)
+
+// Q-format fixed-point samples (see isp_fixed.h) are int16, and
+// ISP_QVEC_SIZE of them are processed per instruction: 32 with AVX-512BW, 16
+// with AVX2 and 8 otherwise. Like isp_vec_t, isp_qvec_t is only aligned to
+// its element.
+#if defined(__AVX512BW__)
+#define ISP_QVEC_SIZE 32
+#define QVEC_ADDS(a, b)                                                        \
+  ((isp_qvec_t)_mm512_adds_epi16((__m512i)(a), (__m512i)(b)))
+#define QVEC_MIN(a, b)                                                         \
+  ((isp_qvec_t)_mm512_min_epi16((__m512i)(a), (__m512i)(b)))
+#define QVEC_MAX(a, b)                                                         \
+  ((isp_qvec_t)_mm512_max_epi16((__m512i)(a), (__m512i)(b)))
+#define QVEC_MULHI(a, b)                                                       \
+  ((isp_qvec_t)_mm512_mulhi_epi16((__m512i)(a), (__m512i)(b)))
+#define QVEC_LOAD_U8(ptr)                                                      \
+  ((isp_qvec_t)_mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i*)(ptr))))
+#define QVEC_STORE_U8(ptr, x)                                                  \
+  _mm256_storeu_si256((__m256i*)(ptr), _mm512_cvtepi16_epi8((__m512i)(x)))
+#elif defined(__AVX2__)
+#define ISP_QVEC_SIZE 16
+#define QVEC_ADDS(a, b)                                                        \
+  ((isp_qvec_t)_mm256_adds_epi16((__m256i)(a), (__m256i)(b)))
+#define QVEC_MIN(a, b)                                                         \
+  ((isp_qvec_t)_mm256_min_epi16((__m256i)(a), (__m256i)(b)))
+#define QVEC_MAX(a, b)                                                         \
+  ((isp_qvec_t)_mm256_max_epi16((__m256i)(a), (__m256i)(b)))
+#define QVEC_MULHI(a, b)                                                       \
+  ((isp_qvec_t)_mm256_mulhi_epi16((__m256i)(a), (__m256i)(b)))
+#define QVEC_LOAD_U8(ptr)                                                      \
+  ((isp_qvec_t)_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(ptr))))
+// packus interleaves the two 128-bit halves, so gather the low 64 bits of
+// each back together.
+#define QVEC_STORE_U8(ptr, x)                                                  \
+  _mm_storeu_si128((__m128i*)(ptr),                                            \
+                   _mm256_castsi256_si128(_mm256_permute4x64_epi64(            \
+                       _mm256_packus_epi16((__m256i)(x), (__m256i)(x)), 0x08)))
+#else
+#define ISP_QVEC_SIZE 8
+#define QVEC_ADDS(a, b)                                                        \
+  ((isp_qvec_t)_mm_adds_epi16((__m128i)(a), (__m128i)(b)))
+#define QVEC_MIN(a, b)                                                         \
+  ((isp_qvec_t)_mm_min_epi16((__m128i)(a), (__m128i)(b)))
+#define QVEC_MAX(a, b)                                                         \
+  ((isp_qvec_t)_mm_max_epi16((__m128i)(a), (__m128i)(b)))
+#define QVEC_MULHI(a, b)                                                       \
+  ((isp_qvec_t)_mm_mulhi_epi16((__m128i)(a), (__m128i)(b)))
+#define QVEC_LOAD_U8(ptr)                                                      \
+  ((isp_qvec_t)_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(ptr)),             \
+                                 _mm_setzero_si128()))
+#define QVEC_STORE_U8(ptr, x)                                                  \
+  _mm_storel_epi64((__m128i*)(ptr),                                            \
+                   _mm_packus_epi16((__m128i)(x), (__m128i)(x)))
+#endif
+
+typedef short isp_qvec_t
+        __attribute__((__vector_size__(ISP_QVEC_SIZE * sizeof(short)),
+                       __aligned__(sizeof(short))));
+typedef unsigned short isp_uqvec_t
+        __attribute__((__vector_size__(ISP_QVEC_SIZE * sizeof(short)),
+                       __aligned__(sizeof(short))));
+
+// Access the ISP_QVEC_SIZE int16 values starting at ptr.
+#define QVEC_AT(ptr) (*(isp_qvec_t*)(ptr))
+
+// Broadcast x to every lane.
+#define QVEC_SET1(x) ((isp_qvec_t){} + (short)(x))
+
+// Pick the lanes of a where mask is set and the lanes of b elsewhere.
+#define QVEC_SELECT(mask, a, b) (((mask) & (a)) | (~(mask) & (b)))
+
+#endif
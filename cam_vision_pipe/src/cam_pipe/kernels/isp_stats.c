@@ -0,0 +1,204 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "isp_simd.h"
+#include "isp_stats.h"
+#include "streaming_isp.h"
+
+// Pixels whose bins are computed before any of them is counted.
+#define ISP_STATS_BLOCK 128
+
+void clear_isp_stats(isp_stats_t *stats) {
+  memset(stats, 0, sizeof(isp_stats_t));
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    stats->max[chan] = -FLT_MAX;
+}
+
+static inline int stats_bin(float value) {
+  value = min(max(value, 0.0f), 1.0f);
+  return min((int)(value * ISP_STATS_BINS), ISP_STATS_BINS - 1);
+}
+
+// The bins of ISP_VECTOR_SIZE values, as stats_bin. Only a value of exactly 1
+// lands past the last bin, and adding its all ones mask moves it back.
+static inline isp_ivec_t stats_bin_vec(isp_vec_t value) {
+  value = VEC_MIN(VEC_MAX(value, (isp_vec_t){ 0 }), (isp_vec_t){ 0 } + 1);
+  isp_ivec_t bin = __builtin_convertvector(value * ISP_STATS_BINS, isp_ivec_t);
+  return bin + (bin >= ISP_STATS_BINS);
+}
+
+void accumulate_isp_stats_row(isp_stats_t *stats, float *input,
+                              int col_size) {
+  ARRAY_2D(float, _input, input, col_size);
+  // The row sums are kept in float lanes, and only added to the double sums
+  // of stats once per row.
+  isp_vec_t sum[CHAN_SIZE] = { { 0 } };
+  isp_vec_t max_value[CHAN_SIZE];
+  isp_vec_t luma_sum = { 0 };
+  isp_ivec_t num_clipped = { 0 };
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    max_value[chan] = (isp_vec_t){ 0 } - FLT_MAX;
+  // The bins of a block of pixels are computed first, so that the histogram
+  // updates, which cannot be vectorized, are all that is left in the scalar
+  // loop. The luminance bins are stored last.
+  int bins[CHAN_SIZE + 1][ISP_STATS_BLOCK];
+  float tail_sum[CHAN_SIZE] = { 0 };
+  float tail_max[CHAN_SIZE] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  float tail_luma_sum = 0;
+  int tail_clipped = 0;
+
+  stats_block:
+  for (int start = 0; start < col_size; start += ISP_STATS_BLOCK) {
+    int block_size = min(ISP_STATS_BLOCK, col_size - start);
+    int num_vec_cols = block_size - block_size % ISP_VECTOR_SIZE;
+    stats_vec:
+    for (int i = 0; i < num_vec_cols; i += ISP_VECTOR_SIZE) {
+      isp_vec_t r = VEC_AT(&_input[0][start + i]);
+      isp_vec_t g = VEC_AT(&_input[1][start + i]);
+      isp_vec_t b = VEC_AT(&_input[2][start + i]);
+      isp_vec_t luma = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+      *(isp_ivec_t *)&bins[0][i] = stats_bin_vec(r);
+      *(isp_ivec_t *)&bins[1][i] = stats_bin_vec(g);
+      *(isp_ivec_t *)&bins[2][i] = stats_bin_vec(b);
+      *(isp_ivec_t *)&bins[3][i] = stats_bin_vec(luma);
+      sum[0] += r;
+      sum[1] += g;
+      sum[2] += b;
+      max_value[0] = VEC_MAX(max_value[0], r);
+      max_value[1] = VEC_MAX(max_value[1], g);
+      max_value[2] = VEC_MAX(max_value[2], b);
+      luma_sum += luma;
+      // Each clipped lane is an all ones mask, or -1.
+      num_clipped -= (r >= 1) | (g >= 1) | (b >= 1);
+    }
+    stats_tail:
+    for (int i = num_vec_cols; i < block_size; i++) {
+      float r = _input[0][start + i];
+      float g = _input[1][start + i];
+      float b = _input[2][start + i];
+      float luma = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+      bins[0][i] = stats_bin(r);
+      bins[1][i] = stats_bin(g);
+      bins[2][i] = stats_bin(b);
+      bins[3][i] = stats_bin(luma);
+      tail_sum[0] += r;
+      tail_sum[1] += g;
+      tail_sum[2] += b;
+      tail_max[0] = max(tail_max[0], r);
+      tail_max[1] = max(tail_max[1], g);
+      tail_max[2] = max(tail_max[2], b);
+      tail_luma_sum += luma;
+      tail_clipped += r >= 1 || g >= 1 || b >= 1;
+    }
+    stats_hist:
+    for (int i = 0; i < block_size; i++) {
+      stats->hist[0][bins[0][i]]++;
+      stats->hist[1][bins[1][i]]++;
+      stats->hist[2][bins[2][i]]++;
+      stats->luma_hist[bins[3][i]]++;
+    }
+  }
+
+  stats->num_pixels += col_size;
+  stats_lanes:
+  for (int lane = 0; lane < ISP_VECTOR_SIZE; lane++) {
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      tail_sum[chan] += sum[chan][lane];
+      tail_max[chan] = max(tail_max[chan], max_value[chan][lane]);
+    }
+    tail_luma_sum += luma_sum[lane];
+    tail_clipped += num_clipped[lane];
+  }
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    stats->sum[chan] += tail_sum[chan];
+    stats->max[chan] = max(stats->max[chan], tail_max[chan]);
+  }
+  stats->luma_sum += tail_luma_sum;
+  stats->num_clipped += tail_clipped;
+}
+
+void transform_stats_row(float *input, int col_size, float *result,
+                         float *TsTw_tran, isp_stats_t *stats) {
+  transform_row(input, col_size, result, TsTw_tran);
+  accumulate_isp_stats_row(stats, input, col_size);
+}
+
+void merge_isp_stats(isp_stats_t *stats, isp_stats_t *partial) {
+  stats->num_pixels += partial->num_pixels;
+  for (int bin = 0; bin < ISP_STATS_BINS; bin++) {
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      stats->hist[chan][bin] += partial->hist[chan][bin];
+    stats->luma_hist[bin] += partial->luma_hist[bin];
+  }
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    stats->sum[chan] += partial->sum[chan];
+    stats->max[chan] = max(stats->max[chan], partial->max[chan]);
+  }
+  stats->luma_sum += partial->luma_sum;
+  stats->num_clipped += partial->num_clipped;
+}
+
+float get_isp_stats_percentile(uint32_t *hist, uint64_t count,
+                               float fraction) {
+  uint64_t below = 0;
+  for (int bin = 0; bin < ISP_STATS_BINS; bin++) {
+    below += hist[bin];
+    if (below >= fraction * count)
+      return (bin + 1) / (float)ISP_STATS_BINS;
+  }
+  return 1;
+}
+
+int pick_wb_preset(isp_stats_t *stats, float *Tw, int num_presets) {
+  if (stats->num_pixels == 0)
+    return 0;
+  ARRAY_3D(float, _Tw, Tw, CHAN_SIZE, CHAN_SIZE);
+  int best = 0;
+  double best_spread = INFINITY;
+  for (int preset = 0; preset < num_presets; preset++) {
+    // The spread of the log of the balanced channel averages, which is 0 for
+    // a neutral grey.
+    double log_mean[CHAN_SIZE];
+    double mean = 0;
+    int valid = 1;
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      double balanced = _Tw[preset][chan][chan] * stats->sum[chan];
+      valid &= balanced > 0;
+      log_mean[chan] = valid ? log(balanced) : 0;
+      mean += log_mean[chan] / CHAN_SIZE;
+    }
+    if (!valid)
+      continue;
+    double spread = 0;
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      spread += (log_mean[chan] - mean) * (log_mean[chan] - mean);
+    if (spread < best_spread) {
+      best_spread = spread;
+      best = preset + 1;
+    }
+  }
+  return best;
+}
+
+void print_isp_stats(isp_stats_t *stats) {
+  if (stats->num_pixels == 0)
+    return;
+  double n = stats->num_pixels;
+  printf("ISP statistics of %lu pixels:\n", stats->num_pixels);
+  printf("  %-8s %10s %10s %10s %10s\n", "", "mean", "median", "p99", "max");
+  const char *names[CHAN_SIZE] = { "R", "G", "B" };
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    printf("  %-8s %10.4f %10.4f %10.4f %10.4f\n", names[chan],
+           stats->sum[chan] / n,
+           get_isp_stats_percentile(stats->hist[chan], n, 0.5),
+           get_isp_stats_percentile(stats->hist[chan], n, 0.99),
+           stats->max[chan]);
+  }
+  printf("  %-8s %10.4f %10.4f %10.4f\n", "luma", stats->luma_sum / n,
+         get_isp_stats_percentile(stats->luma_hist, n, 0.5),
+         get_isp_stats_percentile(stats->luma_hist, n, 0.99));
+  printf("  %.2f%% of the pixels have a clipped channel.\n",
+         100 * stats->num_clipped / n);
+}
@@ -0,0 +1,62 @@
+#ifndef _ISP_STATS_H_
+#define _ISP_STATS_H_
+
+#include "pipe_stages.h"
+
+// 3A statistics of a frame.
+//
+// The statistics describe the input of the transform stage: the demosaiced
+// and denoised camera RGB, before white balancing, with values nominally in
+// [0, 1]. They are accumulated from each row right after the transform stage
+// has read it (see transform_stats_row), while the row is still in the cache.
+//
+// Auto white balance uses the sum of each channel (grey world) and its
+// maximum (white patch). Auto exposure uses the luminance, 0.2126 R + 0.7152
+// G + 0.0722 B, and the number of pixels with a clipped channel. Every
+// channel and the luminance also get a histogram of ISP_STATS_BINS bins over
+// [0, 1]. Values outside of that range are counted in the first or last bin.
+//
+// Threads accumulate partial statistics of their own rows, which are then
+// merged with merge_isp_stats.
+
+#define ISP_STATS_BINS 256
+
+typedef struct _isp_stats_t {
+  uint64_t num_pixels;
+  uint32_t hist[CHAN_SIZE][ISP_STATS_BINS];
+  uint32_t luma_hist[ISP_STATS_BINS];
+  double sum[CHAN_SIZE];
+  float max[CHAN_SIZE];
+  double luma_sum;
+  // Pixels with a channel of at least 1.
+  uint64_t num_clipped;
+} isp_stats_t;
+
+void clear_isp_stats(isp_stats_t* stats);
+
+// Add the pixels of a CHW row to stats.
+void accumulate_isp_stats_row(isp_stats_t* stats, float* input, int col_size);
+
+// transform_row, followed by accumulate_isp_stats_row on its input row.
+void transform_stats_row(float* input,
+                         int col_size,
+                         float* result,
+                         float* TsTw_tran,
+                         isp_stats_t* stats);
+
+// Add the partial statistics of partial to stats.
+void merge_isp_stats(isp_stats_t* stats, isp_stats_t* partial);
+
+// Returns the value below which fraction of the values of hist fall, at the
+// upper edge of its bin.
+float get_isp_stats_percentile(uint32_t* hist, uint64_t count, float fraction);
+
+// Returns the white balance preset (counting from 1) whose gains make the
+// grey world average of stats the most neutral, or 0 if stats is empty.
+// Tw holds the num_presets diagonal white balance matrices, as
+// [num_presets][3][3].
+int pick_wb_preset(isp_stats_t* stats, float* Tw, int num_presets);
+
+void print_isp_stats(isp_stats_t* stats);
+
+#endif
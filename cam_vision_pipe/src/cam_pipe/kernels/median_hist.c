@@ -0,0 +1,189 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "isp_simd.h"
+#include "median_hist.h"
+
+// The counts of the MEDIAN_HIST_FINE levels of a coarse bin, or of the
+// MEDIAN_HIST_COARSE coarse bins, in one SSE register. Both are 16 bytes, and
+// every group of them is 16-byte aligned.
+typedef uint8_t mh_vec_t __attribute__((__vector_size__(16)));
+
+#define MH_AT(ptr) (*(mh_vec_t*)(ptr))
+
+median_hist_t *create_median_hist(int size, int col_size) {
+  assert(size % 2 == 1 && size <= MEDIAN_HIST_MAX_SIZE &&
+         "The median window must be odd, and at most MEDIAN_HIST_MAX_SIZE!");
+  median_hist_t *hist = malloc(sizeof(median_hist_t));
+  hist->size = size;
+  hist->radius = size / 2;
+  hist->col_size = col_size;
+  hist->fine = malloc_aligned(sizeof(uint8_t) * CHAN_SIZE * col_size *
+                              MEDIAN_HIST_LEVELS);
+  hist->coarse = malloc_aligned(sizeof(uint8_t) * CHAN_SIZE * col_size *
+                                MEDIAN_HIST_COARSE);
+  clear_median_hist(hist);
+  return hist;
+}
+
+void free_median_hist(median_hist_t *hist) {
+  free(hist->fine);
+  free(hist->coarse);
+  free(hist);
+}
+
+void clear_median_hist(median_hist_t *hist) {
+  memset(hist->fine, 0,
+         sizeof(uint8_t) * CHAN_SIZE * hist->col_size * MEDIAN_HIST_LEVELS);
+  memset(hist->coarse, 0,
+         sizeof(uint8_t) * CHAN_SIZE * hist->col_size * MEDIAN_HIST_COARSE);
+  hist->num_rows = 0;
+}
+
+static inline int median_hist_level(float value) {
+  value = min(max(value, 0.0f), 1.0f);
+  return (int)(value * (MEDIAN_HIST_LEVELS - 1) + 0.5f);
+}
+
+// Add delta (1 or -1) to the column histograms of chan for every pixel of
+// input, a row of that channel.
+static void update_chan(median_hist_t *hist, int chan, float *input,
+                        int delta) {
+  int col_size = hist->col_size;
+  ARRAY_3D(uint8_t, _fine, hist->fine, col_size, MEDIAN_HIST_LEVELS);
+  ARRAY_3D(uint8_t, _coarse, hist->coarse, col_size, MEDIAN_HIST_COARSE);
+  mh_update_col:
+  for (int col = 0; col < col_size; col++) {
+    int level = median_hist_level(input[col]);
+    _fine[chan][col][level] += delta;
+    _coarse[chan][col][level / MEDIAN_HIST_FINE] += delta;
+  }
+}
+
+// Returns the number of leading bins of counts that fit, along with the
+// *below samples under them, in rank samples. Their counts are added to
+// *below. The running sum is a log-step prefix sum, and as it only grows, the
+// bins that fit are the lanes of the mask, without a loop or a branch.
+static inline int count_bins_below(mh_vec_t counts, int rank, int *below) {
+  mh_vec_t sum = counts;
+  sum += (mh_vec_t)_mm_slli_si128((__m128i)sum, 1);
+  sum += (mh_vec_t)_mm_slli_si128((__m128i)sum, 2);
+  sum += (mh_vec_t)_mm_slli_si128((__m128i)sum, 4);
+  sum += (mh_vec_t)_mm_slli_si128((__m128i)sum, 8);
+  mh_vec_t fits = sum <= (uint8_t)(rank - *below);
+  int bins = __builtin_popcount(_mm_movemask_epi8((__m128i)fits));
+  if (bins > 0)
+    *below += sum[bins - 1];
+  return bins;
+}
+
+// Median filter input, a row of chan.
+static void filter_chan(median_hist_t *hist, int chan, float *input,
+                        float *result) {
+  int col_size = hist->col_size;
+  int radius = hist->radius;
+  ARRAY_3D(uint8_t, _fine, hist->fine, col_size, MEDIAN_HIST_LEVELS);
+  ARRAY_3D(uint8_t, _coarse, hist->coarse, col_size, MEDIAN_HIST_COARSE);
+  // The median has rank samples below it.
+  const int rank = hist->size * hist->size / 2;
+
+  mh_border:
+  for (int col = 0; col < min(radius, col_size); col++) {
+    result[col] = input[col];
+    result[col_size - 1 - col] = input[col_size - 1 - col];
+  }
+  if (col_size < hist->size)
+    return;
+
+  // The window histogram. fine[bin] holds the fine counts of coarse bin bin
+  // for the window centered on column stamp[bin], if it is not -1.
+  mh_vec_t coarse = { 0 };
+  mh_vec_t fine[MEDIAN_HIST_COARSE];
+  int stamp[MEDIAN_HIST_COARSE];
+  for (int bin = 0; bin < MEDIAN_HIST_COARSE; bin++)
+    stamp[bin] = -1;
+  mh_init:
+  for (int col = 0; col < hist->size; col++)
+    coarse += MH_AT(_coarse[chan][col]);
+
+  mh_col:
+  for (int col = radius; col < col_size - radius; col++) {
+    if (col > radius) {
+      coarse += MH_AT(_coarse[chan][col + radius]) -
+                MH_AT(_coarse[chan][col - radius - 1]);
+    }
+    int below = 0;
+    int bin = count_bins_below(coarse, rank, &below);
+
+    // Sliding the fine counts from their stamp costs two column histograms
+    // per column, and rebuilding them costs size.
+    int offset = bin * MEDIAN_HIST_FINE;
+    if (stamp[bin] < 0 || col - stamp[bin] > radius) {
+      fine[bin] = MH_AT(&_fine[chan][col - radius][offset]);
+      mh_build_fine:
+      for (int c = col - radius + 1; c <= col + radius; c++)
+        fine[bin] += MH_AT(&_fine[chan][c][offset]);
+    } else {
+      mh_slide_fine:
+      for (int c = stamp[bin] + 1; c <= col; c++) {
+        fine[bin] += MH_AT(&_fine[chan][c + radius][offset]) -
+                     MH_AT(&_fine[chan][c - radius - 1][offset]);
+      }
+    }
+    stamp[bin] = col;
+    int level = count_bins_below(fine[bin], rank, &below);
+    result[col] = (offset + level) / (float)(MEDIAN_HIST_LEVELS - 1);
+  }
+}
+
+void median_hist_add_row(median_hist_t *hist, float *input) {
+  ARRAY_2D(float, _input, input, hist->col_size);
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    update_chan(hist, chan, _input[chan], 1);
+  hist->num_rows++;
+}
+
+void median_hist_remove_row(median_hist_t *hist, float *input) {
+  ARRAY_2D(float, _input, input, hist->col_size);
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    update_chan(hist, chan, _input[chan], -1);
+  hist->num_rows--;
+}
+
+void median_hist_filter_row(median_hist_t *hist, float *input,
+                            float *result) {
+  ARRAY_2D(float, _input, input, hist->col_size);
+  ARRAY_2D(float, _result, result, hist->col_size);
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    filter_chan(hist, chan, _input[chan], _result[chan]);
+}
+
+void denoise_median_hist_fxp(float *input, int row_size, int col_size,
+                             int size, float *result) {
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(float, _result, result, row_size, col_size);
+  median_hist_t *hist = create_median_hist(size, col_size);
+  int radius = hist->radius;
+
+  dn_hist_row:
+  for (int row = 0; row < row_size; row++) {
+    if (row < radius || row >= row_size - radius) {
+      for (int chan = 0; chan < CHAN_SIZE; chan++) {
+        memcpy(_result[chan][row], _input[chan][row],
+               sizeof(float) * col_size);
+      }
+      continue;
+    }
+    // The window rows above row were added for the previous row.
+    int first = row == radius ? 0 : row + radius;
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      for (int i = first; i <= row + radius; i++)
+        update_chan(hist, chan, _input[chan][i], 1);
+      filter_chan(hist, chan, _input[chan][row], _result[chan][row]);
+      update_chan(hist, chan, _input[chan][row - radius], -1);
+    }
+  }
+  free_median_hist(hist);
+}
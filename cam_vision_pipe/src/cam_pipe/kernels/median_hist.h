@@ -0,0 +1,71 @@
+#ifndef _MEDIAN_HIST_H_
+#define _MEDIAN_HIST_H_
+
+#include "pipe_stages.h"
+
+// Constant-time median filter for large denoise windows.
+//
+// Sorting every window of a k x k median costs O(k^2 log k) per pixel at
+// best, and the bubble sort of denoise_fxp O(k^4). This is the sliding
+// histogram median of Perreault and Hebert instead: samples are quantized to
+// MEDIAN_HIST_LEVELS levels, and every column of the frame keeps a histogram
+// of the k rows around the current one. Moving down a row adds one row to the
+// column histograms and removes another, and moving right along a row adds
+// one column histogram to the window histogram and removes another, so the
+// cost per pixel does not depend on k.
+//
+// The histograms have two tiers: MEDIAN_HIST_COARSE coarse bins of
+// MEDIAN_HIST_FINE levels each. The window only slides its coarse histogram
+// at every pixel. The fine histogram of a coarse bin is brought up to date
+// when the median falls in it, which it usually did at a nearby column.
+//
+// Samples are clamped to [0, 1] and rounded to the nearest multiple of
+// 1/255, the precision of 8-bit input frames, and the output is the median
+// of the rounded samples. It is the exact median of 8-bit samples. The
+// pixels within k / 2 of the border are copied from the input, like
+// denoise_fxp does for the outermost pixels.
+
+#define MEDIAN_HIST_LEVELS 256
+#define MEDIAN_HIST_FINE 16
+#define MEDIAN_HIST_COARSE (MEDIAN_HIST_LEVELS / MEDIAN_HIST_FINE)
+// The counts are bytes, which hold up to 15x15 windows.
+#define MEDIAN_HIST_MAX_SIZE 15
+
+// The column histograms of one band of rows, for all channels.
+typedef struct _median_hist_t {
+  int size;
+  int radius;
+  int col_size;
+  // Rows in the column histograms.
+  int num_rows;
+  // [CHAN_SIZE][col_size][MEDIAN_HIST_LEVELS] and
+  // [CHAN_SIZE][col_size][MEDIAN_HIST_COARSE] counts.
+  uint8_t* fine;
+  uint8_t* coarse;
+} median_hist_t;
+
+// Create the column histograms for rows col_size pixels wide and a size x
+// size window. size must be odd, and at most MEDIAN_HIST_MAX_SIZE.
+median_hist_t* create_median_hist(int size, int col_size);
+
+void free_median_hist(median_hist_t* hist);
+
+// Empty the column histograms.
+void clear_median_hist(median_hist_t* hist);
+
+// Add a CHW row to the column histograms, or remove one added before.
+void median_hist_add_row(median_hist_t* hist, float* input);
+void median_hist_remove_row(median_hist_t* hist, float* input);
+
+// Median filter the CHW row input. The column histograms must hold the size
+// rows centered on it. result must not alias input.
+void median_hist_filter_row(median_hist_t* hist, float* input, float* result);
+
+// Median filter a CHW frame with a size x size window.
+void denoise_median_hist_fxp(float* input,
+                             int row_size,
+                             int col_size,
+                             int size,
+                             float* result);
+
+#endif
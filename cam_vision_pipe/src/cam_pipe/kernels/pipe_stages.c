@@ -1,8 +1,38 @@
 #include <stdio.h>
 #include <math.h>
+#include "nnet_lib/utility/profiling.h"
 #include "pipe_stages.h"
 #include "utility/cam_pipe_utility.h"
 
+const char *isp_stage_names[NumIspStages] = {
+  "scale", "demosaic", "denoise", "resize", "transform", "gamut map",
+  "tone map", "descale",
+};
+
+int find_isp_graph_stage(isp_graph_t *graph, isp_stage_t type) {
+  for (int i = 0; i < graph->num_stages; i++) {
+    if (graph->stages[i].type == type)
+      return i;
+  }
+  return -1;
+}
+
+int find_isp_graph_impl(isp_graph_t *graph, isp_stage_impl_t impl) {
+  for (int i = 0; i < graph->num_stages; i++) {
+    if (graph->stages[i].impl == impl)
+      return i;
+  }
+  return -1;
+}
+
+int check_isp_graph_order(isp_graph_t *graph) {
+  for (int i = 1; i < graph->num_stages; i++) {
+    if (graph->stages[i].type <= graph->stages[i - 1].type)
+      return 1;
+  }
+  return 0;
+}
+
 ALWAYS_INLINE
 void scale_fxp(uint8_t *input, int row_size, int col_size, float *output) {
   ARRAY_3D(uint8_t, _input, input, row_size, col_size);
@@ -38,6 +68,22 @@ void demosaic_fxp(float *input, int row_size, int col_size, float *result) {
   ARRAY_3D(float, _input, input, row_size, col_size);
   ARRAY_3D(float, _result, result, row_size, col_size);
 
+  // The outermost rows and columns have no full neighbourhood, so they are
+  // set to zero.
+  dm_border_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    dm_border_col:
+    for (int col = 0; col < col_size; col++) {
+      _result[chan][0][col] = 0;
+      _result[chan][row_size - 1][col] = 0;
+    }
+    dm_border_row:
+    for (int row = 0; row < row_size; row++) {
+      _result[chan][row][0] = 0;
+      _result[chan][row][col_size - 1] = 0;
+    }
+  }
+
   dm_row:
   for (int row = 1; row < row_size - 1; row++)
     dm_col:
@@ -220,6 +266,9 @@ void gamut_map_fxp(float *input, int row_size, int col_size, float *result,
 }
 
 // Tone mapping
+//
+// Samples outside of [0, 1] are clamped to the first or last entry of the
+// tone map.
 ALWAYS_INLINE
 void tone_map_fxp(float *input, int row_size, int col_size, float *tone_map,
                   float *result) {
@@ -234,12 +283,28 @@ void tone_map_fxp(float *input, int row_size, int col_size, float *tone_map,
     for (int row = 0; row < row_size; row++)
       tm_col:
       for (int col = 0; col < col_size; col++) {
-        uint8_t x = _input[chan][row][col] * 255;
+        uint8_t x = min(max(_input[chan][row][col] * 255, 0), 255);
         _result[chan][row][col] = _tone_map[x][chan];
       }
 }
 
 // Approximate tone mapping
+//
+// A piecewise linear curve instead of the tone map of the camera model. It
+// works on the same [0, 1] range as tone_map_fxp.
+ALWAYS_INLINE
+float tone_map_approx(float value) {
+  float x = value * 255;
+  float y;
+  if (x < 32)
+    y = x * 4;
+  else if (x < 128)
+    y = x + 96;
+  else
+    y = x / 4 + 192;
+  return max(min(y, 255), 0) / 255;
+}
+
 ALWAYS_INLINE
 void tone_map_approx_fxp(float *input, int row_size, int col_size,
                          float *result) {
@@ -252,19 +317,94 @@ void tone_map_approx_fxp(float *input, int row_size, int col_size,
     tm_apx_row:
     for (int row = 0; row < row_size; row++)
       tm_apx_col:
-      for (int col = 0; col < col_size; col++) {
-        if (_input[chan][row][col] < 32)
-          _result[chan][row][col] = _input[chan][row][col] * 4;
-        else if (_input[chan][row][col] < 128)
-          _result[chan][row][col] = _input[chan][row][col] + 96;
-        else
-          _result[chan][row][col] = _input[chan][row][col] / 4 + 192;
-        _result[chan][row][col] = max(min(_result[chan][row][col], 255), 0);
+      for (int col = 0; col < col_size; col++)
+        _result[chan][row][col] = tone_map_approx(_input[chan][row][col]);
+}
+
+// Color map, gamut map, tone map and descale in a single pass
+//
+// Every pixel goes through the four pointwise stages without leaving
+// registers, and only its final 8-bit value is stored. The arithmetic is the
+// same as running transform_fxp, gamut_map_fxp, tone_map_fxp and descale_fxp
+// one after another, without writing and reading back three float frames.
+ALWAYS_INLINE
+void color_pipe_fxp(float *input, int row_size, int col_size, float *TsTw_tran,
+                    float *ctrl_pts, float *weights, float *coefs,
+                    float *tone_map, float *l2_dist, uint8_t *result) {
+  PRINT("Fused color mapping, gamut mapping and tone mapping.\n");
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(uint8_t, _result, result, row_size, col_size);
+  ARRAY_2D(float, _TsTw_tran, TsTw_tran, 3);
+  ARRAY_2D(float, _ctrl_pts, ctrl_pts, 3);
+  ARRAY_2D(float, _weights, weights, 3);
+  ARRAY_2D(float, _coefs, coefs, 3);
+  ARRAY_2D(float, _tone_map, tone_map, 3);
+
+  cp_row:
+  for (int row = 0; row < row_size; row++)
+    cp_col:
+    for (int col = 0; col < col_size; col++) {
+      float pixel[CHAN_SIZE];
+      cp_tr_chan:
+      for (int chan = 0; chan < CHAN_SIZE; chan++) {
+        pixel[chan] = max(_input[0][row][col] * _TsTw_tran[0][chan] +
+                              _input[1][row][col] * _TsTw_tran[1][chan] +
+                              _input[2][row][col] * _TsTw_tran[2][chan],
+                          0);
+      }
+      cp_rbf_cp0:
+      for (int cp = 0; cp < num_ctrl_pts; cp++) {
+        l2_dist[cp] = sqrt((pixel[0] - _ctrl_pts[cp][0]) *
+                               (pixel[0] - _ctrl_pts[cp][0]) +
+                           (pixel[1] - _ctrl_pts[cp][1]) *
+                               (pixel[1] - _ctrl_pts[cp][1]) +
+                           (pixel[2] - _ctrl_pts[cp][2]) *
+                               (pixel[2] - _ctrl_pts[cp][2]));
+      }
+      cp_rbf_chan:
+      for (int chan = 0; chan < CHAN_SIZE; chan++) {
+        float chan_val = 0.0;
+        cp_rbf_cp1:
+        for (int cp = 0; cp < num_ctrl_pts; cp++) {
+          chan_val += l2_dist[cp] * _weights[cp][chan];
+        }
+        chan_val += _coefs[0][chan] + _coefs[1][chan] * pixel[0] +
+                    _coefs[2][chan] * pixel[1] + _coefs[3][chan] * pixel[2];
+        float gamut_val = max(chan_val, 0);
+        uint8_t x = min(gamut_val * 255, 255);
+        float tone_val = _tone_map[x][chan];
+        _result[chan][row][col] = min(max(tone_val * 255, 0), 255);
       }
+    }
+}
+
+// Stages of the frame dataflow are profiled when it runs natively, but not in
+// accelerator traces.
+#ifdef TRACE_MODE
+#define BEGIN_ISP_PROFILING(label)
+#define END_ISP_PROFILING()
+#else
+#define BEGIN_ISP_PROFILING(label) begin_profiling(label, ISP_PROFILING_LAYER)
+#define END_ISP_PROFILING() end_profiling()
+#endif
+
+// Returns whether the stages of graph from first on are the transform, gamut
+// map and exact tone map that color_pipe_fxp runs in a single pass.
+static int is_fusable_color_tail(isp_graph_t *graph, int first) {
+  return first == graph->num_stages - 3 &&
+         graph->stages[first].type == IspStageTransform &&
+         graph->stages[first + 1].type == IspStageGamutMap &&
+         graph->stages[first + 2].type == IspStageToneMap &&
+         graph->stages[first + 2].impl == IspImplExact;
 }
 
 void isp_hw_impl(int row_size,
                  int col_size,
+                 raw_format_t input_format,
+                 int raw_bit_depth,
+                 isp_graph_t graph,
+                 resize_cfg_t resize,
+                 int fuse_color,
                  uint8_t* acc_input,
                  uint8_t* acc_result,
                  float* acc_input_scaled,
@@ -280,33 +420,97 @@ void isp_hw_impl(int row_size,
     input_scaled_internal = acc_input_scaled;
     result_scaled_internal = acc_result_scaled;
 
-    scale_fxp(acc_input, row_size, col_size, acc_input_scaled);
-    demosaic_fxp(
-            input_scaled_internal, row_size, col_size, result_scaled_internal);
-    SWAP_PTRS(input_scaled_internal, result_scaled_internal);
-    denoise_fxp(
-            input_scaled_internal, row_size, col_size, result_scaled_internal);
-    SWAP_PTRS(input_scaled_internal, result_scaled_internal);
-    transform_fxp(input_scaled_internal,
-                  row_size,
-                  col_size,
-                  result_scaled_internal,
-                  acc_TsTw);
-    SWAP_PTRS(input_scaled_internal, result_scaled_internal);
-    gamut_map_fxp(input_scaled_internal,
-                  row_size,
-                  col_size,
-                  result_scaled_internal,
-                  acc_ctrl_pts,
-                  acc_weights,
-                  acc_coefs,
-                  acc_l2_dist);
-    SWAP_PTRS(input_scaled_internal, result_scaled_internal);
-    tone_map_fxp(input_scaled_internal,
-                 row_size,
-                 col_size,
-                 acc_tone_map,
-                 result_scaled_internal);
-    SWAP_PTRS(input_scaled_internal, result_scaled_internal);
-    descale_fxp(input_scaled_internal, row_size, col_size, acc_result);
+    BEGIN_ISP_PROFILING(isp_stage_names[IspStageScale]);
+    if (input_format == RawRgbPlanes) {
+        scale_fxp(acc_input, row_size, col_size, acc_input_scaled);
+    } else {
+        scale_raw_fxp(acc_input, input_format, raw_bit_depth, row_size,
+                      col_size, acc_input_scaled);
+    }
+    END_ISP_PROFILING();
+    // The stages after a resize only see the resized frame.
+    int rows = row_size;
+    int cols = col_size;
+    for (int i = 0; i < graph.num_stages; i++) {
+        isp_graph_stage_t stage = graph.stages[i];
+        if (fuse_color && is_fusable_color_tail(&graph, i)) {
+            BEGIN_ISP_PROFILING("color pipe");
+            color_pipe_fxp(input_scaled_internal,
+                           rows,
+                           cols,
+                           acc_TsTw,
+                           acc_ctrl_pts,
+                           acc_weights,
+                           acc_coefs,
+                           acc_tone_map,
+                           acc_l2_dist,
+                           acc_result);
+            END_ISP_PROFILING();
+            return;
+        }
+        BEGIN_ISP_PROFILING(isp_stage_names[stage.type]);
+        switch (stage.type) {
+            case IspStageDemosaic:
+                demosaic_fxp(input_scaled_internal, rows, cols,
+                             result_scaled_internal);
+                SWAP_PTRS(input_scaled_internal, result_scaled_internal);
+                break;
+            case IspStageDenoise:
+                denoise_fxp(input_scaled_internal, rows, cols,
+                            result_scaled_internal);
+                SWAP_PTRS(input_scaled_internal, result_scaled_internal);
+                break;
+            case IspStageResize:
+                // The resized frame is written back to the input.
+                if (resize.method != ResizeNone) {
+                    resize_fxp(input_scaled_internal,
+                               rows,
+                               cols,
+                               resize,
+                               result_scaled_internal,
+                               input_scaled_internal);
+                    rows = resize.out_rows;
+                    cols = resize.out_cols;
+                }
+                break;
+            case IspStageTransform:
+                transform_fxp(input_scaled_internal,
+                              rows,
+                              cols,
+                              result_scaled_internal,
+                              acc_TsTw);
+                SWAP_PTRS(input_scaled_internal, result_scaled_internal);
+                break;
+            case IspStageGamutMap:
+                gamut_map_fxp(input_scaled_internal,
+                              rows,
+                              cols,
+                              result_scaled_internal,
+                              acc_ctrl_pts,
+                              acc_weights,
+                              acc_coefs,
+                              acc_l2_dist);
+                SWAP_PTRS(input_scaled_internal, result_scaled_internal);
+                break;
+            case IspStageToneMap:
+                if (stage.impl == IspImplApprox) {
+                    tone_map_approx_fxp(input_scaled_internal, rows, cols,
+                                        result_scaled_internal);
+                } else {
+                    tone_map_fxp(input_scaled_internal,
+                                 rows,
+                                 cols,
+                                 acc_tone_map,
+                                 result_scaled_internal);
+                }
+                SWAP_PTRS(input_scaled_internal, result_scaled_internal);
+                break;
+            default:
+                break;
+        }
+        END_ISP_PROFILING();
+    }
+    BEGIN_ISP_PROFILING(isp_stage_names[IspStageDescale]);
+    descale_fxp(input_scaled_internal, rows, cols, acc_result);
+    END_ISP_PROFILING();
 }
@@ -2,6 +2,8 @@
 #define _PIPE_STAGES_H_
 
 #include "common/defs.h"
+#include "raw_unpack.h"
+#include "resize.h"
 
 #define CHAN_SIZE 3
 
@@ -20,8 +22,107 @@
 
 extern int num_ctrl_pts;
 
+// Stages of the ISP, in their default order.
+typedef enum _isp_stage_t {
+  IspStageScale,
+  IspStageDemosaic,
+  IspStageDenoise,
+  IspStageResize,
+  IspStageTransform,
+  IspStageGamutMap,
+  IspStageToneMap,
+  IspStageDescale,
+  NumIspStages,
+} isp_stage_t;
+
+extern const char* isp_stage_names[NumIspStages];
+
+// Implementation of a stage of an ISP stage graph.
+//
+// IspImplExact: The scalar kernel of this file.
+// IspImplSimd: The vectorized kernel, which has the same output. Only for
+//   demosaic and denoise, and not for the frame dataflow, whose isp_hw_impl
+//   models the accelerator and only runs the scalar kernels.
+// IspImplApprox: A cheaper approximation. Only for tone mapping, where it is
+//   tone_map_approx_fxp.
+//
+// The gamut map implementation is selected by gamut_map_impl instead, as the
+// streaming dataflow has more of them.
+typedef enum _isp_stage_impl_t {
+  IspImplExact,
+  IspImplSimd,
+  IspImplApprox,
+} isp_stage_impl_t;
+
+typedef struct _isp_graph_stage_t {
+  isp_stage_t type;
+  isp_stage_impl_t impl;
+} isp_graph_stage_t;
+
+// The stages an ISP runs between scaling the raw input and descaling the
+// output, in order. Each stage appears at most once, and a stage that is not
+// in the graph is skipped. The resize stage does nothing unless a resize is
+// configured.
+typedef struct _isp_graph_t {
+  int num_stages;
+  isp_graph_stage_t stages[NumIspStages];
+} isp_graph_t;
+
+// Returns the index of the stage of this type in graph, or -1.
+int find_isp_graph_stage(isp_graph_t* graph, isp_stage_t type);
+
+// Returns the index of the first stage of graph with this implementation, or
+// -1.
+int find_isp_graph_impl(isp_graph_t* graph, isp_stage_impl_t impl);
+
+// Returns 0 if the stages of graph are in the default order, and 1 otherwise.
+// The streaming dataflow can only run graphs in the default order.
+int check_isp_graph_order(isp_graph_t* graph);
+
+// Stages of the frame dataflow are logged to profiling.log with this layer
+// number.
+#define ISP_PROFILING_LAYER -1
+
+void scale_fxp(uint8_t* input, int row_size, int col_size, float* output);
+
+void demosaic_fxp(float* input, int row_size, int col_size, float* result);
+
+void denoise_fxp(float* input, int row_size, int col_size, float* result);
+
+void gamut_map_fxp(float* input,
+                   int row_size,
+                   int col_size,
+                   float* result,
+                   float* ctrl_pts,
+                   float* weights,
+                   float* coefs,
+                   float* l2_dist);
+
+float tone_map_approx(float value);
+
+void tone_map_approx_fxp(float* input,
+                         int row_size,
+                         int col_size,
+                         float* result);
+
+void color_pipe_fxp(float* input,
+                    int row_size,
+                    int col_size,
+                    float* TsTw_tran,
+                    float* ctrl_pts,
+                    float* weights,
+                    float* coefs,
+                    float* tone_map,
+                    float* l2_dist,
+                    uint8_t* result);
+
 void isp_hw_impl(int row_size,
                  int col_size,
+                 raw_format_t input_format,
+                 int raw_bit_depth,
+                 isp_graph_t graph,
+                 resize_cfg_t resize,
+                 int fuse_color,
                  uint8_t* acc_input,
                  uint8_t* acc_result,
                  float* acc_input_scaled,
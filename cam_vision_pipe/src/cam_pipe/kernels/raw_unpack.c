@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include "isp_simd.h"
+#include "pipe_stages.h"
+#include "raw_unpack.h"
+
+// Number of samples unpacked at a time by scale_raw_row_simd. This is a
+// multiple of every vector size, so each chunk starts at an even column.
+#define RAW_CHUNK_SIZE 256
+
+typedef uint8_t raw_u8vec_t
+        __attribute__((__vector_size__(ISP_VECTOR_SIZE), __aligned__(1)));
+typedef uint16_t raw_u16vec_t
+        __attribute__((__vector_size__(ISP_VECTOR_SIZE * sizeof(uint16_t)),
+                       __aligned__(sizeof(uint16_t))));
+
+int get_raw_row_bytes(raw_format_t format, int col_size) {
+  switch (format) {
+    case RawBayer10:
+      return col_size / 4 * 5;
+    case RawBayer12:
+      return col_size / 2 * 3;
+    case RawBayer16:
+      return col_size * 2;
+    default:
+      return col_size;
+  }
+}
+
+int get_raw_frame_bytes(raw_format_t format, int row_size, int col_size) {
+  int planes = format == RawRgbPlanes ? CHAN_SIZE : 1;
+  return planes * row_size * get_raw_row_bytes(format, col_size);
+}
+
+int get_raw_max_value(raw_format_t format, int bit_depth) {
+  switch (format) {
+    case RawBayer10:
+      return (1 << 10) - 1;
+    case RawBayer12:
+      return (1 << 12) - 1;
+    case RawBayer16:
+      return (1 << bit_depth) - 1;
+    default:
+      return 255;
+  }
+}
+
+int check_raw_format(raw_format_t format, int col_size) {
+  if (format == RawBayer10)
+    return col_size % 4 != 0;
+  if (format == RawBayer12)
+    return col_size % 2 != 0;
+  return 0;
+}
+
+// Returns the channel of the Bayer site at (row, col).
+// G R
+// B G
+ALWAYS_INLINE
+static int get_bayer_chan(int row, int col) {
+  if (row % 2 == col % 2)
+    return 1;
+  return row % 2 == 0 ? 0 : 2;
+}
+
+// Returns sample col of a row of a single-plane frame.
+ALWAYS_INLINE
+static int get_raw_sample(uint8_t *raw_row, raw_format_t format, int col) {
+  if (format == RawBayer10) {
+    uint8_t *group = &raw_row[col / 4 * 5];
+    return (group[col % 4] << 2) | ((group[4] >> (2 * (col % 4))) & 0x3);
+  } else if (format == RawBayer12) {
+    uint8_t *group = &raw_row[col / 2 * 3];
+    return (group[col % 2] << 4) | ((group[2] >> (4 * (col % 2))) & 0xf);
+  } else if (format == RawBayer16) {
+    return raw_row[2 * col] | (raw_row[2 * col + 1] << 8);
+  }
+  return raw_row[col];
+}
+
+ALWAYS_INLINE
+void scale_raw_fxp(uint8_t *input, raw_format_t format, int bit_depth,
+                   int row_size, int col_size, float *output) {
+  ARRAY_3D(float, _output, output, row_size, col_size);
+  int row_bytes = get_raw_row_bytes(format, col_size);
+  int max_value = get_raw_max_value(format, bit_depth);
+  slr_row:
+  for (int row = 0; row < row_size; row++) {
+    uint8_t *raw_row = &input[row * row_bytes];
+    slr_col:
+    for (int col = 0; col < col_size; col++) {
+      int site = get_bayer_chan(row, col);
+      int sample = get_raw_sample(raw_row, format, col) & max_value;
+      float value = sample * 1.0 / max_value;
+      slr_chan:
+      for (int chan = 0; chan < CHAN_SIZE; chan++)
+        _output[chan][row][col] = chan == site ? value : 0;
+    }
+  }
+}
+
+void scale_raw_q(uint8_t *input, raw_format_t format, int bit_depth,
+                 int row_size, int col_size, int frac_bits, short *output) {
+  ARRAY_3D(short, _output, output, row_size, col_size);
+  int row_bytes = get_raw_row_bytes(format, col_size);
+  int max_value = get_raw_max_value(format, bit_depth);
+  slq_row:
+  for (int row = 0; row < row_size; row++) {
+    uint8_t *raw_row = &input[row * row_bytes];
+    slq_col:
+    for (int col = 0; col < col_size; col++) {
+      int site = get_bayer_chan(row, col);
+      // Rounded; samples of up to 16 bits times 2^13 fit in an int.
+      int sample = get_raw_sample(raw_row, format, col) & max_value;
+      int value = ((sample << frac_bits) + max_value / 2) / max_value;
+      slq_chan:
+      for (int chan = 0; chan < CHAN_SIZE; chan++)
+        _output[chan][row][col] = chan == site ? value : 0;
+    }
+  }
+}
+
+// Unpack num_pixels RAW10 samples, a multiple of 4, into samples.
+static void unpack_raw10(uint8_t *raw, int num_pixels, uint16_t *samples) {
+  int pixel = 0;
+#ifdef __SSSE3__
+  // Each iteration unpacks two groups: 8 pixels from 10 bytes. The 16 byte
+  // load must stay inside the row, so the last groups are left to the scalar
+  // loop.
+  const __m128i msb_idx =
+      _mm_setr_epi8(0, -1, 1, -1, 2, -1, 3, -1, 5, -1, 6, -1, 7, -1, 8, -1);
+  const __m128i lsb_idx =
+      _mm_setr_epi8(4, -1, 4, -1, 4, -1, 4, -1, 9, -1, 9, -1, 9, -1, 9, -1);
+  // Shifts the low bits of pixel i to bits 7:6, as there is no per-lane
+  // shift of 16-bit lanes.
+  const __m128i lsb_mul = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+  const __m128i lsb_mask = _mm_set1_epi16(0x3);
+  ur10_simd:
+  for (; pixel / 4 * 5 + 16 <= num_pixels / 4 * 5; pixel += 8) {
+    __m128i bytes = _mm_loadu_si128((__m128i *)&raw[pixel / 4 * 5]);
+    __m128i msb = _mm_shuffle_epi8(bytes, msb_idx);
+    __m128i lsb = _mm_mullo_epi16(_mm_shuffle_epi8(bytes, lsb_idx), lsb_mul);
+    lsb = _mm_and_si128(_mm_srli_epi16(lsb, 6), lsb_mask);
+    _mm_storeu_si128((__m128i *)&samples[pixel],
+                     _mm_or_si128(_mm_slli_epi16(msb, 2), lsb));
+  }
+#endif
+  ur10_scalar:
+  for (; pixel < num_pixels; pixel++)
+    samples[pixel] = get_raw_sample(raw, RawBayer10, pixel);
+}
+
+// Unpack num_pixels RAW12 samples, a multiple of 2, into samples.
+static void unpack_raw12(uint8_t *raw, int num_pixels, uint16_t *samples) {
+  int pixel = 0;
+#ifdef __SSSE3__
+  // Each iteration unpacks four groups: 8 pixels from 12 bytes.
+  const __m128i msb_idx =
+      _mm_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+  const __m128i lsb_idx =
+      _mm_setr_epi8(2, -1, 2, -1, 5, -1, 5, -1, 8, -1, 8, -1, 11, -1, 11, -1);
+  const __m128i lsb_mul = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+  const __m128i lsb_mask = _mm_set1_epi16(0xf);
+  ur12_simd:
+  for (; pixel / 2 * 3 + 16 <= num_pixels / 2 * 3; pixel += 8) {
+    __m128i bytes = _mm_loadu_si128((__m128i *)&raw[pixel / 2 * 3]);
+    __m128i msb = _mm_shuffle_epi8(bytes, msb_idx);
+    __m128i lsb = _mm_mullo_epi16(_mm_shuffle_epi8(bytes, lsb_idx), lsb_mul);
+    lsb = _mm_and_si128(_mm_srli_epi16(lsb, 4), lsb_mask);
+    _mm_storeu_si128((__m128i *)&samples[pixel],
+                     _mm_or_si128(_mm_slli_epi16(msb, 4), lsb));
+  }
+#endif
+  ur12_scalar:
+  for (; pixel < num_pixels; pixel++)
+    samples[pixel] = get_raw_sample(raw, RawBayer12, pixel);
+}
+
+// Store ISP_VECTOR_SIZE scaled samples starting at an even column col into
+// the channels of their Bayer sites.
+static inline void store_bayer_vec(isp_vec_t value, int row, int col,
+                                   int col_size, float *result,
+                                   isp_ivec_t is_even) {
+  ARRAY_2D(float, _result, result, col_size);
+  isp_vec_t zero = {};
+  int even_chan = get_bayer_chan(row, 0);
+  int odd_chan = get_bayer_chan(row, 1);
+  VEC_AT(&_result[even_chan][col]) = VEC_SELECT(is_even, value, zero);
+  VEC_AT(&_result[odd_chan][col]) = VEC_SELECT(is_even, zero, value);
+  VEC_AT(&_result[CHAN_SIZE - even_chan - odd_chan][col]) = zero;
+}
+
+// Scalar tail of scale_raw_row_simd.
+static void scale_raw_row_scalar(uint8_t *raw_row, raw_format_t format,
+                                 int max_value, int row, int col_begin,
+                                 int col_size, float *result) {
+  ARRAY_2D(float, _result, result, col_size);
+  for (int col = col_begin; col < col_size; col++) {
+    int site = get_bayer_chan(row, col);
+    int sample = get_raw_sample(raw_row, format, col) & max_value;
+    float value = sample / (float)max_value;
+    for (int chan = 0; chan < CHAN_SIZE; chan++)
+      _result[chan][col] = chan == site ? value : 0;
+  }
+}
+
+void scale_raw_row_simd(uint8_t *raw_row, raw_format_t format, int bit_depth,
+                        int row, int col_size, float *result) {
+  // A float division by the saturated value rounds the same as the double
+  // division of scale_raw_fxp for every sample of up to 16 bits.
+  const int sample_mask = get_raw_max_value(format, bit_depth);
+  const float max_value = sample_mask;
+  isp_ivec_t is_even;
+  for (int i = 0; i < ISP_VECTOR_SIZE; i++)
+    is_even[i] = i % 2 == 0 ? -1 : 0;
+
+  int vec_end = col_size - col_size % ISP_VECTOR_SIZE;
+  if (format == RawBayer8) {
+    slr_simd_u8:
+    for (int col = 0; col < vec_end; col += ISP_VECTOR_SIZE) {
+      isp_vec_t value = __builtin_convertvector(
+          __builtin_convertvector(*(raw_u8vec_t *)&raw_row[col], isp_ivec_t),
+          isp_vec_t);
+      store_bayer_vec(value / max_value, row, col, col_size, result, is_even);
+    }
+  } else if (format == RawBayer16) {
+    uint16_t *samples = (uint16_t *)raw_row;
+    slr_simd_u16:
+    for (int col = 0; col < vec_end; col += ISP_VECTOR_SIZE) {
+      isp_vec_t value = __builtin_convertvector(
+          *(raw_u16vec_t *)&samples[col] & (uint16_t)sample_mask, isp_vec_t);
+      store_bayer_vec(value / max_value, row, col, col_size, result, is_even);
+    }
+  } else {
+    // Packed samples are unpacked to a chunk of uint16 that stays in the L1
+    // cache, and scaled from there.
+    uint16_t samples[RAW_CHUNK_SIZE];
+    slr_simd_chunk:
+    for (int chunk = 0; chunk < vec_end; chunk += RAW_CHUNK_SIZE) {
+      int chunk_size = min(RAW_CHUNK_SIZE, vec_end - chunk);
+      if (format == RawBayer10)
+        unpack_raw10(&raw_row[chunk / 4 * 5], chunk_size, samples);
+      else
+        unpack_raw12(&raw_row[chunk / 2 * 3], chunk_size, samples);
+      slr_simd_packed:
+      for (int i = 0; i < chunk_size; i += ISP_VECTOR_SIZE) {
+        isp_vec_t value = __builtin_convertvector(
+            *(raw_u16vec_t *)&samples[i], isp_vec_t);
+        store_bayer_vec(value / max_value, row, chunk + i, col_size, result,
+                        is_even);
+      }
+    }
+  }
+  scale_raw_row_scalar(raw_row, format, sample_mask, row, vec_end, col_size,
+                       result);
+}
+
+void pack_raw_row(uint16_t *samples, raw_format_t format, int col_size,
+                  uint8_t *raw_row) {
+  if (format == RawBayer10) {
+    prr_raw10:
+    for (int col = 0; col < col_size; col += 4) {
+      uint8_t *group = &raw_row[col / 4 * 5];
+      uint8_t lsb = 0;
+      for (int i = 0; i < 4; i++) {
+        group[i] = samples[col + i] >> 2;
+        lsb |= (samples[col + i] & 0x3) << (2 * i);
+      }
+      group[4] = lsb;
+    }
+  } else if (format == RawBayer12) {
+    prr_raw12:
+    for (int col = 0; col < col_size; col += 2) {
+      uint8_t *group = &raw_row[col / 2 * 3];
+      group[0] = samples[col] >> 4;
+      group[1] = samples[col + 1] >> 4;
+      group[2] = (samples[col] & 0xf) | ((samples[col + 1] & 0xf) << 4);
+    }
+  } else if (format == RawBayer16) {
+    prr_bayer16:
+    for (int col = 0; col < col_size; col++) {
+      raw_row[2 * col] = samples[col] & 0xff;
+      raw_row[2 * col + 1] = samples[col] >> 8;
+    }
+  } else {
+    prr_bayer8:
+    for (int col = 0; col < col_size; col++)
+      raw_row[col] = samples[col];
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef _RAW_UNPACK_H_
+#define _RAW_UNPACK_H_
+
+#include "common/defs.h"
+
+// Layout of the frames read from the camera sensor.
+//
+// RawRgbPlanes: CHW uint8 with all three channels, of which demosaic only
+//   uses the channel of each Bayer site. This is the original ISP input.
+// RawBayer8: A single plane of uint8 samples.
+// RawBayer10: MIPI CSI-2 RAW10. Every 4 pixels are packed into 5 bytes: bits
+//   9:2 of each pixel, then a byte with bits 1:0 of all four, pixel 0 in the
+//   lowest two bits.
+// RawBayer12: MIPI CSI-2 RAW12. Every 2 pixels are packed into 3 bytes: bits
+//   11:4 of each pixel, then a byte with bits 3:0 of both, pixel 0 in the
+//   lowest four bits.
+// RawBayer16: A single plane of little-endian uint16 samples, of which the
+//   lowest raw_bit_depth bits are used. The higher bits are masked off, so
+//   they cannot push a sample past saturation.
+//
+// The single-plane formats follow the G R / B G pattern of demosaic_fxp, and
+// rows are not padded. Scaling maps the largest sample to 1, so every format
+// produces the same scaled frame for the same scene.
+typedef enum _raw_format_t {
+  RawRgbPlanes,
+  RawBayer8,
+  RawBayer10,
+  RawBayer12,
+  RawBayer16,
+} raw_format_t;
+
+// Returns the number of bytes in one row of a frame, or in one row of one
+// channel for RawRgbPlanes.
+int get_raw_row_bytes(raw_format_t format, int col_size);
+
+// Returns the number of bytes in a whole frame.
+int get_raw_frame_bytes(raw_format_t format, int row_size, int col_size);
+
+// Returns the value of a saturated sample. bit_depth is only used by
+// RawBayer16.
+int get_raw_max_value(raw_format_t format, int bit_depth);
+
+// Returns 0 if frames col_size pixels wide can be stored in this format, and
+// 1 if the packed groups of pixels would straddle two rows.
+int check_raw_format(raw_format_t format, int col_size);
+
+// Scale stage for a single-plane frame.
+//
+// Every sample is unpacked, scaled and stored into the channel of its Bayer
+// site in the CHW output. The other two channels of that pixel are zero.
+void scale_raw_fxp(uint8_t* input,
+                   raw_format_t format,
+                   int bit_depth,
+                   int row_size,
+                   int col_size,
+                   float* output);
+
+// Fixed-point version of scale_raw_fxp. Samples are stored as int16 with
+// frac_bits fractional bits (see isp_fixed.h).
+void scale_raw_q(uint8_t* input,
+                 raw_format_t format,
+                 int bit_depth,
+                 int row_size,
+                 int col_size,
+                 int frac_bits,
+                 short* output);
+
+// Vectorized scale_raw_fxp for one row.
+//
+// Args:
+//   raw_row: The get_raw_row_bytes() bytes of the row.
+//   row: Index of the row in the frame, which selects its Bayer sites.
+//   result: The scaled row, stored as [CHAN_SIZE][col_size].
+void scale_raw_row_simd(uint8_t* raw_row,
+                        raw_format_t format,
+                        int bit_depth,
+                        int row,
+                        int col_size,
+                        float* result);
+
+// Pack a row of col_size samples of a single-plane format, the inverse of the
+// unpacking above. Samples must not exceed get_raw_max_value().
+void pack_raw_row(uint16_t* samples,
+                  raw_format_t format,
+                  int col_size,
+                  uint8_t* raw_row);
+
+#endif
@@ -0,0 +1,238 @@
+#include <stdlib.h>
+#include <math.h>
+#include "common/utility.h"
+#include "isp_simd.h"
+#include "pipe_stages.h"
+#include "resize.h"
+
+int check_resize_cfg(resize_cfg_t *cfg, int row_size, int col_size) {
+  if (cfg->method == ResizeNone)
+    return 0;
+  if (cfg->crop_row < 0 || cfg->crop_col < 0 || cfg->crop_rows <= 0 ||
+      cfg->crop_cols <= 0 || cfg->crop_row + cfg->crop_rows > row_size ||
+      cfg->crop_col + cfg->crop_cols > col_size)
+    return 1;
+  if (cfg->out_rows <= 0 || cfg->out_cols <= 0 ||
+      cfg->out_rows > cfg->crop_rows || cfg->out_cols > cfg->crop_cols)
+    return 1;
+  return 0;
+}
+
+int get_resize_out_rows(resize_cfg_t *cfg, int row_size) {
+  return cfg->method == ResizeNone ? row_size : cfg->out_rows;
+}
+
+int get_resize_out_cols(resize_cfg_t *cfg, int col_size) {
+  return cfg->method == ResizeNone ? col_size : cfg->out_cols;
+}
+
+int get_resize_max_taps(resize_method_t method, int in_size, int out_size) {
+  if (method == ResizeBilinear)
+    return 2;
+  // An output pixel covers in_size / out_size input pixels, which can
+  // straddle one more at either end.
+  return (int)ceil((double)in_size / out_size) + 1;
+}
+
+float get_resize_tap(resize_method_t method, int in_size, int out_size,
+                     int out_index, int tap, int *in_index) {
+  double scale = (double)in_size / out_size;
+  double weight;
+  int first;
+  if (method == ResizeBilinear) {
+    // Sample at the center of the output pixel.
+    double pos = (out_index + 0.5) * scale - 0.5;
+    pos = min(max(pos, 0), in_size - 1);
+    first = (int)pos;
+    double frac = pos - first;
+    weight = tap == 0 ? 1 - frac : (tap == 1 ? frac : 0);
+  } else {
+    double begin = out_index * scale;
+    double end = (out_index + 1) * scale;
+    first = (int)begin;
+    int index = first + tap;
+    weight = index < end && index < in_size
+                 ? (min(index + 1, end) - max(index, begin)) / scale
+                 : 0;
+  }
+  *in_index = weight == 0 ? first : first + tap;
+  return weight;
+}
+
+void resize_fxp(float *input, int row_size, int col_size, resize_cfg_t cfg,
+                float *temp, float *result) {
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(float, _temp, temp, cfg.crop_rows, cfg.out_cols);
+  ARRAY_3D(float, _result, result, cfg.out_rows, cfg.out_cols);
+  int col_taps = get_resize_max_taps(cfg.method, cfg.crop_cols, cfg.out_cols);
+  int row_taps = get_resize_max_taps(cfg.method, cfg.crop_rows, cfg.out_rows);
+
+  rs_col_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    rs_col_row:
+    for (int row = 0; row < cfg.crop_rows; row++) {
+      rs_col_col:
+      for (int col = 0; col < cfg.out_cols; col++) {
+        float sum = 0;
+        rs_col_tap:
+        for (int tap = 0; tap < col_taps; tap++) {
+          int index;
+          float weight = get_resize_tap(cfg.method, cfg.crop_cols,
+                                        cfg.out_cols, col, tap, &index);
+          sum += weight *
+                 _input[chan][cfg.crop_row + row][cfg.crop_col + index];
+        }
+        _temp[chan][row][col] = sum;
+      }
+    }
+  }
+
+  rs_row_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    rs_row_row:
+    for (int row = 0; row < cfg.out_rows; row++) {
+      rs_row_col:
+      for (int col = 0; col < cfg.out_cols; col++) {
+        float sum = 0;
+        rs_row_tap:
+        for (int tap = 0; tap < row_taps; tap++) {
+          int index;
+          float weight = get_resize_tap(cfg.method, cfg.crop_rows,
+                                        cfg.out_rows, row, tap, &index);
+          sum += weight * _temp[chan][index][col];
+        }
+        _result[chan][row][col] = sum;
+      }
+    }
+  }
+}
+
+static void build_resize_taps(resize_method_t method, int in_size,
+                              int out_size, resize_taps_t *taps) {
+  taps->max_taps = get_resize_max_taps(method, in_size, out_size);
+  taps->index = malloc_aligned(sizeof(int) * taps->max_taps * out_size);
+  taps->weights = malloc_aligned(sizeof(float) * taps->max_taps * out_size);
+  taps->last = malloc_aligned(sizeof(int) * out_size);
+  ARRAY_2D(int, _index, taps->index, out_size);
+  ARRAY_2D(float, _weights, taps->weights, out_size);
+  for (int i = 0; i < out_size; i++) {
+    taps->last[i] = 0;
+    for (int tap = 0; tap < taps->max_taps; tap++) {
+      _weights[tap][i] = get_resize_tap(method, in_size, out_size, i, tap,
+                                        &_index[tap][i]);
+      if (_weights[tap][i] != 0 || tap == 0)
+        taps->last[i] = _index[tap][i];
+    }
+  }
+}
+
+static void free_resize_taps(resize_taps_t *taps) {
+  free(taps->index);
+  free(taps->weights);
+  free(taps->last);
+}
+
+resize_plan_t *build_resize_plan(resize_cfg_t cfg) {
+  resize_plan_t *plan = malloc(sizeof(resize_plan_t));
+  plan->cfg = cfg;
+  build_resize_taps(cfg.method, cfg.crop_rows, cfg.out_rows, &plan->rows);
+  build_resize_taps(cfg.method, cfg.crop_cols, cfg.out_cols, &plan->cols);
+  // Every input row an output row uses has to still be in the ring when
+  // the last one arrives.
+  plan->ring_rows = 1;
+  for (int row = 0; row < cfg.out_rows; row++) {
+    plan->ring_rows = max(plan->ring_rows,
+                          plan->rows.last[row] - plan->rows.index[row] + 1);
+  }
+  return plan;
+}
+
+void free_resize_plan(resize_plan_t *plan) {
+  free_resize_taps(&plan->rows);
+  free_resize_taps(&plan->cols);
+  free(plan);
+}
+
+int get_resize_ring_size(resize_plan_t *plan) {
+  return plan->ring_rows * CHAN_SIZE * plan->cfg.out_cols;
+}
+
+// Load the ISP_VECTOR_SIZE floats at base[index[0...]].
+static inline isp_vec_t gather_vec(float *base, int *index) {
+#if defined(__AVX512F__)
+  return (isp_vec_t)_mm512_i32gather_ps(_mm512_loadu_si512(index), base, 4);
+#elif defined(__AVX2__)
+  return (isp_vec_t)_mm256_i32gather_ps(
+      base, _mm256_loadu_si256((__m256i *)index), 4);
+#else
+  isp_vec_t result;
+  for (int i = 0; i < ISP_VECTOR_SIZE; i++)
+    result[i] = base[index[i]];
+  return result;
+#endif
+}
+
+void resize_cols_simd(resize_plan_t *plan, float *input, int col_size,
+                      float *result) {
+  resize_cfg_t *cfg = &plan->cfg;
+  int out_cols = cfg->out_cols;
+  ARRAY_2D(float, _input, input, col_size);
+  ARRAY_2D(float, _result, result, out_cols);
+  ARRAY_2D(int, _index, plan->cols.index, out_cols);
+  ARRAY_2D(float, _weights, plan->cols.weights, out_cols);
+  int vec_end = out_cols - out_cols % ISP_VECTOR_SIZE;
+
+  rsc_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    float *row = &_input[chan][cfg->crop_col];
+    rsc_simd:
+    for (int col = 0; col < vec_end; col += ISP_VECTOR_SIZE) {
+      isp_vec_t sum = { 0 };
+      for (int tap = 0; tap < plan->cols.max_taps; tap++) {
+        sum += VEC_AT(&_weights[tap][col]) *
+               gather_vec(row, &_index[tap][col]);
+      }
+      VEC_AT(&_result[chan][col]) = sum;
+    }
+    rsc_tail:
+    for (int col = vec_end; col < out_cols; col++) {
+      float sum = 0;
+      for (int tap = 0; tap < plan->cols.max_taps; tap++)
+        sum += _weights[tap][col] * row[_index[tap][col]];
+      _result[chan][col] = sum;
+    }
+  }
+}
+
+void resize_rows_simd(resize_plan_t *plan, int out_row, float *ring,
+                      float *result) {
+  int out_cols = plan->cfg.out_cols;
+  int out_rows = plan->cfg.out_rows;
+  ARRAY_3D(float, _ring, ring, CHAN_SIZE, out_cols);
+  ARRAY_2D(float, _result, result, out_cols);
+  ARRAY_2D(int, _index, plan->rows.index, out_rows);
+  ARRAY_2D(float, _weights, plan->rows.weights, out_rows);
+  int vec_end = out_cols - out_cols % ISP_VECTOR_SIZE;
+
+  rsr_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    rsr_simd:
+    for (int col = 0; col < vec_end; col += ISP_VECTOR_SIZE) {
+      isp_vec_t sum = { 0 };
+      for (int tap = 0; tap < plan->rows.max_taps; tap++) {
+        int slot = _index[tap][out_row] % plan->ring_rows;
+        sum += _weights[tap][out_row] * VEC_AT(&_ring[slot][chan][col]);
+      }
+      VEC_AT(&_result[chan][col]) = sum;
+    }
+    rsr_tail:
+    for (int col = vec_end; col < out_cols; col++) {
+      float sum = 0;
+      for (int tap = 0; tap < plan->rows.max_taps; tap++) {
+        int slot = _index[tap][out_row] % plan->ring_rows;
+        sum += _weights[tap][out_row] * _ring[slot][chan][col];
+      }
+      _result[chan][col] = sum;
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef _RESIZE_H_
+#define _RESIZE_H_
+
+#include "common/defs.h"
+
+// Resizing the frame before the color stages.
+//
+// The resize stage runs right after denoise. It crops a window out of the
+// frame and downscales it to out_rows x out_cols, so that transform, gamut
+// map and tone map only see the pixels a DNN will consume. Each output pixel
+// is a weighted sum of input pixels. The horizontal pass runs first, over
+// every input row, and the vertical pass then combines those rows.
+//
+// ResizeNone: The frame keeps its size. The crop and output size are unused.
+// ResizeArea: Average the input pixels covered by each output pixel, weighted
+//   by how much of each one is covered.
+// ResizeBilinear: Interpolate the two nearest input pixels around the center
+//   of each output pixel in each direction. This is cheaper than area
+//   averaging for large factors, but aliases.
+typedef enum _resize_method_t {
+  ResizeNone,
+  ResizeArea,
+  ResizeBilinear,
+} resize_method_t;
+
+typedef struct _resize_cfg_t {
+  resize_method_t method;
+  // The window of the input frame that is resized.
+  int crop_row;
+  int crop_col;
+  int crop_rows;
+  int crop_cols;
+  int out_rows;
+  int out_cols;
+} resize_cfg_t;
+
+// Returns 0 if cfg fits a row_size x col_size frame, and 1 if the crop does
+// not fit or the output is larger than the crop.
+int check_resize_cfg(resize_cfg_t* cfg, int row_size, int col_size);
+
+// Returns the size of the output frame.
+int get_resize_out_rows(resize_cfg_t* cfg, int row_size);
+int get_resize_out_cols(resize_cfg_t* cfg, int col_size);
+
+// Returns the number of taps of each output pixel along one dimension.
+int get_resize_max_taps(resize_method_t method, int in_size, int out_size);
+
+// Returns the weight of tap of out_index along one dimension, and stores the
+// input index it applies to in in_index. Unused taps have a weight of 0 and
+// the input index of the first tap.
+float get_resize_tap(resize_method_t method,
+                     int in_size,
+                     int out_size,
+                     int out_index,
+                     int tap,
+                     int* in_index);
+
+// Resize stage, for CHW images.
+//
+// The horizontal pass writes crop_rows x out_cols pixels to temp, and the
+// vertical pass writes the out_rows x out_cols result. input may be reused as
+// result.
+void resize_fxp(float* input,
+                int row_size,
+                int col_size,
+                resize_cfg_t cfg,
+                float* temp,
+                float* result);
+
+// The taps of every output pixel along one dimension, for the streaming
+// dataflow. index and weights are stored as [max_taps][out_size] so that
+// consecutive output pixels can be processed as a vector. Indices are
+// relative to the crop.
+typedef struct _resize_taps_t {
+  int max_taps;
+  int* index;
+  float* weights;
+  // The last input index with a nonzero weight, per output pixel.
+  int* last;
+} resize_taps_t;
+
+// Precomputed taps for the streaming dataflow.
+//
+// Input rows are resampled horizontally one at a time, into a ring of
+// ring_rows rows of CHAN_SIZE * out_cols floats. An output row is produced
+// once the input row rows.last[] of it has been added to the ring.
+typedef struct _resize_plan_t {
+  resize_cfg_t cfg;
+  resize_taps_t rows;
+  resize_taps_t cols;
+  int ring_rows;
+} resize_plan_t;
+
+resize_plan_t* build_resize_plan(resize_cfg_t cfg);
+
+void free_resize_plan(resize_plan_t* plan);
+
+// Returns the number of floats in the ring of one plan.
+int get_resize_ring_size(resize_plan_t* plan);
+
+// Vectorized horizontal pass for one row. input is stored as
+// [CHAN_SIZE][col_size], and result as [CHAN_SIZE][out_cols].
+void resize_cols_simd(resize_plan_t* plan,
+                      float* input,
+                      int col_size,
+                      float* result);
+
+// Vectorized vertical pass for output row out_row. Input row r of the crop
+// is expected in slot r % ring_rows of ring.
+void resize_rows_simd(resize_plan_t* plan,
+                      int out_row,
+                      float* ring,
+                      float* result);
+
+#endif
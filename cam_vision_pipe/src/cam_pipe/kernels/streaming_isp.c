@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "common/utility.h"
+#include "utility/cam_pipe_utility.h"
+#include "streaming_isp.h"
+
+// Each stage works on a single row stored as [CHAN_SIZE][col_size]. A
+// stencil stage gets the rows above, at and below its output row in rows[].
+
+// Charge the time since start to stage, and return the current time.
+static double add_stage_time(double *stage_times, isp_stage_t stage,
+                             double start) {
+  if (!stage_times)
+    return 0;
+  double now = get_wall_time();
+  stage_times[stage] += now - start;
+  return now;
+}
+
+int get_streaming_line_buffer_size(int col_size, int denoise_size) {
+  // Scaled input ring + demosaiced ring + two rows for the pointwise stages.
+  return (STREAMING_STENCIL_ROWS + max(denoise_size, STREAMING_STENCIL_ROWS) +
+          2) * CHAN_SIZE * col_size;
+}
+
+ALWAYS_INLINE
+static void scale_row(uint8_t *input, int row, int row_size, int col_size,
+                      float *output) {
+  ARRAY_3D(uint8_t, _input, input, row_size, col_size);
+  ARRAY_2D(float, _output, output, col_size);
+  sl_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    sl_col:
+    for (int col = 0; col < col_size; col++)
+      _output[chan][col] = _input[chan][row][col] * 1.0 / 255;
+}
+
+ALWAYS_INLINE
+static void demosaic_row(float *rows[STREAMING_STENCIL_ROWS], int row,
+                         int row_size, int col_size, float *result) {
+  if (row == 0 || row == row_size - 1) {
+    memset(result, 0, sizeof(float) * CHAN_SIZE * col_size);
+    return;
+  }
+  demosaic_row_simd(rows[0], rows[1], rows[2], col_size, row, col_size, result,
+                    col_size);
+}
+
+ALWAYS_INLINE
+static void denoise_row(float *rows[STREAMING_STENCIL_ROWS], int row,
+                        int row_size, int col_size, float *result) {
+  ARRAY_2D(float, _above, rows[0], col_size);
+  ARRAY_2D(float, _input, rows[1], col_size);
+  ARRAY_2D(float, _below, rows[2], col_size);
+  ARRAY_2D(float, _result, result, col_size);
+
+  if (row == 0 || row == row_size - 1) {
+    memcpy(result, rows[1], sizeof(float) * CHAN_SIZE * col_size);
+    return;
+  }
+  dn_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    median3x3_row_simd(_above[chan], _input[chan], _below[chan], col_size,
+                       _result[chan]);
+}
+
+// Denoise row with the larger window of hist. ring holds the demosaiced rows
+// in slot r % ring_rows, like the rows of every other stage. The column
+// histograms of hist are slid down a row at a time, so consecutive rows only
+// add their bottom row and remove their top row.
+static void denoise_hist_row(median_hist_t *hist, float *ring, int ring_rows,
+                             int row, int row_size, int col_size,
+                             float *result) {
+  ARRAY_2D(float, _ring, ring, CHAN_SIZE * col_size);
+  int radius = hist->radius;
+  if (row < radius || row >= row_size - radius) {
+    memcpy(result, _ring[row % ring_rows],
+           sizeof(float) * CHAN_SIZE * col_size);
+    return;
+  }
+  if (hist->num_rows == 0) {
+    dn_hist_fill:
+    for (int i = row - radius; i < row + radius; i++)
+      median_hist_add_row(hist, _ring[i % ring_rows]);
+  }
+  median_hist_add_row(hist, _ring[(row + radius) % ring_rows]);
+  median_hist_filter_row(hist, _ring[row % ring_rows], result);
+  // The top row is overwritten by the next demosaiced row.
+  median_hist_remove_row(hist, _ring[(row - radius) % ring_rows]);
+}
+
+ALWAYS_INLINE
+void transform_row(float *input, int col_size, float *result,
+                   float *TsTw_tran) {
+  ARRAY_2D(float, _input, input, col_size);
+  ARRAY_2D(float, _result, result, col_size);
+  ARRAY_2D(float, _TsTw_tran, TsTw_tran, 3);
+
+  tr_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    tr_col:
+    for (int col = 0; col < col_size; col++)
+      _result[chan][col] = max(_input[0][col] * _TsTw_tran[0][chan] +
+                                   _input[1][col] * _TsTw_tran[1][chan] +
+                                   _input[2][col] * _TsTw_tran[2][chan],
+                               0);
+}
+
+ALWAYS_INLINE
+void gamut_map_row(float *input, int col_size, float *result,
+                   float *ctrl_pts, float *weights, float *coefs,
+                   float *l2_dist) {
+  ARRAY_2D(float, _input, input, col_size);
+  ARRAY_2D(float, _result, result, col_size);
+  ARRAY_2D(float, _ctrl_pts, ctrl_pts, 3);
+  ARRAY_2D(float, _weights, weights, 3);
+  ARRAY_2D(float, _coefs, coefs, 3);
+
+  gm_rbf_col:
+  for (int col = 0; col < col_size; col++) {
+    gm_rbf_cp0:
+    for (int cp = 0; cp < num_ctrl_pts; cp++) {
+      l2_dist[cp] = sqrt((_input[0][col] - _ctrl_pts[cp][0]) *
+                             (_input[0][col] - _ctrl_pts[cp][0]) +
+                         (_input[1][col] - _ctrl_pts[cp][1]) *
+                             (_input[1][col] - _ctrl_pts[cp][1]) +
+                         (_input[2][col] - _ctrl_pts[cp][2]) *
+                             (_input[2][col] - _ctrl_pts[cp][2]));
+    }
+    gm_rbf_chan:
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      float chan_val = 0.0;
+      gm_rbf_cp1:
+      for (int cp = 0; cp < num_ctrl_pts; cp++) {
+        chan_val += l2_dist[cp] * _weights[cp][chan];
+      }
+      chan_val += _coefs[0][chan] + _coefs[1][chan] * _input[0][col] +
+                  _coefs[2][chan] * _input[1][col] +
+                  _coefs[3][chan] * _input[2][col];
+      _result[chan][col] = max(chan_val, 0);
+    }
+  }
+}
+
+ALWAYS_INLINE
+void tone_map_row(float *input, int col_size, float *tone_map,
+                  float *result) {
+  ARRAY_2D(float, _input, input, col_size);
+  ARRAY_2D(float, _result, result, col_size);
+  ARRAY_2D(float, _tone_map, tone_map, 3);
+
+  tm_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    tm_col:
+    for (int col = 0; col < col_size; col++) {
+      uint8_t x = min(max(_input[chan][col] * 255, 0), 255);
+      _result[chan][col] = _tone_map[x][chan];
+    }
+}
+
+ALWAYS_INLINE
+void tone_map_approx_row(float *input, int col_size, float *result) {
+  tm_apx_col:
+  for (int i = 0; i < CHAN_SIZE * col_size; i++)
+    result[i] = tone_map_approx(input[i]);
+}
+
+ALWAYS_INLINE
+static void descale_row(float *input, int row, int row_size, int col_size,
+                        uint8_t *output) {
+  ARRAY_2D(float, _input, input, col_size);
+  ARRAY_3D(uint8_t, _output, output, row_size, col_size);
+  dsl_chan:
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    dsl_col:
+    for (int col = 0; col < col_size; col++)
+      _output[chan][row][col] = min(max(_input[chan][col] * 255, 0), 255);
+}
+
+void isp_hw_impl_streaming(int row_size,
+                           int col_size,
+                           raw_format_t input_format,
+                           int raw_bit_depth,
+                           isp_graph_t* graph,
+                           uint8_t* input,
+                           uint8_t* result,
+                           int row_begin,
+                           int row_end,
+                           float* line_buffers,
+                           median_hist_t* denoise_hist,
+                           resize_plan_t* resize,
+                           float* resize_ring,
+                           float* TsTw,
+                           float* ctrl_pts,
+                           float* weights,
+                           float* coefs,
+                           float* tone_map,
+                           float* l2_dist,
+                           gamut_map_impl_t gamut_impl,
+                           gamut_lut_t* gamut_lut,
+                           gamut_cache_t* gamut_cache,
+                           uint16_t* dnn_result,
+                           int dnn_align_pad,
+                           isp_stats_t* stats,
+                           double* stage_times) {
+  if (row_begin >= row_end)
+    return;
+  // Rows of the denoise window on either side of its center.
+  int radius = denoise_hist ? denoise_hist->radius : 1;
+  const int kDnRows = 2 * radius + 1;
+  ARRAY_3D(float, _scaled, line_buffers, CHAN_SIZE, col_size);
+  ARRAY_3D(float, _demosaiced, _scaled[STREAMING_STENCIL_ROWS], CHAN_SIZE,
+           col_size);
+  float *row_ping = &_demosaiced[kDnRows][0][0];
+  float *row_pong = row_ping + CHAN_SIZE * col_size;
+  int raw_row_bytes = get_raw_row_bytes(input_format, col_size);
+  uint16_t fp16_lut[256];
+  if (dnn_result)
+    init_dnn_fp16_lut(fp16_lut);
+  int do_demosaic = find_isp_graph_stage(graph, IspStageDemosaic) >= 0;
+  int do_denoise = find_isp_graph_stage(graph, IspStageDenoise) >= 0;
+  int do_transform = find_isp_graph_stage(graph, IspStageTransform) >= 0;
+  int do_gamut_map = find_isp_graph_stage(graph, IspStageGamutMap) >= 0;
+  int tone_map_stage = find_isp_graph_stage(graph, IspStageToneMap);
+  if (denoise_hist)
+    clear_median_hist(denoise_hist);
+
+  // The denoised rows [in_begin, in_end) are needed for the band of output
+  // rows.
+  int out_rows = row_size;
+  int out_cols = col_size;
+  int in_begin = row_begin;
+  int in_end = row_end;
+  int next_out_row = row_begin;
+  if (resize) {
+    out_rows = resize->cfg.out_rows;
+    out_cols = resize->cfg.out_cols;
+    in_begin = resize->cfg.crop_row + resize->rows.index[row_begin];
+    in_end = resize->cfg.crop_row + resize->rows.last[row_end - 1] + 1;
+  }
+  ARRAY_3D(float, _ring, resize_ring, CHAN_SIZE, out_cols);
+
+  // At step i, input row i is scaled, row i - 1 is demosaiced and row i - 1 -
+  // radius is denoised. Row r of a stage lives in slot r % (the number of rows)
+  // of its line buffer: STREAMING_STENCIL_ROWS for the scaled rows, and the
+  // height of the denoise window for the demosaiced rows. A band starts 1 +
+  // radius steps early and ends 1 + radius steps late, to fill in its halo.
+  //
+  // Without a resize, each denoised row is then pushed through the remaining
+  // pointwise stages. Otherwise it is resampled horizontally into the resize
+  // ring, and every output row whose last input row it is gets resampled
+  // vertically and pushed through them instead.
+  const int kRows = STREAMING_STENCIL_ROWS;
+  st_step:
+  for (int step = in_begin - 1 - radius; step < in_end + 1 + radius; step++) {
+    int dm_row = step - 1;
+    int dn_row = step - 1 - radius;
+    double t = stage_times ? get_wall_time() : 0;
+    if (step >= 0 && step < row_size) {
+      if (input_format == RawRgbPlanes) {
+        scale_row(input, step, row_size, col_size,
+                  &_scaled[step % kRows][0][0]);
+      } else {
+        scale_raw_row_simd(&input[step * raw_row_bytes], input_format,
+                           raw_bit_depth, step, col_size,
+                           &_scaled[step % kRows][0][0]);
+      }
+      t = add_stage_time(stage_times, IspStageScale, t);
+    }
+    if (dm_row >= in_begin - radius && dm_row >= 0 && dm_row < row_size) {
+      float *rows[STREAMING_STENCIL_ROWS] = {
+        &_scaled[(dm_row + kRows - 1) % kRows][0][0],
+        &_scaled[dm_row % kRows][0][0],
+        &_scaled[(dm_row + 1) % kRows][0][0],
+      };
+      if (do_demosaic) {
+        demosaic_row(rows, dm_row, row_size, col_size,
+                     &_demosaiced[dm_row % kDnRows][0][0]);
+      } else {
+        memcpy(&_demosaiced[dm_row % kDnRows][0][0], rows[1],
+               sizeof(float) * CHAN_SIZE * col_size);
+      }
+      t = add_stage_time(stage_times, IspStageDemosaic, t);
+    }
+    if (dn_row < in_begin)
+      continue;
+    float *rows[STREAMING_STENCIL_ROWS] = {
+      &_demosaiced[(dn_row + kDnRows - 1) % kDnRows][0][0],
+      &_demosaiced[dn_row % kDnRows][0][0],
+      &_demosaiced[(dn_row + 1) % kDnRows][0][0],
+    };
+    if (do_denoise && denoise_hist) {
+      denoise_hist_row(denoise_hist, &_demosaiced[0][0][0], kDnRows, dn_row,
+                       row_size, col_size, row_ping);
+    } else if (do_denoise) {
+      denoise_row(rows, dn_row, row_size, col_size, row_ping);
+    } else {
+      memcpy(row_ping, rows[1], sizeof(float) * CHAN_SIZE * col_size);
+    }
+    t = add_stage_time(stage_times, IspStageDenoise, t);
+
+    int out_row = dn_row;
+    int out_end = dn_row + 1;
+    if (resize) {
+      int crop_row = dn_row - resize->cfg.crop_row;
+      resize_cols_simd(resize, row_ping, col_size,
+                       &_ring[crop_row % resize->ring_rows][0][0]);
+      t = add_stage_time(stage_times, IspStageResize, t);
+      out_row = next_out_row;
+      while (next_out_row < row_end &&
+             resize->rows.last[next_out_row] == crop_row)
+        next_out_row++;
+      out_end = next_out_row;
+    }
+    st_out_row:
+    for (; out_row < out_end; out_row++) {
+      if (resize) {
+        resize_rows_simd(resize, out_row, resize_ring, row_ping);
+        t = add_stage_time(stage_times, IspStageResize, t);
+      }
+      // Each stage reads row and writes next.
+      float *row = row_ping;
+      float *next = row_pong;
+      if (do_transform) {
+        if (stats)
+          transform_stats_row(row, out_cols, next, TsTw, stats);
+        else
+          transform_row(row, out_cols, next, TsTw);
+        SWAP_PTRS(row, next);
+        t = add_stage_time(stage_times, IspStageTransform, t);
+      }
+      if (do_gamut_map) {
+        // A row is just a CHW image with a single row.
+        if (gamut_impl == GamutMapLut) {
+          gamut_map_lut_fxp(row, 1, out_cols, next, gamut_lut);
+        } else if (gamut_impl == GamutMapMemo) {
+          gamut_map_cached_row(gamut_cache, row, out_cols, next, ctrl_pts,
+                               weights, coefs);
+        } else if (gamut_impl == GamutMapSimd) {
+          gamut_map_simd_row_fxp(row, out_cols, next, ctrl_pts, weights,
+                                 coefs);
+        } else {
+          gamut_map_row(row, out_cols, next, ctrl_pts, weights, coefs,
+                        l2_dist);
+        }
+        SWAP_PTRS(row, next);
+        t = add_stage_time(stage_times, IspStageGamutMap, t);
+      }
+      if (tone_map_stage >= 0) {
+        if (graph->stages[tone_map_stage].impl == IspImplApprox)
+          tone_map_approx_row(row, out_cols, next);
+        else
+          tone_map_row(row, out_cols, tone_map, next);
+        SWAP_PTRS(row, next);
+        t = add_stage_time(stage_times, IspStageToneMap, t);
+      }
+      descale_row(row, out_row, out_rows, out_cols, result);
+      if (dnn_result) {
+        write_dnn_input_row(result, out_row, out_rows, out_cols, dnn_align_pad,
+                            fp16_lut, dnn_result);
+      }
+      t = add_stage_time(stage_times, IspStageDescale, t);
+    }
+  }
+}
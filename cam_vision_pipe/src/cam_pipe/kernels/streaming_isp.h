@@ -0,0 +1,132 @@
+#ifndef _STREAMING_ISP_H_
+#define _STREAMING_ISP_H_
+
+#include "pipe_stages.h"
+#include "demosaic_simd.h"
+#include "dnn_handoff.h"
+#include "denoise_simd.h"
+#include "gamut_map_cache.h"
+#include "gamut_map_lut.h"
+#include "gamut_map_simd.h"
+#include "isp_stats.h"
+#include "median_hist.h"
+#include "raw_unpack.h"
+#include "resize.h"
+
+// Number of rows kept in each rolling line buffer. Demosaic and denoise both
+// use a 3x3 stencil, so they need the row above and below the current one.
+#define STREAMING_STENCIL_ROWS 3
+
+// Implementation of the gamut map stage.
+//
+// GamutMapExact: Evaluate the RBF against every control point.
+// GamutMapLut: Interpolate a precomputed 3D LUT of gamut_lut_size^3 points,
+//   using gamut_lut_interp.
+// GamutMapSimd: Evaluate the exact RBF ISP_VECTOR_SIZE pixels at a time with
+//   gamut_map_simd_row_fxp.
+// GamutMapMemo: Look up every color in a gamut_cache_t that persists across
+//   frames, and only evaluate the RBF of the colors it misses, as
+//   GamutMapSimd does (see gamut_map_cache.h).
+//
+// Only GamutMapExact is supported by the frame dataflow.
+typedef enum _gamut_map_impl_t {
+  GamutMapExact,
+  GamutMapLut,
+  GamutMapSimd,
+  GamutMapMemo,
+} gamut_map_impl_t;
+
+// Returns the number of floats needed for the line buffers of a frame that is
+// col_size pixels wide, with a denoise_size x denoise_size median.
+int get_streaming_line_buffer_size(int col_size, int denoise_size);
+
+// The pointwise stages for a single row, stored as [CHAN_SIZE][col_size].
+void transform_row(float* input, int col_size, float* result, float* TsTw_tran);
+void gamut_map_row(float* input,
+                   int col_size,
+                   float* result,
+                   float* ctrl_pts,
+                   float* weights,
+                   float* coefs,
+                   float* l2_dist);
+void tone_map_row(float* input, int col_size, float* tone_map, float* result);
+void tone_map_approx_row(float* input, int col_size, float* result);
+
+// Streaming version of isp_hw_impl.
+//
+// Rather than running every stage over the whole frame before moving on to
+// the next one, this pushes one row at a time through the whole pipeline. The
+// scaled input and the demosaiced output are kept in rolling line buffers of
+// STREAMING_STENCIL_ROWS rows (or as many as the denoise window has), and the
+// pointwise stages work on a single row, so the working set is O(col_size)
+// instead of O(row_size * col_size).
+//
+// With the 3x3 median, the output is bit-identical to isp_hw_impl.
+//
+// Only output rows [row_begin, row_end) are produced, so a frame can be split
+// into bands that run in parallel, each with its own line buffers. A band
+// also scales the two input rows and demosaics the row on either side of it
+// (its halo), as the 3x3 stencils of the first rows and the last rows of the
+// band need them. With a larger denoise window, the halo grows to the radius
+// of the window.
+//
+// Args:
+//   input_format: Layout of the input frame. Single-plane formats are unpacked
+//      and scaled a row at a time by scale_raw_row_simd.
+//   raw_bit_depth: Significant bits of a RawBayer16 sample.
+//   graph: The enabled stages, which must be in the default order (see
+//      check_isp_graph_order). Demosaic and denoise always use the vectorized
+//      kernels. The resize stage is controlled by resize instead.
+//   input: The input frame, of get_raw_frame_bytes() bytes.
+//   result: The CHW uint8 output frame.
+//   row_begin, row_end: The band of output rows to produce.
+//   line_buffers: Scratch space of get_streaming_line_buffer_size(col_size,
+//      denoise_size) floats, where denoise_size is the size of denoise_hist,
+//      or 3 without it.
+//   denoise_hist: If not NULL, the denoise stage is a median over its larger
+//      window (see median_hist.h) instead of the vectorized 3x3 median. Its
+//      column histograms are scratch space of the band.
+//   resize: If not NULL, the denoised frame is cropped and resized with this
+//      plan, and the output frame has its size.
+//   resize_ring: Scratch space of get_resize_ring_size() floats, if resize is
+//      not NULL.
+//   l2_dist: Scratch space of num_ctrl_pts floats for the gamut map.
+//   gamut_impl: Implementation of the gamut map stage.
+//   gamut_lut: The LUT to interpolate if gamut_impl is GamutMapLut.
+//   gamut_cache: The cache of this band if gamut_impl is GamutMapMemo. It
+//      must be able to hold rows of the output width.
+//   dnn_result: If not NULL, each output row is also written here as fp16
+//      NHWC with dnn_align_pad padding channels (see dnn_handoff.h), while it
+//      is still in the cache.
+//   stats: If not NULL, the transform stage adds every row it reads to it
+//      (see transform_stats_row). Nothing is added without a transform stage.
+//   stage_times: If not NULL, the seconds spent in each isp_stage_t are
+//      added to it. The dnn_result conversion counts towards descaling.
+void isp_hw_impl_streaming(int row_size,
+                           int col_size,
+                           raw_format_t input_format,
+                           int raw_bit_depth,
+                           isp_graph_t* graph,
+                           uint8_t* input,
+                           uint8_t* result,
+                           int row_begin,
+                           int row_end,
+                           float* line_buffers,
+                           median_hist_t* denoise_hist,
+                           resize_plan_t* resize,
+                           float* resize_ring,
+                           float* TsTw,
+                           float* ctrl_pts,
+                           float* weights,
+                           float* coefs,
+                           float* tone_map,
+                           float* l2_dist,
+                           gamut_map_impl_t gamut_impl,
+                           gamut_lut_t* gamut_lut,
+                           gamut_cache_t* gamut_cache,
+                           uint16_t* dnn_result,
+                           int dnn_align_pad,
+                           isp_stats_t* stats,
+                           double* stage_times);
+
+#endif
@@ -0,0 +1,80 @@
+// Checks that the streaming dataflow produces the same output as the frame
+// dataflow.
+//
+// Usage: test_dataflows [threads]
+//
+// The camera model is read from $CAVA_HOME. Random frames of several sizes,
+// including odd ones, are run through cam_pipe() with each dataflow, and the
+// outputs are compared byte for byte. With threads, the streaming dataflow
+// also runs once more on the thread pool, which splits each frame into bands.
+// This returns nonzero if any output differs.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nnet_lib/utility/thread_pool.h"
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+// Returns the number of bytes of the streaming output that differ from the
+// frame output.
+static int compare_dataflows(uint8_t *input, int row_size, int col_size,
+                             uint8_t *expected, uint8_t *result) {
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  isp_dataflow = IspFrameDataflow;
+  cam_pipe(input, expected, row_size, col_size);
+  isp_dataflow = IspStreamingDataflow;
+  cam_pipe(input, result, row_size, col_size);
+  int num_diffs = 0;
+  for (int i = 0; i < frame_size; i++)
+    num_diffs += result[i] != expected[i];
+  return num_diffs;
+}
+
+int main(int argc, char *argv[]) {
+  int num_threads = argc > 1 ? atoi(argv[1]) : 4;
+  const int sizes[][2] = { { 4, 4 }, { 8, 8 },   { 17, 33 },
+                           { 32, 32 }, { 64, 48 }, { 91, 127 } };
+  const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  bool match = true;
+  for (int s = 0; s < num_sizes; s++) {
+    int row_size = sizes[s][0], col_size = sizes[s][1];
+    int frame_size = row_size * col_size * CHAN_SIZE;
+    uint8_t *input = malloc_aligned(sizeof(uint8_t) * frame_size);
+    uint8_t *expected = malloc_aligned(sizeof(uint8_t) * frame_size);
+    uint8_t *result = malloc_aligned(sizeof(uint8_t) * frame_size);
+    unsigned seed = s + 1;
+    for (int i = 0; i < frame_size; i++)
+      input[i] = rand_r(&seed) % 256;
+
+    int num_diffs =
+        compare_dataflows(input, row_size, col_size, expected, result);
+    printf("%3d x %3d, 1 thread:  %s", row_size, col_size,
+           num_diffs == 0 ? "outputs match\n" : "MISMATCH");
+    if (num_diffs != 0)
+      printf(", %d of %d values differ\n", num_diffs, frame_size);
+    match &= num_diffs == 0;
+
+    if (num_threads > 1) {
+      init_thread_pool(num_threads);
+      num_diffs =
+          compare_dataflows(input, row_size, col_size, expected, result);
+      destroy_thread_pool();
+      printf("%3d x %3d, %d threads: %s", row_size, col_size, num_threads,
+             num_diffs == 0 ? "outputs match\n" : "MISMATCH");
+      if (num_diffs != 0)
+        printf(", %d of %d values differ\n", num_diffs, frame_size);
+      match &= num_diffs == 0;
+    }
+
+    free(input);
+    free(expected);
+    free(result);
+  }
+  return match ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+// Benchmarks the vectorized demosaic against the scalar demosaic_fxp.
+//
+// Usage: test_demosaic [iterations]
+//
+// Random Bayer frames of 32x32, 1080p and 4K are demosaiced by both kernels,
+// and the throughput of each is reported in MPixel/s along with whether their
+// outputs match.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/kernels/demosaic_simd.h"
+#include "cam_pipe/kernels/pipe_stages.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 10;
+  const int sizes[][2] = { { 32, 32 }, { 1080, 1920 }, { 2160, 3840 } };
+  const char *names[] = { "32x32", "1080p", "4K" };
+
+  for (int s = 0; s < 3; s++) {
+    int row_size = sizes[s][0], col_size = sizes[s][1];
+    int frame_size = row_size * col_size * CHAN_SIZE;
+    double mpixels = row_size * col_size * 1e-6 * iterations;
+    float *input = malloc_aligned(sizeof(float) * frame_size);
+    float *expected = malloc_aligned(sizeof(float) * frame_size);
+    float *result = malloc_aligned(sizeof(float) * frame_size);
+
+    // Only the channel of each Bayer site is populated, as after scaling a
+    // raw frame.
+    ARRAY_3D(float, _input, input, row_size, col_size);
+    unsigned seed = 1;
+    memset(input, 0, sizeof(float) * frame_size);
+    for (int row = 0; row < row_size; row++) {
+      for (int col = 0; col < col_size; col++) {
+        int chan = row % 2 == col % 2 ? 1 : (row % 2 == 0 ? 0 : 2);
+        _input[chan][row][col] = (float)rand_r(&seed) / RAND_MAX;
+      }
+    }
+
+    // Warm up, so that neither kernel pays for first touching its output.
+    demosaic_fxp(input, row_size, col_size, expected);
+    demosaic_simd_fxp(input, row_size, col_size, result);
+
+    double start = get_wall_time();
+    for (int i = 0; i < iterations; i++)
+      demosaic_fxp(input, row_size, col_size, expected);
+    double scalar_time = get_wall_time() - start;
+
+    start = get_wall_time();
+    for (int i = 0; i < iterations; i++)
+      demosaic_simd_fxp(input, row_size, col_size, result);
+    double simd_time = get_wall_time() - start;
+
+    bool match = memcmp(expected, result, sizeof(float) * frame_size) == 0;
+    printf("%-6s scalar: %9.2f MPixel/s, simd: %9.2f MPixel/s (%.2fx), %s\n",
+           names[s], mpixels / scalar_time, mpixels / simd_time,
+           scalar_time / simd_time, match ? "outputs match" : "MISMATCH");
+
+    free(input);
+    free(expected);
+    free(result);
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+// Benchmarks the vectorized 3x3 median against the scalar denoise_fxp.
+//
+// Usage: test_denoise [iterations]
+//
+// Random frames of several sizes, from a few pixels up to 4K, are denoised by
+// both kernels, and the throughput of each is reported in MPixel/s along with
+// whether their outputs match. The samples are 8-bit levels, so that windows
+// have ties as in a real frame. This returns nonzero if any output differs.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/kernels/denoise_simd.h"
+#include "cam_pipe/kernels/pipe_stages.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 3;
+  const int sizes[][2] = { { 3, 3 },      { 5, 17 },     { 32, 32 },
+                           { 91, 127 },   { 1080, 1920 }, { 2160, 3840 } };
+  const char *names[] = { "3x3", "5x17", "32x32", "91x127", "1080p", "4K" };
+  const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  bool all_match = true;
+  for (int s = 0; s < num_sizes; s++) {
+    int row_size = sizes[s][0], col_size = sizes[s][1];
+    int frame_size = row_size * col_size * CHAN_SIZE;
+    double mpixels = row_size * col_size * 1e-6 * iterations;
+    float *input = malloc_aligned(sizeof(float) * frame_size);
+    float *expected = malloc_aligned(sizeof(float) * frame_size);
+    float *result = malloc_aligned(sizeof(float) * frame_size);
+    unsigned seed = s + 1;
+    for (int i = 0; i < frame_size; i++)
+      input[i] = (rand_r(&seed) % 256) / 255.0f;
+
+    // Warm up, so that neither kernel pays for first touching its output.
+    denoise_fxp(input, row_size, col_size, expected);
+    denoise_simd_fxp(input, row_size, col_size, result);
+
+    double start = get_wall_time();
+    for (int i = 0; i < iterations; i++)
+      denoise_fxp(input, row_size, col_size, expected);
+    double scalar_time = get_wall_time() - start;
+
+    start = get_wall_time();
+    for (int i = 0; i < iterations; i++)
+      denoise_simd_fxp(input, row_size, col_size, result);
+    double simd_time = get_wall_time() - start;
+
+    bool match = memcmp(expected, result, sizeof(float) * frame_size) == 0;
+    all_match &= match;
+    printf("%-6s scalar: %9.2f MPixel/s, simd: %9.2f MPixel/s (%.2fx), %s\n",
+           names[s], mpixels / scalar_time, mpixels / simd_time,
+           scalar_time / simd_time, match ? "outputs match" : "MISMATCH");
+
+    free(input);
+    free(expected);
+    free(result);
+  }
+  return all_match ? 0 : 1;
+}
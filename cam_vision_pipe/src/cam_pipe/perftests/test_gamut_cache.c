@@ -0,0 +1,100 @@
+// Benchmarks memoizing the gamut map across a stream of frames.
+//
+// Usage: test_gamut_cache [rows] [cols] [frames] [cache_kb] [image.bin]
+//
+// The camera model is read from $CAVA_HOME. The frames are run through the
+// streaming dataflow with the SIMD gamut map and with GamutMapMemo, and this
+// reports the average time per frame of each, the hit rate of the cache and
+// whether the outputs are identical. By default, the frames are a synthetic
+// scene of flat 16x16 patches of color with a little noise, which slides one
+// column to the left per frame. If an image (as written by
+// scripts/convert_image.py) is given, it is used as every frame instead, and
+// sets the frame size.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+#define PATCH_SIZE 16
+
+// Runs every frame through a streaming context with impl, storing the outputs
+// one after another in results, and returns the average time per frame.
+static double run_frames(gamut_map_impl_t impl, uint8_t *frames,
+                         int num_frames, int row_size, int col_size,
+                         uint8_t *results) {
+  gamut_map_impl = impl;
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  double start = get_wall_time();
+  for (int i = 0; i < num_frames; i++) {
+    isp_process_frame(ctx, &frames[i * frame_size],
+                      &results[i * frame_size]);
+  }
+  double frame_time = (get_wall_time() - start) / num_frames;
+  if (impl == GamutMapMemo)
+    isp_context_print_stage_times(ctx);
+  isp_context_destroy(ctx);
+  return frame_time;
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 480;
+  int col_size = argc > 2 ? atoi(argv[2]) : 640;
+  int num_frames = argc > 3 ? atoi(argv[3]) : 4;
+  gamut_cache_kb = argc > 4 ? atoi(argv[4]) : 4096;
+  uint8_t *image = NULL;
+  if (argc > 5) {
+    uint8_t *hwc_image = read_image_from_binary(argv[5], &row_size, &col_size);
+    convert_hwc_to_chw(hwc_image, row_size, col_size, &image);
+    free(hwc_image);
+  }
+  isp_dataflow = IspStreamingDataflow;
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  int patch_cols = col_size / PATCH_SIZE + num_frames + 1;
+  int num_patches = (row_size / PATCH_SIZE + 1) * patch_cols;
+  uint8_t *patches = malloc(sizeof(uint8_t) * num_patches * CHAN_SIZE);
+  uint8_t *frames = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *expected = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *result = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  unsigned seed = 1;
+  for (int i = 0; i < num_patches * CHAN_SIZE; i++)
+    patches[i] = 32 + rand_r(&seed) % 192;
+  for (int i = 0; i < num_frames; i++) {
+    ARRAY_3D(uint8_t, _frame, &frames[i * frame_size], row_size, col_size);
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      for (int row = 0; row < row_size; row++) {
+        for (int col = 0; col < col_size; col++) {
+          int patch = (row / PATCH_SIZE) * patch_cols +
+                      (col + i) / PATCH_SIZE;
+          _frame[chan][row][col] =
+              image ? image[(chan * row_size + row) * col_size + col]
+                    : patches[patch * CHAN_SIZE + chan] + rand_r(&seed) % 3;
+        }
+      }
+    }
+  }
+
+  printf("%d %d x %d frames, %d KB of gamut map cache.\n", num_frames,
+         row_size, col_size, gamut_cache_kb);
+  double simd_time = run_frames(GamutMapSimd, frames, num_frames, row_size,
+                                col_size, expected);
+  double memo_time = run_frames(GamutMapMemo, frames, num_frames, row_size,
+                                col_size, result);
+  bool match = memcmp(result, expected, frame_size * num_frames) == 0;
+  printf("  SIMD gamut map:     %8.3f ms per frame\n", simd_time * 1e3);
+  printf("  memoized gamut map: %8.3f ms per frame\n", memo_time * 1e3);
+  printf("  %s\n", match ? "outputs match" : "MISMATCH");
+
+  free(image);
+  free(patches);
+  free(frames);
+  free(expected);
+  free(result);
+  return match ? 0 : 1;
+}
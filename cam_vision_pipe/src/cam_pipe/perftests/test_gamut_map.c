@@ -0,0 +1,93 @@
+// Benchmarks the SIMD gamut map against the scalar gamut_map_fxp.
+//
+// Usage: test_gamut_map [rows] [cols] [threads]
+//
+// The camera model is read from $CAVA_HOME. A random frame is mapped by the
+// scalar kernel once and by the SIMD kernel once single-threaded and once with
+// the thread pool, and the throughput of each is reported in MPixel/s.
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/kernels/gamut_map_simd.h"
+#include "cam_pipe/kernels/pipe_stages.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+#include "cam_pipe/utility/load_cam_model.h"
+#include "nnet_lib/utility/thread_pool.h"
+
+static float max_abs_diff(float *a, float *b, int size) {
+  float diff = 0;
+  for (int i = 0; i < size; i++)
+    diff = max(diff, fabsf(a[i] - b[i]));
+  return diff;
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 64;
+  int col_size = argc > 2 ? atoi(argv[2]) : 64;
+  int num_threads = argc > 3 ? atoi(argv[3]) : 4;
+  double mpixels = row_size * col_size * 1e-6;
+
+  const char *cava_home = getenv("CAVA_HOME");
+  if (cava_home == NULL) {
+    fprintf(stderr, "CAVA_HOME returned NULL\n");
+    exit(1);
+  }
+  char cam_model_path[256];
+  snprintf(cam_model_path, sizeof(cam_model_path),
+           "%s/cam_vision_pipe/cam_models/NikonD7000/", cava_home);
+  float *ctrl_pts = get_ctrl_pts(cam_model_path, num_ctrl_pts);
+  float *weights = get_weights(cam_model_path, num_ctrl_pts);
+  float *coefs = get_coefs(cam_model_path, num_ctrl_pts);
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  float *input = malloc_aligned(sizeof(float) * frame_size);
+  float *expected = malloc_aligned(sizeof(float) * frame_size);
+  float *result = malloc_aligned(sizeof(float) * frame_size);
+  float *l2_dist = malloc_aligned(sizeof(float) * num_ctrl_pts);
+  unsigned seed = 1;
+  for (int i = 0; i < frame_size; i++)
+    input[i] = (float)rand_r(&seed) / RAND_MAX;
+
+  printf("Gamut map of a %d x %d frame, %d control points.\n", row_size,
+         col_size, num_ctrl_pts);
+  double start = get_wall_time();
+  gamut_map_fxp(input, row_size, col_size, expected, ctrl_pts, weights, coefs,
+                l2_dist);
+  double scalar_time = get_wall_time() - start;
+  printf("  scalar:            %8.3f MPixel/s\n", mpixels / scalar_time);
+
+  start = get_wall_time();
+  gamut_map_simd_fxp(input, row_size, col_size, result, ctrl_pts, weights,
+                     coefs);
+  double simd_time = get_wall_time() - start;
+  printf("  simd, 1 thread:    %8.3f MPixel/s (%.2fx), max error %g\n",
+         mpixels / simd_time, scalar_time / simd_time,
+         max_abs_diff(expected, result, frame_size));
+
+  if (num_threads > 1) {
+    init_thread_pool(num_threads);
+    memset(result, 0, sizeof(float) * frame_size);
+    start = get_wall_time();
+    gamut_map_simd_fxp(input, row_size, col_size, result, ctrl_pts, weights,
+                       coefs);
+    simd_time = get_wall_time() - start;
+    printf("  simd, %2d threads:  %8.3f MPixel/s (%.2fx), max error %g\n",
+           num_threads, mpixels / simd_time, scalar_time / simd_time,
+           max_abs_diff(expected, result, frame_size));
+    destroy_thread_pool();
+  }
+
+  free(input);
+  free(expected);
+  free(result);
+  free(l2_dist);
+  free(ctrl_pts);
+  free(weights);
+  free(coefs);
+  return 0;
+}
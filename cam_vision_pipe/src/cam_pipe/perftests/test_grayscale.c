@@ -0,0 +1,103 @@
+// Benchmarks the grayscale conversion of the ISP output.
+//
+// Usage: test_grayscale [rows] [cols] [iterations]
+//
+// A random CHW frame is converted to grayscale with the pow() based reference
+// conversion, with the table based SIMD conversion, and straight into a float
+// network input. The throughput of each is reported in MPixel/s, along with
+// how many gray values differ from the reference.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/kernels/grayscale.h"
+#include "cam_pipe/kernels/isp_simd.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+static float sRGB_to_linear(float x) {
+  if (x < 0.04045)
+    return x / 12.92;
+  return pow((x + 0.055) / 1.055, 2.4);
+}
+
+static float linear_to_sRGB(float y) {
+  if (y <= 0.0031308)
+    return 12.92 * y;
+  return 1.055 * pow(y, 1 / 2.4) - 0.055;
+}
+
+// The conversion this replaces.
+static void convert_to_gray_ref(uint8_t *input, int row_size, int col_size,
+                                uint8_t *result) {
+  int size = row_size * col_size;
+  ARRAY_2D(uint8_t, _input, input, size);
+  for (int i = 0; i < size; i++) {
+    float R_linear = sRGB_to_linear(_input[0][i] / 255.0);
+    float G_linear = sRGB_to_linear(_input[1][i] / 255.0);
+    float B_linear = sRGB_to_linear(_input[2][i] / 255.0);
+    float gray_linear =
+        0.2126 * R_linear + 0.7152 * G_linear + 0.0722 * B_linear;
+    result[i] = round(linear_to_sRGB(gray_linear) * 255);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 1080;
+  int col_size = argc > 2 ? atoi(argv[2]) : 1920;
+  int iterations = argc > 3 ? atoi(argv[3]) : 10;
+  int size = row_size * col_size;
+  // Pad rows to a multiple of 8 floats, like the input of an SMV network.
+  int align_pad = (8 - col_size % 8) % 8;
+
+  uint8_t *image = malloc_aligned(sizeof(uint8_t) * size * CHAN_SIZE);
+  uint8_t *expected = malloc_aligned(sizeof(uint8_t) * size);
+  uint8_t *result = malloc_aligned(sizeof(uint8_t) * size);
+  float *dnn_input =
+      malloc_aligned(sizeof(float) * row_size * (col_size + align_pad));
+  unsigned seed = 1;
+  for (int i = 0; i < size * CHAN_SIZE; i++)
+    image[i] = rand_r(&seed) % 256;
+  gray_lut_t lut;
+  init_gray_lut(&lut);
+
+  double start = get_wall_time();
+  for (int i = 0; i < iterations; i++)
+    convert_to_gray_ref(image, row_size, col_size, expected);
+  double ref_time = (get_wall_time() - start) / iterations;
+  start = get_wall_time();
+  for (int i = 0; i < iterations; i++)
+    convert_to_gray_simd(image, row_size, col_size, &lut, result);
+  double simd_time = (get_wall_time() - start) / iterations;
+  start = get_wall_time();
+  for (int i = 0; i < iterations; i++) {
+    write_gray_dnn_input(image, row_size, col_size, align_pad, &lut,
+                         dnn_input);
+  }
+  double dnn_time = (get_wall_time() - start) / iterations;
+
+  int simd_diffs = 0;
+  int dnn_diffs = 0;
+  ARRAY_2D(float, _dnn_input, dnn_input, col_size + align_pad);
+  for (int i = 0; i < size; i++) {
+    simd_diffs += result[i] != expected[i];
+    dnn_diffs += _dnn_input[i / col_size][i % col_size] != expected[i];
+  }
+
+  double mpixels = size / 1e6;
+  printf("%d x %d frame, %d floats per vector.\n", row_size, col_size,
+         ISP_VECTOR_SIZE);
+  printf("  pow() reference:  %8.1f MPixel/s\n", mpixels / ref_time);
+  printf("  SIMD tables:      %8.1f MPixel/s, %d of %d values differ\n",
+         mpixels / simd_time, simd_diffs, size);
+  printf("  into DNN input:   %8.1f MPixel/s, %d of %d values differ\n",
+         mpixels / dnn_time, dnn_diffs, size);
+
+  free(image);
+  free(expected);
+  free(result);
+  free(dnn_input);
+  return 0;
+}
@@ -0,0 +1,254 @@
+// Benchmarks the inverse camera pipeline that generates raw datasets.
+//
+// Usage: test_inverse_isp [rows] [cols] [frames] [threads] [image.bin]
+//
+// The camera model is read from $CAVA_HOME. By default, every frame is a
+// smooth synthetic scene. If an image (as written by scripts/convert_image.py)
+// is given, it is used as every frame instead, and sets the frame size.
+//
+// The exact inverse gamut map is timed on a few rows, as a whole frame takes
+// seconds, and checked against a scalar reference of the same stages. The
+// LUT version is timed on [frames] frames, on one thread and with the frames
+// spread over [threads] threads (4 by default), and reported in frames per
+// minute. Finally, the raw frame of each format is run through the forward
+// ISP, and this reports the PSNR of the result against the original image,
+// away from the border that demosaicing zeroes.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nnet_lib/utility/thread_pool.h"
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/kernels/inverse_isp.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+#include "cam_pipe/utility/load_cam_model.h"
+
+// Rows converted with the exact inverse gamut map.
+#define EXACT_ROWS 8
+// The white balance preset the ISP uses by default.
+#define WB_INDEX 6
+
+typedef struct _frame_worker_args {
+  inverse_isp_t *isp;
+  uint8_t *image;
+  int row_size;
+  int col_size;
+  int first;
+  int stride;
+  int num_frames;
+  uint8_t *results;
+} frame_worker_args;
+
+// Converts frames first, first + stride, ... of num_frames, each into its own
+// raw frame.
+static void *frame_worker(void *args) {
+  frame_worker_args *a = (frame_worker_args *)args;
+  int frame_bytes =
+      get_raw_frame_bytes(a->isp->format, a->row_size, a->col_size);
+  float *buffers =
+      malloc_aligned(sizeof(float) * get_inverse_isp_buffer_size(a->col_size));
+  for (int i = a->first; i < a->num_frames; i += a->stride) {
+    inverse_isp_frame(a->isp, a->image, a->row_size, a->col_size, buffers,
+                      &a->results[i * frame_bytes]);
+  }
+  free(buffers);
+  return NULL;
+}
+
+// Converts num_frames copies of image on num_threads threads, and returns the
+// number of frames per minute.
+static double run_frames(inverse_isp_t *isp, uint8_t *image, int row_size,
+                         int col_size, int num_frames, int num_threads,
+                         uint8_t *results) {
+  frame_worker_args args[num_threads];
+  for (int i = 0; i < num_threads; i++) {
+    args[i] = (frame_worker_args){ isp, image, row_size, col_size,
+                                   i, num_threads, num_frames, results };
+  }
+  double start = get_wall_time();
+  if (num_threads > 1) {
+    for (int i = 0; i < num_threads; i++)
+      thread_dispatch(frame_worker, &args[i]);
+    thread_pool_join();
+  } else {
+    frame_worker(&args[0]);
+  }
+  return num_frames * 60 / (get_wall_time() - start);
+}
+
+// The inverse stages of scripts/convert_image.py for one HWC pixel at (row,
+// col), with the RBF evaluated in double precision. Returns the sample of its
+// Bayer site, scaled to max_value.
+static int reference_pixel(uint8_t *pixel, int row, int col, float *tone_map,
+                           float *ctrl_pts, float *weights, float *coefs,
+                           float *TsTw_inv, int max_value) {
+  double color[CHAN_SIZE], mapped[CHAN_SIZE];
+  for (int chan = 0; chan < CHAN_SIZE; chan++)
+    color[chan] = tone_map[pixel[chan] * CHAN_SIZE + chan];
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    double sum = coefs[chan] + coefs[3 + chan] * color[0] +
+                 coefs[6 + chan] * color[1] + coefs[9 + chan] * color[2];
+    for (int cp = 0; cp < num_ctrl_pts; cp++) {
+      double dr = color[0] - ctrl_pts[cp * 3];
+      double dg = color[1] - ctrl_pts[cp * 3 + 1];
+      double db = color[2] - ctrl_pts[cp * 3 + 2];
+      sum += sqrt(dr * dr + dg * dg + db * db) * weights[cp * 3 + chan];
+    }
+    mapped[chan] = max(sum, 0);
+  }
+  int site = row % 2 == col % 2 ? 1 : (row % 2 == 0 ? 0 : 2);
+  double value = 0;
+  for (int k = 0; k < CHAN_SIZE; k++)
+    value += TsTw_inv[site * 3 + k] * mapped[k];
+  value = max(value, 0) * (site == 1 ? 0.5 : 1);
+  return min(value * max_value, max_value);
+}
+
+// PSNR of two CHW frames, without the outermost pixels.
+static double interior_psnr(uint8_t *image, uint8_t *reference, int row_size,
+                            int col_size) {
+  ARRAY_3D(uint8_t, _image, image, row_size, col_size);
+  ARRAY_3D(uint8_t, _reference, reference, row_size, col_size);
+  double squared_error = 0;
+  int size = 0;
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    for (int row = 1; row < row_size - 1; row++) {
+      for (int col = 1; col < col_size - 1; col++) {
+        double diff =
+            (double)_image[chan][row][col] - _reference[chan][row][col];
+        squared_error += diff * diff;
+        size++;
+      }
+    }
+  }
+  if (squared_error == 0)
+    return INFINITY;
+  return 10 * log10(255.0 * 255.0 * size / squared_error);
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 480;
+  int col_size = argc > 2 ? atoi(argv[2]) : 640;
+  int num_frames = argc > 3 ? atoi(argv[3]) : 32;
+  int num_threads = argc > 4 ? atoi(argv[4]) : 4;
+  uint8_t *image = NULL;
+  if (argc > 5) {
+    image = read_image_from_binary(argv[5], &row_size, &col_size);
+  } else {
+    image = malloc_aligned(sizeof(uint8_t) * row_size * col_size * CHAN_SIZE);
+    ARRAY_3D(uint8_t, _image, image, col_size, CHAN_SIZE);
+    for (int row = 0; row < row_size; row++) {
+      for (int col = 0; col < col_size; col++) {
+        float y = (float)row / row_size, x = (float)col / col_size;
+        _image[row][col][0] = 32 + 192 * y;
+        _image[row][col][1] = 32 + 192 * x;
+        _image[row][col][2] = 128 + 96 * sinf(6.28f * (x + y));
+      }
+    }
+  }
+  const char *cava_home = getenv("CAVA_HOME");
+  if (cava_home == NULL) {
+    fprintf(stderr, "CAVA_HOME returned NULL\n");
+    return 1;
+  }
+  char cam_model_path[256];
+  snprintf(cam_model_path, sizeof(cam_model_path),
+           "%s/cam_vision_pipe/cam_models/NikonD7000/", cava_home);
+  printf("%d x %d frames.\n", row_size, col_size);
+
+  // The exact RBF, against the scalar reference.
+  inverse_isp_t *exact =
+      create_inverse_isp(cam_model_path, WB_INDEX, 0, LutTetrahedral,
+                         RawBayer16, 16);
+  int exact_rows = min(EXACT_ROWS, row_size);
+  float *buffers =
+      malloc_aligned(sizeof(float) * get_inverse_isp_buffer_size(col_size));
+  uint8_t *raw = malloc_aligned(
+      get_raw_frame_bytes(RawRgbPlanes, row_size, col_size) * num_frames);
+  double start = get_wall_time();
+  inverse_isp_frame(exact, image, exact_rows, col_size, buffers, raw);
+  double exact_time = (get_wall_time() - start) * row_size / exact_rows;
+  float *TsTw_inv = get_inverse_TsTw(cam_model_path, WB_INDEX);
+  int max_diff = 0;
+  uint16_t *samples = (uint16_t *)raw;
+  for (int row = 0; row < exact_rows; row++) {
+    for (int col = 0; col < col_size; col++) {
+      int expected = reference_pixel(
+          &image[(row * col_size + col) * CHAN_SIZE], row, col,
+          exact->tone_map, exact->ctrl_pts, exact->weights, exact->coefs,
+          TsTw_inv, exact->max_value);
+      max_diff = max(max_diff, abs(samples[row * col_size + col] - expected));
+    }
+  }
+  free(TsTw_inv);
+  free_inverse_isp(exact);
+  printf("  exact RBF: %8.1f frames per minute, max difference from the "
+         "reference %d of 65535\n",
+         60 / exact_time, max_diff);
+
+  // The LUT, on one thread and on num_threads.
+  inverse_isp_t *isp =
+      create_inverse_isp(cam_model_path, WB_INDEX, gamut_lut_size,
+                         LutTetrahedral, RawRgbPlanes, 8);
+  int frame_bytes = get_raw_frame_bytes(RawRgbPlanes, row_size, col_size);
+  run_frames(isp, image, row_size, col_size, 1, 1, raw);
+  double single_rate =
+      run_frames(isp, image, row_size, col_size, num_frames, 1, raw);
+  init_thread_pool(num_threads);
+  double threaded_rate =
+      run_frames(isp, image, row_size, col_size, num_frames, num_threads, raw);
+  destroy_thread_pool();
+  bool match = true;
+  for (int i = 1; i < num_frames; i++)
+    match &= memcmp(raw, &raw[i * frame_bytes], frame_bytes) == 0;
+  printf("  %d^3 LUT: 1 thread %8.1f frames per minute, %d threads %8.1f, "
+         "%s\n",
+         gamut_lut_size, single_rate, num_threads, threaded_rate,
+         match ? "frames match" : "frames MISMATCH");
+  free_inverse_isp(isp);
+
+  // Round trip through the forward ISP.
+  const raw_format_t formats[] = { RawRgbPlanes, RawBayer8, RawBayer10,
+                                   RawBayer12, RawBayer16 };
+  const char *names[] = { "rgb", "bayer8", "raw10", "raw12", "bayer16" };
+  uint8_t *original = NULL;
+  convert_hwc_to_chw(image, row_size, col_size, &original);
+  uint8_t *result = malloc_aligned(sizeof(uint8_t) * frame_bytes);
+  isp_dataflow = IspStreamingDataflow;
+  gamut_map_impl = GamutMapLut;
+  printf("Round trip through the forward ISP:\n");
+  for (int f = 0; f < 5; f++) {
+    if (check_raw_format(formats[f], col_size))
+      continue;
+    isp = create_inverse_isp(cam_model_path, WB_INDEX, gamut_lut_size,
+                             LutTetrahedral, formats[f], 12);
+    inverse_isp_frame(isp, image, row_size, col_size, buffers, raw);
+    free_inverse_isp(isp);
+    uint8_t *input = raw;
+    uint8_t *chw = NULL;
+    if (formats[f] == RawRgbPlanes) {
+      convert_hwc_to_chw(raw, row_size, col_size, &chw);
+      input = chw;
+    }
+    raw_format = formats[f];
+    raw_bit_depth = 12;
+    isp_context_t *ctx = isp_context_create(row_size, col_size);
+    isp_process_frame(ctx, input, result);
+    isp_context_destroy(ctx);
+    free(chw);
+    printf("  %-8s PSNR %6.2f dB\n", names[f],
+           interior_psnr(result, original, row_size, col_size));
+  }
+
+  free(image);
+  free(original);
+  free(buffers);
+  free(raw);
+  free(result);
+  return match ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// Compares the fixed-point dataflow against the float streaming dataflow.
+//
+// Usage: test_isp_fixed [rows] [cols] [frames] [frac_bits] [image.bin]
+//
+// The camera model is read from $CAVA_HOME. Both dataflows interpolate the
+// same tetrahedral gamut map LUT and run on a single thread. Each frame is
+// run through an ISP context of each dataflow, and this reports the average
+// time per frame, the size of the frame buffers of each, and the PSNR of the
+// fixed-point output against the float output. If an image (as written by
+// scripts/convert_image.py) is given, it is used as every frame instead of
+// random pixels, and sets the frame size.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/kernels/isp_simd.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+// Runs every frame through a context of dataflow, storing the outputs one
+// after another in results, and returns the average time per frame.
+static double run_frames(isp_dataflow_t dataflow, uint8_t *frames,
+                         int num_frames, int row_size, int col_size,
+                         uint8_t *results) {
+  isp_dataflow = dataflow;
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  double start = get_wall_time();
+  for (int i = 0; i < num_frames; i++) {
+    isp_process_frame(ctx, &frames[i * frame_size],
+                      &results[i * frame_size]);
+  }
+  double frame_time = (get_wall_time() - start) / num_frames;
+  isp_context_destroy(ctx);
+  return frame_time;
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 32;
+  int col_size = argc > 2 ? atoi(argv[2]) : 32;
+  int num_frames = argc > 3 ? atoi(argv[3]) : 4;
+  isp_frac_bits = argc > 4 ? atoi(argv[4]) : 12;
+  uint8_t *image = NULL;
+  if (argc > 5) {
+    uint8_t *hwc_image = read_image_from_binary(argv[5], &row_size, &col_size);
+    convert_hwc_to_chw(hwc_image, row_size, col_size, &image);
+    free(hwc_image);
+  }
+  gamut_map_impl = GamutMapLut;
+  gamut_lut_interp = LutTetrahedral;
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  uint8_t *frames = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *expected = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *result = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  unsigned seed = 1;
+  for (int i = 0; i < num_frames; i++) {
+    for (int j = 0; j < frame_size; j++) {
+      frames[i * frame_size + j] = image ? image[j] : rand_r(&seed) % 256;
+    }
+  }
+
+  double float_time = run_frames(IspStreamingDataflow, frames, num_frames,
+                                 row_size, col_size, expected);
+  double fixed_time = run_frames(IspFixedPointDataflow, frames, num_frames,
+                                 row_size, col_size, result);
+
+  printf("%d %d x %d frames, %d fractional bits, %d int16 lanes.\n",
+         num_frames, row_size, col_size, isp_frac_bits, ISP_QVEC_SIZE);
+  printf("  float streaming dataflow: %8.3f ms per frame\n", float_time * 1e3);
+  printf("  fixed-point dataflow:     %8.3f ms per frame, %8.1f KB of frames\n",
+         fixed_time * 1e3, 2 * sizeof(isp_q_t) * frame_size / 1024.0);
+  int num_diffs = 0;
+  int max_diff = 0;
+  for (int i = 0; i < frame_size * num_frames; i++) {
+    int diff = abs(result[i] - expected[i]);
+    num_diffs += diff != 0;
+    max_diff = max(max_diff, diff);
+  }
+  printf("  PSNR %.2f dB, %d of %d values differ, by at most %d\n",
+         compute_psnr(result, expected, frame_size * num_frames), num_diffs,
+         frame_size * num_frames, max_diff);
+
+  free(image);
+  free(frames);
+  free(expected);
+  free(result);
+  return 0;
+}
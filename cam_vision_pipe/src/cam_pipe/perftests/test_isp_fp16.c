@@ -0,0 +1,97 @@
+// Compares the half-precision frame dataflow against the fp32 frame dataflow.
+//
+// Usage: test_isp_fp16 [rows] [cols] [frames] [image.bin]
+//
+// The camera model is read from $CAVA_HOME. Each frame is run through an ISP
+// context of each dataflow, and this reports the average time per frame, the
+// size of the frame buffers of each, and the PSNR of the fp16 output against
+// the fp32 output, with a histogram of the differences between them. If an
+// image (as written by scripts/convert_image.py) is given, it is used as
+// every frame instead of random pixels, and sets the frame size.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+// Runs every frame through a context of dataflow, storing the outputs one
+// after another in results, and returns the average time per frame.
+static double run_frames(isp_dataflow_t dataflow, uint8_t *frames,
+                         int num_frames, int row_size, int col_size,
+                         uint8_t *results) {
+  isp_dataflow = dataflow;
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  double start = get_wall_time();
+  for (int i = 0; i < num_frames; i++) {
+    isp_process_frame(ctx, &frames[i * frame_size],
+                      &results[i * frame_size]);
+  }
+  double frame_time = (get_wall_time() - start) / num_frames;
+  isp_context_destroy(ctx);
+  return frame_time;
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 32;
+  int col_size = argc > 2 ? atoi(argv[2]) : 32;
+  int num_frames = argc > 3 ? atoi(argv[3]) : 4;
+  uint8_t *image = NULL;
+  if (argc > 4) {
+    uint8_t *hwc_image = read_image_from_binary(argv[4], &row_size, &col_size);
+    convert_hwc_to_chw(hwc_image, row_size, col_size, &image);
+    free(hwc_image);
+  }
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  uint8_t *frames = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *expected = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *result = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  unsigned seed = 1;
+  for (int i = 0; i < num_frames; i++) {
+    for (int j = 0; j < frame_size; j++) {
+      frames[i * frame_size + j] = image ? image[j] : rand_r(&seed) % 256;
+    }
+  }
+
+  double fp32_time = run_frames(IspFrameDataflow, frames, num_frames,
+                                row_size, col_size, expected);
+  double fp16_time = run_frames(IspHalfFrameDataflow, frames, num_frames,
+                                row_size, col_size, result);
+
+  printf("%d %d x %d frames.\n", num_frames, row_size, col_size);
+  printf("  fp32 frame dataflow: %8.3f ms per frame, %8.1f KB of frames\n",
+         fp32_time * 1e3, 2 * sizeof(float) * frame_size / 1024.0);
+  printf("  fp16 frame dataflow: %8.3f ms per frame, %8.1f KB of frames\n",
+         fp16_time * 1e3, 2 * sizeof(uint16_t) * frame_size / 1024.0);
+  // diff_hist[i] counts the differences in [2^i, 2^(i+1)).
+  int diff_hist[8] = { 0 };
+  int num_diffs = 0;
+  int max_diff = 0;
+  for (int i = 0; i < frame_size * num_frames; i++) {
+    int diff = abs(result[i] - expected[i]);
+    num_diffs += diff != 0;
+    max_diff = max(max_diff, diff);
+    if (diff != 0)
+      diff_hist[31 - __builtin_clz(diff)]++;
+  }
+  printf("  PSNR %.2f dB, %d of %d values differ, by at most %d\n",
+         compute_psnr(result, expected, frame_size * num_frames), num_diffs,
+         frame_size * num_frames, max_diff);
+  for (int i = 0; i < 8; i++) {
+    if (diff_hist[i] > 0) {
+      printf("    differences of %3d to %3d: %8d\n", 1 << i, (2 << i) - 1,
+             diff_hist[i]);
+    }
+  }
+
+  free(image);
+  free(frames);
+  free(expected);
+  free(result);
+  return 0;
+}
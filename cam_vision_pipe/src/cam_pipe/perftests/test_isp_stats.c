@@ -0,0 +1,130 @@
+// Measures what collecting 3A statistics costs the streaming dataflow.
+//
+// Usage: test_isp_stats [rows] [cols] [frames] [threads] [image.bin]
+//
+// The camera model is read from $CAVA_HOME. The frames are run through the
+// streaming dataflow without and with statistics, and this reports the
+// average time per frame of each and whether the outputs are identical. The
+// statistics merged from every thread are checked against those of a single
+// band. The white balance preset they suggest is then fed back into the
+// context for the next frame, as an auto white balance loop would. By
+// default, every frame is random pixels with a warm cast. If an image (as
+// written by scripts/convert_image.py) is given, it is used as every frame
+// instead, and sets the frame size.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nnet_lib/utility/thread_pool.h"
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+// Runs every frame through a streaming context, storing the outputs one after
+// another in results, and returns the average time per frame. With
+// statistics, stats receives those of the first frame.
+static double run_frames(bool collect_stats, uint8_t *frames, int num_frames,
+                         int row_size, int col_size, uint8_t *results,
+                         isp_stats_t *stats) {
+  isp_collect_stats = collect_stats;
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  double start = get_wall_time();
+  for (int i = 0; i < num_frames; i++) {
+    isp_process_frame(ctx, &frames[i * frame_size],
+                      &results[i * frame_size]);
+    if (collect_stats && i == 0)
+      *stats = *isp_context_get_stats(ctx);
+  }
+  double frame_time = (get_wall_time() - start) / num_frames;
+  isp_context_destroy(ctx);
+  return frame_time;
+}
+
+// Returns whether a and b have the same histograms and counts, and sums that
+// differ only by rounding.
+static bool stats_match(isp_stats_t *a, isp_stats_t *b) {
+  bool match = a->num_pixels == b->num_pixels &&
+               a->num_clipped == b->num_clipped &&
+               memcmp(a->hist, b->hist, sizeof(a->hist)) == 0 &&
+               memcmp(a->luma_hist, b->luma_hist, sizeof(a->luma_hist)) == 0;
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    match &= fabs(a->sum[chan] - b->sum[chan]) <= 1e-9 * a->num_pixels &&
+             a->max[chan] == b->max[chan];
+  }
+  return match && fabs(a->luma_sum - b->luma_sum) <= 1e-9 * a->num_pixels;
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 480;
+  int col_size = argc > 2 ? atoi(argv[2]) : 640;
+  int num_frames = argc > 3 ? atoi(argv[3]) : 4;
+  int num_threads = argc > 4 ? atoi(argv[4]) : 0;
+  uint8_t *image = NULL;
+  if (argc > 5) {
+    uint8_t *hwc_image = read_image_from_binary(argv[5], &row_size, &col_size);
+    convert_hwc_to_chw(hwc_image, row_size, col_size, &image);
+    free(hwc_image);
+  }
+  isp_dataflow = IspStreamingDataflow;
+  gamut_map_impl = GamutMapLut;
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  uint8_t *frames = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *expected = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *result = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  // Red at full range, green at 3/4 and blue at 1/2.
+  const int cast[CHAN_SIZE] = { 256, 192, 128 };
+  unsigned seed = 1;
+  for (int i = 0; i < num_frames; i++) {
+    for (int j = 0; j < frame_size; j++) {
+      frames[i * frame_size + j] =
+          image ? image[j] : rand_r(&seed) % cast[j / (frame_size / CHAN_SIZE)];
+    }
+  }
+
+  isp_stats_t single_stats;
+  isp_stats_t stats;
+  run_frames(true, frames, 1, row_size, col_size, result, &single_stats);
+  if (num_threads > 0)
+    init_thread_pool(num_threads);
+  double base_time = run_frames(false, frames, num_frames, row_size, col_size,
+                                expected, NULL);
+  double stats_time = run_frames(true, frames, num_frames, row_size, col_size,
+                                 result, &stats);
+  bool match = memcmp(result, expected, frame_size * num_frames) == 0;
+  bool merged = stats_match(&stats, &single_stats);
+
+  printf("%d %d x %d frames, streaming dataflow, %d threads.\n", num_frames,
+         row_size, col_size, num_threads);
+  printf("  without statistics: %8.3f ms per frame\n", base_time * 1e3);
+  printf("  with statistics:    %8.3f ms per frame\n", stats_time * 1e3);
+  printf("  %s, merged statistics %s\n",
+         match ? "outputs match" : "output MISMATCH",
+         merged ? "match a single band" : "MISMATCH a single band");
+  print_isp_stats(&stats);
+
+  // Pick the preset of each frame from the statistics of the previous one.
+  isp_collect_stats = 1;
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  for (int i = 0; i < num_frames; i++) {
+    isp_process_frame(ctx, &frames[i * frame_size], result);
+    int next = isp_context_pick_wb_index(ctx);
+    printf("  frame %d: white balance preset %d, suggests %d\n", i,
+           ctx->wb_index, next);
+    isp_context_set_wb_index(ctx, next);
+  }
+  isp_context_destroy(ctx);
+  if (num_threads > 0)
+    destroy_thread_pool();
+
+  free(image);
+  free(frames);
+  free(expected);
+  free(result);
+  return match && merged ? 0 : 1;
+}
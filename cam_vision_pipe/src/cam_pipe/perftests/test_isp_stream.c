@@ -0,0 +1,84 @@
+// Runs a stream of frames through one ISP context.
+//
+// Usage: test_isp_stream [rows] [cols] [frames] [frame|streaming] [threads]
+//                        [exact|simd|lut]
+//
+// The camera model is read from $CAVA_HOME. This reports the one-time cost of
+// creating the context, the average cost per frame after that, and the cost
+// of a standalone cam_pipe() call, which reloads the model for every frame.
+// Every frame is also checked against the standalone result. With more than
+// one thread, the streaming dataflow splits each frame into bands, and the
+// time each thread spends in each stage is reported too.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "nnet_lib/utility/thread_pool.h"
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 32;
+  int col_size = argc > 2 ? atoi(argv[2]) : 32;
+  int num_frames = argc > 3 ? atoi(argv[3]) : 8;
+  if (argc > 4 && strcmp(argv[4], "streaming") == 0)
+    isp_dataflow = IspStreamingDataflow;
+  int num_threads = argc > 5 ? atoi(argv[5]) : 0;
+  if (argc > 6 && strcmp(argv[6], "simd") == 0)
+    gamut_map_impl = GamutMapSimd;
+  else if (argc > 6 && strcmp(argv[6], "lut") == 0)
+    gamut_map_impl = GamutMapLut;
+  if (num_threads > 0)
+    init_thread_pool(num_threads);
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  uint8_t *frames = malloc_aligned(sizeof(uint8_t) * frame_size * num_frames);
+  uint8_t *result = malloc_aligned(sizeof(uint8_t) * frame_size);
+  uint8_t *expected = malloc_aligned(sizeof(uint8_t) * frame_size);
+  unsigned seed = 1;
+  for (int i = 0; i < frame_size * num_frames; i++)
+    frames[i] = rand_r(&seed) % 256;
+
+  double start = get_wall_time();
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  double create_time = get_wall_time() - start;
+
+  double frame_time = 0;
+  bool match = true;
+  for (int i = 0; i < num_frames; i++) {
+    start = get_wall_time();
+    isp_process_frame(ctx, &frames[i * frame_size], result);
+    frame_time += get_wall_time() - start;
+    cam_pipe(&frames[i * frame_size], expected, row_size, col_size);
+    match &= memcmp(result, expected, frame_size) == 0;
+  }
+
+  start = get_wall_time();
+  cam_pipe(frames, expected, row_size, col_size);
+  double standalone_time = get_wall_time() - start;
+
+  printf("%d %d x %d frames, %s dataflow, %d threads.\n", num_frames,
+         row_size, col_size,
+         isp_dataflow == IspStreamingDataflow ? "streaming" : "frame",
+         num_threads);
+  printf("  context create:     %8.3f ms\n", create_time * 1e3);
+  printf("  per frame:          %8.3f ms\n", frame_time / num_frames * 1e3);
+  printf("  standalone cam_pipe: %7.3f ms\n", standalone_time * 1e3);
+  printf("  %s\n", match ? "outputs match" : "MISMATCH");
+  if (ctx->gamut_lut)
+    print_gamut_lut_error(ctx->gamut_lut);
+  isp_context_print_stage_times(ctx);
+  isp_context_destroy(ctx);
+  if (num_threads > 0)
+    destroy_thread_pool();
+
+  free(frames);
+  free(result);
+  free(expected);
+  return match ? 0 : 1;
+}
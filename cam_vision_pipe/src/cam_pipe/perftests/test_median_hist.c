@@ -0,0 +1,144 @@
+// Benchmarks the sliding histogram median against sorting every window.
+//
+// Usage: test_median_hist [rows] [cols] [threads]
+//
+// A random frame of 8-bit samples is median filtered with 3x3, 5x5 and 7x7
+// windows, by sorting the window of every pixel as denoise_fxp does and by
+// denoise_median_hist_fxp, and the throughput of each is reported in
+// MPixel/s along with whether their outputs match. The vectorized 3x3 median
+// is reported for reference.
+//
+// The camera model is then read from $CAVA_HOME, and a random frame is run
+// through the streaming dataflow with each window, on one thread and on
+// [threads] threads (4 by default). This reports the time per frame of each,
+// and whether the bands give the same output as a single thread.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nnet_lib/utility/thread_pool.h"
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+// denoise_fxp with a size x size window.
+static void denoise_sort(float *input, int row_size, int col_size, int size,
+                         float *result) {
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(float, _result, result, row_size, col_size);
+  int radius = size / 2;
+  float filter[MEDIAN_HIST_MAX_SIZE * MEDIAN_HIST_MAX_SIZE];
+  for (int chan = 0; chan < CHAN_SIZE; chan++) {
+    for (int row = 0; row < row_size; row++) {
+      for (int col = 0; col < col_size; col++) {
+        if (row < radius || row >= row_size - radius || col < radius ||
+            col >= col_size - radius) {
+          _result[chan][row][col] = _input[chan][row][col];
+          continue;
+        }
+        int n = 0;
+        for (int i = row - radius; i <= row + radius; i++) {
+          for (int j = col - radius; j <= col + radius; j++)
+            filter[n++] = _input[chan][i][j];
+        }
+        for (int i = 0; i < n - 1; i++) {
+          for (int j = 0; j < n - i - 1; j++) {
+            if (filter[j] > filter[j + 1]) {
+              float temp = filter[j];
+              filter[j] = filter[j + 1];
+              filter[j + 1] = temp;
+            }
+          }
+        }
+        _result[chan][row][col] = filter[n / 2];
+      }
+    }
+  }
+}
+
+// Runs a frame through a streaming context on the threads of the thread
+// pool, and returns the average time per frame.
+static double run_streaming(int denoise_size, uint8_t *frame, int row_size,
+                            int col_size, uint8_t *result) {
+  const int kFrames = 4;
+  isp_denoise_size = denoise_size;
+  isp_context_t *ctx = isp_context_create(row_size, col_size);
+  isp_process_frame(ctx, frame, result);
+  double start = get_wall_time();
+  for (int i = 0; i < kFrames; i++)
+    isp_process_frame(ctx, frame, result);
+  double frame_time = (get_wall_time() - start) / kFrames;
+  isp_context_destroy(ctx);
+  return frame_time;
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 480;
+  int col_size = argc > 2 ? atoi(argv[2]) : 640;
+  int num_threads = argc > 3 ? atoi(argv[3]) : 4;
+  const int sizes[] = { 3, 5, 7 };
+  const int kNumSizes = 3;
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  double mpixels = row_size * col_size * 1e-6;
+  float *input = malloc_aligned(sizeof(float) * frame_size);
+  float *expected = malloc_aligned(sizeof(float) * frame_size);
+  float *result = malloc_aligned(sizeof(float) * frame_size);
+  unsigned seed = 1;
+  for (int i = 0; i < frame_size; i++)
+    input[i] = (rand_r(&seed) % 256) / 255.0f;
+
+  printf("%d x %d frame.\n", row_size, col_size);
+  denoise_simd_fxp(input, row_size, col_size, result);
+  double start = get_wall_time();
+  denoise_simd_fxp(input, row_size, col_size, result);
+  printf("  3x3 simd median: %9.2f MPixel/s\n",
+         mpixels / (get_wall_time() - start));
+  for (int s = 0; s < kNumSizes; s++) {
+    int size = sizes[s];
+    start = get_wall_time();
+    denoise_sort(input, row_size, col_size, size, expected);
+    double sort_time = get_wall_time() - start;
+    start = get_wall_time();
+    denoise_median_hist_fxp(input, row_size, col_size, size, result);
+    double hist_time = get_wall_time() - start;
+    bool match = memcmp(expected, result, sizeof(float) * frame_size) == 0;
+    printf("  %dx%d sort: %9.2f MPixel/s, histogram: %9.2f MPixel/s (%.2fx), "
+           "%s\n",
+           size, size, mpixels / sort_time, mpixels / hist_time,
+           sort_time / hist_time, match ? "outputs match" : "MISMATCH");
+  }
+
+  uint8_t *frame = malloc_aligned(sizeof(uint8_t) * frame_size);
+  uint8_t *single = malloc_aligned(sizeof(uint8_t) * frame_size);
+  uint8_t *banded = malloc_aligned(sizeof(uint8_t) * frame_size);
+  for (int i = 0; i < frame_size; i++)
+    frame[i] = rand_r(&seed) % 256;
+  isp_dataflow = IspStreamingDataflow;
+  gamut_map_impl = GamutMapLut;
+  bool all_match = true;
+  printf("Streaming dataflow, ms per frame:\n");
+  for (int s = 0; s < kNumSizes; s++) {
+    double single_time =
+        run_streaming(sizes[s], frame, row_size, col_size, single);
+    init_thread_pool(num_threads);
+    double banded_time =
+        run_streaming(sizes[s], frame, row_size, col_size, banded);
+    destroy_thread_pool();
+    bool match = memcmp(single, banded, frame_size) == 0;
+    all_match &= match;
+    printf("  %dx%d denoise: 1 thread %8.3f, %d threads %8.3f, %s\n",
+           sizes[s], sizes[s], single_time * 1e3, num_threads,
+           banded_time * 1e3, match ? "outputs match" : "MISMATCH");
+  }
+
+  free(input);
+  free(expected);
+  free(result);
+  free(frame);
+  free(single);
+  free(banded);
+  return all_match ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// Benchmarks the scale stage for every raw input format.
+//
+// Usage: test_raw_unpack [rows] [cols] [iterations]
+//
+// A random frame is scaled by scale_raw_fxp and by scale_raw_row_simd, one
+// row at a time as in the streaming dataflow. For each format this reports
+// the bytes read per frame, the throughput of both kernels in MPixel/s, and
+// whether their outputs match. The RGB planes row is the original scale
+// stage, for reference. The bayer16/10 row reads 10-bit samples from the same
+// random uint16, so it also checks that the unused high bits are masked off
+// and every sample stays within [0, 1]. This returns nonzero if any output
+// differs or is out of range.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/kernels/pipe_stages.h"
+#include "cam_pipe/kernels/raw_unpack.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 1080;
+  int col_size = argc > 2 ? atoi(argv[2]) : 1920;
+  int iterations = argc > 3 ? atoi(argv[3]) : 10;
+  const raw_format_t formats[] = { RawRgbPlanes, RawBayer8,  RawBayer10,
+                                   RawBayer12,   RawBayer16, RawBayer16 };
+  const int bit_depths[] = { 8, 8, 10, 12, 16, 10 };
+  const char *names[] = { "rgb",   "bayer8",  "raw10",
+                          "raw12", "bayer16", "bayer16/10" };
+  const int num_formats = sizeof(formats) / sizeof(formats[0]);
+  double mpixels = row_size * col_size * 1e-6 * iterations;
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  uint8_t *input = malloc_aligned(sizeof(uint8_t) * frame_size);
+  float *expected = malloc_aligned(sizeof(float) * frame_size);
+  unsigned seed = 1;
+  for (int i = 0; i < frame_size; i++)
+    input[i] = rand_r(&seed) % 256;
+
+  printf("Scale stage of a %d x %d frame.\n", row_size, col_size);
+  bool all_match = true;
+  for (int f = 0; f < num_formats; f++) {
+    raw_format_t format = formats[f];
+    int bit_depth = bit_depths[f];
+    if (check_raw_format(format, col_size))
+      continue;
+    int row_bytes = get_raw_row_bytes(format, col_size);
+
+    double start = get_wall_time();
+    for (int i = 0; i < iterations; i++) {
+      if (format == RawRgbPlanes)
+        scale_fxp(input, row_size, col_size, expected);
+      else
+        scale_raw_fxp(input, format, bit_depth, row_size, col_size,
+                      expected);
+    }
+    double scalar_time = get_wall_time() - start;
+
+    // The streaming dataflow scales into a [CHAN_SIZE][col_size] row, so the
+    // rows of the frame are rearranged afterwards for the comparison.
+    float *row_buffer = malloc_aligned(sizeof(float) * CHAN_SIZE * col_size);
+    bool match = true;
+    double simd_time = 0;
+    if (format != RawRgbPlanes) {
+      for (int i = 0; i < iterations; i++) {
+        start = get_wall_time();
+        for (int row = 0; row < row_size; row++) {
+          scale_raw_row_simd(&input[row * row_bytes], format, bit_depth, row,
+                             col_size, row_buffer);
+        }
+        simd_time += get_wall_time() - start;
+      }
+      ARRAY_3D(float, _expected, expected, row_size, col_size);
+      for (int row = 0; row < row_size; row++) {
+        scale_raw_row_simd(&input[row * row_bytes], format, bit_depth, row,
+                           col_size, row_buffer);
+        for (int chan = 0; chan < CHAN_SIZE; chan++) {
+          match &= memcmp(&_expected[chan][row][0],
+                          &row_buffer[chan * col_size],
+                          sizeof(float) * col_size) == 0;
+        }
+      }
+    }
+    free(row_buffer);
+    for (int i = 0; i < frame_size; i++)
+      match &= expected[i] >= 0 && expected[i] <= 1;
+    all_match &= match;
+
+    printf("  %-10s %9d bytes, scalar: %8.2f MPixel/s", names[f],
+           get_raw_frame_bytes(format, row_size, col_size),
+           mpixels / scalar_time);
+    if (format != RawRgbPlanes) {
+      printf(", simd: %8.2f MPixel/s (%.2fx), %s", mpixels / simd_time,
+             scalar_time / simd_time, match ? "outputs match" : "MISMATCH");
+    }
+    printf("\n");
+  }
+
+  free(input);
+  free(expected);
+  return all_match ? 0 : 1;
+}
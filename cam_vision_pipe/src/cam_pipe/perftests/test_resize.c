@@ -0,0 +1,129 @@
+// Benchmarks the resize stage, and what it saves the whole ISP.
+//
+// Usage: test_resize [rows] [cols] [out_rows] [out_cols] [iterations]
+//
+// A random denoised frame is resized by resize_fxp and by the vectorized
+// streaming passes, with both methods, and the throughput of each is reported
+// in input MPixel/s along with whether their outputs match. Then a random raw
+// frame is run through the streaming ISP with the LUT gamut map, at full size
+// and resized, to show the time saved by the stages after the resize. The
+// camera model is read from $CAVA_HOME.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/utility.h"
+#include "cam_pipe/cam_pipe.h"
+#include "cam_pipe/kernels/pipe_stages.h"
+#include "cam_pipe/kernels/resize.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+
+// Resize input a row at a time, as in the streaming dataflow.
+static void resize_streaming(resize_plan_t *plan, float *input, int row_size,
+                             int col_size, float *ring, float *result) {
+  resize_cfg_t *cfg = &plan->cfg;
+  ARRAY_3D(float, _input, input, row_size, col_size);
+  ARRAY_3D(float, _ring, ring, CHAN_SIZE, cfg->out_cols);
+  float *row = malloc_aligned(sizeof(float) * CHAN_SIZE * col_size);
+  float *out_row = malloc_aligned(sizeof(float) * CHAN_SIZE * cfg->out_cols);
+  ARRAY_3D(float, _result, result, cfg->out_rows, cfg->out_cols);
+  ARRAY_2D(float, _out_row, out_row, cfg->out_cols);
+  int next_out_row = 0;
+  for (int r = 0; r < cfg->crop_rows; r++) {
+    for (int chan = 0; chan < CHAN_SIZE; chan++) {
+      memcpy(&row[chan * col_size], &_input[chan][cfg->crop_row + r][0],
+             sizeof(float) * col_size);
+    }
+    resize_cols_simd(plan, row, col_size, &_ring[r % plan->ring_rows][0][0]);
+    for (; next_out_row < cfg->out_rows &&
+           plan->rows.last[next_out_row] == r; next_out_row++) {
+      resize_rows_simd(plan, next_out_row, ring, out_row);
+      for (int chan = 0; chan < CHAN_SIZE; chan++) {
+        memcpy(&_result[chan][next_out_row][0], _out_row[chan],
+               sizeof(float) * cfg->out_cols);
+      }
+    }
+  }
+  free(row);
+  free(out_row);
+}
+
+int main(int argc, char *argv[]) {
+  int row_size = argc > 1 ? atoi(argv[1]) : 1080;
+  int col_size = argc > 2 ? atoi(argv[2]) : 1920;
+  int out_rows = argc > 3 ? atoi(argv[3]) : 224;
+  int out_cols = argc > 4 ? atoi(argv[4]) : 224;
+  int iterations = argc > 5 ? atoi(argv[5]) : 10;
+  const resize_method_t methods[] = { ResizeArea, ResizeBilinear };
+  const char *names[] = { "area", "bilinear" };
+  double mpixels = row_size * col_size * 1e-6 * iterations;
+
+  int frame_size = row_size * col_size * CHAN_SIZE;
+  int out_size = out_rows * out_cols * CHAN_SIZE;
+  float *input = malloc_aligned(sizeof(float) * frame_size);
+  float *temp = malloc_aligned(sizeof(float) * frame_size);
+  float *expected = malloc_aligned(sizeof(float) * out_size);
+  float *result = malloc_aligned(sizeof(float) * out_size);
+  unsigned seed = 1;
+  for (int i = 0; i < frame_size; i++)
+    input[i] = (float)rand_r(&seed) / RAND_MAX;
+
+  printf("Resize stage, %d x %d to %d x %d.\n", row_size, col_size, out_rows,
+         out_cols);
+  for (int m = 0; m < 2; m++) {
+    resize_cfg_t cfg = { methods[m], 0, 0, row_size, col_size, out_rows,
+                         out_cols };
+    resize_plan_t *plan = build_resize_plan(cfg);
+    float *ring = malloc_aligned(sizeof(float) * get_resize_ring_size(plan));
+
+    double start = get_wall_time();
+    for (int i = 0; i < iterations; i++)
+      resize_fxp(input, row_size, col_size, cfg, temp, expected);
+    double scalar_time = get_wall_time() - start;
+
+    start = get_wall_time();
+    for (int i = 0; i < iterations; i++)
+      resize_streaming(plan, input, row_size, col_size, ring, result);
+    double simd_time = get_wall_time() - start;
+
+    bool match = memcmp(expected, result, sizeof(float) * out_size) == 0;
+    printf("%-9s scalar: %8.2f MPixel/s, simd: %8.2f MPixel/s (%.2fx), %s\n",
+           names[m], mpixels / scalar_time, mpixels / simd_time,
+           scalar_time / simd_time, match ? "outputs match" : "MISMATCH");
+    free(ring);
+    free_resize_plan(plan);
+  }
+
+  uint8_t *frame = malloc_aligned(sizeof(uint8_t) * frame_size);
+  uint8_t *image = malloc_aligned(sizeof(uint8_t) * frame_size);
+  for (int i = 0; i < frame_size; i++)
+    frame[i] = rand_r(&seed) % 256;
+  isp_dataflow = IspStreamingDataflow;
+  gamut_map_impl = GamutMapLut;
+  printf("Streaming ISP per frame:\n");
+  for (int m = -1; m < 2; m++) {
+    isp_resize = (resize_cfg_t){ ResizeNone };
+    if (m >= 0) {
+      isp_resize = (resize_cfg_t){ methods[m], 0, 0, row_size, col_size,
+                                   out_rows, out_cols };
+    }
+    isp_context_t *ctx = isp_context_create(row_size, col_size);
+    double start = get_wall_time();
+    for (int i = 0; i < iterations; i++)
+      isp_process_frame(ctx, frame, image);
+    double frame_time = (get_wall_time() - start) / iterations;
+    printf("  %-9s %8.3f ms\n", m >= 0 ? names[m] : "full size",
+           frame_time * 1e3);
+    isp_context_destroy(ctx);
+  }
+
+  free(input);
+  free(temp);
+  free(expected);
+  free(result);
+  free(frame);
+  free(image);
+  return 0;
+}
@@ -0,0 +1,215 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common/utility.h"
+#include "kernels/pipe_stages.h"
+#include "cam_pipe_utility.h"
+#include "load_cam_model.h"
+#include "cam_model_bin.h"
+
+// Continue a 64-bit FNV-1a hash over size bytes of data.
+static uint64_t fnv1a(uint64_t hash, uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// The checksum of a whole compiled model of size bytes, taking its checksum
+// field as zero.
+static uint64_t cam_model_checksum(uint8_t *data, size_t size) {
+  cam_model_header_t header;
+  memcpy(&header, data, sizeof(header));
+  header.checksum = 0;
+  uint64_t hash = fnv1a(0xcbf29ce484222325ULL, (uint8_t *)&header,
+                        sizeof(header));
+  return fnv1a(hash, data + sizeof(header), size - sizeof(header));
+}
+
+// Returns whether size bytes at offset are inside the file and aligned for
+// floats.
+static int cam_model_fits(cam_model_header_t *header, uint64_t offset,
+                          uint64_t size) {
+  return offset % sizeof(float) == 0 && offset <= header->total_size &&
+         size <= header->total_size - offset;
+}
+
+// Returns whether every array of the model lies inside the file.
+static int cam_model_in_bounds(cam_model_header_t *header) {
+  if (header->num_ctrl_pts < 0 || header->num_wb_presets < 1)
+    return 0;
+  uint64_t mat_size = sizeof(float) * CHAN_SIZE * CHAN_SIZE;
+  uint64_t cp_size = sizeof(float) * CHAN_SIZE * (uint64_t)header->num_ctrl_pts;
+  uint64_t wb_size = mat_size * header->num_wb_presets;
+  return cam_model_fits(header, header->Ts_offset, mat_size) &&
+         cam_model_fits(header, header->TsTw_offset, wb_size) &&
+         cam_model_fits(header, header->Tw_offset, wb_size) &&
+         cam_model_fits(header, header->ctrl_pts_offset, cp_size) &&
+         cam_model_fits(header, header->weights_offset, cp_size) &&
+         cam_model_fits(header, header->coefs_offset, sizeof(float) * 12) &&
+         cam_model_fits(header, header->tone_map_offset,
+                        sizeof(float) * 256 * CHAN_SIZE);
+}
+
+// Reserve size bytes at the next cacheline-aligned offset.
+static uint64_t cam_model_alloc(uint64_t *total_size, size_t size) {
+  uint64_t offset =
+      (*total_size + CACHELINE_SIZE - 1) / CACHELINE_SIZE * CACHELINE_SIZE;
+  *total_size = offset + size;
+  return offset;
+}
+
+int compile_cam_model(char *cam_model_path, int num_ctrl_pts,
+                      char *output_path) {
+  int num_wb_presets = get_num_wb_presets(cam_model_path);
+  size_t mat_size = sizeof(float) * CHAN_SIZE * CHAN_SIZE;
+  size_t cp_size = sizeof(float) * num_ctrl_pts * CHAN_SIZE;
+
+  cam_model_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic = CAM_MODEL_MAGIC;
+  header.version = CAM_MODEL_VERSION;
+  header.num_ctrl_pts = num_ctrl_pts;
+  header.num_wb_presets = num_wb_presets;
+  uint64_t total_size = sizeof(cam_model_header_t);
+  header.Ts_offset = cam_model_alloc(&total_size, mat_size);
+  header.TsTw_offset = cam_model_alloc(&total_size, mat_size * num_wb_presets);
+  header.Tw_offset = cam_model_alloc(&total_size, mat_size * num_wb_presets);
+  header.ctrl_pts_offset = cam_model_alloc(&total_size, cp_size);
+  header.weights_offset = cam_model_alloc(&total_size, cp_size);
+  header.coefs_offset = cam_model_alloc(&total_size, sizeof(float) * 12);
+  header.tone_map_offset =
+      cam_model_alloc(&total_size, sizeof(float) * 256 * CHAN_SIZE);
+  header.total_size = total_size;
+
+  uint8_t *blob = calloc(total_size, 1);
+  float *Ts = get_Ts(cam_model_path);
+  memcpy(blob + header.Ts_offset, Ts, mat_size);
+  free(Ts);
+  for (int wb = 0; wb < num_wb_presets; wb++) {
+    float *TsTw = get_TsTw(cam_model_path, wb + 1);
+    float *trans = transpose_mat(TsTw, CHAN_SIZE, CHAN_SIZE);
+    memcpy(blob + header.TsTw_offset + wb * mat_size, trans, mat_size);
+    free(TsTw);
+    free(trans);
+    float *Tw = get_Tw(cam_model_path, wb + 1);
+    memcpy(blob + header.Tw_offset + wb * mat_size, Tw, mat_size);
+    free(Tw);
+  }
+  float *ctrl_pts = get_ctrl_pts(cam_model_path, num_ctrl_pts);
+  memcpy(blob + header.ctrl_pts_offset, ctrl_pts, cp_size);
+  free(ctrl_pts);
+  float *weights = get_weights(cam_model_path, num_ctrl_pts);
+  memcpy(blob + header.weights_offset, weights, cp_size);
+  free(weights);
+  float *coefs = get_coefs(cam_model_path, num_ctrl_pts);
+  memcpy(blob + header.coefs_offset, coefs, sizeof(float) * 12);
+  free(coefs);
+  float *tone_map = get_tone_map(cam_model_path);
+  memcpy(blob + header.tone_map_offset, tone_map,
+         sizeof(float) * 256 * CHAN_SIZE);
+  free(tone_map);
+
+  memcpy(blob, &header, sizeof(header));
+  header.checksum = cam_model_checksum(blob, total_size);
+  memcpy(blob, &header, sizeof(header));
+
+  FILE *fp = fopen(output_path, "wb");
+  int err = fp == NULL;
+  if (!err) {
+    err = fwrite(blob, 1, total_size, fp) != total_size;
+    err |= fclose(fp) != 0;
+  }
+  free(blob);
+  return err;
+}
+
+cam_model_t *map_cam_model(char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(cam_model_header_t)) {
+    fprintf(stderr, "The compiled camera model %s is truncated!\n", path);
+    exit(1);
+  }
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "Failed to mmap the compiled camera model %s!\n", path);
+    exit(1);
+  }
+
+  cam_model_header_t *header = (cam_model_header_t *)base;
+  if (header->magic != CAM_MODEL_MAGIC ||
+      header->version != CAM_MODEL_VERSION) {
+    fprintf(stderr,
+            "%s is not a version %d compiled camera model! Recompile it.\n",
+            path, CAM_MODEL_VERSION);
+    exit(1);
+  }
+  if (header->total_size != (uint64_t)st.st_size ||
+      header->checksum != cam_model_checksum((uint8_t *)base, st.st_size) ||
+      !cam_model_in_bounds(header)) {
+    fprintf(stderr, "The compiled camera model %s is corrupted!\n", path);
+    exit(1);
+  }
+
+  cam_model_t *model = malloc(sizeof(cam_model_t));
+  model->base = base;
+  model->size = st.st_size;
+  model->header = header;
+  return model;
+}
+
+void unmap_cam_model(cam_model_t *model) {
+  munmap(model->base, model->size);
+  free(model);
+}
+
+static float *cam_model_array(cam_model_t *model, uint64_t offset) {
+  return (float *)((uint8_t *)model->base + offset);
+}
+
+static void check_wb_index(cam_model_t *model, int wb_index) {
+  if (wb_index < 1 || wb_index > model->header->num_wb_presets) {
+    fprintf(stderr,
+            "White balance index %d is out of range; the camera model has "
+            "%d presets.\n",
+            wb_index, model->header->num_wb_presets);
+    exit(1);
+  }
+}
+
+float *cam_model_TsTw(cam_model_t *model, int wb_index) {
+  check_wb_index(model, wb_index);
+  return cam_model_array(model, model->header->TsTw_offset) +
+         (wb_index - 1) * CHAN_SIZE * CHAN_SIZE;
+}
+
+float *cam_model_Tw(cam_model_t *model, int wb_index) {
+  check_wb_index(model, wb_index);
+  return cam_model_array(model, model->header->Tw_offset) +
+         (wb_index - 1) * CHAN_SIZE * CHAN_SIZE;
+}
+
+float *cam_model_ctrl_pts(cam_model_t *model) {
+  return cam_model_array(model, model->header->ctrl_pts_offset);
+}
+
+float *cam_model_weights(cam_model_t *model) {
+  return cam_model_array(model, model->header->weights_offset);
+}
+
+float *cam_model_coefs(cam_model_t *model) {
+  return cam_model_array(model, model->header->coefs_offset);
+}
+
+float *cam_model_tone_map(cam_model_t *model) {
+  return cam_model_array(model, model->header->tone_map_offset);
+}
@@ -0,0 +1,84 @@
+#ifndef _CAM_MODEL_BIN_H_
+#define _CAM_MODEL_BIN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compiled binary camera model.
+//
+// compile_cam_model() parses the text camera model once and writes every
+// white balance preset, the control points, weights, coefs and tone map to a
+// single file. At runtime, map_cam_model() mmaps that file and the ISP uses
+// the arrays in place, so no text is parsed and nothing is copied.
+//
+// The file starts with a cam_model_header_t. Every array is stored as native
+// floats at a CACHELINE_SIZE aligned byte offset from the start of the file:
+//
+//   Ts:       [3][3]
+//   TsTw:     [num_wb_presets][3][3], already transposed for the transform
+//             stage.
+//   Tw:       [num_wb_presets][3][3], as diagonal matrices.
+//   ctrl_pts: [num_ctrl_pts][3]
+//   weights:  [num_ctrl_pts][3]
+//   coefs:    [4][3]
+//   tone_map: [256][3]
+//
+// The checksum covers the whole file, with the checksum field taken as zero.
+// map_cam_model() also checks that every array lies inside the file.
+
+// Name of the compiled model inside a camera model directory.
+#define CAM_MODEL_BIN_NAME "raw2jpg_model.bin"
+
+#define CAM_MODEL_MAGIC 0x4c444d43  // "CMDL"
+#define CAM_MODEL_VERSION 2
+
+typedef struct _cam_model_header_t {
+  uint32_t magic;
+  uint32_t version;
+  int32_t num_ctrl_pts;
+  int32_t num_wb_presets;
+  uint64_t Ts_offset;
+  uint64_t TsTw_offset;
+  uint64_t Tw_offset;
+  uint64_t ctrl_pts_offset;
+  uint64_t weights_offset;
+  uint64_t coefs_offset;
+  uint64_t tone_map_offset;
+  uint64_t total_size;
+  uint64_t checksum;
+} cam_model_header_t;
+
+// A mapped camera model.
+typedef struct _cam_model_t {
+  void* base;
+  size_t size;
+  cam_model_header_t* header;
+} cam_model_t;
+
+// Compile the text camera model in cam_model_path (which ends with a slash)
+// with num_ctrl_pts control points to output_path.
+//
+// Returns 0 on success, or 1 if the output could not be written.
+int compile_cam_model(char* cam_model_path,
+                      int num_ctrl_pts,
+                      char* output_path);
+
+// Map a compiled camera model.
+//
+// Returns NULL if there is no file at path. A file that is truncated, from a
+// different version, fails the checksum, or has an array out of bounds is a
+// fatal error.
+cam_model_t* map_cam_model(char* path);
+
+void unmap_cam_model(cam_model_t* model);
+
+// Pointers to the arrays of a mapped model. wb_index counts from 1, like the
+// text loaders.
+float* cam_model_TsTw(cam_model_t* model, int wb_index);
+float* cam_model_Tw(cam_model_t* model, int wb_index);
+float* cam_model_ctrl_pts(cam_model_t* model);
+float* cam_model_weights(cam_model_t* model);
+float* cam_model_coefs(cam_model_t* model);
+float* cam_model_tone_map(cam_model_t* model);
+
+#endif
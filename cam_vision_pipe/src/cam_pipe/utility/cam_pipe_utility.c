@@ -2,9 +2,11 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
+#include <time.h>
 
 #include "utility/cam_pipe_utility.h"
 #include "kernels/pipe_stages.h"
+#include "kernels/grayscale.h"
 
 uint8_t *read_image_from_binary(char *file_path, int *row_size, int *col_size) {
   uint8_t *image;
@@ -27,6 +29,37 @@ uint8_t *read_image_from_binary(char *file_path, int *row_size, int *col_size) {
   return image;
 }
 
+uint8_t *read_raw_from_binary(char *file_path, raw_format_t format,
+                              int row_size, int col_size) {
+  FILE *fp = fopen(file_path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to open %s!\n", file_path);
+    exit(1);
+  }
+  int size = get_raw_frame_bytes(format, row_size, col_size);
+  uint8_t *image = malloc_aligned(sizeof(uint8_t) * size);
+  // The file must hold exactly one frame, or the dimensions are wrong.
+  if (fread(image, sizeof(uint8_t), size, fp) != size || fgetc(fp) != EOF) {
+    fprintf(stderr, "%s is not a %d x %d raw frame of %d bytes!\n", file_path,
+            row_size, col_size, size);
+    exit(1);
+  }
+  fclose(fp);
+  return image;
+}
+
+void write_raw_to_binary(char *file_path, uint8_t *image, raw_format_t format,
+                         int row_size, int col_size) {
+  FILE *fp = fopen(file_path, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to open %s!\n", file_path);
+    exit(1);
+  }
+  int size = get_raw_frame_bytes(format, row_size, col_size);
+  fwrite(image, sizeof(uint8_t), size, fp);
+  fclose(fp);
+}
+
 void write_image_to_binary(char *file_path, uint8_t *image, int row_size, int col_size) {
   FILE *fp = fopen(file_path, "w");
 
@@ -83,27 +116,27 @@ void convert_chw_to_hwc(uint8_t *input, int row_size, int col_size,
         _result[h][w][c] = _input[c][h][w];
 }
 
-static float sRGB_to_linear(float x) {
-    if (x < 0.04045) return x/12.92;
-    return pow((x+0.055)/1.055, 2.4);
-}
-
-static float linear_to_sRGB(float y) {
-    if (y <= 0.0031308) return 12.92 * y;
-    return 1.055 * pow(y, 1/2.4) - 0.055;
-}
-
 // Convert a RGB image into grayscale.
 // The grayscale value is stored in the first channel
 void convert_image_to_grayscale(uint8_t* input, int row_size, int col_size) {
-    ARRAY_3D(uint8_t, _input, input, row_size, col_size);
-    for (int row = 0; row < row_size; row++)
-        for (int col = 0; col < col_size; col++) {
-            float R_linear = sRGB_to_linear(_input[0][row][col] / 255.0);
-            float G_linear = sRGB_to_linear(_input[1][row][col] / 255.0);
-            float B_linear = sRGB_to_linear(_input[2][row][col] / 255.0);
-            float gray_linear =
-                    0.2126 * R_linear + 0.7152 * G_linear + 0.0722 * B_linear;
-            _input[0][row][col] = round(linear_to_sRGB(gray_linear) * 255);
+    gray_lut_t lut;
+    init_gray_lut(&lut);
+    convert_to_gray_simd(input, row_size, col_size, &lut, input);
+}
+
+double compute_psnr(uint8_t* image, uint8_t* reference, int size) {
+    double squared_error = 0;
+    for (int i = 0; i < size; i++) {
+        double diff = (double)image[i] - reference[i];
+        squared_error += diff * diff;
     }
+    if (squared_error == 0)
+        return INFINITY;
+    return 10 * log10(255.0 * 255.0 * size / squared_error);
+}
+
+double get_wall_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
@@ -5,6 +5,18 @@
 #include "kernels/pipe_stages.h"
 
 uint8_t* read_image_from_binary(char* file_path, int* row_size, int* col_size);
+// Read a headerless single-plane sensor dump of row_size x col_size pixels,
+// stored in format.
+uint8_t* read_raw_from_binary(char* file_path,
+                              raw_format_t format,
+                              int row_size,
+                              int col_size);
+// Write a headerless single-plane frame that read_raw_from_binary can read.
+void write_raw_to_binary(char* file_path,
+                         uint8_t* image,
+                         raw_format_t format,
+                         int row_size,
+                         int col_size);
 void write_image_to_binary(char* file_path,
                            uint8_t* image,
                            int row_size,
@@ -19,5 +31,11 @@ void convert_chw_to_hwc(uint8_t* input,
                         int col_size,
                         uint8_t** result);
 void convert_image_to_grayscale(uint8_t* input, int row_size, int col_size);
+// Returns the PSNR of image against reference in dB, both of size uint8
+// values, or INFINITY if they are identical.
+double compute_psnr(uint8_t* image, uint8_t* reference, int size);
+// Returns the wall-clock time in seconds, from CLOCK_MONOTONIC. Only
+// differences between two calls are meaningful.
+double get_wall_time();
 
 #endif
@@ -11,7 +11,7 @@ float* get_Ts(char* cam_model_path) {
   float *Ts;
   int err = posix_memalign((void **)&Ts, CACHELINE_SIZE, sizeof(float) * 9);
   assert(err == 0 && "Failed to allocate memory!");
-  char *line;
+  char *line = NULL;
   char *str;
   float line_data[3];
   size_t len = 0;
@@ -19,7 +19,7 @@ float* get_Ts(char* cam_model_path) {
 
   // Open file for reading
   char file_name[] = "raw2jpg_transform.txt";
-  char file_path[100];
+  char file_path[256];
   strcpy(file_path, cam_model_path);
   strcat(file_path, file_name);
   FILE *fp = fopen(file_path, "r");
@@ -49,12 +49,32 @@ float* get_Ts(char* cam_model_path) {
   return Ts;
 }
 
+// Get the number of white balance presets in the transform file
+int get_num_wb_presets(char* cam_model_path) {
+  char file_name[] = "raw2jpg_transform.txt";
+  char file_path[256];
+  strcpy(file_path, cam_model_path);
+  strcat(file_path, file_name);
+  FILE *fp = fopen(file_path, "r");
+  if (fp == NULL) {
+    printf("Didn't find the camera model file!\n");
+    exit(1);
+  }
+  int num_wb_presets = 0;
+  if (fscanf(fp, "%d", &num_wb_presets) != 1) {
+    printf("Failed to read the number of white balance presets!\n");
+    exit(1);
+  }
+  fclose(fp);
+  return num_wb_presets;
+}
+
 // Get white balance transform
 float* get_Tw(char* cam_model_path, int wb_index) {
   float *Tw;
   int err = posix_memalign((void **)&Tw, CACHELINE_SIZE, sizeof(float) * 9);
   assert(err == 0 && "Failed to allocate memory!");
-  char *line;
+  char *line = NULL;
   char *str;
   float line_data[3];
   size_t len = 0;
@@ -67,7 +87,7 @@ float* get_Tw(char* cam_model_path, int wb_index) {
   // Open file for reading
   // Open file for reading
   char file_name[] = "raw2jpg_transform.txt";
-  char file_path[100];
+  char file_path[256];
   strcpy(file_path, cam_model_path);
   strcat(file_path, file_name);
   FILE *fp = fopen(file_path, "r");
@@ -111,7 +131,7 @@ float* get_TsTw(char* cam_model_path, int wb_index) {
   float *TsTw;
   int err = posix_memalign((void **)&TsTw, CACHELINE_SIZE, sizeof(float) * 9);
   assert(err == 0 && "Failed to allocate memory!");
-  char *line;
+  char *line = NULL;
   char *str;
   float line_data[3];
   size_t len = 0;
@@ -123,7 +143,7 @@ float* get_TsTw(char* cam_model_path, int wb_index) {
 
   // Open file for reading
   char file_name[] = "raw2jpg_transform.txt";
-  char file_path[100];
+  char file_path[256];
   strcpy(file_path, cam_model_path);
   strcat(file_path, file_name);
   FILE *fp = fopen(file_path, "r");
@@ -160,7 +180,7 @@ float* get_ctrl_pts(char* cam_model_path, int num_cntrl_pts) {
   int err = posix_memalign((void **)&ctrl_pnts, CACHELINE_SIZE,
                            sizeof(float) * num_cntrl_pts * 3);
   assert(err == 0 && "Failed to allocate memory!");
-  char *line;
+  char *line = NULL;
   char *str;
   float line_data[3];
   size_t len = 0;
@@ -168,7 +188,7 @@ float* get_ctrl_pts(char* cam_model_path, int num_cntrl_pts) {
 
   // Open file for reading
   char file_name[] = "raw2jpg_ctrlPoints.txt";
-  char file_path[100];
+  char file_path[256];
   strcpy(file_path, cam_model_path);
   strcat(file_path, file_name);
   FILE *fp = fopen(file_path, "r");
@@ -205,7 +225,7 @@ float* get_weights(char* cam_model_path, int num_cntrl_pts) {
   int err = posix_memalign((void **)&weights, CACHELINE_SIZE,
                            sizeof(float) * num_cntrl_pts * 3);
   assert(err == 0 && "Failed to allocate memory!");
-  char *line;
+  char *line = NULL;
   char *str;
   float line_data[3];
   size_t len = 0;
@@ -213,7 +233,7 @@ float* get_weights(char* cam_model_path, int num_cntrl_pts) {
 
   // Open file for reading
   char file_name[] = "raw2jpg_coefs.txt";
-  char file_path[100];
+  char file_path[256];
   strcpy(file_path, cam_model_path);
   strcat(file_path, file_name);
   FILE *fp = fopen(file_path, "r");
@@ -249,7 +269,7 @@ float* get_coefs(char* cam_model_path, int num_cntrl_pts) {
   float *coefs;
   int err = posix_memalign((void **)&coefs, CACHELINE_SIZE, sizeof(float) * 12);
   assert(err == 0 && "Failed to allocate memory!");
-  char *line;
+  char *line = NULL;
   char *str;
   float line_data[3];
   size_t len = 0;
@@ -257,7 +277,7 @@ float* get_coefs(char* cam_model_path, int num_cntrl_pts) {
 
   // Open file for reading
   char file_name[] = "raw2jpg_coefs.txt";
-  char file_path[100];
+  char file_path[256];
   strcpy(file_path, cam_model_path);
   strcat(file_path, file_name);
   FILE *fp = fopen(file_path, "r");
@@ -295,7 +315,7 @@ float* get_tone_map(char* cam_model_path) {
   int err = posix_memalign((void **)&tone_map, CACHELINE_SIZE,
                            sizeof(float) * 256 * CHAN_SIZE);
   assert(err == 0 && "Failed to allocate memory!");
-  char *line;
+  char *line = NULL;
   char *str;
   float line_data[3];
   size_t len = 0;
@@ -303,7 +323,7 @@ float* get_tone_map(char* cam_model_path) {
 
   // Open file for reading
   char file_name[] = "raw2jpg_respFcns.txt";
-  char file_path[100];
+  char file_path[256];
   strcpy(file_path, cam_model_path);
   strcat(file_path, file_name);
   FILE *fp = fopen(file_path, "r");
@@ -333,3 +353,94 @@ float* get_tone_map(char* cam_model_path) {
   free(line);
   return tone_map;
 }
+
+// Read num_rows lines of three values, starting at line first, from a file
+// of the camera model.
+static float *read_cam_model_rows(char *cam_model_path, const char *file_name,
+                                  int first, int num_rows) {
+  float *rows;
+  int err = posix_memalign((void **)&rows, CACHELINE_SIZE,
+                           sizeof(float) * num_rows * 3);
+  assert(err == 0 && "Failed to allocate memory!");
+  char *line = NULL;
+  size_t len = 0;
+  int line_idx = 0;
+
+  char file_path[256];
+  strcpy(file_path, cam_model_path);
+  strcat(file_path, file_name);
+  FILE *fp = fopen(file_path, "r");
+  if (fp == NULL) {
+    printf("Didn't find the camera model file!\n");
+    exit(1);
+  }
+
+  while (getline(&line, &len, fp) != -1 && line_idx < first + num_rows) {
+    if (line_idx >= first) {
+      char *str = strtok(line, " \n");
+      for (int j = 0; j < 3 && str != NULL; j++) {
+        rows[(line_idx - first) * 3 + j] = atof(str);
+        str = strtok(NULL, " \n");
+      }
+    }
+    line_idx = line_idx + 1;
+  }
+  fclose(fp);
+  free(line);
+  if (line_idx < first + num_rows) {
+    printf("The camera model file %s is too short!\n", file_name);
+    exit(1);
+  }
+  return rows;
+}
+
+// Get the inverse of the combined transforms
+float* get_inverse_TsTw(char* cam_model_path, int wb_index) {
+  // jpg2raw_transform.txt holds the forward transforms, the same as
+  // raw2jpg_transform.txt, so invert them with the adjugate.
+  int wb_base = 5 + 5 * (wb_index - 1);
+  float *m = read_cam_model_rows(cam_model_path, "jpg2raw_transform.txt",
+                                 wb_base, 3);
+  float *inv;
+  int err = posix_memalign((void **)&inv, CACHELINE_SIZE, sizeof(float) * 9);
+  assert(err == 0 && "Failed to allocate memory!");
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      // Cofactor (j, i), from the cyclic neighbours of row j and column i.
+      int r0 = (j + 1) % 3, r1 = (j + 2) % 3;
+      int c0 = (i + 1) % 3, c1 = (i + 2) % 3;
+      inv[i * 3 + j] = (double)m[r0 * 3 + c0] * m[r1 * 3 + c1] -
+                       (double)m[r0 * 3 + c1] * m[r1 * 3 + c0];
+    }
+  }
+  double det = (double)m[0] * inv[0] + (double)m[1] * inv[3] +
+               (double)m[2] * inv[6];
+  assert(det != 0 && "The color transform is not invertible!");
+  for (int i = 0; i < 9; i++)
+    inv[i] /= det;
+  free(m);
+  return inv;
+}
+
+// Get inverse gamut map control points
+float* get_inverse_ctrl_pts(char* cam_model_path, int num_cntrl_pts) {
+  return read_cam_model_rows(cam_model_path, "jpg2raw_ctrlPoints.txt", 1,
+                             num_cntrl_pts);
+}
+
+// Get inverse gamut map weights
+float* get_inverse_weights(char* cam_model_path, int num_cntrl_pts) {
+  return read_cam_model_rows(cam_model_path, "jpg2raw_coefs.txt", 1,
+                             num_cntrl_pts);
+}
+
+// Get inverse gamut map coeficients
+float* get_inverse_coefs(char* cam_model_path, int num_cntrl_pts) {
+  return read_cam_model_rows(cam_model_path, "jpg2raw_coefs.txt",
+                             num_cntrl_pts + 1, 4);
+}
+
+// Get inverse tone mapping table
+float* get_inverse_tone_map(char* cam_model_path) {
+  return read_cam_model_rows(cam_model_path, "jpg2raw_respFcns.txt", 1, 256);
+}
@@ -4,6 +4,9 @@
 // Get color space transform
 float *get_Ts(char *cam_model_path);
 
+// Get the number of white balance presets
+int get_num_wb_presets(char *cam_model_path);
+
 // Get white balance transform
 float *get_Tw(char *cam_model_path, int wb_index);
 
@@ -22,4 +25,18 @@ float *get_coefs(char *cam_model_path, int num_cntrl_pts);
 // Get tone mapping table
 float *get_tone_map(char *cam_model_path);
 
+// The jpg2raw_* files of the camera model, which undo the stages above to
+// turn a processed image back into a raw one.
+
+// Get the inverse of the combined transforms
+float *get_inverse_TsTw(char *cam_model_path, int wb_index);
+
+// Get inverse gamut map control points, weights and coeficients
+float *get_inverse_ctrl_pts(char *cam_model_path, int num_cntrl_pts);
+float *get_inverse_weights(char *cam_model_path, int num_cntrl_pts);
+float *get_inverse_coefs(char *cam_model_path, int num_cntrl_pts);
+
+// Get inverse tone mapping table, from each 8-bit level to a linear value
+float *get_inverse_tone_map(char *cam_model_path);
+
 #endif
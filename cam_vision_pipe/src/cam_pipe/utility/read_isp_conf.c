@@ -0,0 +1,207 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "confuse.h"
+
+#include "cam_pipe.h"
+#include "read_isp_conf.h"
+
+// Names of the stage types in the config file, by isp_stage_t. Scaling and
+// descaling cannot be configured.
+static const char *stage_types[NumIspStages] = {
+  NULL, "DEMOSAIC", "DENOISE", "RESIZE", "TRANSFORM", "GAMUT_MAP", "TONE_MAP",
+  NULL,
+};
+
+static const char *stage_impls[] = { "EXACT", "SIMD", "APPROX" };
+
+static const char *gamut_map_impls[] = { "EXACT", "SIMD", "TRILINEAR_LUT",
+                                         "TETRAHEDRAL_LUT", "MEMO" };
+
+static cfg_opt_t isp_stage_cfg[] = {
+  CFG_STR("type", "", CFGF_NODEFAULT),
+  CFG_STR("impl", "EXACT", CFGF_NODEFAULT),
+  CFG_BOOL("enabled", cfg_true, CFGF_NONE),
+  CFG_INT("lut_size", 33, CFGF_NODEFAULT),
+  CFG_INT("window", 3, CFGF_NODEFAULT),
+  CFG_END()
+};
+
+static cfg_opt_t isp_cfg[] = {
+  CFG_SEC("stage", isp_stage_cfg,
+          CFGF_MULTI | CFGF_TITLE | CFGF_NO_TITLE_DUPES),
+  CFG_END()
+};
+
+static cfg_opt_t isp_top_level_cfg[] = {
+  CFG_SEC("isp", isp_cfg, CFGF_NODEFAULT),
+  CFG_END()
+};
+
+// Returns the index of str in names, or -1.
+static int find_name(const char *str, const char **names, int num_names) {
+  for (int i = 0; i < num_names; i++) {
+    if (names[i] && strcmp(str, names[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static int validate_stage_type(cfg_t *cfg, cfg_opt_t *opt) {
+  const char *value = cfg_opt_getnstr(opt, cfg_opt_size(opt) - 1);
+  assert(value);
+  if (find_name(value, stage_types, NumIspStages) < 0) {
+    cfg_error(cfg,
+              "Invalid ISP stage type '%s' for '%s'! Supported types are "
+              "DEMOSAIC, DENOISE, RESIZE, TRANSFORM, GAMUT_MAP and TONE_MAP.",
+              value, cfg->name);
+    return -1;
+  }
+  return 0;
+}
+
+static int validate_stage_section(cfg_t *cfg, cfg_opt_t *opt) {
+  cfg_t *stage = cfg_opt_getnsec(opt, cfg_opt_size(opt) - 1);
+  if (cfg_size(stage, "type") == 0) {
+    cfg_error(cfg, "Missing required option 'type' in ISP stage '%s'.",
+              cfg_title(stage));
+    return -1;
+  }
+  int type = find_name(cfg_getstr(stage, "type"), stage_types, NumIspStages);
+  if (cfg_size(stage, "lut_size") != 0 &&
+      (type != IspStageGamutMap || cfg_getint(stage, "lut_size") < 2)) {
+    cfg_error(cfg, "'lut_size' of ISP stage '%s' must be at least 2, and is "
+                   "only used by GAMUT_MAP.",
+              cfg_title(stage));
+    return -1;
+  }
+  if (cfg_size(stage, "window") != 0) {
+    int window = cfg_getint(stage, "window");
+    if (type != IspStageDenoise || window < 3 ||
+        window > MEDIAN_HIST_MAX_SIZE || window % 2 == 0) {
+      cfg_error(cfg, "'window' of ISP stage '%s' must be odd, from 3 to %d, "
+                     "and is only used by DENOISE.",
+                cfg_title(stage), MEDIAN_HIST_MAX_SIZE);
+      return -1;
+    }
+  }
+  if (cfg_size(stage, "impl") == 0)
+    return 0;
+  const char *impl = cfg_getstr(stage, "impl");
+  if (type == IspStageGamutMap) {
+    if (find_name(impl, gamut_map_impls, 5) < 0) {
+      cfg_error(cfg, "Invalid impl '%s' for ISP stage '%s'! GAMUT_MAP "
+                     "supports EXACT, SIMD, TRILINEAR_LUT, TETRAHEDRAL_LUT "
+                     "and MEMO.",
+                impl, cfg_title(stage));
+      return -1;
+    }
+    return 0;
+  }
+  int stage_impl = find_name(impl, stage_impls, 3);
+  bool supported = stage_impl == IspImplExact ||
+                   (stage_impl == IspImplSimd &&
+                    (type == IspStageDemosaic || type == IspStageDenoise)) ||
+                   (stage_impl == IspImplApprox && type == IspStageToneMap);
+  if (!supported) {
+    cfg_error(cfg, "Invalid impl '%s' for ISP stage '%s'! Only DEMOSAIC and "
+                   "DENOISE support SIMD, and only TONE_MAP supports APPROX.",
+              impl, cfg_title(stage));
+    return -1;
+  }
+  return 0;
+}
+
+static int validate_isp(cfg_t *cfg, cfg_opt_t *opt) {
+  cfg_t *isp = cfg_opt_getnsec(opt, cfg_opt_size(opt) - 1);
+  bool seen[NumIspStages] = { false };
+  for (unsigned i = 0; i < cfg_size(isp, "stage"); i++) {
+    cfg_t *stage = cfg_getnsec(isp, "stage", i);
+    int type = find_name(cfg_getstr(stage, "type"), stage_types, NumIspStages);
+    if (seen[type]) {
+      cfg_error(cfg, "ISP stage type '%s' appears more than once!",
+                stage_types[type]);
+      return -1;
+    }
+    seen[type] = true;
+  }
+  return 0;
+}
+
+void configure_isp_from_file(const char *cfg_file, isp_graph_t *graph) {
+  cfg_t *all_opts = cfg_init(isp_top_level_cfg, CFGF_NONE);
+  cfg_set_validate_func(all_opts, "isp|stage|type", validate_stage_type);
+  cfg_set_validate_func(all_opts, "isp|stage", validate_stage_section);
+  cfg_set_validate_func(all_opts, "isp", validate_isp);
+
+  int ret = cfg_parse(all_opts, cfg_file);
+  if (ret == CFG_FILE_ERROR) {
+    assert(false && "Failed to open the ISP configuration file!");
+  } else if (ret == CFG_PARSE_ERROR) {
+    fprintf(stderr,
+            "An error occurred when reading the ISP configuration file!\n");
+    exit(-1);
+  }
+  if (cfg_size(all_opts, "isp") == 0) {
+    fprintf(stderr, "%s has no isp section!\n", cfg_file);
+    exit(-1);
+  }
+
+  cfg_t *isp = cfg_getsec(all_opts, "isp");
+  graph->num_stages = 0;
+  for (unsigned i = 0; i < cfg_size(isp, "stage"); i++) {
+    cfg_t *stage = cfg_getnsec(isp, "stage", i);
+    if (!cfg_getbool(stage, "enabled"))
+      continue;
+    int type = find_name(cfg_getstr(stage, "type"), stage_types, NumIspStages);
+    isp_stage_impl_t impl = IspImplExact;
+    if (cfg_size(stage, "impl") != 0) {
+      const char *value = cfg_getstr(stage, "impl");
+      if (type == IspStageGamutMap) {
+        switch (find_name(value, gamut_map_impls, 5)) {
+          case 1:
+            gamut_map_impl = GamutMapSimd;
+            break;
+          case 2:
+            gamut_map_impl = GamutMapLut;
+            gamut_lut_interp = LutTrilinear;
+            break;
+          case 3:
+            gamut_map_impl = GamutMapLut;
+            gamut_lut_interp = LutTetrahedral;
+            break;
+          case 4:
+            gamut_map_impl = GamutMapMemo;
+            break;
+          default:
+            gamut_map_impl = GamutMapExact;
+            break;
+        }
+      } else {
+        impl = find_name(value, stage_impls, 3);
+      }
+    }
+    if (cfg_size(stage, "lut_size") != 0)
+      gamut_lut_size = cfg_getint(stage, "lut_size");
+    if (cfg_size(stage, "window") != 0)
+      isp_denoise_size = cfg_getint(stage, "window");
+    graph->stages[graph->num_stages++] = (isp_graph_stage_t){ type, impl };
+  }
+  cfg_free(all_opts);
+}
+
+void print_isp_graph(isp_graph_t *graph) {
+  printf("==================================\n");
+  printf("ISP stages: %s", isp_stage_names[IspStageScale]);
+  for (int i = 0; i < graph->num_stages; i++) {
+    isp_graph_stage_t *stage = &graph->stages[i];
+    printf(", %s", isp_stage_names[stage->type]);
+    if (stage->impl != IspImplExact)
+      printf(" (%s)", stage->impl == IspImplSimd ? "simd" : "approx");
+  }
+  printf(", %s\n", isp_stage_names[IspStageDescale]);
+  printf("==================================\n");
+}
@@ -0,0 +1,40 @@
+#ifndef _READ_ISP_CONF_H_
+#define _READ_ISP_CONF_H_
+
+#include "kernels/pipe_stages.h"
+
+// Read the ISP stage graph from the isp section of cfg_file.
+//
+// Each stage subsection names a stage type, and the stages run in the order
+// they are listed. A stage that is not listed or has enabled = false does not
+// run at all. For example:
+//
+//   isp {
+//     stage demosaic {
+//       type = DEMOSAIC
+//       impl = SIMD
+//     }
+//     stage gamut {
+//       type = GAMUT_MAP
+//       impl = TETRAHEDRAL_LUT
+//       lut_size = 17
+//     }
+//     stage tone {
+//       type = TONE_MAP
+//       impl = APPROX
+//     }
+//   }
+//
+// Stage types are DEMOSAIC, DENOISE, RESIZE, TRANSFORM, GAMUT_MAP and
+// TONE_MAP. Scaling the raw input always runs first and descaling last. impl
+// is EXACT (the default), SIMD for demosaic and denoise, or APPROX for tone
+// mapping. For the gamut map, it is EXACT, SIMD, TRILINEAR_LUT,
+// TETRAHEDRAL_LUT or MEMO, and sets gamut_map_impl, gamut_lut_interp and
+// gamut_lut_size, which are otherwise left as they are. Likewise, window sets
+// isp_denoise_size for DENOISE.
+void configure_isp_from_file(const char* cfg_file, isp_graph_t* graph);
+
+// Print the stages of graph.
+void print_isp_graph(isp_graph_t* graph);
+
+#endif
@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cam_pipe/utility/cam_model_bin.h"
+
+// Compiles a text camera model into the binary format loaded by the ISP.
+//
+// Usage: compile-cam-model CAM_MODEL_DIR [NUM_CTRL_PTS]
+//
+// The output is written to CAM_MODEL_DIR/raw2jpg_model.bin, where
+// isp_context_create() looks for it.
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s CAM_MODEL_DIR [NUM_CTRL_PTS]\n", argv[0]);
+        return 1;
+    }
+    int num_ctrl_pts = argc > 2 ? strtol(argv[2], NULL, 10) : 3702;
+
+    // The text loaders expect the directory to end with a slash.
+    char cam_model_path[256];
+    char output_path[256 + sizeof(CAM_MODEL_BIN_NAME)];
+    int len = strlen(argv[1]);
+    const char* sep = len > 0 && argv[1][len - 1] == '/' ? "" : "/";
+    if (snprintf(cam_model_path, sizeof(cam_model_path), "%s%s", argv[1],
+                 sep) >= (int)sizeof(cam_model_path)) {
+        fprintf(stderr, "The camera model path is too long!\n");
+        return 1;
+    }
+    snprintf(output_path, sizeof(output_path), "%s%s", cam_model_path,
+             CAM_MODEL_BIN_NAME);
+
+    if (compile_cam_model(cam_model_path, num_ctrl_pts, output_path)) {
+        fprintf(stderr, "Failed to write %s!\n", output_path);
+        return 1;
+    }
+    printf("Wrote %s\n", output_path);
+    return 0;
+}
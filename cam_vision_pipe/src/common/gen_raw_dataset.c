@@ -0,0 +1,261 @@
+#include <argp.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/utility.h"
+#include "cam_pipe/kernels/inverse_isp.h"
+#include "cam_pipe/utility/cam_pipe_utility.h"
+#include "nnet_lib/utility/thread_pool.h"
+
+// Generates a raw dataset from processed images by running them through the
+// inverse camera pipeline (see cam_pipe/kernels/inverse_isp.h).
+//
+// Every input is an image written by scripts/convert_image.py, and its raw
+// frame is written to OUTPUT_DIR under the same name, with a .raw extension
+// for the single-plane formats. The frames are spread across the threads of
+// the thread pool, each of which reads, converts and writes whole frames.
+
+typedef struct _arguments {
+    char* output_dir;
+    char** inputs;
+    int num_inputs;
+    char* cam_model_path;
+    raw_format_t raw_format;
+    int raw_bit_depth;
+    int wb_index;
+    int gamut_lut_size;
+    int num_threads;
+} arguments;
+
+typedef struct _gen_worker_args {
+    arguments* args;
+    inverse_isp_t* isp;
+    // Frames first, first + stride, ... are converted by this worker.
+    int first;
+    int stride;
+    int num_frames;
+    int num_failed;
+    long num_pixels;
+} gen_worker_args;
+
+static char prog_doc[] =
+        "\nGenerates raw frames from processed images with the inverse camera "
+        "pipeline.\n";
+static char args_doc[] = "OUTPUT_DIR IMAGE.bin...";
+static struct argp_option options[] = {
+    { "raw-format", 'r', "FORMAT", 0,
+      "Layout of the raw frames: rgb (default), HWC uint8 images with a "
+      "header, or one of the headerless single-plane formats bayer8, raw10, "
+      "raw12 or bayer16." },
+    { "raw-bit-depth", 'b', "BITS", 0,
+      "Significant bits of a bayer16 sample (default 16)." },
+    { "wb-index", 'w', "INDEX", 0,
+      "White balance preset of the camera model to undo (default 6)." },
+    { "gamut-lut-size", 'l', "N", 0,
+      "Number of inverse gamut map LUT grid points per channel (default "
+      "33), or 0 to evaluate the exact RBF." },
+    { "num-threads", 't', "THREADS", 0,
+      "Number of frames converted at once (default 1)." },
+    { "cam-model", 'm', "DIR", 0,
+      "Camera model directory. Defaults to the Nikon D7000 model under "
+      "CAVA_HOME." },
+    { 0 },
+};
+
+// Same names as the --raw-format option of the camera vision pipeline.
+static int str2rawformat(char* str, raw_format_t* format) {
+    const char* names[] = { "rgb", "bayer8", "raw10", "raw12", "bayer16" };
+    const raw_format_t formats[] = { RawRgbPlanes, RawBayer8, RawBayer10,
+                                     RawBayer12, RawBayer16 };
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(str, names[i]) == 0) {
+            *format = formats[i];
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static error_t parse_opt(int key, char* arg, struct argp_state* state) {
+    arguments* args = (arguments*)(state->input);
+    switch (key) {
+        case 'r':
+            if (str2rawformat(arg, &args->raw_format))
+                argp_error(state, "Invalid raw format %s.", arg);
+            break;
+        case 'b':
+            args->raw_bit_depth = strtol(arg, NULL, 10);
+            if (args->raw_bit_depth < 1 || args->raw_bit_depth > 16)
+                argp_error(state, "The bit depth must be from 1 to 16.");
+            break;
+        case 'w':
+            args->wb_index = strtol(arg, NULL, 10);
+            break;
+        case 'l':
+            args->gamut_lut_size = strtol(arg, NULL, 10);
+            if (args->gamut_lut_size == 1 || args->gamut_lut_size < 0)
+                argp_error(state, "The LUT needs at least 2 grid points.");
+            break;
+        case 't':
+            args->num_threads = strtol(arg, NULL, 10);
+            if (args->num_threads < 1)
+                argp_error(state, "There must be at least one thread.");
+            break;
+        case 'm':
+            args->cam_model_path = arg;
+            break;
+        case ARGP_KEY_ARG:
+            args->output_dir = arg;
+            args->inputs = &state->argv[state->next];
+            args->num_inputs = state->argc - state->next;
+            state->next = state->argc;
+            break;
+        case ARGP_KEY_END:
+            if (args->num_inputs == 0)
+                argp_usage(state);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp parser = { options, parse_opt, args_doc, prog_doc };
+
+// Convert one input into a raw frame in the output directory. Returns 0 on
+// success.
+static int gen_raw_frame(arguments* args, inverse_isp_t* isp, char* input,
+                         long* num_pixels) {
+    if (access(input, R_OK) != 0) {
+        fprintf(stderr, "Cannot read %s!\n", input);
+        return 1;
+    }
+    int row_size, col_size;
+    uint8_t* image = read_image_from_binary(input, &row_size, &col_size);
+    if (check_raw_format(args->raw_format, col_size)) {
+        fprintf(stderr,
+                "%s is %d pixels wide, which the raw format cannot pack!\n",
+                input, col_size);
+        free(image);
+        return 1;
+    }
+
+    // basename() may modify its argument.
+    char name[256];
+    snprintf(name, sizeof(name), "%s", input);
+    char* stem = basename(name);
+    char* ext = strrchr(stem, '.');
+    if (ext)
+        *ext = '\0';
+    char output_path[1024];
+    snprintf(output_path, sizeof(output_path), "%s/%s.%s", args->output_dir,
+             stem, args->raw_format == RawRgbPlanes ? "bin" : "raw");
+
+    float* buffers = malloc_aligned(sizeof(float) *
+                                    get_inverse_isp_buffer_size(col_size));
+    uint8_t* raw = malloc_aligned(
+            get_raw_frame_bytes(args->raw_format, row_size, col_size));
+    inverse_isp_frame(isp, image, row_size, col_size, buffers, raw);
+    if (args->raw_format == RawRgbPlanes)
+        write_image_to_binary(output_path, raw, row_size, col_size);
+    else
+        write_raw_to_binary(output_path, raw, args->raw_format, row_size,
+                            col_size);
+    *num_pixels += (long)row_size * col_size;
+
+    free(image);
+    free(buffers);
+    free(raw);
+    return 0;
+}
+
+static void* gen_raw_worker(void* worker_args) {
+    gen_worker_args* a = (gen_worker_args*)worker_args;
+    for (int i = a->first; i < a->args->num_inputs; i += a->stride) {
+        if (gen_raw_frame(a->args, a->isp, a->args->inputs[i],
+                          &a->num_pixels))
+            a->num_failed++;
+        else
+            a->num_frames++;
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    arguments args = { 0 };
+    args.raw_format = RawRgbPlanes;
+    args.raw_bit_depth = 16;
+    args.wb_index = 6;
+    args.gamut_lut_size = 33;
+    args.num_threads = 1;
+    argp_parse(&parser, argc, argv, 0, 0, &args);
+
+    // The text loaders expect the directory to end with a slash.
+    char cam_model_path[256];
+    int len;
+    if (args.cam_model_path) {
+        int dir_len = strlen(args.cam_model_path);
+        const char* sep = dir_len > 0 && args.cam_model_path[dir_len - 1] == '/'
+                                  ? ""
+                                  : "/";
+        len = snprintf(cam_model_path, sizeof(cam_model_path), "%s%s",
+                       args.cam_model_path, sep);
+    } else {
+        const char* cava_home = getenv("CAVA_HOME");
+        if (cava_home == NULL) {
+            fprintf(stderr, "CAVA_HOME returned NULL\n");
+            return 1;
+        }
+        len = snprintf(cam_model_path, sizeof(cam_model_path),
+                       "%s/cam_vision_pipe/cam_models/NikonD7000/", cava_home);
+    }
+    if (len >= (int)sizeof(cam_model_path)) {
+        fprintf(stderr, "The camera model path is too long!\n");
+        return 1;
+    }
+
+    inverse_isp_t* isp = create_inverse_isp(
+            cam_model_path, args.wb_index, args.gamut_lut_size,
+            LutTetrahedral, args.raw_format, args.raw_bit_depth);
+
+    int num_workers = min(args.num_threads, args.num_inputs);
+    gen_worker_args* workers = calloc(num_workers, sizeof(gen_worker_args));
+    for (int i = 0; i < num_workers; i++)
+        workers[i] = (gen_worker_args){ &args, isp, i, num_workers };
+    double start = get_wall_time();
+    if (num_workers > 1) {
+        init_thread_pool(num_workers);
+        for (int i = 0; i < num_workers; i++)
+            thread_dispatch(gen_raw_worker, &workers[i]);
+        thread_pool_join();
+        destroy_thread_pool();
+    } else {
+        gen_raw_worker(&workers[0]);
+    }
+    double elapsed = get_wall_time() - start;
+
+    int num_frames = 0, num_failed = 0;
+    long num_pixels = 0;
+    for (int i = 0; i < num_workers; i++) {
+        num_frames += workers[i].num_frames;
+        num_failed += workers[i].num_failed;
+        num_pixels += workers[i].num_pixels;
+    }
+    printf("Wrote %d raw frames to %s in %.3f s on %d threads: %.0f frames "
+           "per minute, %.2f MPixel/s.\n",
+           num_frames, args.output_dir, elapsed, num_workers,
+           num_frames * 60 / elapsed, num_pixels * 1e-6 / elapsed);
+    if (args.raw_format != RawRgbPlanes) {
+        printf("Read them with --raw-format and --raw-size set to the format "
+               "and the size of each frame.\n");
+    }
+    if (num_failed > 0)
+        fprintf(stderr, "Failed to convert %d inputs.\n", num_failed);
+
+    free(workers);
+    free_inverse_isp(isp);
+    return num_failed > 0;
+}
@@ -1,4 +1,5 @@
 #include <argp.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -7,7 +8,9 @@
 #include "common/utility.h"
 
 #include "cam_pipe/utility/cam_pipe_utility.h"
+#include "cam_pipe/utility/read_isp_conf.h"
 #include "cam_pipe/kernels/pipe_stages.h"
+#include "cam_pipe/kernels/grayscale.h"
 #include "cam_pipe/cam_pipe.h"
 
 #include "arch/common.h"
@@ -16,10 +19,14 @@
 #include "nnet_lib/utility/compression.h"
 #include "nnet_lib/utility/data_archive.h"
 #include "nnet_lib/utility/data_archive_bin.h"
+#include "nnet_lib/utility/data_layout_conversion.h"
+#include "nnet_lib/utility/fold_batch_norm.h"
 #include "nnet_lib/utility/init_data.h"
 #include "nnet_lib/utility/profiling.h"
 #include "nnet_lib/utility/read_model_conf.h"
+#include "nnet_lib/utility/thread_pool.h"
 #include "nnet_lib/utility/utility.h"
+#include "nnet_lib/utility/winograd_weights.h"
 
 int NUM_TEST_CASES;
 int NUM_CLASSES;
@@ -44,6 +51,26 @@ typedef struct _arguments {
     int num_threads;
     data_init_mode data_mode;
     sigmoid_impl_t sigmoid_impl;
+    isp_dataflow_t isp_dataflow;
+    int isp_frac_bits;
+    raw_format_t raw_format;
+    int raw_bit_depth;
+    int raw_rows;
+    int raw_cols;
+    gamut_map_impl_t gamut_map_impl;
+    lut_interp_t gamut_lut_interp;
+    int gamut_lut_size;
+    int gamut_cache_kb;
+    bool isp_dnn_handoff;
+    resize_method_t isp_resize;
+    int crop_rows;
+    int crop_cols;
+    int crop_row;
+    int crop_col;
+    bool isp_fuse_color;
+    bool isp_stats;
+    int isp_denoise_size;
+    char* isp_config;
 } arguments;
 
 static char prog_doc[] = "\nCamera vision pipeline on gem5-Aladdin.\n";
@@ -62,7 +89,60 @@ static struct argp_option options[] = {
       "Sigmoid implementation: exp-unit (default), centered-lut, or "
       "noncentered-lut." },
     { "num-threads", 't', "THREADS", 0,
-      "Number of worker threads in the thread pool." },
+      "Number of worker threads in the thread pool. The streaming ISP "
+      "dataflow splits each frame into one band of rows per thread." },
+    { "isp-dataflow", 'i', "DATAFLOW", 0,
+      "ISP dataflow: frame (default), streaming, frame-fp16, which keeps "
+      "the frame buffers of the frame dataflow as fp16, or fixed, which runs "
+      "every stage on int16 fixed-point samples." },
+    { "isp-frac-bits", 'q', "BITS", 0,
+      "Fractional bits of the samples of the fixed ISP dataflow, from 8 to "
+      "13 (default 12)." },
+    { "raw-format", 'r', "FORMAT", 0,
+      "Layout of the raw image: rgb (default), a binary file of HWC uint8 "
+      "images, or one of the single-plane Bayer formats bayer8, raw10 (MIPI "
+      "packed), raw12 (MIPI packed) or bayer16. Single-plane images are "
+      "headerless sensor dumps and require --raw-size." },
+    { "raw-size", 's', "ROWSxCOLS", 0,
+      "Dimensions of a single-plane raw image." },
+    { "raw-bit-depth", 'b', "BITS", 0,
+      "Significant bits of a bayer16 sample (default 16)." },
+    { "gamut-map", 'g', "IMPL", 0,
+      "Gamut map implementation: exact (default), simd, memo, which caches "
+      "the exact result of every color across frames, trilinear-lut or "
+      "tetrahedral-lut. All but exact require the streaming, frame-fp16 or "
+      "fixed ISP dataflow. The fixed dataflow always interpolates a LUT, "
+      "tetrahedral unless trilinear-lut is given." },
+    { "gamut-lut-size", 'l', "N", 0,
+      "Number of gamut map LUT grid points per channel (default 33)." },
+    { "gamut-cache-kb", 'k', "KB", 0,
+      "Memory budget of the memo gamut map caches, shared by all threads "
+      "(default 4096)." },
+    { "isp-dnn-handoff", 'z', 0, 0,
+      "Have the ISP write the fp16 NHWC input of the first convolution, "
+      "which the network reads in place (SMV only). Only the streaming "
+      "dataflow writes it without a separate conversion pass." },
+    { "isp-resize", 'e', "METHOD", 0,
+      "Resize the frame to the input size of the network right after "
+      "denoising, before the color stages: none (default), area or "
+      "bilinear." },
+    { "isp-crop", 'c', "ROWSxCOLS+ROW+COL", 0,
+      "Crop the frame to the ROWSxCOLS window at ROW, COL before resizing "
+      "it. Without --isp-resize, the window is the output image." },
+    { "isp-fuse-color", 'u', 0, 0,
+      "Run color mapping, gamut mapping, tone mapping and descaling as a "
+      "single pass over the frame in the frame ISP dataflow." },
+    { "isp-stats", 'a', 0, 0,
+      "Collect 3A statistics of the frame while the ISP transforms it, and "
+      "print them with the white balance preset they suggest (streaming and "
+      "frame-fp16 ISP dataflows)." },
+    { "isp-denoise-size", 'w', "N", 0,
+      "Size of the N x N window of the denoise median: 3 (default), or an "
+      "odd size up to 15, which uses a constant-time sliding histogram "
+      "median (streaming ISP dataflow)." },
+    { "isp-config", 'p', "FILE", 0,
+      "Read the ISP stages to run, their order and their implementations "
+      "from the isp section of FILE." },
     { 0 },
 };
 
@@ -105,6 +185,95 @@ int str2sigmoidimpl(char* str, sigmoid_impl_t* impl) {
     return 1;
 }
 
+// Convert a string to an ISP dataflow.
+//
+// If the string was a valid choice, this updates @dataflow and returns 0;
+// otherwise, returns 1.
+int str2ispdataflow(char* str, isp_dataflow_t* dataflow) {
+    if (strncmp(str, "frame", 6) == 0) {
+        *dataflow = IspFrameDataflow;
+        return 0;
+    } else if (strncmp(str, "streaming", 10) == 0) {
+        *dataflow = IspStreamingDataflow;
+        return 0;
+    } else if (strncmp(str, "frame-fp16", 11) == 0) {
+        *dataflow = IspHalfFrameDataflow;
+        return 0;
+    } else if (strncmp(str, "fixed", 6) == 0) {
+        *dataflow = IspFixedPointDataflow;
+        return 0;
+    }
+    return 1;
+}
+
+// Convert a string to an ISP resize method.
+//
+// If the string was a valid choice, this updates @method and returns 0;
+// otherwise, returns 1.
+int str2resizemethod(char* str, resize_method_t* method) {
+    if (strncmp(str, "none", 5) == 0) {
+        *method = ResizeNone;
+        return 0;
+    } else if (strncmp(str, "area", 5) == 0) {
+        *method = ResizeArea;
+        return 0;
+    } else if (strncmp(str, "bilinear", 9) == 0) {
+        *method = ResizeBilinear;
+        return 0;
+    }
+    return 1;
+}
+
+// Convert a string to a raw image format.
+//
+// If the string was a valid choice, this updates @format and returns 0;
+// otherwise, returns 1.
+int str2rawformat(char* str, raw_format_t* format) {
+    if (strncmp(str, "rgb", 4) == 0) {
+        *format = RawRgbPlanes;
+        return 0;
+    } else if (strncmp(str, "bayer8", 7) == 0) {
+        *format = RawBayer8;
+        return 0;
+    } else if (strncmp(str, "raw10", 6) == 0) {
+        *format = RawBayer10;
+        return 0;
+    } else if (strncmp(str, "raw12", 6) == 0) {
+        *format = RawBayer12;
+        return 0;
+    } else if (strncmp(str, "bayer16", 8) == 0) {
+        *format = RawBayer16;
+        return 0;
+    }
+    return 1;
+}
+
+// Convert a string to a gamut map implementation.
+//
+// If the string was a valid choice, this updates @impl and @interp and
+// returns 0; otherwise, returns 1.
+int str2gamutmapimpl(char* str, gamut_map_impl_t* impl, lut_interp_t* interp) {
+    if (strncmp(str, "exact", 6) == 0) {
+        *impl = GamutMapExact;
+        return 0;
+    } else if (strncmp(str, "simd", 5) == 0) {
+        *impl = GamutMapSimd;
+        return 0;
+    } else if (strncmp(str, "memo", 5) == 0) {
+        *impl = GamutMapMemo;
+        return 0;
+    } else if (strncmp(str, "trilinear-lut", 14) == 0) {
+        *impl = GamutMapLut;
+        *interp = LutTrilinear;
+        return 0;
+    } else if (strncmp(str, "tetrahedral-lut", 16) == 0) {
+        *impl = GamutMapLut;
+        *interp = LutTetrahedral;
+        return 0;
+    }
+    return 1;
+}
+
 static error_t parse_opt(int key, char* arg, struct argp_state* state) {
     arguments* args = (arguments*)(state->input);
     switch (key) {
@@ -130,6 +299,90 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
             args->num_threads = strtol(arg, NULL, 10);
             break;
         }
+        case 'i': {
+            if (str2ispdataflow(arg, &args->isp_dataflow))
+                argp_usage(state);
+            break;
+        }
+        case 'q': {
+            args->isp_frac_bits = strtol(arg, NULL, 10);
+            if (args->isp_frac_bits < ISP_Q_MIN_FRAC_BITS ||
+                args->isp_frac_bits > ISP_Q_MAX_FRAC_BITS)
+                argp_usage(state);
+            break;
+        }
+        case 'r': {
+            if (str2rawformat(arg, &args->raw_format))
+                argp_usage(state);
+            break;
+        }
+        case 's': {
+            if (sscanf(arg, "%dx%d", &args->raw_rows, &args->raw_cols) != 2 ||
+                args->raw_rows < 1 || args->raw_cols < 1)
+                argp_usage(state);
+            break;
+        }
+        case 'b': {
+            args->raw_bit_depth = strtol(arg, NULL, 10);
+            if (args->raw_bit_depth < 1 || args->raw_bit_depth > 16)
+                argp_usage(state);
+            break;
+        }
+        case 'g': {
+            if (str2gamutmapimpl(
+                        arg, &args->gamut_map_impl, &args->gamut_lut_interp))
+                argp_usage(state);
+            break;
+        }
+        case 'z': {
+            args->isp_dnn_handoff = true;
+            break;
+        }
+        case 'e': {
+            if (str2resizemethod(arg, &args->isp_resize))
+                argp_usage(state);
+            break;
+        }
+        case 'p': {
+            args->isp_config = arg;
+            break;
+        }
+        case 'u': {
+            args->isp_fuse_color = true;
+            break;
+        }
+        case 'a': {
+            args->isp_stats = true;
+            break;
+        }
+        case 'w': {
+            args->isp_denoise_size = strtol(arg, NULL, 10);
+            if (args->isp_denoise_size < 3 ||
+                args->isp_denoise_size > MEDIAN_HIST_MAX_SIZE ||
+                args->isp_denoise_size % 2 == 0)
+                argp_usage(state);
+            break;
+        }
+        case 'c': {
+            if (sscanf(arg, "%dx%d+%d+%d", &args->crop_rows, &args->crop_cols,
+                       &args->crop_row, &args->crop_col) != 4 ||
+                args->crop_rows < 1 || args->crop_cols < 1 ||
+                args->crop_row < 0 || args->crop_col < 0)
+                argp_usage(state);
+            break;
+        }
+        case 'l': {
+            args->gamut_lut_size = strtol(arg, NULL, 10);
+            if (args->gamut_lut_size < 2)
+                argp_usage(state);
+            break;
+        }
+        case 'k': {
+            args->gamut_cache_kb = strtol(arg, NULL, 10);
+            if (args->gamut_cache_kb < 1)
+                argp_usage(state);
+            break;
+        }
         case ARGP_KEY_ARG: {
             if (state->arg_num >= NUM_REQUIRED_ARGS)
                 argp_usage(state);
@@ -154,6 +407,41 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
                         "from.\n");
                 argp_usage(state);
             }
+            if (args->gamut_map_impl != GamutMapExact &&
+                args->isp_dataflow == IspFrameDataflow) {
+                fprintf(stderr,
+                        "[ERROR]: Only the exact gamut map is supported "
+                        "by the frame ISP dataflow.\n");
+                argp_usage(state);
+            }
+            if (args->isp_stats &&
+                args->isp_dataflow != IspStreamingDataflow &&
+                args->isp_dataflow != IspHalfFrameDataflow) {
+                fprintf(stderr,
+                        "[ERROR]: Only the streaming and frame-fp16 ISP "
+                        "dataflows collect statistics.\n");
+                argp_usage(state);
+            }
+            if (args->isp_denoise_size != 3 &&
+                args->isp_dataflow != IspStreamingDataflow) {
+                fprintf(stderr,
+                        "[ERROR]: Only the streaming ISP dataflow has "
+                        "denoise windows larger than 3x3.\n");
+                argp_usage(state);
+            }
+            if (args->raw_format != RawRgbPlanes && args->raw_rows == 0) {
+                fprintf(stderr,
+                        "[ERROR]: Single-plane raw images require "
+                        "--raw-size.\n");
+                argp_usage(state);
+            }
+            if (args->raw_format != RawRgbPlanes &&
+                check_raw_format(args->raw_format, args->raw_cols)) {
+                fprintf(stderr,
+                        "[ERROR]: The raw image width is not a whole number "
+                        "of packed pixel groups.\n");
+                argp_usage(state);
+            }
             break;
         }
         default:
@@ -167,6 +455,26 @@ void set_default_args(arguments* args) {
     args->num_threads = 0;
     args->data_mode = RANDOM;
     args->sigmoid_impl = ExpUnit;
+    args->isp_dataflow = IspFrameDataflow;
+    args->isp_frac_bits = 12;
+    args->raw_format = RawRgbPlanes;
+    args->raw_bit_depth = 16;
+    args->raw_rows = 0;
+    args->raw_cols = 0;
+    args->gamut_map_impl = GamutMapExact;
+    args->gamut_lut_interp = LutTetrahedral;
+    args->gamut_lut_size = 33;
+    args->gamut_cache_kb = 4096;
+    args->isp_dnn_handoff = false;
+    args->isp_resize = ResizeNone;
+    args->crop_rows = 0;
+    args->crop_cols = 0;
+    args->crop_row = 0;
+    args->crop_col = 0;
+    args->isp_fuse_color = false;
+    args->isp_stats = false;
+    args->isp_denoise_size = 3;
+    args->isp_config = NULL;
     for (int i = 0; i < NUM_ARGS; i++) {
         args->args[i] = NULL;
     }
@@ -263,6 +571,32 @@ void free_network_weights(network_t* network) {
     }
 }
 
+// Check whether the camera pipeline can write the input of the network.
+//
+// The first SMV standard convolution reads its input as fp16 NHWC, so the
+// ISP can write it directly if that convolution comes straight after the
+// input layer and takes an RGB image of the same size. If so, this returns
+// true and sets @dims to the NHWC dimensions of its input.
+bool can_handoff_isp_to_dnn(network_t* network,
+                            int row_size,
+                            int col_size,
+                            dims_t* dims) {
+#if ARCHITECTURE == SMV
+    if (network->depth < 2)
+        return false;
+    layer_t* first_layer = &network->layers[1];
+    if (first_layer->type != CONV_STANDARD ||
+        first_layer->inputs.rows != row_size ||
+        first_layer->inputs.cols != col_size ||
+        first_layer->inputs.height != CHAN_SIZE)
+        return false;
+    *dims = nchw_to_nhwc_dims(&first_layer->inputs, DATA_ALIGNMENT);
+    return true;
+#else
+    return false;
+#endif
+}
+
 static struct argp parser = { options, parse_opt, args_doc, prog_doc };
 
 int main(int argc, char* argv[]) {
@@ -287,20 +621,166 @@ int main(int argc, char* argv[]) {
 
     // Read a raw image.
     printf("Reading a raw image from %s\n", args.args[RAW_IMAGE_BIN]);
-    host_input_nwc = read_image_from_binary(
-            args.args[RAW_IMAGE_BIN], &row_size, &col_size);
-    printf("Raw image shape: %d x %d x %d\n", row_size, col_size, CHAN_SIZE);
-    // The input image is stored in HWC format. To make it more efficient for
-    // future optimization (e.g., vectorization), I expect we would transform it
-    // to CHW format at some point.
-    convert_hwc_to_chw(host_input_nwc, row_size, col_size, &host_input);
+    if (args.raw_format == RawRgbPlanes) {
+        host_input_nwc = read_image_from_binary(
+                args.args[RAW_IMAGE_BIN], &row_size, &col_size);
+        printf("Raw image shape: %d x %d x %d\n", row_size, col_size,
+               CHAN_SIZE);
+        // The input image is stored in HWC format. To make it more efficient
+        // for future optimization (e.g., vectorization), I expect we would
+        // transform it to CHW format at some point.
+        convert_hwc_to_chw(host_input_nwc, row_size, col_size, &host_input);
+    } else {
+        // A single-plane sensor dump is fed to the ISP as is.
+        row_size = args.raw_rows;
+        col_size = args.raw_cols;
+        host_input = read_raw_from_binary(
+                args.args[RAW_IMAGE_BIN], args.raw_format, row_size, col_size);
+        printf("Raw image shape: %d x %d, %d bytes\n", row_size, col_size,
+               get_raw_frame_bytes(args.raw_format, row_size, col_size));
+    }
+
+    // The network is configured first, so that the camera pipeline can write
+    // the input of its first layer if --isp-dnn-handoff is given.
+    NUM_TEST_CASES = args.num_inputs;
+    NUM_WORKER_THREADS = args.num_threads;
+    SIGMOID_IMPL = args.sigmoid_impl;
+
+    network_t network;
+    device_t* device;
+    sampling_param_t* sampling_param;
+    network.depth = configure_network_from_file(args.args[NETWORK_CONFIG],
+                                                &network.layers,
+                                                &device,
+                                                &sampling_param);
+
+    // The frame can be cropped, and resized to the input of the network, by
+    // the camera pipeline.
+    resize_cfg_t resize = { ResizeNone };
+    if (args.isp_resize != ResizeNone || args.crop_rows > 0) {
+        resize.method =
+                args.isp_resize != ResizeNone ? args.isp_resize : ResizeArea;
+        resize.crop_row = args.crop_row;
+        resize.crop_col = args.crop_col;
+        resize.crop_rows = args.crop_rows > 0 ? args.crop_rows : row_size;
+        resize.crop_cols = args.crop_cols > 0 ? args.crop_cols : col_size;
+        if (args.isp_resize != ResizeNone) {
+            resize.out_rows = network.layers[0].inputs.rows;
+            resize.out_cols = network.layers[0].inputs.cols;
+        } else {
+            resize.out_rows = resize.crop_rows;
+            resize.out_cols = resize.crop_cols;
+        }
+        if (check_resize_cfg(&resize, row_size, col_size)) {
+            fprintf(stderr,
+                    "Cannot crop %d x %d at %d, %d out of the %d x %d image "
+                    "and resize it to %d x %d!\n",
+                    resize.crop_rows, resize.crop_cols, resize.crop_row,
+                    resize.crop_col, row_size, col_size, resize.out_rows,
+                    resize.out_cols);
+            exit(1);
+        }
+        printf("Resizing the image to %d x %d in the camera pipeline.\n",
+               resize.out_rows, resize.out_cols);
+    }
+    int out_row_size = get_resize_out_rows(&resize, row_size);
+    int out_col_size = get_resize_out_cols(&resize, col_size);
 
     // Allocate a buffer for storing the output image data.
-    host_result =
-            malloc_aligned(sizeof(uint8_t) * row_size * col_size * CHAN_SIZE);
+    host_result = malloc_aligned(
+            sizeof(uint8_t) * out_row_size * out_col_size * CHAN_SIZE);
+
+    fp16array_t* dnn_input = NULL;
+    dims_t dnn_input_dims;
+    if (args.isp_dnn_handoff) {
+        if (can_handoff_isp_to_dnn(
+                    &network, out_row_size, out_col_size, &dnn_input_dims)) {
+            dnn_input = init_fp16array(
+                    NUM_TEST_CASES * get_dims_size(&dnn_input_dims), true);
+        } else {
+            printf("The first layer of the network cannot read the camera "
+                   "pipeline output directly. Converting it instead.\n");
+        }
+    }
 
     // Invoke the camera pipeline
-    cam_pipe(host_input, host_result, row_size, col_size);
+    isp_dataflow = args.isp_dataflow;
+    isp_frac_bits = args.isp_frac_bits;
+    raw_format = args.raw_format;
+    raw_bit_depth = args.raw_bit_depth;
+    gamut_map_impl = args.gamut_map_impl;
+    gamut_lut_interp = args.gamut_lut_interp;
+    gamut_lut_size = args.gamut_lut_size;
+    gamut_cache_kb = args.gamut_cache_kb;
+    isp_resize = resize;
+    isp_fuse_color = args.isp_fuse_color;
+    isp_collect_stats = args.isp_stats;
+    isp_denoise_size = args.isp_denoise_size;
+    if (args.isp_config) {
+        configure_isp_from_file(args.isp_config, &isp_graph);
+        print_isp_graph(&isp_graph);
+        if (gamut_map_impl != GamutMapExact &&
+            isp_dataflow == IspFrameDataflow) {
+            fprintf(stderr,
+                    "[ERROR]: Only the exact gamut map is supported by the "
+                    "frame ISP dataflow.\n");
+            exit(1);
+        }
+        if (find_isp_graph_impl(&isp_graph, IspImplSimd) >= 0 &&
+            isp_dataflow == IspFrameDataflow) {
+            fprintf(stderr,
+                    "[ERROR]: The frame ISP dataflow only runs the scalar "
+                    "demosaic and denoise.\n");
+            exit(1);
+        }
+        if (isp_denoise_size != 3 && isp_dataflow != IspStreamingDataflow) {
+            fprintf(stderr,
+                    "[ERROR]: Only the streaming ISP dataflow has denoise "
+                    "windows larger than 3x3.\n");
+            exit(1);
+        }
+        if (isp_dataflow == IspStreamingDataflow &&
+            check_isp_graph_order(&isp_graph)) {
+            fprintf(stderr,
+                    "[ERROR]: The streaming ISP dataflow only runs the ISP "
+                    "stages in their default order.\n");
+            exit(1);
+        }
+        if (resize.method != ResizeNone &&
+            find_isp_graph_stage(&isp_graph, IspStageResize) < 0) {
+            fprintf(stderr,
+                    "[ERROR]: --isp-resize and --isp-crop require a RESIZE "
+                    "stage in the ISP configuration.\n");
+            exit(1);
+        }
+    }
+    init_thread_pool(args.num_threads);
+    init_profiling_log();
+    isp_context_t* isp = isp_context_create(row_size, col_size);
+    if (isp->gamut_lut)
+        print_gamut_lut_error(isp->gamut_lut);
+    if (dnn_input) {
+        isp_process_frame_dnn(isp, host_input, host_result,
+                              (uint16_t*)dnn_input->d, dnn_input_dims.align_pad);
+        // There is only one image, so every test case gets a copy of it.
+        size_t image_size = get_dims_size(&dnn_input_dims) * sizeof(float16);
+        for (int i = 1; i < NUM_TEST_CASES; i++) {
+            memcpy((char*)dnn_input->d + i * image_size, dnn_input->d,
+                   image_size);
+        }
+    } else {
+        isp_process_frame(isp, host_input, host_result);
+    }
+    isp_context_print_stage_times(isp);
+    if (args.isp_stats) {
+        print_isp_stats(isp_context_get_stats(isp));
+        printf("Suggested white balance preset: %d (using %d)\n",
+               isp_context_pick_wb_index(isp), isp->wb_index);
+    }
+    isp_context_destroy(isp);
+    destroy_thread_pool();
+    row_size = out_row_size;
+    col_size = out_col_size;
 
     // Transform the output image back to HWC format.
     convert_chw_to_hwc(host_result, row_size, col_size, &host_result_nwc);
@@ -318,27 +798,16 @@ int main(int argc, char* argv[]) {
     // the "vision" part of the camera vision pipeline.
     //////////////////////////////////////////////////////////////////////////
 
-    NUM_TEST_CASES = args.num_inputs;
-    NUM_WORKER_THREADS = args.num_threads;
-    SIGMOID_IMPL = args.sigmoid_impl;
-
-    network_t network;
-    device_t* device;
-    sampling_param_t* sampling_param;
-    network.depth = configure_network_from_file(args.args[NETWORK_CONFIG],
-                                                &network.layers,
-                                                &device,
-                                                &sampling_param);
-
     // Sanity check on the dimensionality of the input layer. It should match
     // the image generated from the camera pipeline.
-    if (network.layers[0].inputs.height == 1) {
+    bool grayscale_input = network.layers[0].inputs.height == 1;
+    if (grayscale_input) {
         printf("The DNN model requiers a grayscale input image. Converting "
                "the RGB image into grayscale.\n");
-        convert_image_to_grayscale(host_result, row_size, col_size);
-    } else if (row_size != network.layers[0].inputs.rows ||
-               col_size != network.layers[0].inputs.cols ||
-               CHAN_SIZE != network.layers[0].inputs.height) {
+    }
+    if (row_size != network.layers[0].inputs.rows ||
+        col_size != network.layers[0].inputs.cols ||
+        (!grayscale_input && CHAN_SIZE != network.layers[0].inputs.height)) {
         fprintf(stderr,
                 "Input layer shape: %d x %d x %d. Does not match the image "
                 "from the camera pipeline! Image shape: %d x %d x %d\n",
@@ -380,38 +849,58 @@ int main(int argc, char* argv[]) {
         model_file = read_all_except_input_from_file(
                 args.args[DATA_FILE], &network, &global_weights->data[0].dense,
                 &labels, &compress_type);
-        inputs->data[0].dense = init_farray(
-                NUM_TEST_CASES * get_dims_size(&input_layer.inputs), true);
-        init_data_from_image(inputs->data[0].dense->d,
-                             &network,
-                             NUM_TEST_CASES,
-                             host_result);
     } else {
         global_weights->data[0].dense = init_farray(total_weight_size, false);
-        inputs->data[0].dense = init_farray(
-                NUM_TEST_CASES * get_dims_size(&input_layer.inputs), true);
         init_weights(global_weights->data[0].dense->d, network.layers,
                      network.depth, args.data_mode, TRANSPOSE_WEIGHTS);
         //init_data(inputs->data[0].dense->d, &network, NUM_TEST_CASES,
         //          args.data_mode);
-        init_data_from_image(inputs->data[0].dense->d,
-                             &network,
-                             NUM_TEST_CASES,
-                             host_result);
         init_labels(labels.d, NUM_TEST_CASES, args.data_mode);
     }
-    inputs->type[0] = Uncompressed;
+    if (dnn_input) {
+        // The camera pipeline already wrote the input of the first
+        // convolution.
+        inputs->data[0].dense_hp = dnn_input;
+        inputs->type[0] = UncompressedHalfPrecision;
+        network.layers[1].host_inputs_nhwc = true;
+    } else {
+        inputs->data[0].dense = init_farray(
+                NUM_TEST_CASES * get_dims_size(&input_layer.inputs), true);
+        if (grayscale_input) {
+            // Write the gray image straight into the single-channel input,
+            // and give every test case a copy of it.
+            gray_lut_t gray_lut;
+            init_gray_lut(&gray_lut);
+            write_gray_dnn_input(host_result, row_size, col_size,
+                                 input_layer.inputs.align_pad, &gray_lut,
+                                 inputs->data[0].dense->d);
+            size_t image_size = get_dims_size(&input_layer.inputs);
+            for (int i = 1; i < NUM_TEST_CASES; i++) {
+                memcpy(inputs->data[0].dense->d + i * image_size,
+                       inputs->data[0].dense->d, image_size * sizeof(float));
+            }
+        } else {
+            init_data_from_image(inputs->data[0].dense->d,
+                                 &network,
+                                 NUM_TEST_CASES,
+                                 host_result);
+        }
+        inputs->type[0] = Uncompressed;
+    }
     global_weights->type[0] = Uncompressed;
 
     init_sigmoid_table(&sigmoid_table);
     init_exp_table(&exp_table);
+    fold_batch_norm_layers(
+            &network, &global_weights->data[0].dense, &compress_type);
     process_compressed_weights(
             &network, global_weights->data[0].dense, &compress_type);
+    transform_winograd_weights(&network);
+    init_nnet_fwd(inputs, outputs, &network, device);
     fflush(stdout);
 
     // Run a forward pass through the neural net
     printf("Running forward pass\n");
-    init_profiling_log();
     nnet_fwd(inputs, global_weights, outputs, &network, device, sampling_param);
     dump_profiling_log();
     close_profiling_log();
@@ -433,6 +922,7 @@ int main(int argc, char* argv[]) {
            error_fraction);
 
     // Free up the allocated memories.
+    free_nnet_fwd(&network, device);
     if (sigmoid_table)
         free(sigmoid_table);
     if (exp_table)
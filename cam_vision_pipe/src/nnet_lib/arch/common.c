@@ -1,6 +1,9 @@
 #include "nnet_fwd.h"
 #include "arch/common.h"
 #include "arch/interface.h"
+#include "core/ref/convolution.h"
+#include "core/ref/winograd.h"
+#include "utility/activation_arena.h"
 #include "utility/utility.h"
 
 // Common dispatch function for executing a layer.
@@ -110,3 +113,58 @@ result_buf layer_dispatcher(data_list* activations,
 
     return result_loc;
 }
+
+// Returns true if layer @lnum and the pooling layer after it can run as one
+// fused layer, which applies the activation function and the pooling to each
+// convolution output while it is still in cache.
+//
+// Layer lnum must be a standard convolution whose activation function works
+// on each element on its own, and the next layer must be a max or average
+// pooling layer with no activation function of its own. The pooling window
+// and the convolution outputs must fit the bounds in core/ref/convolution.h.
+bool can_fuse_conv_act_pool(layer_t* layers, int lnum, int num_layers) {
+    if (lnum + 1 >= num_layers)
+        return false;
+    layer_t* conv_layer = &layers[lnum];
+    layer_t* pool_layer = &layers[lnum + 1];
+    if (conv_layer->type != CONV_STANDARD || pool_layer->type != POOLING)
+        return false;
+    // A Winograd convolution needs fewer multiplies than the fused one does.
+    if (conv_layer->winograd_tile)
+        return false;
+    if (pool_layer->pool != MAX && pool_layer->pool != AVG)
+        return false;
+    if (pool_layer->activation != NO_ACTIVATION ||
+        pool_layer->input_preprocessing != NO_PREPROCESSING)
+        return false;
+    // The fused kernel buffers a window of convolution rows on the stack.
+    if (pool_layer->weights.cols > MAX_FUSED_POOL_SIZE ||
+        conv_layer->outputs.cols > MAX_FUSED_CONV_COLS)
+        return false;
+    // Softmax normalizes over all the outputs of an image.
+    return conv_layer->activation != SOFTMAX;
+}
+
+// Returns the bytes of activation arena scratch that the reference backends
+// use to run layer @lnum, which is the zeropadded copy of the inputs of a
+// padded standard or depthwise convolution.
+size_t zeropad_scratch_size(layer_t* layers, int lnum, device_t* device) {
+    layer_t* curr_layer = &layers[lnum];
+    if ((curr_layer->type != CONV_STANDARD &&
+         curr_layer->type != CONV_DEPTHWISE) ||
+        !has_padding(&curr_layer->pad))
+        return 0;
+    return arena_fp32_bytes(NUM_TEST_CASES *
+                            get_dims_size(&curr_layer->inputs));
+}
+
+// Returns the bytes of activation arena scratch that the MONOLITHIC and
+// COMPOSABLE backends use to run layer @lnum: its zeropadded inputs, and the
+// transformed input tiles of a Winograd convolution.
+size_t ref_layer_scratch_size(layer_t* layers, int lnum, device_t* device) {
+    layer_t* curr_layer = &layers[lnum];
+    size_t scratch = zeropad_scratch_size(layers, lnum, device);
+    if (curr_layer->type == CONV_STANDARD && curr_layer->winograd_tile)
+        scratch += arena_fp32_bytes(get_winograd_scratch_size(curr_layer));
+    return scratch;
+}
@@ -29,4 +29,10 @@ result_buf layer_dispatcher(data_list* activations,
                             data_list* result,
                             device_t* device,
                             sampling_param_t* sampling_param);
+
+bool can_fuse_conv_act_pool(layer_t* layers, int lnum, int num_layers);
+
+size_t zeropad_scratch_size(layer_t* layers, int lnum, device_t* device);
+
+size_t ref_layer_scratch_size(layer_t* layers, int lnum, device_t* device);
 #endif
@@ -6,7 +6,9 @@
 #include "core/ref/convolution.h"
 #include "core/ref/matrix_multiply.h"
 #include "core/ref/pooling.h"
+#include "core/ref/winograd.h"
 #include "core/ref/zeropad.h"
+#include "utility/activation_arena.h"
 #include "utility/data_layout_conversion.h"
 #include "utility/utility.h"
 #include "arch/common.h"
@@ -24,6 +26,9 @@ unsigned kActivationFuncHw = 0x0003;
 unsigned kInnerProductHw = 0x0004;
 unsigned kBatchNormHw = 0x0005;
 
+// The activation arena of the network, planned by init_nnet_fwd().
+static activation_arena_t* g_composable_arena = NULL;
+
 // This is an architecture that divides each layer type into a separate
 // hardware block. This is represented by ensuring that each layer is
 // responsible for loading its own input activations and weights. For clarity,
@@ -77,14 +82,22 @@ result_buf inner_product_layer(data_list* activations,
     return results;
 }
 
+// @scratch is only used by a Winograd convolution, and holds the transformed
+// inputs of a tile.
 void standard_convolution_layer_hw(float* activations,
                                    float* weights,
+                                   float* scratch,
                                    layer_t* layers,
                                    int lnum,
                                    float* results) {
     layer_t curr_layer = layers[lnum];
     grab_input_activations_dma(activations, activations, &layers[lnum]);
-    convolution3d_no_padding(activations, weights, curr_layer, results);
+    if (curr_layer.winograd_tile) {
+        winograd_convolution3d_no_padding(
+                activations, weights, curr_layer, scratch, results);
+    } else {
+        convolution3d_no_padding(activations, weights, curr_layer, results);
+    }
     store_output_activations_dma(results, results, &layers[lnum]);
 }
 
@@ -110,6 +123,21 @@ void pointwise_convolution_layer_hw(float* activations,
     store_output_activations_dma(results, results, &layers[lnum]);
 }
 
+// The convolution block can also apply the activation function and pool its
+// outputs before storing them, so that only the pooled outputs are stored.
+void standard_convolution_pooling_layer_hw(float* activations,
+                                           float* weights,
+                                           layer_t* layers,
+                                           int lnum,
+                                           float* results) {
+    layer_t conv_layer = layers[lnum];
+    layer_t pool_layer = layers[lnum + 1];
+    grab_input_activations_dma(activations, activations, &layers[lnum]);
+    convolution3d_act_pool_no_padding(
+            activations, weights, conv_layer, pool_layer, results);
+    store_output_activations_dma(results, results, &layers[lnum + 1]);
+}
+
 result_buf standard_convolution_layer(data_list* activations,
                                       data_list* weights,
                                       layer_t* layers,
@@ -118,29 +146,89 @@ result_buf standard_convolution_layer(data_list* activations,
                                       device_t* device,
                                       sampling_param_t* sampling_param) {
     layer_t curr_layer = layers[lnum];
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
     if (has_padding(&curr_layer.pad)) {
-        results = create_new_data_list_if_necessary(
-                results,
-                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs),
-                Uncompressed);
-        copy_zeropad(activations->data[0].dense->d, layers, lnum,
-                     results->data[0].dense->d);
-        SWAP_PTRS(results, activations);
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
     }
 
     results = create_new_data_list_if_necessary(
             results,
             NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
             Uncompressed);
-    float* act_buf = activations->data[0].dense->d;
+    float* act_buf = conv_inputs;
     float* wgt_buf = weights->data[0].dense->d;
     float* out_buf = results->data[0].dense->d;
+    size_t wgt_bytes = WEIGHT_BYTES(layers, lnum);
+    farray_t* transformed = NULL;
+    float* scratch_buf = NULL;
+    if (curr_layer.winograd_tile) {
+        // Only the transformed filters are sent to the convolution block.
+        wgt_buf = weights->data[1].dense->d;
+        wgt_bytes = get_num_winograd_weights(
+                            &curr_layer, curr_layer.winograd_tile) *
+                    sizeof(float);
+        transformed = arena_init_farray(
+                get_winograd_scratch_size(&curr_layer), false);
+        scratch_buf = transformed->d;
+        MAP_ARRAY(kConvolutionHw, scratch_buf,
+                  transformed->size * sizeof(float));
+    }
     MAP_ARRAY(kConvolutionHw, act_buf, INPUT_BYTES(layers, lnum));
-    MAP_ARRAY(kConvolutionHw, wgt_buf, WEIGHT_BYTES(layers, lnum));
+    MAP_ARRAY(kConvolutionHw, wgt_buf, wgt_bytes);
     MAP_ARRAY(kConvolutionHw, out_buf, OUTPUT_BYTES(layers, lnum));
 
     INVOKE_KERNEL(kConvolutionHw, standard_convolution_layer_hw, act_buf,
-                  wgt_buf, layers, lnum, out_buf);
+                  wgt_buf, scratch_buf, layers, lnum, out_buf);
+    if (transformed)
+        free_farray(transformed);
+    if (padded_activations)
+        free_farray(padded_activations);
+    return results;
+}
+
+// Runs the standard convolution @lnum, its activation function, and the
+// pooling layer after it on the convolution block. The result has the
+// dimensions of the outputs of the pooling layer.
+result_buf standard_convolution_pooling_layer(data_list* activations,
+                                              data_list* weights,
+                                              layer_t* layers,
+                                              int lnum,
+                                              data_list* results,
+                                              device_t* device,
+                                              sampling_param_t* sampling_param) {
+    layer_t curr_layer = layers[lnum];
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
+    if (has_padding(&curr_layer.pad)) {
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
+    }
+
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum + 1].outputs),
+            Uncompressed);
+    float* act_buf = conv_inputs;
+    float* wgt_buf = weights->data[0].dense->d;
+    float* out_buf = results->data[0].dense->d;
+    MAP_ARRAY(kConvolutionHw, act_buf, INPUT_BYTES(layers, lnum));
+    MAP_ARRAY(kConvolutionHw, wgt_buf, WEIGHT_BYTES(layers, lnum));
+    MAP_ARRAY(kConvolutionHw, out_buf, OUTPUT_BYTES(layers, lnum + 1));
+
+    INVOKE_KERNEL(kConvolutionHw, standard_convolution_pooling_layer_hw,
+                  act_buf, wgt_buf, layers, lnum, out_buf);
+    if (padded_activations)
+        free_farray(padded_activations);
     return results;
 }
 
@@ -152,21 +240,22 @@ result_buf depthwise_convolution_layer(data_list* activations,
                                        device_t* device,
                                        sampling_param_t* sampling_param) {
     layer_t curr_layer = layers[lnum];
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
     if (has_padding(&curr_layer.pad)) {
-        results = create_new_data_list_if_necessary(
-                results,
-                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs),
-                Uncompressed);
-        copy_zeropad(activations->data[0].dense->d, layers, lnum,
-                     results->data[0].dense->d);
-        SWAP_PTRS(results, activations);
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
     }
 
     results = create_new_data_list_if_necessary(
             results,
             NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
             Uncompressed);
-    float* act_buf = activations->data[0].dense->d;
+    float* act_buf = conv_inputs;
     float* wgt_buf = weights->data[0].dense->d;
     float* out_buf = results->data[0].dense->d;
     MAP_ARRAY(kConvolutionHw, act_buf, INPUT_BYTES(layers, lnum));
@@ -175,6 +264,8 @@ result_buf depthwise_convolution_layer(data_list* activations,
 
     INVOKE_KERNEL(kConvolutionHw, depthwise_convolution_layer_hw, act_buf,
                   wgt_buf, layers, lnum, out_buf);
+    if (padded_activations)
+        free_farray(padded_activations);
     return results;
 }
 
@@ -336,10 +427,28 @@ result_buf run_layer(data_list* activations,
     return result_loc;
 }
 
+// Plans the activation arena that every pass runs in. A convolution that runs
+// fused with the pooling layer after it is planned as part of that layer.
+void init_nnet_fwd(data_list* activations,
+                   data_list* results,
+                   network_t* network,
+                   device_t* device) {
+    g_composable_arena = plan_activation_arena(
+            network, activations, results, Uncompressed, ref_layer_scratch_size,
+            can_fuse_conv_act_pool, device);
+}
+
+void free_nnet_fwd(network_t* network, device_t* device) {
+    free_activation_arena(g_composable_arena);
+    g_composable_arena = NULL;
+}
+
 // Runs the forward pass of a neural network.
 //
 // This version loads weights on a per layer basis, and activations are
-// ping-ponged between two buffers, activations and results.
+// ping-ponged between two buffers, activations and results. Both are backed by
+// the activation arena planned by init_nnet_fwd(), so a pass does not
+// allocate any memory. The result is written to results.
 void nnet_fwd(data_list* activations,
               data_list* weights,
               data_list* results,
@@ -347,33 +456,54 @@ void nnet_fwd(data_list* activations,
               device_t* device,
               sampling_param_t* sampling_param) {
     M5_SWITCH_CPU();
-    layer_t curr_layer;
+    layer_t* layers = network->layers;
+
+    // The pass runs on the two lists of the arena, so the caller's lists are
+    // only touched at the start and the end.
+    data_list* activations_internal = NULL;
+    data_list* results_internal = NULL;
+    arena_begin_pass(g_composable_arena, activations, &activations_internal,
+                     &results_internal);
 
     // Alternate between reading from/writing to activations and results so we
     // can avoid copying matrices. The initial activations is obviously in
     // "activations", so that's where we start.
-    result_buf result_loc = activations;
+    result_buf result_loc = activations_internal;
 
     //******************//
     //   PRIMARY LOOP   //
     //******************//
 
-nnet_fwd_outer:
+    nnet_fwd_outer:
     for (int l = 1; l < network->depth; l++) {
-        curr_layer = network->layers[l];
-
-        if (result_loc == results) {
-            result_loc =
-                    run_layer(results, curr_layer.host_weights, network->layers,
-                              l, activations, device, sampling_param);
+        if (result_loc == results_internal) {
+            SWAP_PTRS(activations_internal, results_internal);
+        }
+        if (can_fuse_conv_act_pool(layers, l, network->depth)) {
+            PRINT_MSG("\nStandard convolution fused with pooling.\n");
+            // The fused layer writes the output of the pooling layer, and was
+            // planned as part of it.
+            arena_begin_layer(l + 1, activations_internal, results_internal);
+            result_loc = standard_convolution_pooling_layer(
+                    activations_internal, layers[l].host_weights, layers, l,
+                    results_internal, device, sampling_param);
+            // The pooling layer has run too.
+            l++;
         } else {
-            result_loc = run_layer(activations, curr_layer.host_weights,
-                                   network->layers, l, results, device,
+            arena_begin_layer(l, activations_internal, results_internal);
+            result_loc = run_layer(activations_internal,
+                                   layers[l].host_weights,
+                                   layers,
+                                   l,
+                                   results_internal,
+                                   device,
                                    sampling_param);
         }
+        arena_end_layer(l, layers, result_loc);
     }
 
-    network->layers[network->depth - 1].result_in_temp = (result_loc == results);
+    arena_end_pass(result_loc, results);
+    network->layers[network->depth - 1].result_in_temp = true;
 }
 
 #endif
@@ -70,6 +70,20 @@ result_buf flatten_input(data_list* activations,
                          int lnum,
                          data_list* result);
 
+// Prepares a network for nnet_fwd(), once, after its weights are loaded.
+//
+// This does all the work that does not depend on the inputs: converting the
+// weights into the layouts the backend uses and planning the memory of a
+// pass. activations must hold inputs of the format and size that every pass
+// will be given, and results gets the buffer the result is written to.
+void init_nnet_fwd(data_list* activations,
+                   data_list* results,
+                   network_t* network,
+                   device_t* device);
+
+// Releases what init_nnet_fwd() set up.
+void free_nnet_fwd(network_t* network, device_t* device);
+
 // Does the forward predictive pass of a neural net.
 //
 // A float array of class predictions in row major format of size
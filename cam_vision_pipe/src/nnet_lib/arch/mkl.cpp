@@ -220,6 +220,15 @@ result_buf run_layer(data_list* activations,
     return result_loc;
 }
 
+// MKL-DNN manages the memory of its primitives itself (see above), and the
+// session is built by each pass, so there is nothing to prepare.
+void init_nnet_fwd(data_list* activations,
+                   data_list* results,
+                   network_t* network,
+                   device_t* device) {}
+
+void free_nnet_fwd(network_t* network, device_t* device) {}
+
 void nnet_fwd(data_list* activations,
               data_list* weights,
               data_list* results,
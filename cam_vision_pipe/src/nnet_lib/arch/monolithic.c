@@ -8,7 +8,9 @@
 #include "core/ref/convolution.h"
 #include "core/ref/matrix_multiply.h"
 #include "core/ref/pooling.h"
+#include "core/ref/winograd.h"
 #include "core/ref/zeropad.h"
+#include "utility/activation_arena.h"
 #include "utility/data_layout_conversion.h"
 #include "utility/utility.h"
 
@@ -20,6 +22,9 @@
 
 unsigned kNnetFwdHw = 0x0001;
 
+// The activation arena of the network, planned by init_nnet_fwd().
+static activation_arena_t* g_monolithic_arena = NULL;
+
 // This is an architecture that runs an entire neural network in a single
 // block, where nnet_fwd is the top level function. nnet_fwd is thus
 // responsible for ensuring that all activations and weights data is available
@@ -74,27 +79,69 @@ result_buf standard_convolution_layer(data_list* activations,
                                       sampling_param_t* sampling_param) {
     require_data_type(activations, 0, Uncompressed);
     require_data_type(kernels, 0, Uncompressed);
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
     if (has_padding(&layers[lnum].pad)) {
-        // TODO: Get rid of all this manual zeropadding!
-        //
-        // @results will contain the zeropadded image. The convolution routine
-        // will then process that buffer and produce its outputs in
-        // @activations.
-        results = create_new_data_list_if_necessary(
-                results,
-                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs),
-                Uncompressed);
-        copy_zeropad(activations->data[0].dense->d, layers, lnum,
-                     results->data[0].dense->d);
-        SWAP_PTRS(results, activations);
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
     }
     results = create_new_data_list_if_necessary(
             results,
             NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
             Uncompressed);
-    convolution3d_no_padding(activations->data[0].dense->d,
-                             kernels->data[0].dense->d, layers[lnum],
-                             results->data[0].dense->d);
+    if (layers[lnum].winograd_tile) {
+        farray_t* transformed = arena_init_farray(
+                get_winograd_scratch_size(&layers[lnum]), false);
+        winograd_convolution3d_no_padding(conv_inputs,
+                                          kernels->data[1].dense->d,
+                                          layers[lnum],
+                                          transformed->d,
+                                          results->data[0].dense->d);
+        free_farray(transformed);
+    } else {
+        convolution3d_no_padding(conv_inputs, kernels->data[0].dense->d,
+                                 layers[lnum], results->data[0].dense->d);
+    }
+    if (padded_activations)
+        free_farray(padded_activations);
+    return results;
+}
+
+// Runs the standard convolution @lnum, its activation function, and the
+// pooling layer after it in a single pass. The result has the dimensions of
+// the outputs of the pooling layer.
+result_buf standard_convolution_pooling_layer(data_list* activations,
+                                              data_list* kernels,
+                                              layer_t* layers,
+                                              int lnum,
+                                              data_list* results,
+                                              device_t* device,
+                                              sampling_param_t* sampling_param) {
+    require_data_type(activations, 0, Uncompressed);
+    require_data_type(kernels, 0, Uncompressed);
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
+    if (has_padding(&layers[lnum].pad)) {
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
+    }
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum + 1].outputs),
+            Uncompressed);
+    convolution3d_act_pool_no_padding(conv_inputs, kernels->data[0].dense->d,
+                                      layers[lnum], layers[lnum + 1],
+                                      results->data[0].dense->d);
+    if (padded_activations)
+        free_farray(padded_activations);
     return results;
 }
 
@@ -107,22 +154,24 @@ result_buf depthwise_convolution_layer(data_list* activations,
                                        sampling_param_t* sampling_param) {
     require_data_type(activations, 0, Uncompressed);
     require_data_type(kernels, 0, Uncompressed);
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
     if (has_padding(&layers[lnum].pad)) {
-        results = create_new_data_list_if_necessary(
-                results,
-                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs),
-                Uncompressed);
-        copy_zeropad(activations->data[0].dense->d, layers, lnum,
-                     results->data[0].dense->d);
-        SWAP_PTRS(results, activations);
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
     }
     results = create_new_data_list_if_necessary(
             results,
             NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
             Uncompressed);
-    convolution2d_depthwise_nopadding(activations->data[0].dense->d,
-                                      kernels->data[0].dense->d, layers[lnum],
-                                      results->data[0].dense->d);
+    convolution2d_depthwise_nopadding(conv_inputs, kernels->data[0].dense->d,
+                                      layers[lnum], results->data[0].dense->d);
+    if (padded_activations)
+        free_farray(padded_activations);
     return results;
 }
 
@@ -230,10 +279,28 @@ result_buf run_layer(data_list* activations,
 }
 
 
+// Plans the activation arena that every pass runs in. A convolution that runs
+// fused with the pooling layer after it is planned as part of that layer.
+void init_nnet_fwd(data_list* activations,
+                   data_list* results,
+                   network_t* network,
+                   device_t* device) {
+    g_monolithic_arena = plan_activation_arena(
+            network, activations, results, Uncompressed, ref_layer_scratch_size,
+            can_fuse_conv_act_pool, device);
+}
+
+void free_nnet_fwd(network_t* network, device_t* device) {
+    free_activation_arena(g_monolithic_arena);
+    g_monolithic_arena = NULL;
+}
+
 // Runs the forward pass of a neural network.
 //
 // This version loads weights on a per layer basis, and activations are
-// ping-ponged between two buffers, activations and results.
+// ping-ponged between two buffers, activations and results. Both are backed by
+// the activation arena planned by init_nnet_fwd(), so a pass does not
+// allocate any memory. The result is written to results.
 void nnet_fwd(data_list* activations,
               data_list* weights,
               data_list* results,
@@ -241,12 +308,19 @@ void nnet_fwd(data_list* activations,
               device_t* device,
               sampling_param_t* sampling_param) {
     M5_SWITCH_CPU();
-    layer_t curr_layer;
+    layer_t* layers = network->layers;
+
+    // The pass runs on the two lists of the arena, so the caller's lists are
+    // only touched at the start and the end.
+    data_list* activations_internal = NULL;
+    data_list* results_internal = NULL;
+    arena_begin_pass(g_monolithic_arena, activations, &activations_internal,
+                     &results_internal);
 
     // Alternate between reading from/writing to activations and results so we
     // can avoid copying matrices. The initial activations is obviously in
     // "activations", so that's where we start.
-    result_buf result_loc = activations;
+    result_buf result_loc = activations_internal;
 
     // FORMAT HERE IS H TIMES W, NOT W TIMES H!!!!!
     // SO EACH DATA POINT IS A ***ROW****
@@ -257,29 +331,34 @@ void nnet_fwd(data_list* activations,
 
     nnet_fwd_outer:
     for (int l = 1; l < network->depth; l++) {
-        curr_layer = network->layers[l];
-
-        if (result_loc == results) {
-            result_loc = run_layer(results,
-                                   curr_layer.host_weights,
-                                   network->layers,
-                                   l,
-                                   activations,
-                                   device,
-                                   sampling_param);
+        if (result_loc == results_internal) {
+            SWAP_PTRS(activations_internal, results_internal);
+        }
+        if (can_fuse_conv_act_pool(layers, l, network->depth)) {
+            PRINT_MSG("\nStandard convolution fused with pooling.\n");
+            // The fused layer writes the output of the pooling layer, and was
+            // planned as part of it.
+            arena_begin_layer(l + 1, activations_internal, results_internal);
+            result_loc = standard_convolution_pooling_layer(
+                    activations_internal, layers[l].host_weights, layers, l,
+                    results_internal, device, sampling_param);
+            // The pooling layer has run too.
+            l++;
         } else {
-            result_loc = run_layer(activations,
-                                   curr_layer.host_weights,
-                                   network->layers,
+            arena_begin_layer(l, activations_internal, results_internal);
+            result_loc = run_layer(activations_internal,
+                                   layers[l].host_weights,
+                                   layers,
                                    l,
-                                   results,
+                                   results_internal,
                                    device,
                                    sampling_param);
         }
+        arena_end_layer(l, layers, result_loc);
     }
 
-    network->layers[network->depth - 1].result_in_temp =
-            (result_loc == results);
+    arena_end_pass(result_loc, results);
+    network->layers[network->depth - 1].result_in_temp = true;
 }
 
 #endif
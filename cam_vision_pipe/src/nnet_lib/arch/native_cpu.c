@@ -0,0 +1,343 @@
+#include <assert.h>
+
+#include "nnet_fwd.h"
+#include "arch/common.h"
+#include "arch/interface.h"
+#include "core/ref/activation_functions.h"
+#include "core/native_cpu/convolution.h"
+#include "core/native_cpu/gemm.h"
+#include "core/native_cpu/matrix_multiply.h"
+#include "core/native_cpu/winograd.h"
+#include "core/ref/batch_norm.h"
+#include "core/ref/pooling.h"
+#include "core/ref/zeropad.h"
+#include "utility/activation_arena.h"
+#include "utility/data_layout_conversion.h"
+#include "utility/utility.h"
+
+#ifdef DMA_MODE
+#include "gem5_harness.h"
+#endif
+
+#if ARCHITECTURE == NATIVE_CPU
+
+// This is an architecture for running the network natively on the host CPU,
+// as fast as it can without an external library like Eigen or MKL-DNN.
+//
+// FC layers and pointwise and standard convolutions are all matrix
+// multiplications, and they run on the blocked GEMM in core/native_cpu.
+// Standard convolutions feed it the implicit im2col expansion of their
+// inputs. The other layers are memory bound, and use the reference
+// implementations, except for depthwise convolutions, which are vectorized
+// along rows instead.
+//
+// Convolutions are not fused with the pooling layers after them: the fused
+// kernel in core/ref computes one output at a time and cannot use the GEMM,
+// so it is slower than running the two layers separately.
+
+// The activation arena of the network, planned by init_nnet_fwd().
+static activation_arena_t* g_native_cpu_arena = NULL;
+
+result_buf flatten_input(data_list* activations,
+                         layer_t* layers,
+                         int lnum,
+                         data_list* results) {
+    require_data_type(activations, 0, Uncompressed);
+    return im2row(activations, layers, lnum, results);
+}
+
+result_buf inner_product_layer(data_list* activations,
+                               data_list* weights,
+                               layer_t* layers,
+                               int lnum,
+                               data_list* results,
+                               device_t* device,
+                               sampling_param_t* sampling_param) {
+    require_data_type(activations, 0, Uncompressed);
+    require_data_type(weights, 0, Uncompressed);
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
+            Uncompressed);
+    // These kernels fuse the bias with the GEMM and assume that the rows
+    // parameter includes the extra row of biases.
+#if TRANSPOSE_WEIGHTS == 0
+    cpu_matrix_multiply_with_bias(
+            activations->data[0].dense->d, weights->data[0].dense->d,
+            NUM_TEST_CASES, layers[lnum].weights.rows + 1,
+            layers[lnum].weights.cols + layers[lnum].weights.align_pad,
+            results->data[0].dense->d);
+#else
+    cpu_matrix_multiply_with_bias_transpose(
+            activations->data[0].dense->d, weights->data[0].dense->d,
+            NUM_TEST_CASES, layers[lnum].weights.rows + 1,
+            layers[lnum].weights.cols + layers[lnum].weights.align_pad,
+            results->data[0].dense->d);
+#endif
+    return results;
+}
+
+result_buf standard_convolution_layer(data_list* activations,
+                                      data_list* kernels,
+                                      layer_t* layers,
+                                      int lnum,
+                                      data_list* results,
+                                      device_t* device,
+                                      sampling_param_t* sampling_param) {
+    require_data_type(activations, 0, Uncompressed);
+    require_data_type(kernels, 0, Uncompressed);
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
+    if (has_padding(&layers[lnum].pad)) {
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
+    }
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
+            Uncompressed);
+    if (layers[lnum].winograd_tile) {
+        cpu_winograd_convolution3d_no_padding(conv_inputs,
+                                              kernels->data[1].dense->d,
+                                              layers[lnum],
+                                              results->data[0].dense->d);
+    } else {
+        cpu_convolution3d_no_padding(conv_inputs, kernels->data[0].dense->d,
+                                     layers[lnum], results->data[0].dense->d);
+    }
+    if (padded_activations)
+        free_farray(padded_activations);
+    return results;
+}
+
+result_buf depthwise_convolution_layer(data_list* activations,
+                                       data_list* kernels,
+                                       layer_t* layers,
+                                       int lnum,
+                                       data_list* results,
+                                       device_t* device,
+                                       sampling_param_t* sampling_param) {
+    require_data_type(activations, 0, Uncompressed);
+    require_data_type(kernels, 0, Uncompressed);
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = activations->data[0].dense->d;
+    if (has_padding(&layers[lnum].pad)) {
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs), false);
+        copy_zeropad(conv_inputs, layers, lnum, padded_activations->d);
+        conv_inputs = padded_activations->d;
+    }
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
+            Uncompressed);
+    cpu_convolution2d_depthwise_nopadding(conv_inputs,
+                                          kernels->data[0].dense->d,
+                                          layers[lnum],
+                                          results->data[0].dense->d);
+    if (padded_activations)
+        free_farray(padded_activations);
+    return results;
+}
+
+result_buf pointwise_convolution_layer(data_list* activations,
+                                       data_list* kernels,
+                                       layer_t* layers,
+                                       int lnum,
+                                       data_list* results,
+                                       device_t* device,
+                                       sampling_param_t* sampling_param) {
+    require_data_type(activations, 0, Uncompressed);
+    require_data_type(kernels, 0, Uncompressed);
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
+            Uncompressed);
+    cpu_convolution3d_pointwise_nopadding(activations->data[0].dense->d,
+                                          kernels->data[0].dense->d,
+                                          layers[lnum],
+                                          results->data[0].dense->d);
+    return results;
+}
+
+result_buf pooling_layer(data_list* activations,
+                         layer_t* layers,
+                         int lnum,
+                         data_list* results,
+                         device_t* device,
+                         sampling_param_t* sampling_param) {
+    require_data_type(activations, 0, Uncompressed);
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
+            Uncompressed);
+    layer_t curr_layer = layers[lnum];
+    if (curr_layer.pool == MAX) {
+        max_pooling(activations->data[0].dense->d, results->data[0].dense->d,
+                    curr_layer);
+    } else if (curr_layer.pool == AVG) {
+        avg_pooling(activations->data[0].dense->d, results->data[0].dense->d,
+                    curr_layer);
+    } else {
+        assert(false && "Unsupported pooling layer type!");
+    }
+    return results;
+}
+
+result_buf batch_norm_layer(data_list* activations,
+                            data_list* weights,
+                            layer_t* layers,
+                            int lnum,
+                            data_list* results,
+                            device_t* device,
+                            sampling_param_t* sampling_param) {
+    require_data_type(activations, 0, Uncompressed);
+    require_data_type(weights, 0, Uncompressed);
+    results = create_new_data_list_if_necessary(
+            results,
+            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
+            Uncompressed);
+    batch_norm_fxp(activations->data[0].dense->d, weights->data[0].dense->d,
+                   &layers[lnum], NUM_TEST_CASES, results->data[0].dense->d);
+    return results;
+}
+
+result_buf activation_sublayer(data_list* activations,
+                               layer_t* layers,
+                               int lnum) {
+    require_data_type(activations, 0, Uncompressed);
+    int input_size = get_dims_size(&layers[lnum].outputs);
+    activation_fun(activations->data[0].dense->d, NUM_TEST_CASES, input_size,
+                   layers[lnum].outputs.align_pad, layers[lnum].activation);
+    return activations;
+}
+
+result_buf run_layer(data_list* activations,
+                     data_list* weights,
+                     layer_t* layers,
+                     int layer_num,
+                     data_list* results,
+                     device_t* device,
+                     sampling_param_t* sampling_param) {
+    layer_t curr_layer = layers[layer_num];
+    result_buf result_loc = layer_dispatcher(activations,
+                                             weights,
+                                             layers,
+                                             layer_num,
+                                             results,
+                                             device,
+                                             sampling_param);
+
+    if (curr_layer.activation != NO_ACTIVATION) {
+        PRINT_MSG("\nactivation function\n");
+        // Pass through activation function
+        if (result_loc == activations) {
+            activation_sublayer(activations, layers, layer_num);
+        } else {
+            activation_sublayer(results, layers, layer_num);
+        }
+
+        PRINT_DEBUG4D(result_loc->data[0].dense->d, curr_layer.outputs.rows,
+                      curr_layer.outputs.cols + curr_layer.outputs.align_pad,
+                      curr_layer.outputs.height);
+    }
+    return result_loc;
+}
+
+
+// Returns the bytes of activation arena scratch that layer lnum uses: its
+// zeropadded inputs, and the scratch of the GEMM kernels it runs on.
+static size_t native_cpu_layer_scratch_size(layer_t* layers,
+                                            int lnum,
+                                            device_t* device) {
+    layer_t* curr_layer = &layers[lnum];
+    size_t scratch = zeropad_scratch_size(layers, lnum, device);
+    if (curr_layer->type == CONV_STANDARD) {
+        if (curr_layer->winograd_tile)
+            scratch += cpu_winograd_scratch_size(curr_layer);
+        else
+            scratch += cpu_convolution3d_scratch_size(curr_layer);
+    } else if (curr_layer->type == CONV_POINTWISE) {
+        scratch += cpu_convolution3d_pointwise_scratch_size(curr_layer);
+    } else if (curr_layer->type == FC) {
+        scratch += cpu_gemm_scratch_size();
+    }
+    return scratch;
+}
+
+// Plans the activation arena that every pass runs in.
+void init_nnet_fwd(data_list* activations,
+                   data_list* results,
+                   network_t* network,
+                   device_t* device) {
+    g_native_cpu_arena = plan_activation_arena(
+            network, activations, results, Uncompressed,
+            native_cpu_layer_scratch_size, NULL, device);
+}
+
+void free_nnet_fwd(network_t* network, device_t* device) {
+    free_activation_arena(g_native_cpu_arena);
+    g_native_cpu_arena = NULL;
+}
+
+// Runs the forward pass of a neural network.
+//
+// This version loads weights on a per layer basis, and activations are
+// ping-ponged between two buffers, activations and results. Both are backed by
+// the activation arena planned by init_nnet_fwd(), so a pass does not
+// allocate any memory. The result is written to results.
+void nnet_fwd(data_list* activations,
+              data_list* weights,
+              data_list* results,
+              network_t* network,
+              device_t* device,
+              sampling_param_t* sampling_param) {
+    M5_SWITCH_CPU();
+    layer_t* layers = network->layers;
+
+    // The pass runs on the two lists of the arena, so the caller's lists are
+    // only touched at the start and the end.
+    data_list* activations_internal = NULL;
+    data_list* results_internal = NULL;
+    arena_begin_pass(g_native_cpu_arena, activations, &activations_internal,
+                     &results_internal);
+
+    // Alternate between reading from/writing to activations and results so we
+    // can avoid copying matrices. The initial activations is obviously in
+    // "activations", so that's where we start.
+    result_buf result_loc = activations_internal;
+
+    // FORMAT HERE IS H TIMES W, NOT W TIMES H!!!!!
+    // SO EACH DATA POINT IS A ***ROW****
+
+    //******************//
+    //   PRIMARY LOOP   //
+    //******************//
+
+    nnet_fwd_outer:
+    for (int l = 1; l < network->depth; l++) {
+        if (result_loc == results_internal) {
+            SWAP_PTRS(activations_internal, results_internal);
+        }
+        arena_begin_layer(l, activations_internal, results_internal);
+        result_loc = run_layer(activations_internal,
+                               layers[l].host_weights,
+                               layers,
+                               l,
+                               results_internal,
+                               device,
+                               sampling_param);
+        arena_end_layer(l, layers, result_loc);
+    }
+
+    arena_end_pass(result_loc, results);
+    network->layers[network->depth - 1].result_in_temp = true;
+}
+
+#endif
@@ -509,6 +509,29 @@ void set_io_requirements(network_t* network,
     }
 }
 
+// SMIV does not use an activation arena: its layers still allocate their own
+// buffers, so this only sets up the accelerator.
+void init_nnet_fwd(data_list* activations,
+                   data_list* results,
+                   network_t* network,
+                   device_t* device) {
+    init_smiv_global(device);
+
+#ifdef USE_MKLDNN
+    nnet_mkl::MklSession* session = new nnet_mkl::MklSession();
+    device->session = (void*)session;
+#endif
+    set_io_requirements(network, device, &g_smiv);
+}
+
+void free_nnet_fwd(network_t* network, device_t* device) {
+#ifdef USE_MKLDNN
+    delete (nnet_mkl::MklSession*)device->session;
+    device->session = NULL;
+#endif
+    free_smiv_global();
+}
+
 // Runs the forward pass of a neural network.
 //
 // This version loads weights on a per layer basis, and activations are
@@ -519,16 +542,8 @@ void nnet_fwd(data_list* activations,
               network_t* network,
               device_t* device,
               sampling_param_t* sampling_param) {
-    init_smiv_global(device);
-
     M5_SWITCH_CPU();
 
-#ifdef USE_MKLDNN
-    nnet_mkl::MklSession* session = new nnet_mkl::MklSession();
-    device->session = (void*)session;
-#endif
-    set_io_requirements(network, device, &g_smiv);
-
     //******************//
     //   PRIMARY LOOP   //
     //******************//
@@ -556,8 +571,6 @@ void nnet_fwd(data_list* activations,
 
     results = copy_data_list(results, result_loc);
     network->layers[network->depth - 1].result_in_temp = true;
-
-    free_smiv_global();
 }
 
 #endif
@@ -11,6 +11,7 @@
 #include "core/ref/zeropad.h"
 #include "core/smv/smv.h"
 #include "core/smv/params.h"
+#include "utility/activation_arena.h"
 #include "utility/compression.h"
 #include "utility/data_layout_conversion.h"
 #include "utility/profiling.h"
@@ -42,6 +43,8 @@
 #if ARCHITECTURE == SMV
 
 smv_global g_smv;
+// The activation arena of the network, planned by init_nnet_fwd().
+static activation_arena_t* g_smv_arena = NULL;
 
 void init_smv_global(device_t* device) {
     // Use the same accelerator id for all hardware blocks. This means we will
@@ -180,8 +183,8 @@ result_buf depthwise_convolution_layer(data_list* activations,
     farray_t* fp32_results = NULL;
     if (activations->type[0] == UncompressedHalfPrecision) {
         fp32_activations =
-                unpack_data_fp16x4(activations->data[0].dense_hp, NULL);
-        fp32_results = init_farray(
+                arena_unpack_data_fp16x4(activations->data[0].dense_hp);
+        fp32_results = arena_init_farray(
                 NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs), false);
     } else {
         fp32_activations = activations->data[0].dense;
@@ -189,19 +192,21 @@ result_buf depthwise_convolution_layer(data_list* activations,
     }
     layer_t curr_layer = layers[lnum];
     float* current_layer_weights = weights->data[0].dense->d;
+    // Zeropad into scratch rather than into the results, so the results keep
+    // their planned buffer.
+    farray_t* padded_activations = NULL;
+    float* conv_inputs = fp32_activations->d;
     if (has_padding(&curr_layer.pad)) {
-        results = create_new_data_list_if_necessary(
-                results,
-                NUM_TEST_CASES * get_dims_size(&curr_layer.inputs),
-                Uncompressed);
+        padded_activations = arena_init_farray(
+                NUM_TEST_CASES * get_dims_size(&curr_layer.inputs), false);
         copy_zeropad(
-                fp32_activations->d, layers, lnum, results->data[0].dense->d);
+                fp32_activations->d, layers, lnum, padded_activations->d);
         PRINT_MSG("After zeropadding:\n");
-        PRINT_DEBUG4D(results->data[0].dense->d,
+        PRINT_DEBUG4D(padded_activations->d,
                       curr_layer.inputs.rows,
                       curr_layer.inputs.cols + curr_layer.inputs.align_pad,
                       curr_layer.inputs.height);
-        SWAP_PTRS(results, activations);
+        conv_inputs = padded_activations->d;
     }
     PRINT_DEBUG4D_V(weights->data[0].dense->d, curr_layer.weights.rows,
                     curr_layer.weights.cols + curr_layer.weights.align_pad,
@@ -211,14 +216,12 @@ result_buf depthwise_convolution_layer(data_list* activations,
             NUM_TEST_CASES * get_dims_size(&curr_layer.outputs),
             UncompressedHalfPrecision);
     smiv_depthwise_convolution_layer_impl(
-            activations->data[0].dense->d, current_layer_weights, layers, lnum,
+            conv_inputs, current_layer_weights, layers, lnum,
             fp32_results->d, (smiv_global*)&g_smv, device);
+    if (padded_activations)
+        free_farray(padded_activations);
 
-    // TODO: Ugly - have to free the array container but not the buffer inside
-    // before we call pack_data_fp16!
-    packed_fp16* dest_buf = results->data[0].dense_hp->d;
-    free(results->data[0].dense_hp);
-    results->data[0].dense_hp = pack_data_fp16(fp32_results, dest_buf);
+    pack_data_fp16_into(fp32_results, results->data[0].dense_hp);
     free_farray(fp32_activations);
     free_farray(fp32_results);
     return results;
@@ -237,8 +240,8 @@ result_buf pointwise_convolution_layer(data_list* activations,
     farray_t* fp32_results = NULL;
     if (activations->type[0] == UncompressedHalfPrecision) {
         fp32_activations =
-                unpack_data_fp16x4(activations->data[0].dense_hp, NULL);
-        fp32_results = init_farray(
+                arena_unpack_data_fp16x4(activations->data[0].dense_hp);
+        fp32_results = arena_init_farray(
                 NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs), false);
     } else {
         fp32_activations = activations->data[0].dense;
@@ -246,10 +249,12 @@ result_buf pointwise_convolution_layer(data_list* activations,
     }
 
     // Allocate memory to store the transformed input.
-    float* nhwc_inputs = NULL;
-    dims_t nhwc = convert_nchw_to_nhwc_fp32(fp32_activations->d, NUM_TEST_CASES,
-                                            layers[lnum].inputs, DATA_ALIGNMENT,
-                                            &nhwc_inputs);
+    dims_t nhwc = nchw_to_nhwc_dims(&layers[lnum].inputs, DATA_ALIGNMENT);
+    float* nhwc_inputs = (float*)arena_malloc(
+            NUM_TEST_CASES * get_dims_size(&nhwc) * sizeof(float));
+    convert_nchw_to_nhwc_fp32(fp32_activations->d, NUM_TEST_CASES,
+                              layers[lnum].inputs, DATA_ALIGNMENT,
+                              &nhwc_inputs);
 
     // HACK: We need to modify the layer[lnum] descriptor to reflect the fact
     // that we're doing a matrix multiply, but these changes can't be seen
@@ -268,8 +273,9 @@ result_buf pointwise_convolution_layer(data_list* activations,
     // Allocate new memory to store the results of the FC. The
     // activations/results buffers are not necessarily big enough to store this
     // (due to data alignment).
-    float* nhwc_outputs = (float*)malloc_aligned(
-            get_dims_size(&layers[lnum].outputs) * sizeof(float));
+    float* nhwc_outputs = (float*)arena_malloc(
+            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs) *
+            sizeof(float));
 
     // Finally, invoke the FC hardware.
     smiv_inner_product_layer_impl(nhwc_inputs, weights->data[0].dense->d,
@@ -291,23 +297,19 @@ result_buf pointwise_convolution_layer(data_list* activations,
 
     results = create_new_data_list_if_necessary(
             results,
-            NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
+            NUM_TEST_CASES * get_dims_size(&old_layer.outputs),
             UncompressedHalfPrecision);
     convert_nhwc_to_nchw_fp32(nhwc_outputs, NUM_TEST_CASES, output_dims,
                               DATA_ALIGNMENT, &fp32_results->d);
-    // TODO: Ugly - have to free the array container but not the buffer inside
-    // before we call pack_data_fp16!
-    packed_fp16* dest_buf = results->data[0].dense_hp->d;
-    free(results->data[0].dense_hp);
-    results->data[0].dense_hp = pack_data_fp16(fp32_results, dest_buf);
+    pack_data_fp16_into(fp32_results, results->data[0].dense_hp);
     free_farray(fp32_activations);
     free_farray(fp32_results);
 
     // Restore the original layer descriptor.
     layers[lnum] = old_layer;
 
-    free(nhwc_inputs);
-    free(nhwc_outputs);
+    arena_free(nhwc_inputs);
+    arena_free(nhwc_outputs);
     return results;
 }
 
@@ -330,8 +332,8 @@ result_buf pooling_layer(data_list* activations,
         farray_t* fp32_results = NULL;
         if (activations->type[0] == UncompressedHalfPrecision) {
             fp32_activations =
-                    unpack_data_fp16x4(activations->data[0].dense_hp, NULL);
-            fp32_results = init_farray(
+                    arena_unpack_data_fp16x4(activations->data[0].dense_hp);
+            fp32_results = arena_init_farray(
                     NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
                     false);
         } else {
@@ -361,12 +363,7 @@ result_buf pooling_layer(data_list* activations,
         }
 #endif
         if (activations->type[0] == UncompressedHalfPrecision) {
-            // Ugly - need to free the farray_t* container without freeing the
-            // buffer it wraps.
-            packed_fp16* results_buf = results->data[0].dense_hp->d;
-            free(results->data[0].dense_hp);
-            results->data[0].dense_hp =
-                    pack_data_fp16(fp32_results, results_buf);
+            pack_data_fp16_into(fp32_results, results->data[0].dense_hp);
             free_farray(fp32_activations);
             free_farray(fp32_results);
         }
@@ -391,6 +388,20 @@ result_buf batch_norm_layer(data_list* activations,
 }
 
 
+// Returns true if the activation function of a layer runs on the CPU after
+// the layer, rather than in the accelerator.
+static bool needs_sw_activation_function(layer_t* layer, device_t* device) {
+    // SMV supports the same activation functions as SMIV (for now).
+    activation_type act_func = layer->activation;
+    bool do_activation = act_func != NO_ACTIVATION;
+    bool do_hw_activation = device->use_hw_activation_func &&
+                            smiv_is_supported_activation_func(layer->type,
+                                                              act_func);
+    bool use_pipelined_activation = device->use_pipelined_activation_func;
+    return do_activation && !do_hw_activation &&
+           !(use_pipelined_activation && layer->type == CONV_STANDARD);
+}
+
 result_buf run_layer(data_list* activations,
                      data_list* weights,
                      layer_t* layers,
@@ -414,16 +425,7 @@ result_buf run_layer(data_list* activations,
                                              sampling_param);
     end_profiling();
 
-    // SMV supports the same activation functions as SMIV (for now).
-    activation_type act_func = layers[layer_num].activation;
-    bool do_activation = act_func != NO_ACTIVATION;
-    bool do_hw_activation =
-            device->use_hw_activation_func &&
-            smiv_is_supported_activation_func(layers[layer_num].type, act_func);
-    bool use_pipelined_activation = device->use_pipelined_activation_func;
-    if (do_activation && !do_hw_activation &&
-        !(use_pipelined_activation &&
-          layers[layer_num].type == CONV_STANDARD)) {
+    if (needs_sw_activation_function(&layers[layer_num], device)) {
         if (result_loc == results) {
             SWAP_PTRS(results, activations);
         }
@@ -663,16 +665,72 @@ void early_convert_weights_data_layout(network_t* network, device_t* device) {
     }
 }
 
-// Runs the forward pass of a neural network.
+// Bytes of scratch for the software fallbacks, which unpack their inputs into
+// fp32 and compute an fp32 copy of their outputs.
+static size_t smv_fp32_fallback_scratch_size(layer_t* layers, int lnum) {
+    // The inputs are unpacked whole, eight values at a time.
+    size_t input_elems = max2(calc_layer_output_memory(layers, lnum - 1),
+                              NUM_TEST_CASES * get_dims_size(&layers[lnum].inputs));
+    return arena_fp32_bytes(next_multiple(input_elems, 8)) +
+           arena_fp32_bytes(NUM_TEST_CASES *
+                            get_dims_size(&layers[lnum].outputs));
+}
+
+// Returns the bytes of activation arena scratch that layer lnum allocates.
 //
-// This version loads weights on a per layer basis, and activations are
-// ping-ponged between two buffers, activations and results.
-void nnet_fwd(data_list* activations,
-              data_list* weights,
-              data_list* results,
-              network_t* network,
-              device_t* device,
-              sampling_param_t* sampling_param) {
+// The accelerated layers report their own scratch, and the activation arena
+// measures their tiling descriptors; the software fallbacks are sized here.
+// Every allocation is checked against the plan when the layer runs.
+static size_t smv_layer_scratch_size(layer_t* layers,
+                                     int lnum,
+                                     device_t* device) {
+    layer_t* curr_layer = &layers[lnum];
+    size_t scratch = 0;
+    if (curr_layer->type == CONV_STANDARD) {
+        scratch = smv_standard_convolution_scratch_size(curr_layer, &g_smv);
+    } else if (curr_layer->type == CONV_DEPTHWISE) {
+        scratch = smv_fp32_fallback_scratch_size(layers, lnum);
+        if (has_padding(&curr_layer->pad)) {
+            scratch += arena_fp32_bytes(NUM_TEST_CASES *
+                                        get_dims_size(&curr_layer->inputs));
+        }
+    } else if (curr_layer->type == CONV_POINTWISE) {
+        dims_t nhwc = nchw_to_nhwc_dims(&curr_layer->inputs, DATA_ALIGNMENT);
+        int weights_cols = curr_layer->weights.cols;
+        dims_t fc_outputs = { nhwc.height * nhwc.rows, weights_cols, 1,
+                              calc_padding(weights_cols, DATA_ALIGNMENT) };
+        scratch = smv_fp32_fallback_scratch_size(layers, lnum) +
+                  arena_fp32_bytes(NUM_TEST_CASES * get_dims_size(&nhwc)) +
+                  arena_fp32_bytes(NUM_TEST_CASES * get_dims_size(&fc_outputs));
+    } else if (curr_layer->type == POOLING) {
+        if (device->use_hw_pooling)
+            scratch = smv_pooling_scratch_size(curr_layer, &g_smv);
+        else
+            scratch = smv_fp32_fallback_scratch_size(layers, lnum);
+    } else if (curr_layer->type == BATCH_NORM) {
+        if (device->use_hw_batch_norm)
+            scratch = smv_batch_norm_scratch_size(curr_layer, &g_smv);
+        else
+            scratch = smv_fp32_fallback_scratch_size(layers, lnum);
+    } else if (curr_layer->type == FC) {
+        scratch = smv_inner_product_scratch_size(curr_layer, &g_smv);
+    }
+    // The activation function unpacks the results into fp32 once the layer
+    // has freed its own scratch.
+    if (needs_sw_activation_function(curr_layer, device)) {
+        size_t act_scratch = arena_fp32_bytes(next_multiple(
+                calc_layer_output_memory(layers, lnum), VECTOR_SIZE));
+        scratch = max2(scratch, act_scratch);
+    }
+    return scratch;
+}
+
+// Prepares the network for nnet_fwd(): converts the weights into the layouts
+// SMV uses, and plans the activation arena that every pass runs in.
+void init_nnet_fwd(data_list* activations,
+                   data_list* results,
+                   network_t* network,
+                   device_t* device) {
     init_smv_global(device);
 
 #ifdef USE_MKLDNN
@@ -682,11 +740,47 @@ void nnet_fwd(data_list* activations,
 
     set_io_requirements(network, device, &g_smv);
     early_convert_weights_data_layout(network, device);
-    fp16array_t* fp16_activations =
-            pack_data_fp16(activations->data[0].dense, NULL);
-    free_farray(activations->data[0].dense);
-    activations->data[0].dense_hp = fp16_activations;
-    activations->type[0] = UncompressedHalfPrecision;
+    // The inputs are packed into the arena if they are in fp32. They may
+    // already be in fp16, if the camera pipeline wrote them directly.
+    g_smv_arena = plan_activation_arena(network, activations, results,
+                                        UncompressedHalfPrecision,
+                                        smv_layer_scratch_size, NULL, device);
+    init_thread_pool(NUM_WORKER_THREADS);
+}
+
+void free_nnet_fwd(network_t* network, device_t* device) {
+    free_activation_arena(g_smv_arena);
+    g_smv_arena = NULL;
+
+#ifdef USE_MKLDNN
+    delete (nnet_mkl::MklSession*)device->session;
+    device->session = NULL;
+#endif
+
+    destroy_thread_pool();
+    free_smv_global();
+}
+
+// Runs the forward pass of a neural network.
+//
+// This version loads weights on a per layer basis, and activations are
+// ping-ponged between two buffers, activations and results. Both are backed by
+// the activation arena planned by init_nnet_fwd(), so a pass does not
+// allocate any memory. The result is written to results as fp32.
+void nnet_fwd(data_list* activations,
+              data_list* weights,
+              data_list* results,
+              network_t* network,
+              device_t* device,
+              sampling_param_t* sampling_param) {
+    // We need to ensure that we update the original data_list objects, but
+    // internally a lot of pointer-swapping is done to reduce the number of
+    // memory allocations, so to separate these two worlds, the pass runs on
+    // the two lists of the arena.
+    data_list* activations_internal = NULL;
+    data_list* results_internal = NULL;
+    arena_begin_pass(g_smv_arena, activations, &activations_internal,
+                     &results_internal);
 
     // At this point we're done preprocessing all the data and about to start
     // running the network layers, so stop fast forwarding and switch to the
@@ -697,51 +791,30 @@ void nnet_fwd(data_list* activations,
     if (other_status == 0) {
         M5_QUIESCE();
     }
-    init_thread_pool(NUM_WORKER_THREADS);
 
     //******************//
     //   PRIMARY LOOP   //
     //******************//
 
-    // We need to ensure that we update the original data_list objects, but
-    // internally a lot of pointer-swapping is done to reduce the number of
-    // memory allocations, so to separate these two worlds, create internal
-    // copies.
-    data_list* activations_internal = activations;
-    data_list* results_internal = results;
-
     M5_RESET_STATS();
     // Alternate between reading from/writing to activations and results so we
     // can avoid copying matrices. The initial activations is obviously in
     // "activations", so that's where we start.
-    result_buf result_loc = activations;
+    result_buf result_loc = activations_internal;
     nnet_fwd_outer:
     for (int l = 0; l < network->depth; l++) {
         if (result_loc == results_internal) {
             SWAP_PTRS(activations_internal, results_internal);
         }
+        arena_begin_layer(l, activations_internal, results_internal);
         result_loc = run_layer(activations_internal,
                                network->layers[l].host_weights, network->layers,
                                l, results_internal, device, sampling_param);
+        arena_end_layer(l, network->layers, result_loc);
     }
 
-    if (result_loc->type[0] == UncompressedHalfPrecision) {
-        farray_t* fp32_results =
-                unpack_data_fp16x4(result_loc->data[0].dense_hp, NULL);
-        free_fp16array(results->data[0].dense_hp);
-        results->data[0].dense = fp32_results;
-        results->type[0] = Uncompressed;
-    } else {
-        results = copy_data_list(results, result_loc);
-    }
+    arena_end_pass(result_loc, results);
     network->layers[network->depth - 1].result_in_temp = true;
-
-#ifdef USE_MKLDNN
-    delete session;
-#endif
-
-    destroy_thread_pool();
-    free_smv_global();
 }
 
 #endif
@@ -6,6 +6,7 @@
 #include "core/ref/activation_functions.h"
 #include "core/ref/batch_norm.h"
 #include "core/smiv/smiv.h"
+#include "utility/activation_arena.h"
 #include "utility/compression.h"
 #include "utility/profiling.h"
 #include "utility/utility.h"
@@ -44,8 +45,9 @@ typedef struct _smv_batch_norm_tiling_cfg {
 } smv_batch_norm_tiling_cfg;
 
 static smv_batch_norm_output_tile* init_smv_batch_norm_output_tiles(int num_tiles) {
-    smv_batch_norm_output_tile* tiles = (smv_batch_norm_output_tile*)malloc(
-            sizeof(smv_batch_norm_output_tile) * num_tiles);
+    smv_batch_norm_output_tile* tiles =
+            (smv_batch_norm_output_tile*)arena_malloc(
+                    sizeof(smv_batch_norm_output_tile) * num_tiles);
     for (int i = 0; i < num_tiles; i++)
         tiles[i].num = i;
     return tiles;
@@ -53,16 +55,23 @@ static smv_batch_norm_output_tile* init_smv_batch_norm_output_tiles(int num_tile
 
 static smv_batch_norm_tiling_cfg* init_smv_batch_norm_tiling_cfg(
         int num_tiles) {
-    smv_batch_norm_tiling_cfg* cfg = (smv_batch_norm_tiling_cfg*)malloc(
+    smv_batch_norm_tiling_cfg* cfg = (smv_batch_norm_tiling_cfg*)arena_malloc(
             sizeof(smv_batch_norm_tiling_cfg));
     cfg->num_input_tiles = num_tiles;
-    cfg->input_tiles = (smv_batch_norm_input_tile*)malloc(
+    cfg->input_tiles = (smv_batch_norm_input_tile*)arena_malloc(
             sizeof(smv_batch_norm_input_tile) * num_tiles);
     for (int i = 0; i < num_tiles; i++)
         cfg->input_tiles[i].num = i;
     return cfg;
 }
 
+static void free_smv_batch_norm_tiling_cfg(smv_batch_norm_tiling_cfg* cfg) {
+    for (int i = 0; i < cfg->num_input_tiles; i++)
+        arena_free(cfg->input_tiles[i].output_tiles);
+    arena_free(cfg->input_tiles);
+    arena_free(cfg);
+}
+
 static void print_smv_batch_norm_tiling_cfg(smv_batch_norm_tiling_cfg* cfg,
                                             int lnum) {
     INFO_MSG("\nTiling info for layer %d\n", lnum);
@@ -176,6 +185,15 @@ static smv_batch_norm_tiling_cfg* smv_batch_norm_tile_work(layer_t* curr_layer,
     return cfg;
 }
 
+size_t smv_batch_norm_scratch_size(layer_t* curr_layer, smv_global* g_smv) {
+    // The tiling descriptors are all the hardware batch norm allocates, and
+    // the activation arena measures those itself.
+    smv_batch_norm_tiling_cfg* cfg =
+            smv_batch_norm_tile_work(curr_layer, g_smv);
+    free_smv_batch_norm_tiling_cfg(cfg);
+    return 0;
+}
+
 static void smv_batch_norm_layer_hw_impl(packed_fp16* host_activations,
                                          packed_fp16* host_weights,
                                          packed_fp16* host_results,
@@ -446,6 +464,7 @@ void smv_batch_norm_layer_impl(data_list* activations,
                 }
             }
         }
+        free_smv_batch_norm_tiling_cfg(cfg);
     } else {
         begin_profiling(__func__, lnum);
         // The reference implementation is faster than MKL since we can
@@ -458,8 +477,8 @@ void smv_batch_norm_layer_impl(data_list* activations,
         farray_t* fp32_results = NULL;
         if (activations->type[0] == UncompressedHalfPrecision) {
             fp32_activations =
-                    unpack_data_fp16x4(activations->data[0].dense_hp, NULL);
-            fp32_results = init_farray(
+                    arena_unpack_data_fp16x4(activations->data[0].dense_hp);
+            fp32_results = arena_init_farray(
                     NUM_TEST_CASES * get_dims_size(&layers[lnum].outputs),
                     false);
         } else {
@@ -476,12 +495,7 @@ void smv_batch_norm_layer_impl(data_list* activations,
         }
 
         if (activations->type[0] == UncompressedHalfPrecision) {
-            // Ugly - need to free the farray_t* container without freeing the
-            // buffer it wraps.
-            packed_fp16* results_buf = results->data[0].dense_hp->d;
-            free(results->data[0].dense_hp);
-            results->data[0].dense_hp =
-                    pack_data_fp16(fp32_results, results_buf);
+            pack_data_fp16_into(fp32_results, results->data[0].dense_hp);
             free_farray(fp32_activations);
             free_farray(fp32_results);
         }
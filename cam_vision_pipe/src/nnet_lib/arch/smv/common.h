@@ -64,6 +64,14 @@ void smv_standard_convolution_layer_impl(data_list* host_activations,
                                          smv_global* g_smv,
                                          device_t* device,
                                          sampling_param_t* sampling_param);
+// Bytes of activation arena scratch that the accelerated layers allocate for
+// their data. These compute the tiling of the layer the same way the layer
+// does, which the arena measures on top.
+size_t smv_standard_convolution_scratch_size(layer_t* curr_layer,
+                                             smv_global* g_smv);
+size_t smv_inner_product_scratch_size(layer_t* curr_layer, smv_global* g_smv);
+size_t smv_pooling_scratch_size(layer_t* curr_layer, smv_global* g_smv);
+size_t smv_batch_norm_scratch_size(layer_t* curr_layer, smv_global* g_smv);
 void smv_inner_product_layer_impl(data_list* host_activations,
                                   layer_t* layers,
                                   int lnum,
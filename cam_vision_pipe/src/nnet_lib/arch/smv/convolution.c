@@ -10,6 +10,7 @@
 #include "core/smv/params.h"
 #include "core/smv/smv.h"
 #include "core/ref/activation_functions.h"
+#include "utility/activation_arena.h"
 #include "utility/data_layout_conversion.h"
 #include "utility/fp16_utils.h"
 #include "utility/thread_pool.h"
@@ -65,13 +66,13 @@ void free_conv_tiling_cfg(conv_tiling_cfg* cfg) {
         for (int i = 0; i < l2_tile->num_input_tiles; i++) {
             conv_input_tile* input_tile = &l2_tile->input_tiles[i];
             for (int j = 0; j < input_tile->num_output_tiles; j++) {
-                free(input_tile->output_tiles[j].hw_passes);
+                arena_free(input_tile->output_tiles[j].hw_passes);
             }
-            free(input_tile->output_tiles);
+            arena_free(input_tile->output_tiles);
         }
-        free(l2_tile->input_tiles);
+        arena_free(l2_tile->input_tiles);
     }
-    free(cfg->l2_tiles);
+    arena_free(cfg->l2_tiles);
 }
 
 void print_conv_tiling_cfg(conv_tiling_cfg* cfg, int lnum) {
@@ -175,29 +176,21 @@ void smv_convolution_layer_hw_impl_inputs_load(
         float* local_activations,
         layer_t* curr_layer,
         smv_convolution_options* options) {
-    int input_height = curr_layer->inputs.height;
-    int input_rows = curr_layer->inputs.rows;
-    int input_cols = curr_layer->inputs.cols;
-    int input_pad = curr_layer->inputs.align_pad;
-    ARRAY_4D(packed_fp16, _a, host_activations, input_rows, input_cols,
-             input_height + input_pad);
     if (curr_layer->input_req == IO_DMA || curr_layer->input_req == IO_ACP) {
         // Read in ALL channels of the input into the UMEM at once, so that we
-        // can reuse them on subsequent output channels.
+        // can reuse them on subsequent output channels. The host passes the
+        // start of the current image's input tile, so nothing is offset here.
         size_t num_input_pixels =
                 curr_layer->inputs.rows * curr_layer->inputs.cols *
                 (curr_layer->inputs.height + curr_layer->inputs.align_pad);
         if (curr_layer->input_req == IO_DMA) {
             setReadyBits(local_activations,
                          num_input_pixels * sizeof(*local_activations), 0);
-            dma_load_and_unpack_fp16(local_activations,
-                                     &_a[options->img][0][0][0],
-                                     num_input_pixels, 0, 0);
+            dma_load_and_unpack_fp16(
+                    local_activations, host_activations, num_input_pixels, 0, 0);
         } else {
-            int source_offset = &_a[options->img][0][0][0] - &_a[0][0][0][0];
-            acp_load_and_unpack_fp16(local_activations,
-                                     &_a[options->img][0][0][0],
-                                     num_input_pixels, 0, source_offset);
+            acp_load_and_unpack_fp16(
+                    local_activations, host_activations, num_input_pixels, 0, 0);
         }
     }
 }
@@ -995,12 +988,12 @@ static conv_tiling_cfg convolution_divide_work(layer_t* curr_layer,
     // Create tiling configurations.
     cfg.num_l2_tiles = num_l2_tiles;
     cfg.l2_tiles =
-            (conv_l2_tile*)malloc(sizeof(conv_l2_tile) * num_l2_tiles);
+            (conv_l2_tile*)arena_malloc(sizeof(conv_l2_tile) * num_l2_tiles);
     int remaining_kernels = curr_layer_nhwc_padded.outputs.height;
     for (int k = 0; k < cfg.num_l2_tiles; k++) {
         conv_l2_tile* l2_tile = &cfg.l2_tiles[k];
         l2_tile->num_input_tiles = num_input_tiles;
-        l2_tile->input_tiles = (conv_input_tile*)malloc(
+        l2_tile->input_tiles = (conv_input_tile*)arena_malloc(
                 l2_tile->num_input_tiles * sizeof(conv_input_tile));
         l2_tile->num_kernels = min2(max_kernels_per_l2_tile, remaining_kernels);
         remaining_kernels -= l2_tile->num_kernels;
@@ -1055,7 +1048,7 @@ static conv_tiling_cfg convolution_divide_work(layer_t* curr_layer,
             }
             input_tile->num_output_tiles = ceil(((float)l2_tile->num_kernels) /
                                                 num_ofmaps_per_output_tile);
-            input_tile->output_tiles = (conv_output_tile*)malloc(
+            input_tile->output_tiles = (conv_output_tile*)arena_malloc(
                     sizeof(conv_output_tile) * input_tile->num_output_tiles);
             remaining_input_rows -= (max_rows_per_input_tile - halo_rows);
             int remaining_ofmaps = l2_tile->num_kernels;
@@ -1079,10 +1072,12 @@ static conv_tiling_cfg convolution_divide_work(layer_t* curr_layer,
                         calc_padding(output_tile->output_dims[0], DATA_ALIGNMENT);
                 output_tile->num_hw_passes =
                         ceil((float)output_tile->num_ofmaps / NUM_PE_INSTS);
-                output_tile->hw_passes = (smv_convolution_options*)malloc(
+                output_tile->hw_passes = (smv_convolution_options*)arena_malloc(
                         output_tile->num_hw_passes *
                         sizeof(smv_convolution_options));
-                output_tile->hw_passes->load_inputs_first = true;
+                // Only the first pass loads the inputs ahead of the weights.
+                for (int p = 0; p < output_tile->num_hw_passes; p++)
+                    output_tile->hw_passes[p].load_inputs_first = (p == 0);
                 remaining_ofmaps -= output_tile->num_ofmaps;
             }
         }
@@ -1090,6 +1085,104 @@ static conv_tiling_cfg convolution_divide_work(layer_t* curr_layer,
     return cfg;
 }
 
+dims_t smv_get_nhwc_activations(data_list* host_activations,
+                                layer_t* curr_layer,
+                                data_list* result) {
+    if (!curr_layer->host_inputs_nhwc) {
+        dims_t nhwc = nchw_to_nhwc_dims(&curr_layer->inputs, DATA_ALIGNMENT);
+        result->data[0].dense_hp = arena_init_fp16array(
+                NUM_TEST_CASES * get_dims_size(&nhwc), false);
+        return convert_nchw_to_nhwc(host_activations,
+                                    0,
+                                    NUM_TEST_CASES,
+                                    curr_layer->inputs,
+                                    DATA_ALIGNMENT,
+                                    result);
+    }
+    require_data_type(host_activations, 0, UncompressedHalfPrecision);
+    // Refer to the existing buffer, which must not be freed with result.
+    fp16array_t* nhwc = arena_init_fp16array(0, false);
+    nhwc->d = host_activations->data[0].dense_hp->d;
+    nhwc->size = host_activations->data[0].dense_hp->size;
+    result->data[0].dense_hp = nhwc;
+    result->type[0] = UncompressedHalfPrecision;
+    return nchw_to_nhwc_dims(&curr_layer->inputs, DATA_ALIGNMENT);
+}
+
+// Returns true if the weight tiled implementation (convolution_wt.c) should
+// run this layer instead. It loads every kernel once but the inputs once per
+// output tile, which pays off when the weights are larger. If it would be
+// faster but cannot run the layer, this prints why when verbose is set.
+static bool use_weight_tiling(layer_t* curr_layer,
+                              conv_tiling_cfg* tiling,
+                              bool verbose) {
+    const int input_height = curr_layer->inputs.height;
+    int64_t num_input_tiles = tiling->l2_tiles[0].num_input_tiles;
+    int64_t num_output_tiles =
+            tiling->l2_tiles[0].input_tiles[0].num_output_tiles;
+    int64_t kernel_size =
+            curr_layer->weights.rows * curr_layer->weights.cols *
+            (input_height +
+             calc_padding(curr_layer->weights.height, DATA_ALIGNMENT));
+    int64_t weight_size =
+            kernel_size * curr_layer->outputs.height * sizeof(float16);
+    int64_t ofmap_size =
+            curr_layer->outputs.rows *
+            (curr_layer->outputs.cols + curr_layer->outputs.align_pad);
+    int64_t input_size =
+            curr_layer->inputs.rows * curr_layer->inputs.cols *
+            (input_height + calc_padding(input_height, DATA_ALIGNMENT)) *
+            sizeof(float16);
+    int64_t lat_dram = 140;
+    int64_t lat_l2 = curr_layer->input_req == IO_ACP ? 40 : 140;
+    int64_t orig_lat = (weight_size * num_input_tiles + input_size) * lat_dram;
+    int64_t new_lat = (weight_size + input_size) * lat_dram;
+    if (num_input_tiles > 1)
+        new_lat += (num_output_tiles - 1) * input_size * lat_l2;
+    if (new_lat >= orig_lat)
+        return false;
+    if (kernel_size < ofmap_size) {
+        if (verbose) {
+            printf("This is layer %d. The weight priority does potentially "
+                   "give better performance, but our current implementation "
+                   "doesn't support this case. It assumes that a single kernel "
+                   "size is larger than a single channel of the output feature "
+                   "maps.\n",
+                   curr_layer->num);
+        }
+        return false;
+    }
+    return true;
+}
+
+size_t smv_standard_convolution_scratch_size(layer_t* curr_layer,
+                                             smv_global* g_smv) {
+    // The NHWC inputs, or a header that refers to the inputs if they are
+    // already NHWC.
+    dims_t nhwc = nchw_to_nhwc_dims(&curr_layer->inputs, DATA_ALIGNMENT);
+    size_t nhwc_size = curr_layer->host_inputs_nhwc
+                               ? 0
+                               : NUM_TEST_CASES * get_dims_size(&nhwc);
+    size_t scratch = arena_fp16_bytes(nhwc_size);
+    conv_tiling_cfg tiling = convolution_divide_work(curr_layer, g_smv);
+    if (use_weight_tiling(curr_layer, &tiling, false)) {
+        scratch += smv_wt_convolution_partial_result_size(curr_layer, g_smv);
+    } else {
+        int max_result_size = 0;
+        for (int lt = 0; lt < tiling.num_l2_tiles; lt++) {
+            conv_l2_tile* l2_tile = &tiling.l2_tiles[lt];
+            for (int it = 0; it < l2_tile->num_input_tiles; it++) {
+                max_result_size = max2(max_result_size,
+                                       get_largest_output_tile_size(
+                                               &l2_tile->input_tiles[it]));
+            }
+        }
+        scratch += arena_fp16_bytes(max_result_size);
+    }
+    free_conv_tiling_cfg(&tiling);
+    return scratch;
+}
+
 void smv_standard_convolution_layer_impl(data_list* host_activations,
                                          data_list* host_weights,
                                          layer_t* layers,
@@ -1112,16 +1205,14 @@ void smv_standard_convolution_layer_impl(data_list* host_activations,
     const int k_rows = curr_layer.weights.rows;
     const int k_cols = curr_layer.weights.cols;
 
-    data_list* nhwc_activations = init_data_list(1);
+    union DataFormat nhwc_data;
+    data_storage_t nhwc_type = NumDataStorageTypes;
+    data_list nhwc_activations = { &nhwc_data, &nhwc_type, 1 };
     begin_ignored_profiling(lnum);
-    dims_t activations_nhwc = convert_nchw_to_nhwc(host_activations,
-                                                   0,
-                                                   NUM_TEST_CASES,
-                                                   curr_layer.inputs,
-                                                   DATA_ALIGNMENT,
-                                                   nhwc_activations);
+    dims_t activations_nhwc = smv_get_nhwc_activations(
+            host_activations, &curr_layer, &nhwc_activations);
     end_profiling();
-    packed_fp16* activations = nhwc_activations->data[0].dense_hp->d;
+    packed_fp16* activations = nhwc_data.dense_hp->d;
     ARRAY_4D(float16,
              _activations,
              activations,
@@ -1141,41 +1232,20 @@ void smv_standard_convolution_layer_impl(data_list* host_activations,
              result_height, result_rows, result_cols + result_pad);
 
     conv_tiling_cfg tiling = convolution_divide_work(&curr_layer, g_smv);
-    int64_t num_input_tiles = tiling.l2_tiles[0].num_input_tiles;
-    int64_t num_output_tiles = tiling.l2_tiles[0].input_tiles[0].num_output_tiles;
-    int64_t kernel_size = k_rows * k_cols *
-                      (input_height + nhwc_weights_dims.align_pad);
-    int64_t weight_size = kernel_size * result_height * sizeof(float16);
-    int64_t ofmap_size =  result_rows * (result_cols + result_pad);
-    int64_t input_size = input_rows * input_cols *
-                     (input_height + activations_nhwc.align_pad) *
-                     sizeof(float16);
-    int64_t lat_dram = 140;
-    int64_t lat_l2 = curr_layer.input_req == IO_ACP ? 40 : 140;
-    int64_t orig_lat = (weight_size * num_input_tiles + input_size) * lat_dram;
-    int64_t new_lat = (weight_size + input_size) * lat_dram;
-    if (num_input_tiles > 1)
-        new_lat += (num_output_tiles - 1) * input_size * lat_l2;
-    if (new_lat < orig_lat) {
-        if (kernel_size < ofmap_size) {
-            printf("This is layer %d. The weight priority does potentially "
-                   "give better performance, but our current implementation "
-                   "doesn't support this case. It assumes that a single kernel "
-                   "size is larger than a single channel of the output feature "
-                   "maps.\n",
-                   lnum);
-        } else {
-            INFO_MSG("Use new tiling for layer %d.\n", lnum);
-            smv_wt_standard_convolution_layer_impl(host_activations,
-                                                   host_weights,
-                                                   layers,
-                                                   lnum,
-                                                   host_results,
-                                                   g_smv,
-                                                   device,
-                                                   sampling_param);
-            return;
-        }
+    if (use_weight_tiling(&curr_layer, &tiling, true)) {
+        INFO_MSG("Use new tiling for layer %d.\n", lnum);
+        // The weight tiled implementation makes its own copy of the inputs.
+        free_fp16array(nhwc_data.dense_hp);
+        free_conv_tiling_cfg(&tiling);
+        smv_wt_standard_convolution_layer_impl(host_activations,
+                                               host_weights,
+                                               layers,
+                                               lnum,
+                                               host_results,
+                                               g_smv,
+                                               device,
+                                               sampling_param);
+        return;
     }
     set_sampling_parameters(&tiling, &curr_layer, sampling_param);
     print_conv_tiling_cfg(&tiling, lnum);
@@ -1225,7 +1295,7 @@ void smv_standard_convolution_layer_impl(data_list* host_activations,
                         img,
                         l2_tile_kern_start,
                         device,
-                        nhwc_activations->data[0].dense_hp->d,
+                        nhwc_data.dense_hp->d,
                         host_weights->data[0].dense_hp->d,
                         host_results->data[0].dense_hp->d);
                 l2_tile_kern_start += l2_tile->num_kernels;
@@ -1282,7 +1352,8 @@ void smv_standard_convolution_layer_impl(data_list* host_activations,
 
                 // Store all results from the accelerator in this temporary buffer.
                 int result_buf_size = get_largest_output_tile_size(input_tile);
-                fp16array_t* temp_result = init_fp16array(result_buf_size, true);
+                fp16array_t* temp_result =
+                        arena_init_fp16array(result_buf_size, true);
 
                 // Inner loop for output tiling of an input tile.
                 for (int ot = 0; ot < input_tile->num_output_tiles; ot++) {
@@ -1502,6 +1573,6 @@ void smv_standard_convolution_layer_impl(data_list* host_activations,
             l2_tile_kern_start += l2_tile->num_kernels;
         }
     }
-    free_data_list(nhwc_activations);
+    free_fp16array(nhwc_data.dense_hp);
     free_conv_tiling_cfg(&tiling);
 }
@@ -70,6 +70,20 @@ void run_sampled_hw_pass(layer_t* partial_layer,
                          int img,
                          packed_fp16* temp_results_buf);
 
+// Get the inputs of a convolution in NHWC.
+//
+// Host activations are stored in NCHW and are converted into result, unless
+// the layer's host inputs are already NHWC, in which case result refers to
+// them without a copy. Returns the NHWC dimensions.
+dims_t smv_get_nhwc_activations(data_list* host_activations,
+                                layer_t* curr_layer,
+                                data_list* result);
+
+// Returns the arena bytes for the partial results buffer of the weight tiled
+// implementation.
+size_t smv_wt_convolution_partial_result_size(layer_t* curr_layer,
+                                              smv_global* g_smv);
+
 void smv_wt_standard_convolution_layer_impl(data_list* host_activations,
                                             data_list* host_weights,
                                             layer_t* layers,
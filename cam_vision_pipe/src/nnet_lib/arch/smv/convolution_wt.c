@@ -9,6 +9,7 @@
 #include "core/smv/params.h"
 #include "core/smv/smv.h"
 #include "core/ref/activation_functions.h"
+#include "utility/activation_arena.h"
 #include "utility/data_layout_conversion.h"
 #include "utility/fp16_utils.h"
 #include "utility/thread_pool.h"
@@ -47,11 +48,11 @@ void free_conv_wt_tiling_cfg(conv_wt_tiling_cfg* cfg) {
     for (int i = 0; i < cfg->num_output_tiles; i++) {
         conv_wt_output_tile* output_tile = &cfg->output_tiles[i];
         for (int j = 0; j < output_tile->num_input_tiles; j++) {
-            free(output_tile->input_tiles[j].hw_passes);
+            arena_free(output_tile->input_tiles[j].hw_passes);
         }
-        free(output_tile->input_tiles);
+        arena_free(output_tile->input_tiles);
     }
-    free(cfg->output_tiles);
+    arena_free(cfg->output_tiles);
 }
 
 void print_conv_wt_tiling_cfg(conv_wt_tiling_cfg* cfg, int lnum) {
@@ -667,13 +668,13 @@ static conv_wt_tiling_cfg convolution_wt_divide_work(layer_t* curr_layer,
     // Create tiling configurations.
     cfg.num_output_tiles = ceil(((float)curr_layer_nhwc_padded.outputs.height) /
                                 max_kernels_per_output_tile);
-    cfg.output_tiles = (conv_wt_output_tile*)malloc(sizeof(conv_wt_output_tile) *
-                                                 cfg.num_output_tiles);
+    cfg.output_tiles = (conv_wt_output_tile*)arena_malloc(
+            sizeof(conv_wt_output_tile) * cfg.num_output_tiles);
     int remaining_ofmaps = curr_layer_nhwc_padded.outputs.height;
     for (int k = 0; k < cfg.num_output_tiles; k++) {
         conv_wt_output_tile* output_tile = &cfg.output_tiles[k];
         output_tile->num_input_tiles = num_input_tiles;
-        output_tile->input_tiles = (conv_wt_input_tile*)malloc(
+        output_tile->input_tiles = (conv_wt_input_tile*)arena_malloc(
                 output_tile->num_input_tiles * sizeof(conv_wt_input_tile));
         output_tile->num_ofmaps =
                 min2(remaining_ofmaps, max_kernels_per_output_tile);
@@ -737,16 +738,30 @@ static conv_wt_tiling_cfg convolution_wt_divide_work(layer_t* curr_layer,
             remaining_input_rows -= (max_rows_per_input_tile - halo_rows);
             input_tile->num_hw_passes =
                     ceil((float)output_tile->num_ofmaps / NUM_PE_INSTS);
-            input_tile->hw_passes = (smv_convolution_options*)malloc(
+            input_tile->hw_passes = (smv_convolution_options*)arena_malloc(
                     input_tile->num_hw_passes *
                     sizeof(smv_convolution_options));
-            input_tile->hw_passes->load_inputs_first = false;
+            for (int p = 0; p < input_tile->num_hw_passes; p++)
+                input_tile->hw_passes[p].load_inputs_first = false;
         }
         remaining_ofmaps -= output_tile->num_ofmaps;
     }
     return cfg;
 }
 
+size_t smv_wt_convolution_partial_result_size(layer_t* curr_layer,
+                                              smv_global* g_smv) {
+    conv_wt_tiling_cfg tiling = convolution_wt_divide_work(curr_layer, g_smv);
+    int max_result_size = 0;
+    for (int ot = 0; ot < tiling.num_output_tiles; ot++) {
+        max_result_size =
+                max2(max_result_size,
+                     get_largest_wt_output_tile_size(&tiling.output_tiles[ot]));
+    }
+    free_conv_wt_tiling_cfg(&tiling);
+    return arena_fp16_bytes(max_result_size);
+}
+
 void smv_wt_standard_convolution_layer_impl(data_list* host_activations,
                                             data_list* host_weights,
                                             layer_t* layers,
@@ -769,20 +784,17 @@ void smv_wt_standard_convolution_layer_impl(data_list* host_activations,
     const int k_rows = curr_layer.weights.rows;
     const int k_cols = curr_layer.weights.cols;
 
-    data_list* nhwc_activations = init_data_list(1);
+    union DataFormat nhwc_data;
+    data_storage_t nhwc_type = NumDataStorageTypes;
+    data_list nhwc_activations = { &nhwc_data, &nhwc_type, 1 };
     begin_ignored_profiling(lnum);
-    convert_nchw_to_nhwc(host_activations,
-                         0,
-                         NUM_TEST_CASES,
-                         curr_layer.inputs,
-                         DATA_ALIGNMENT,
-                         nhwc_activations);
+    smv_get_nhwc_activations(host_activations, &curr_layer, &nhwc_activations);
     dims_t nhwc_activations_dims = { input_rows,
                                 input_cols,
                                 input_height,
                                 calc_padding(input_height, DATA_ALIGNMENT) };
     end_profiling();
-    packed_fp16* activations = nhwc_activations->data[0].dense_hp->d;
+    packed_fp16* activations = nhwc_data.dense_hp->d;
     ARRAY_4D(float16,
              _activations,
              activations,
@@ -870,7 +882,8 @@ void smv_wt_standard_convolution_layer_impl(data_list* host_activations,
 
             // Set up the results buffer and mappings.
             int result_buf_size = get_largest_wt_output_tile_size(output_tile);
-            fp16array_t* temp_result = init_fp16array(result_buf_size, true);
+            fp16array_t* temp_result =
+                    arena_init_fp16array(result_buf_size, true);
 
             // Inner loop for input tiling. The input is tiled along rows, and
             // the output of an input tile is furtur tiled along output channels.
@@ -1092,6 +1105,6 @@ void smv_wt_standard_convolution_layer_impl(data_list* host_activations,
             output_tile_kern_start += output_tile->num_ofmaps;
         }
     }
-    free_data_list(nhwc_activations);
+    free_fp16array(nhwc_data.dense_hp);
     free_conv_wt_tiling_cfg(&tiling);
 }
@@ -11,6 +11,7 @@
 #include "core/smiv/params.h"
 #include "core/smv/params.h"
 #include "core/smv/smv.h"
+#include "utility/activation_arena.h"
 #include "utility/compression.h"
 #include "utility/utility.h"
 #include "config.h"
@@ -390,10 +391,10 @@ void smv_inner_product_check_absolute_size_limits(layer_t* curr_layer,
 }
 
 inner_product_tiling_cfg* init_inner_product_tiling_cfg(int num_tiles) {
-    inner_product_tiling_cfg* cfg =
-            (inner_product_tiling_cfg*)malloc(sizeof(inner_product_tiling_cfg));
-    cfg->tiles =
-            (inner_product_tile*)malloc(sizeof(inner_product_tile) * num_tiles);
+    inner_product_tiling_cfg* cfg = (inner_product_tiling_cfg*)arena_malloc(
+            sizeof(inner_product_tiling_cfg));
+    cfg->tiles = (inner_product_tile*)arena_malloc(sizeof(inner_product_tile) *
+                                                   num_tiles);
     for (int i = 0; i < num_tiles; i++) {
         cfg->tiles[i].num = i;
     }
@@ -402,7 +403,7 @@ inner_product_tiling_cfg* init_inner_product_tiling_cfg(int num_tiles) {
 }
 
 inner_product_strip* init_inner_product_strips(int num_strips) {
-    inner_product_strip* strips = (inner_product_strip*)malloc(
+    inner_product_strip* strips = (inner_product_strip*)arena_malloc(
             sizeof(inner_product_strip) * num_strips);
     for (int i = 0; i < num_strips; i++)
         strips[i].num = i;
@@ -411,10 +412,10 @@ inner_product_strip* init_inner_product_strips(int num_strips) {
 
 void free_inner_product_tiling_cfg(inner_product_tiling_cfg* cfg) {
     for (int tile = 0; tile < cfg->num_tiles; tile++) {
-        free(cfg->tiles[tile].strips);
+        arena_free(cfg->tiles[tile].strips);
     }
-    free(cfg->tiles);
-    free(cfg);
+    arena_free(cfg->tiles);
+    arena_free(cfg);
 }
 
 void print_inner_product_tiling_cfg(inner_product_tiling_cfg* cfg) {
@@ -725,6 +726,31 @@ layer_t create_partial_layer(layer_t* curr_layer,
     return partial_layer;
 }
 
+size_t smv_inner_product_scratch_size(layer_t* curr_layer, smv_global* g_smv) {
+    inner_product_tiling_cfg* fc_cfgs =
+            smv_inner_product_tile_work(curr_layer, g_smv);
+    bool decomp_result_buf_output_req = curr_layer->output_req == IO_NONE ||
+                                        curr_layer->output_req == IO_DMA ||
+                                        curr_layer->output_req == IO_ACP;
+    size_t max_scratch = 0;
+    for (int tile_num = 0; tile_num < fc_cfgs->num_tiles; tile_num++) {
+        inner_product_tile* tile = &fc_cfgs->tiles[tile_num];
+        size_t scratch = 0;
+        if (fc_cfgs->num_tiles > 1) {
+            scratch += arena_fp16_bytes(tile->strips[0].weights_dims[0] *
+                                        NUM_TEST_CASES);
+        }
+        if (curr_layer->host_weights->type[tile_num] == PackedCSR &&
+            decomp_result_buf_output_req) {
+            scratch += arena_fp16_bytes(
+                    next_multiple(tile->strips[0].weights_dims[1], 16));
+        }
+        max_scratch = max2(max_scratch, scratch);
+    }
+    free_inner_product_tiling_cfg(fc_cfgs);
+    return max_scratch;
+}
+
 void smv_inner_product_layer_impl_rowwise(data_list* host_activations,
                                           layer_t* curr_layer,
                                           data_list* host_results,
@@ -755,8 +781,8 @@ void smv_inner_product_layer_impl_rowwise(data_list* host_activations,
         fp16array_t* host_inputs_buffer;
         if (fc_cfgs->num_tiles > 1) {
             int num_inputs_in_tile = tile->strips[0].weights_dims[0];
-            host_inputs_buffer =
-                    init_fp16array(num_inputs_in_tile * NUM_TEST_CASES, false);
+            host_inputs_buffer = arena_init_fp16array(
+                    num_inputs_in_tile * NUM_TEST_CASES, false);
             copy_data_col_range(
                     (float*)host_activations->data[0].dense_hp->d,
                     &curr_layer->inputs,
@@ -780,7 +806,7 @@ void smv_inner_product_layer_impl_rowwise(data_list* host_activations,
                                            curr_layer->output_req == IO_ACP);
         fp16array_t* decomp_result_buf = NULL;
         if (use_decomp_result_buf) {
-            decomp_result_buf = init_fp16array(
+            decomp_result_buf = arena_init_fp16array(
                     next_multiple(tile->strips[0].weights_dims[1], 16), true);
         }
         float16* curr_dense_weights_loc =
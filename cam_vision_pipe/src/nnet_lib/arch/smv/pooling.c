@@ -7,6 +7,7 @@
 #include "core/nnet_fwd_defs.h"
 #include "core/smiv/smiv.h"
 #include "core/smv/params.h"
+#include "utility/activation_arena.h"
 #include "utility/data_layout_conversion.h"
 #include "utility/profiling.h"
 #include "utility/utility.h"
@@ -150,9 +151,9 @@ static void smv_pooling_layer_hw(packed_fp16* dma_activations,
 
 pool_tiling_cfg* init_pool_tiling_cfg(int num_input_tiles) {
     pool_tiling_cfg* pool_cfg =
-            (pool_tiling_cfg*)malloc(sizeof(pool_tiling_cfg));
-    pool_cfg->input_tiles =
-            (pool_input_tile*)malloc(sizeof(pool_input_tile) * num_input_tiles);
+            (pool_tiling_cfg*)arena_malloc(sizeof(pool_tiling_cfg));
+    pool_cfg->input_tiles = (pool_input_tile*)arena_malloc(
+            sizeof(pool_input_tile) * num_input_tiles);
     pool_cfg->num_input_tiles = num_input_tiles;
     for (int i = 0; i < num_input_tiles; i++) {
         pool_cfg->input_tiles[i].num = i;
@@ -162,7 +163,7 @@ pool_tiling_cfg* init_pool_tiling_cfg(int num_input_tiles) {
 
 
 pool_output_tile* init_pool_output_tiles(int num_output_tiles) {
-    pool_output_tile* output_tiles = (pool_output_tile*)malloc(
+    pool_output_tile* output_tiles = (pool_output_tile*)arena_malloc(
             sizeof(pool_output_tile) * num_output_tiles);
     for (int i = 0; i < num_output_tiles; i++) {
         output_tiles[i].num = i;
@@ -266,10 +267,10 @@ static pool_tiling_cfg* smv_pooling_divide_work(layer_t* curr_layer,
 
 void free_pool_tiling_cfg(pool_tiling_cfg* cfg) {
     for (int i = 0; i < cfg->num_input_tiles; i++) {
-        free(cfg->input_tiles[i].output_tiles);
+        arena_free(cfg->input_tiles[i].output_tiles);
     }
-    free(cfg->input_tiles);
-    free(cfg);
+    arena_free(cfg->input_tiles);
+    arena_free(cfg);
 }
 
 void print_pool_tiling_cfg(pool_tiling_cfg* cfg, int lnum) {
@@ -352,6 +353,20 @@ layer_t create_partial_pool_layer(layer_t* curr_layer,
     return partial_layer;
 }
 
+size_t smv_pooling_scratch_size(layer_t* curr_layer, smv_global* g_smv) {
+    // The activation arena measures the tiling descriptors itself.
+    pool_tiling_cfg* pool_cfg = smv_pooling_divide_work(curr_layer, g_smv);
+    free_pool_tiling_cfg(pool_cfg);
+    return arena_fp16_bytes(NUM_TEST_CASES *
+                            compute_blocked_nhwc_size(&curr_layer->inputs,
+                                                      VECTOR_SIZE,
+                                                      DATA_ALIGNMENT)) +
+           arena_fp16_bytes(NUM_TEST_CASES *
+                            compute_blocked_nhwc_size(&curr_layer->outputs,
+                                                      VECTOR_SIZE,
+                                                      DATA_ALIGNMENT));
+}
+
 void smv_pooling_layer_impl(data_list* inputs,
                             layer_t* curr_layer,
                             smv_global* g_smv,
@@ -364,34 +379,43 @@ void smv_pooling_layer_impl(data_list* inputs,
     end_profiling();
 
     begin_ignored_profiling(curr_layer->num);
-    data_list* nhwc_inputs = init_data_list(1);
+    union DataFormat nhwc_inputs_data;
+    data_storage_t nhwc_inputs_type = NumDataStorageTypes;
+    data_list nhwc_inputs = { &nhwc_inputs_data, &nhwc_inputs_type, 1 };
+    nhwc_inputs_data.dense_hp = arena_init_fp16array(
+            NUM_TEST_CASES * compute_blocked_nhwc_size(&curr_layer->inputs,
+                                                       VECTOR_SIZE,
+                                                       DATA_ALIGNMENT),
+            false);
     convert_nchw_to_blocked_nhwc(inputs, 0, NUM_TEST_CASES, VECTOR_SIZE,
                                  curr_layer->inputs, DATA_ALIGNMENT,
-                                 nhwc_inputs);
+                                 &nhwc_inputs);
     end_profiling();
 
     // Prepare a temporary buffer for the NHWC-formatted outputs.
-    data_list* nhwc_outputs = init_data_list(1);
-    nhwc_outputs->type[0] = inputs->type[0];
-    nhwc_outputs->data[0].dense_hp = init_fp16array(
-            compute_blocked_nhwc_size(
-                    &curr_layer->outputs, VECTOR_SIZE, DATA_ALIGNMENT),
+    union DataFormat nhwc_outputs_data;
+    data_storage_t nhwc_outputs_type = inputs->type[0];
+    data_list nhwc_outputs = { &nhwc_outputs_data, &nhwc_outputs_type, 1 };
+    nhwc_outputs_data.dense_hp = arena_init_fp16array(
+            NUM_TEST_CASES * compute_blocked_nhwc_size(&curr_layer->outputs,
+                                                       VECTOR_SIZE,
+                                                       DATA_ALIGNMENT),
             true);
 
     for (int img = 0; img < NUM_TEST_CASES; img++) {
-        float16* current_inputs = (float16*)nhwc_inputs->data[0].dense_hp->d;
-        float16* current_results = (float16*)nhwc_outputs->data[0].dense_hp->d;
+        float16* current_inputs = (float16*)nhwc_inputs_data.dense_hp->d;
+        float16* current_results = (float16*)nhwc_outputs_data.dense_hp->d;
         // Flush cache lines for inputs and outputs.
         begin_ignored_profiling(curr_layer->num);
         if (curr_layer->input_req == IO_DMA) {
             flush_cache_range(
                     current_inputs,
-                    nhwc_inputs->data[0].dense_hp->size * sizeof(float16));
+                    nhwc_inputs_data.dense_hp->size * sizeof(float16));
         }
         if (curr_layer->output_req == IO_DMA) {
             flush_cache_range(
                     current_results,
-                    nhwc_outputs->data[0].dense_hp->size * sizeof(float16));
+                    nhwc_outputs_data.dense_hp->size * sizeof(float16));
         }
         end_profiling();
 
@@ -449,11 +473,11 @@ void smv_pooling_layer_impl(data_list* inputs,
     begin_ignored_profiling(curr_layer->num);
     dims_t output_dims =
             nchw_to_nhwc_dims(&curr_layer->outputs, DATA_ALIGNMENT);
-    convert_blocked_nhwc_to_nchw(nhwc_outputs, 0, NUM_TEST_CASES, VECTOR_SIZE,
+    convert_blocked_nhwc_to_nchw(&nhwc_outputs, 0, NUM_TEST_CASES, VECTOR_SIZE,
                                  output_dims, DATA_ALIGNMENT, results);
     end_profiling();
 
-    free_data_list(nhwc_inputs);
-    free_data_list(nhwc_outputs);
+    free_fp16array(nhwc_inputs_data.dense_hp);
+    free_fp16array(nhwc_outputs_data.dense_hp);
     free_pool_tiling_cfg(pool_cfg);
 }
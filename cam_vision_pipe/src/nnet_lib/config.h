@@ -102,6 +102,24 @@
 
 #endif
 
+// If 1, then 3x3, stride 1 convolutions run with Winograd minimal filtering
+// when their transformed filters pass an accuracy check at load time. Only
+// the MONOLITHIC, COMPOSABLE and NATIVE_CPU backends implement it.
+//
+// COMPOSABLE leaves it off by default: its convolution block is simulated as
+// a direct convolution, and Winograd filters would change what the block
+// computes and how much data it loads. A Winograd convolution is also never
+// fused with the pooling layer after it.
+//
+// This can also be defined from the build command.
+#ifndef WINOGRAD_CONV
+#if ARCHITECTURE == MONOLITHIC || ARCHITECTURE == NATIVE_CPU
+#define WINOGRAD_CONV 1
+#else
+#define WINOGRAD_CONV 0
+#endif
+#endif
+
 /////////////////////////////////////////////////
 /////// SHOULD NOT NEED TO CHANGE THESE /////////
 /////////////////////////////////////////////////
@@ -118,6 +136,8 @@
 #define ARCH_STR "EIGEN"
 #elif ARCHITECTURE == MKLDNN
 #define ARCH_STR "MKLDNN"
+#elif ARCHITECTURE == NATIVE_CPU
+#define ARCH_STR "NATIVE_CPU"
 #else
 #error "Unknown architecture!"
 #endif
@@ -0,0 +1,244 @@
+#include <stdlib.h>
+
+#include "core/native_cpu/convolution.h"
+#include "core/native_cpu/gemm.h"
+#include "utility/activation_arena.h"
+#include "utility/utility.h"
+#include "nnet_fwd.h"
+
+// Bytes of a table of one offset per output pixel.
+static size_t pixel_offsets_bytes(layer_t* curr_layer) {
+    return curr_layer->outputs.rows * curr_layer->outputs.cols * sizeof(int);
+}
+
+// Bytes of a table of one offset per position in a convolution window.
+static size_t window_offsets_bytes(layer_t* curr_layer) {
+    return curr_layer->inputs.height * curr_layer->weights.rows *
+           curr_layer->weights.cols * sizeof(int);
+}
+
+// Scratch of the two tables conv_window_offsets() and conv_result_offsets()
+// build.
+static size_t conv_offsets_scratch_size(layer_t* curr_layer) {
+    size_t scratch = arena_buffer_bytes(pixel_offsets_bytes(curr_layer));
+    if (curr_layer->outputs.align_pad != 0)
+        scratch += arena_buffer_bytes(pixel_offsets_bytes(curr_layer));
+    return scratch;
+}
+
+// Offsets of the top left input pixel of the window of every output pixel of
+// a convolution within one input channel, in output order.
+static int* conv_window_offsets(layer_t* curr_layer) {
+    const int a_width = curr_layer->inputs.cols + curr_layer->inputs.align_pad;
+    const int result_rows = curr_layer->outputs.rows;
+    const int result_cols = curr_layer->outputs.cols;
+    int* offsets = (int*)arena_malloc(pixel_offsets_bytes(curr_layer));
+    for (int i = 0; i < result_rows; i++) {
+        for (int j = 0; j < result_cols; j++) {
+            offsets[i * result_cols + j] =
+                    i * curr_layer->stride.rows * a_width +
+                    j * curr_layer->stride.cols;
+        }
+    }
+    return offsets;
+}
+
+// Offsets of every output pixel within one output channel, in output order.
+// Returns NULL if the outputs have no alignment padding, in which case the
+// pixels are simply consecutive.
+static int* conv_result_offsets(layer_t* curr_layer) {
+    const int result_rows = curr_layer->outputs.rows;
+    const int result_cols = curr_layer->outputs.cols;
+    const int result_width = result_cols + curr_layer->outputs.align_pad;
+    if (result_width == result_cols)
+        return NULL;
+    int* offsets = (int*)arena_malloc(pixel_offsets_bytes(curr_layer));
+    for (int i = 0; i < result_rows; i++) {
+        for (int j = 0; j < result_cols; j++)
+            offsets[i * result_cols + j] = i * result_width + j;
+    }
+    return offsets;
+}
+
+// Returns a view of the outputs of image img as a matrix with one row per
+// output channel and one column per output pixel.
+static gemm_matrix_t conv_result_matrix(layer_t* curr_layer,
+                                        float* result,
+                                        int img,
+                                        int* result_offsets) {
+    const int result_size = curr_layer->outputs.rows *
+                            (curr_layer->outputs.cols +
+                             curr_layer->outputs.align_pad);
+    gemm_matrix_t matrix = gemm_row_major(
+            result + img * curr_layer->outputs.height * result_size,
+            result_size);
+    matrix.col_offsets = result_offsets;
+    return matrix;
+}
+
+// Perform a 3D convolution over the data in @a with all kernels.
+//
+// Each image is multiplied as a matrix of kernels, one row per kernel, with
+// the im2col expansion of the image: one column per output pixel, holding
+// every input pixel in its window. That expansion is never built. Its rows
+// and columns are described by two offset tables into the image, one for
+// every position within a window and one for the corner of every window, and
+// the GEMM gathers each panel of it straight from the image as it packs it.
+void cpu_convolution3d_no_padding(float* a,
+                                  float* kernels,
+                                  layer_t curr_layer,
+                                  float* result) {
+    const int a_height = curr_layer.inputs.height;
+    const int a_rows = curr_layer.inputs.rows;
+    const int a_width = curr_layer.inputs.cols + curr_layer.inputs.align_pad;
+    const int a_size = a_height * a_rows * a_width;
+
+    const int k_rows = curr_layer.weights.rows;
+    const int k_cols = curr_layer.weights.cols;
+    const int k_width = k_cols + curr_layer.weights.align_pad;
+    const int num_kerns = curr_layer.outputs.height;
+    const int window_size = a_height * k_rows * k_cols;
+    const int num_pixels = curr_layer.outputs.rows * curr_layer.outputs.cols;
+
+    // Offsets of each position in a window, within the image and within a
+    // kernel.
+    int* window_offsets = (int*)arena_malloc(window_offsets_bytes(&curr_layer));
+    int* kernel_offsets = (int*)arena_malloc(window_offsets_bytes(&curr_layer));
+    int w = 0;
+    for (int d = 0; d < a_height; d++) {
+        for (int k = 0; k < k_rows; k++) {
+            for (int l = 0; l < k_cols; l++) {
+                window_offsets[w] = (d * a_rows + k) * a_width + l;
+                kernel_offsets[w] = (d * k_rows + k) * k_width + l;
+                w++;
+            }
+        }
+    }
+    int* pixel_offsets = conv_window_offsets(&curr_layer);
+    int* result_offsets = conv_result_offsets(&curr_layer);
+
+    gemm_matrix_t kernels_mat =
+            gemm_row_major(kernels, a_height * k_rows * k_width);
+    if (k_width != k_cols)
+        kernels_mat.col_offsets = kernel_offsets;
+
+    conv3d_per_image:
+    for (int img = 0; img < NUM_TEST_CASES; img++) {
+        gemm_matrix_t im2col = { a + img * a_size, 0, 0, window_offsets,
+                                 pixel_offsets };
+        gemm_matrix_t result_mat = conv_result_matrix(
+                &curr_layer, result, img, result_offsets);
+        cpu_gemm_with_bias(num_kerns, num_pixels, window_size, &kernels_mat,
+                           &im2col, NULL, NULL, &result_mat);
+    }
+
+    arena_free(result_offsets);
+    arena_free(pixel_offsets);
+    arena_free(kernel_offsets);
+    arena_free(window_offsets);
+}
+
+size_t cpu_convolution3d_scratch_size(layer_t* curr_layer) {
+    return 2 * arena_buffer_bytes(window_offsets_bytes(curr_layer)) +
+           conv_offsets_scratch_size(curr_layer) + cpu_gemm_scratch_size();
+}
+
+// Perform a 1x1 convolution over the data in @a with all kernels.
+//
+// Each image is multiplied as the transpose of the weights, one row per
+// kernel, with the image, one row per input channel and one column per
+// output pixel. The biases follow the weights, one per kernel.
+void cpu_convolution3d_pointwise_nopadding(float* a,
+                                           float* kernels,
+                                           layer_t curr_layer,
+                                           float* result) {
+    const int a_height = curr_layer.inputs.height;
+    const int a_size = curr_layer.inputs.rows *
+                       (curr_layer.inputs.cols + curr_layer.inputs.align_pad);
+    const int num_kerns = curr_layer.outputs.height;
+    const int k_width = num_kerns + curr_layer.weights.align_pad;
+    const int num_pixels = curr_layer.outputs.rows * curr_layer.outputs.cols;
+
+    int* pixel_offsets = conv_window_offsets(&curr_layer);
+    int* result_offsets = conv_result_offsets(&curr_layer);
+    gemm_matrix_t kernels_mat = gemm_col_major(kernels, k_width);
+    float* biases = kernels + a_height * k_width;
+
+    conv_pw_per_image:
+    for (int img = 0; img < NUM_TEST_CASES; img++) {
+        gemm_matrix_t image = gemm_row_major(a + img * a_height * a_size,
+                                             a_size);
+        image.col_offsets = pixel_offsets;
+        gemm_matrix_t result_mat = conv_result_matrix(
+                &curr_layer, result, img, result_offsets);
+        cpu_gemm_with_bias(num_kerns, num_pixels, a_height, &kernels_mat,
+                           &image, biases, NULL, &result_mat);
+    }
+
+    arena_free(result_offsets);
+    arena_free(pixel_offsets);
+}
+
+size_t cpu_convolution3d_pointwise_scratch_size(layer_t* curr_layer) {
+    return conv_offsets_scratch_size(curr_layer) + cpu_gemm_scratch_size();
+}
+
+// Apply each 2D filter of @kernels to the matching channel of @a.
+//
+// A depthwise convolution is too small to be worth a GEMM. Instead, each row
+// of outputs is accumulated one filter tap at a time: every tap scales a row
+// of inputs, which vectorizes along the row. Every output still sums its
+// products in the same order as the reference.
+void cpu_convolution2d_depthwise_nopadding(float* a,
+                                           float* kernels,
+                                           layer_t curr_layer,
+                                           float* result) {
+    const int a_height = curr_layer.inputs.height;
+    const int a_rows = curr_layer.inputs.rows;
+    const int a_width = curr_layer.inputs.cols + curr_layer.inputs.align_pad;
+
+    const int result_rows = curr_layer.outputs.rows;
+    const int result_cols = curr_layer.outputs.cols;
+    const int result_width = result_cols + curr_layer.outputs.align_pad;
+
+    const int k_rows = curr_layer.weights.rows;
+    const int k_cols = curr_layer.weights.cols;
+    const int k_pad = curr_layer.weights.align_pad;
+    const int row_stride = curr_layer.stride.rows;
+    const int col_stride = curr_layer.stride.cols;
+
+    ARRAY_4D(float, _a, a, a_height, a_rows, a_width);
+    ARRAY_3D(float, _kernels, kernels, k_rows, k_cols + k_pad);
+    ARRAY_4D(float, _result, result, a_height, result_rows, result_width);
+
+    conv_dw_per_image:
+    for (int img = 0; img < NUM_TEST_CASES; img++) {
+        conv_dw_per_chan:
+        for (int chan = 0; chan < a_height; chan++) {
+            conv_dw_result_rows:
+            for (int i = 0; i < result_rows; i++) {
+                float* result_row = &_result[img][chan][i][0];
+                for (int j = 0; j < result_cols; j++)
+                    result_row[j] = 0;
+                conv_dw_kernel_rows:
+                for (int k = 0; k < k_rows; k++) {
+                    conv_dw_kernel_cols:
+                    for (int l = 0; l < k_cols; l++) {
+                        float kern_val = _kernels[chan][k][l];
+                        float* a_row = &_a[img][chan][i * row_stride + k][l];
+                        if (col_stride == 1) {
+                            conv_dw_unit_stride:
+                            for (int j = 0; j < result_cols; j++)
+                                result_row[j] += kern_val * a_row[j];
+                        } else {
+                            conv_dw_strided:
+                            for (int j = 0; j < result_cols; j++)
+                                result_row[j] +=
+                                        kern_val * a_row[j * col_stride];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef _CORE_NATIVE_CPU_CONVOLUTION_H_
+#define _CORE_NATIVE_CPU_CONVOLUTION_H_
+
+#include "nnet_fwd.h"
+
+// These compute the same results as their counterparts in core/ref, on the
+// same NCHW layouts, and likewise do not handle zero padding. Their scratch
+// comes from the activation arena, and the _scratch_size functions return
+// how much of it they use.
+
+void cpu_convolution3d_no_padding(float* a,
+                                  float* kernels,
+                                  layer_t curr_layer,
+                                  float* result);
+
+size_t cpu_convolution3d_scratch_size(layer_t* curr_layer);
+
+void cpu_convolution3d_pointwise_nopadding(float* a,
+                                           float* kernels,
+                                           layer_t curr_layer,
+                                           float* result);
+
+size_t cpu_convolution3d_pointwise_scratch_size(layer_t* curr_layer);
+
+void cpu_convolution2d_depthwise_nopadding(float* a,
+                                           float* kernels,
+                                           layer_t curr_layer,
+                                           float* result);
+
+#endif
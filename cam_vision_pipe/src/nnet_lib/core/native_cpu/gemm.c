@@ -0,0 +1,345 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/native_cpu/gemm.h"
+#include "utility/activation_arena.h"
+#include "utility/utility.h"
+#include "nnet_fwd.h"
+
+typedef float gemm_vec_t
+        __attribute__((__vector_size__(GEMM_VECTOR_SIZE * sizeof(float)),
+                       __aligned__(sizeof(float))));
+
+// Access the GEMM_VECTOR_SIZE floats starting at ptr.
+#define VEC_AT(ptr) (*(gemm_vec_t*)(ptr))
+
+// Every x86 part with AVX2 also has FMA3, so the micro-kernel fuses its
+// multiplies and adds even when the build only asks for -mavx2.
+#if defined(__AVX2__) && !defined(__FMA__)
+#define GEMM_KERNEL_ATTRS __attribute__((target("fma")))
+#else
+#define GEMM_KERNEL_ATTRS
+#endif
+
+gemm_matrix_t gemm_row_major(float* d, int ld) {
+    gemm_matrix_t matrix = { d, ld, 1, NULL, NULL };
+    return matrix;
+}
+
+gemm_matrix_t gemm_col_major(float* d, int ld) {
+    gemm_matrix_t matrix = { d, 1, ld, NULL, NULL };
+    return matrix;
+}
+
+// Offsets of len consecutive rows or columns of a matrix, starting at start.
+static void gemm_offsets(
+        const int* offsets, int stride, int start, int len, int* result) {
+    for (int i = 0; i < len; i++)
+        result[i] = offsets ? offsets[start + i] : (start + i) * stride;
+}
+
+// Returns true if consecutive elements of each row of a matrix are adjacent.
+static bool gemm_rows_contiguous(gemm_matrix_t* matrix) {
+    return !matrix->col_offsets && matrix->col_stride == 1;
+}
+
+// Returns true if consecutive elements of each column of a matrix are
+// adjacent.
+static bool gemm_cols_contiguous(gemm_matrix_t* matrix) {
+    return !matrix->row_offsets && matrix->row_stride == 1;
+}
+
+// Pack rows i0 to i0 + mc and columns k0 to k0 + kc of A into panels of
+// GEMM_MR rows. Each panel is stored column by column, and the last one is
+// padded with zeros.
+static void gemm_pack_a(
+        gemm_matrix_t* a, int i0, int mc, int k0, int kc, float* packed) {
+    int row_offsets[GEMM_MR];
+    int col_offsets[GEMM_KC];
+    gemm_offsets(a->col_offsets, a->col_stride, k0, kc, col_offsets);
+
+    gemm_pack_a_panels:
+    for (int i = 0; i < mc; i += GEMM_MR) {
+        int rows = min2(GEMM_MR, mc - i);
+        gemm_offsets(a->row_offsets, a->row_stride, i0 + i, rows, row_offsets);
+        // Columns of a panel are adjacent in a column major A, like the
+        // kernels of a pointwise convolution.
+        bool dense = rows == GEMM_MR;
+        for (int r = 1; r < rows && dense; r++)
+            dense = row_offsets[r] == row_offsets[0] + r;
+        gemm_pack_a_cols:
+        for (int kk = 0; kk < kc; kk++) {
+            float* src = a->d + col_offsets[kk];
+            if (dense) {
+                memcpy(packed, src + row_offsets[0], GEMM_MR * sizeof(float));
+            } else {
+                int r = 0;
+                for (; r < rows; r++)
+                    packed[r] = src[row_offsets[r]];
+                for (; r < GEMM_MR; r++)
+                    packed[r] = 0;
+            }
+            packed += GEMM_MR;
+        }
+    }
+}
+
+// Pack rows k0 to k0 + kc and columns j0 to j0 + nc of B into panels of
+// GEMM_NR columns. Each panel is stored row by row, and the last one is
+// padded with zeros.
+static void gemm_pack_b(
+        gemm_matrix_t* b, int k0, int kc, int j0, int nc, float* packed) {
+    int row_offsets[GEMM_KC];
+    int col_offsets[GEMM_NR];
+    gemm_offsets(b->row_offsets, b->row_stride, k0, kc, row_offsets);
+
+    gemm_pack_b_panels:
+    for (int j = 0; j < nc; j += GEMM_NR) {
+        int cols = min2(GEMM_NR, nc - j);
+        gemm_offsets(b->col_offsets, b->col_stride, j0 + j, cols, col_offsets);
+        // Rows of a panel are often adjacent in memory, even when B is
+        // gathered (like the pixels of one row of a convolution output).
+        bool dense = cols == GEMM_NR;
+        for (int c = 1; c < cols && dense; c++)
+            dense = col_offsets[c] == col_offsets[0] + c;
+        gemm_pack_b_rows:
+        for (int kk = 0; kk < kc; kk++) {
+            float* src = b->d + row_offsets[kk];
+            if (dense) {
+                memcpy(packed, src + col_offsets[0], GEMM_NR * sizeof(float));
+            } else {
+                int c = 0;
+                for (; c < cols; c++)
+                    packed[c] = src[col_offsets[c]];
+                for (; c < GEMM_NR; c++)
+                    packed[c] = 0;
+            }
+            packed += GEMM_NR;
+        }
+    }
+}
+
+// Multiply a packed panel of A with a packed panel of B over kc, and store
+// the GEMM_MR x GEMM_NR product in tile.
+//
+// The accumulators are fully unrolled so that they live in registers for
+// the whole loop. Each step loads two vectors of B, and broadcasts each of
+// the GEMM_MR values of A against both.
+GEMM_KERNEL_ATTRS
+static void gemm_micro_kernel(int kc, float* a, float* b, float* tile) {
+    gemm_vec_t c0[GEMM_MR];
+    gemm_vec_t c1[GEMM_MR];
+    #pragma GCC unroll 16
+    for (int r = 0; r < GEMM_MR; r++) {
+        c0[r] = (gemm_vec_t){ 0 };
+        c1[r] = (gemm_vec_t){ 0 };
+    }
+
+    gemm_micro_kernel_k:
+    for (int p = 0; p < kc; p++) {
+        gemm_vec_t b0 = VEC_AT(b);
+        gemm_vec_t b1 = VEC_AT(b + GEMM_VECTOR_SIZE);
+        #pragma GCC unroll 16
+        for (int r = 0; r < GEMM_MR; r++) {
+            c0[r] += a[r] * b0;
+            c1[r] += a[r] * b1;
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    #pragma GCC unroll 16
+    for (int r = 0; r < GEMM_MR; r++) {
+        VEC_AT(tile + r * GEMM_NR) = c0[r];
+        VEC_AT(tile + r * GEMM_NR + GEMM_VECTOR_SIZE) = c1[r];
+    }
+}
+
+// Write the rows x cols corner of a tile to C at (i0, j0). The first KC block
+// of a product overwrites C and adds the biases, later ones accumulate.
+static void gemm_store_tile(gemm_matrix_t* c,
+                            int i0,
+                            int rows,
+                            int j0,
+                            int cols,
+                            float* tile,
+                            bool first,
+                            float* row_bias,
+                            float* col_bias) {
+    int row_offsets[GEMM_MR];
+    int col_offsets[GEMM_NR];
+    gemm_offsets(c->row_offsets, c->row_stride, i0, rows, row_offsets);
+
+    if (gemm_rows_contiguous(c) && cols == GEMM_NR) {
+        gemm_vec_t bias0 = { 0 };
+        gemm_vec_t bias1 = { 0 };
+        if (first && col_bias) {
+            bias0 = VEC_AT(col_bias + j0);
+            bias1 = VEC_AT(col_bias + j0 + GEMM_VECTOR_SIZE);
+        }
+        gemm_store_tile_vec_rows:
+        for (int r = 0; r < rows; r++) {
+            float* dst = c->d + row_offsets[r] + j0;
+            gemm_vec_t val0 = VEC_AT(tile + r * GEMM_NR);
+            gemm_vec_t val1 = VEC_AT(tile + r * GEMM_NR + GEMM_VECTOR_SIZE);
+            if (first) {
+                float bias = row_bias ? row_bias[i0 + r] : 0;
+                VEC_AT(dst) = val0 + bias0 + bias;
+                VEC_AT(dst + GEMM_VECTOR_SIZE) = val1 + bias1 + bias;
+            } else {
+                VEC_AT(dst) += val0;
+                VEC_AT(dst + GEMM_VECTOR_SIZE) += val1;
+            }
+        }
+        return;
+    }
+
+    gemm_offsets(c->col_offsets, c->col_stride, j0, cols, col_offsets);
+    gemm_store_tile_rows:
+    for (int r = 0; r < rows; r++) {
+        float* dst = c->d + row_offsets[r];
+        gemm_store_tile_cols:
+        for (int j = 0; j < cols; j++) {
+            float val = tile[r * GEMM_NR + j];
+            if (first) {
+                if (row_bias)
+                    val += row_bias[i0 + r];
+                if (col_bias)
+                    val += col_bias[j0 + j];
+                dst[col_offsets[j]] = val;
+            } else {
+                dst[col_offsets[j]] += val;
+            }
+        }
+    }
+}
+
+// Dot product of two dense vectors.
+static float gemm_dot(float* x, float* y, int len) {
+    gemm_vec_t acc0 = { 0 };
+    gemm_vec_t acc1 = { 0 };
+    int i = 0;
+    for (; i + GEMM_NR <= len; i += GEMM_NR) {
+        acc0 += VEC_AT(x + i) * VEC_AT(y + i);
+        acc1 += VEC_AT(x + i + GEMM_VECTOR_SIZE) *
+                VEC_AT(y + i + GEMM_VECTOR_SIZE);
+    }
+    acc0 += acc1;
+    float sum = 0;
+    for (int l = 0; l < GEMM_VECTOR_SIZE; l++)
+        sum += acc0[l];
+    for (; i < len; i++)
+        sum += x[i] * y[i];
+    return sum;
+}
+
+// With fewer rows of A than a micro-kernel covers, as in an FC layer run on a
+// handful of images, packing B costs as much as the multiply itself. If B is
+// dense, it is streamed once in place instead.
+//
+// Returns false if the layout of the operands is not handled here.
+static bool gemm_small_m(int m,
+                         int n,
+                         int k,
+                         gemm_matrix_t* a,
+                         gemm_matrix_t* b,
+                         float* row_bias,
+                         float* col_bias,
+                         gemm_matrix_t* c) {
+    if (!gemm_rows_contiguous(c) || c->row_offsets || a->row_offsets ||
+        a->col_offsets)
+        return false;
+
+    if (gemm_rows_contiguous(b) && !b->row_offsets) {
+        // Accumulate each row of B into every row of C.
+        for (int i = 0; i < m; i++) {
+            float* c_row = c->d + i * c->row_stride;
+            float bias = row_bias ? row_bias[i] : 0;
+            for (int j = 0; j < n; j++)
+                c_row[j] = bias + (col_bias ? col_bias[j] : 0);
+        }
+        gemm_small_m_k:
+        for (int kk = 0; kk < k; kk++) {
+            float* b_row = b->d + kk * b->row_stride;
+            gemm_small_m_rows:
+            for (int i = 0; i < m; i++) {
+                float* c_row = c->d + i * c->row_stride;
+                float a_val = a->d[i * a->row_stride + kk * a->col_stride];
+                gemm_small_m_cols:
+                for (int j = 0; j < n; j++)
+                    c_row[j] += a_val * b_row[j];
+            }
+        }
+        return true;
+    }
+
+    if (gemm_cols_contiguous(b) && !b->col_offsets && a->col_stride == 1) {
+        // Each element of C is the dot product of a row of A and a column of
+        // B.
+        gemm_small_m_dot_cols:
+        for (int j = 0; j < n; j++) {
+            float* b_col = b->d + j * b->col_stride;
+            gemm_small_m_dot_rows:
+            for (int i = 0; i < m; i++) {
+                float val = gemm_dot(a->d + i * a->row_stride, b_col, k);
+                if (row_bias)
+                    val += row_bias[i];
+                if (col_bias)
+                    val += col_bias[j];
+                c->d[i * c->row_stride + j] = val;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+size_t cpu_gemm_scratch_size() {
+    return arena_buffer_bytes(GEMM_MC * GEMM_KC * sizeof(float)) +
+           arena_buffer_bytes(GEMM_KC * GEMM_NC * sizeof(float));
+}
+
+void cpu_gemm_with_bias(int m,
+                        int n,
+                        int k,
+                        gemm_matrix_t* a,
+                        gemm_matrix_t* b,
+                        float* row_bias,
+                        float* col_bias,
+                        gemm_matrix_t* c) {
+    if (m < GEMM_MR &&
+        gemm_small_m(m, n, k, a, b, row_bias, col_bias, c))
+        return;
+
+    float* packed_a = (float*)arena_malloc(GEMM_MC * GEMM_KC * sizeof(float));
+    float* packed_b = (float*)arena_malloc(GEMM_KC * GEMM_NC * sizeof(float));
+    float tile[GEMM_MR * GEMM_NR] __attribute__((aligned(CACHELINE_SIZE)));
+
+    gemm_nc:
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = min2(GEMM_NC, n - jc);
+        gemm_kc:
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = min2(GEMM_KC, k - pc);
+            gemm_pack_b(b, pc, kc, jc, nc, packed_b);
+            gemm_mc:
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                int mc = min2(GEMM_MC, m - ic);
+                gemm_pack_a(a, ic, mc, pc, kc, packed_a);
+                gemm_nr:
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    gemm_mr:
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        gemm_micro_kernel(kc, packed_a + ir * kc,
+                                          packed_b + jr * kc, tile);
+                        gemm_store_tile(c, ic + ir, min2(GEMM_MR, mc - ir),
+                                        jc + jr, min2(GEMM_NR, nc - jr), tile,
+                                        pc == 0, row_bias, col_bias);
+                    }
+                }
+            }
+        }
+    }
+    arena_free(packed_b);
+    arena_free(packed_a);
+}
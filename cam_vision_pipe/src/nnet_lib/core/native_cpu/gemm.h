@@ -0,0 +1,78 @@
+#ifndef _CORE_NATIVE_CPU_GEMM_H_
+#define _CORE_NATIVE_CPU_GEMM_H_
+
+#include <stddef.h>
+
+// Blocked single precision GEMM for the NATIVE_CPU backend.
+//
+// C = A * B is computed the way optimized BLAS libraries do it. B is packed
+// KC x NC at a time into panels of GEMM_NR columns, A is packed MC x KC at a
+// time into panels of GEMM_MR rows, and a micro-kernel keeps a GEMM_MR x
+// GEMM_NR block of C in registers while it streams one panel of each through
+// the KC loop. The packed panel of B stays in L2 (or L3) across the rows of
+// A, and the packed panel of A stays in L1 across the columns of B.
+//
+// The micro-kernel is written with GCC vector extensions, so its width
+// follows the instruction set the backend is compiled for: two vectors of
+// 16 floats with AVX-512, of 8 with AVX, and of 4 otherwise.
+
+#if defined(__AVX512F__)
+#define GEMM_VECTOR_SIZE 16
+// With 32 vector registers, 24 accumulators fit.
+#define GEMM_MR 12
+#elif defined(__AVX__)
+#define GEMM_VECTOR_SIZE 8
+#define GEMM_MR 6
+#else
+#define GEMM_VECTOR_SIZE 4
+#define GEMM_MR 6
+#endif
+#define GEMM_NR (2 * GEMM_VECTOR_SIZE)
+
+// Cache blocking. KC * GEMM_NR floats of B and KC * GEMM_MR floats of A are
+// touched per micro-kernel call, MC * KC floats of A are reused from L2, and
+// KC * NC floats of B from L3.
+#define GEMM_KC 256
+#define GEMM_MC (GEMM_MR * 16)
+#define GEMM_NC (GEMM_NR * 128)
+
+// A view of a matrix stored anywhere in memory.
+//
+// Element (i, j) is at d[row_offset(i) + col_offset(j)], where each offset
+// is looked up in row_offsets or col_offsets if they are given, and is
+// otherwise i * row_stride or j * col_stride. Strides express row and
+// column major matrices; offset tables express matrices that are gathered
+// from a tensor, like the im2col expansion of the input of a convolution,
+// without ever building them.
+typedef struct _gemm_matrix_t {
+    float* d;
+    int row_stride;
+    int col_stride;
+    const int* row_offsets;
+    const int* col_offsets;
+} gemm_matrix_t;
+
+// Returns a view of a dense row major matrix whose rows are ld apart.
+gemm_matrix_t gemm_row_major(float* d, int ld);
+
+// Returns a view of a dense column major matrix whose columns are ld apart.
+gemm_matrix_t gemm_col_major(float* d, int ld);
+
+// C = A * B + bias, for an m x k matrix A and a k x n matrix B.
+//
+// row_bias has one value per row of C and col_bias one per column; either or
+// both may be NULL. C must not overlap A or B. The packed panels are scratch
+// from the activation arena.
+void cpu_gemm_with_bias(int m,
+                        int n,
+                        int k,
+                        gemm_matrix_t* a,
+                        gemm_matrix_t* b,
+                        float* row_bias,
+                        float* col_bias,
+                        gemm_matrix_t* c);
+
+// Returns the bytes of activation arena scratch cpu_gemm_with_bias() uses.
+size_t cpu_gemm_scratch_size();
+
+#endif
@@ -0,0 +1,50 @@
+#include "core/native_cpu/gemm.h"
+#include "core/native_cpu/matrix_multiply.h"
+#include "nnet_fwd.h"
+
+// Multiply matrices a and b, assuming both are row major and the last row of b
+// are biases.
+//
+// Args:
+//   a_height = height of A matrix.
+//   b_height = height of the B matrix, which is also the width of the A matrix
+//     + 1.
+//   b_width = width of the B matrix.
+void cpu_matrix_multiply_with_bias(float* a,
+                                   float* b,
+                                   int a_height,
+                                   int b_height,
+                                   int b_width,
+                                   float* result) {
+    int a_width = b_height - 1;
+    gemm_matrix_t a_mat = gemm_row_major(a, a_width);
+    gemm_matrix_t b_mat = gemm_row_major(b, b_width);
+    gemm_matrix_t result_mat = gemm_row_major(result, b_width);
+    float* biases = b + a_width * b_width;
+    cpu_gemm_with_bias(a_height, b_width, a_width, &a_mat, &b_mat, NULL,
+                       biases, &result_mat);
+}
+
+// Multiply the matrices a and b, but assume that b has been transposed (col
+// major).
+//
+// The biases are stored after all elements in b.
+//
+// Args:
+//   a_height = height of the A matrix.
+//   b_width = width of the TRANSPOSED B matrix + 1.
+//   b_height = height of the TRANSPOSED B matrix.
+void cpu_matrix_multiply_with_bias_transpose(float* a,
+                                             float* b,
+                                             int a_height,
+                                             int b_width,
+                                             int b_height,
+                                             float* result) {
+    int a_width = b_width - 1;
+    gemm_matrix_t a_mat = gemm_row_major(a, a_width);
+    gemm_matrix_t b_mat = gemm_col_major(b, a_width);
+    gemm_matrix_t result_mat = gemm_row_major(result, b_height);
+    float* biases = b + b_height * a_width;
+    cpu_gemm_with_bias(a_height, b_height, a_width, &a_mat, &b_mat, NULL,
+                       biases, &result_mat);
+}
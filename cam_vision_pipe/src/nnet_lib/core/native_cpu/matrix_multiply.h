@@ -0,0 +1,22 @@
+#ifndef _CORE_NATIVE_CPU_MATRIX_MULTIPLY_H_
+#define _CORE_NATIVE_CPU_MATRIX_MULTIPLY_H_
+
+// These take the same arguments as matrix_multiply_with_bias() and
+// matrix_multiply_with_bias_transpose() in core/ref, and compute the same
+// result with the blocked GEMM.
+
+void cpu_matrix_multiply_with_bias(float* a,
+                                   float* b,
+                                   int a_height,
+                                   int b_height,
+                                   int b_width,
+                                   float* result);
+
+void cpu_matrix_multiply_with_bias_transpose(float* a,
+                                             float* b,
+                                             int a_height,
+                                             int b_width,
+                                             int b_height,
+                                             float* result);
+
+#endif
@@ -0,0 +1,224 @@
+#include <stdlib.h>
+
+#include "core/native_cpu/gemm.h"
+#include "core/native_cpu/winograd.h"
+#include "core/ref/winograd.h"
+#include "utility/activation_arena.h"
+#include "utility/utility.h"
+#include "nnet_fwd.h"
+
+// Number of tiles that are transformed and multiplied at once.
+#define WINOGRAD_TILE_BLOCK 128
+
+// Compute L X L^T for n tiles at once, where L is out_dim x in_dim and each X
+// is in_dim x in_dim.
+//
+// Element (i, j) of tile t is at x[(i * in_dim + j) * x_stride + t], and
+// likewise in result with result_stride, so every step of the transform is a
+// vector operation across the tiles. temp holds out_dim * in_dim * n floats.
+static void winograd_transform_block(const float* left,
+                                     int out_dim,
+                                     int in_dim,
+                                     const float* x,
+                                     int x_stride,
+                                     float* result,
+                                     int result_stride,
+                                     int n,
+                                     float* temp) {
+    ARRAY_2D(const float, _left, left, in_dim);
+    ARRAY_3D(float, _temp, temp, in_dim, n);
+
+    // temp = L X.
+    for (int i = 0; i < out_dim; i++) {
+        for (int j = 0; j < in_dim; j++) {
+            float* temp_row = &_temp[i][j][0];
+            for (int t = 0; t < n; t++)
+                temp_row[t] = 0;
+            for (int k = 0; k < in_dim; k++) {
+                const float coeff = _left[i][k];
+                if (coeff == 0)
+                    continue;
+                const float* x_row = x + (k * in_dim + j) * x_stride;
+                for (int t = 0; t < n; t++)
+                    temp_row[t] += coeff * x_row[t];
+            }
+        }
+    }
+    // result = temp L^T.
+    for (int i = 0; i < out_dim; i++) {
+        for (int j = 0; j < out_dim; j++) {
+            float* result_row = result + (i * out_dim + j) * result_stride;
+            for (int t = 0; t < n; t++)
+                result_row[t] = 0;
+            for (int k = 0; k < in_dim; k++) {
+                const float coeff = _left[j][k];
+                if (coeff == 0)
+                    continue;
+                const float* temp_row = &_temp[i][k][0];
+                for (int t = 0; t < n; t++)
+                    result_row[t] += coeff * temp_row[t];
+            }
+        }
+    }
+}
+
+// Returns the number of tiles in a block of the convolution, which is the
+// row length of every buffer it transforms.
+static int winograd_block_stride(layer_t* curr_layer) {
+    const int tile = curr_layer->winograd_tile;
+    const int tile_rows = FRAC_CEIL(curr_layer->outputs.rows, tile);
+    const int tile_cols = FRAC_CEIL(curr_layer->outputs.cols, tile);
+    // Small layers use shorter rows, so that their blocks stay compact.
+    return min2(WINOGRAD_TILE_BLOCK, NUM_TEST_CASES * tile_rows * tile_cols);
+}
+
+size_t cpu_winograd_scratch_size(layer_t* curr_layer) {
+    const int alpha = WINOGRAD_ALPHA(curr_layer->winograd_tile);
+    const size_t position_bytes =
+            alpha * alpha * winograd_block_stride(curr_layer) * sizeof(float);
+    return arena_buffer_bytes(position_bytes * curr_layer->inputs.height) +
+           arena_buffer_bytes(position_bytes * curr_layer->outputs.height) +
+           2 * arena_buffer_bytes(position_bytes) + cpu_gemm_scratch_size();
+}
+
+// Perform a 3D convolution over the data in @a with all kernels, using the
+// transformed filters of curr_layer.winograd_tile.
+//
+// Once the inputs of a tile are transformed, every one of its alpha^2
+// positions is an independent dot product over the input channels. So tiles
+// are processed a block at a time: their transformed inputs form one
+// channels x tiles matrix per position, the kernels x channels matrix of
+// transformed filters for that position is multiplied by each of those, and
+// the products of each kernel are transformed back for all the tiles of the
+// block together.
+void cpu_winograd_convolution3d_no_padding(float* a,
+                                           float* kernels,
+                                           layer_t curr_layer,
+                                           float* result) {
+    const int tile = curr_layer.winograd_tile;
+    const int alpha = WINOGRAD_ALPHA(tile);
+    const int alpha_sq = alpha * alpha;
+    const float* input_transform = get_winograd_input_transform(tile);
+    const float* output_transform = get_winograd_output_transform(tile);
+
+    const int a_height = curr_layer.inputs.height;
+    const int a_rows = curr_layer.inputs.rows;
+    const int a_cols = curr_layer.inputs.cols;
+    const int a_width = a_cols + curr_layer.inputs.align_pad;
+
+    const int num_kerns = curr_layer.outputs.height;
+    const int result_rows = curr_layer.outputs.rows;
+    const int result_cols = curr_layer.outputs.cols;
+    const int result_width = result_cols + curr_layer.outputs.align_pad;
+    const int tile_rows = FRAC_CEIL(result_rows, tile);
+    const int tile_cols = FRAC_CEIL(result_cols, tile);
+    const int image_tiles = tile_rows * tile_cols;
+    // Blocks run across images, so that the transformed filters, which are
+    // four times the size of the original ones, are read once per block of
+    // the whole batch rather than once per image.
+    const int num_tiles = NUM_TEST_CASES * image_tiles;
+    const int block_stride = winograd_block_stride(&curr_layer);
+
+    ARRAY_4D(float, _a, a, a_height, a_rows, a_width);
+    ARRAY_4D(float, _result, result, num_kerns, result_rows, result_width);
+
+    // Transformed inputs, [position][channel][tile], and their products with
+    // the filters, [position][kernel][tile].
+    float* transformed = (float*)arena_malloc(
+            alpha_sq * a_height * block_stride * sizeof(float));
+    float* products = (float*)arena_malloc(
+            alpha_sq * num_kerns * block_stride * sizeof(float));
+    // Input tiles of one channel, then output tiles of one kernel, both
+    // [position][tile].
+    float* tiles =
+            (float*)arena_malloc(alpha_sq * block_stride * sizeof(float));
+    float* temp =
+            (float*)arena_malloc(alpha_sq * block_stride * sizeof(float));
+    ARRAY_3D(float, _transformed, transformed, a_height, block_stride);
+    ARRAY_3D(float, _products, products, num_kerns, block_stride);
+    ARRAY_2D(float, _tiles, tiles, block_stride);
+
+    // The image and the top left output of each tile of a block.
+    int tile_img[WINOGRAD_TILE_BLOCK];
+    int tile_row0[WINOGRAD_TILE_BLOCK];
+    int tile_col0[WINOGRAD_TILE_BLOCK];
+
+    winograd_tile_blocks:
+    for (int t0 = 0; t0 < num_tiles; t0 += block_stride) {
+        const int block_size = min2(block_stride, num_tiles - t0);
+        for (int t = 0; t < block_size; t++) {
+            const int image_tile = (t0 + t) % image_tiles;
+            tile_img[t] = (t0 + t) / image_tiles;
+            tile_row0[t] = (image_tile / tile_cols) * tile;
+            tile_col0[t] = (image_tile % tile_cols) * tile;
+        }
+
+        winograd_input_chans:
+        for (int d = 0; d < a_height; d++) {
+            for (int t = 0; t < block_size; t++) {
+                const float* origin =
+                        &_a[tile_img[t]][d][tile_row0[t]][tile_col0[t]];
+                const int rows = min2(alpha, a_rows - tile_row0[t]);
+                const int cols = min2(alpha, a_cols - tile_col0[t]);
+                if (rows == alpha && cols == alpha) {
+                    for (int i = 0; i < alpha; i++) {
+                        for (int j = 0; j < alpha; j++)
+                            _tiles[i * alpha + j][t] = origin[i * a_width + j];
+                    }
+                    continue;
+                }
+                // Inputs past the edge only feed outputs past the edge, which
+                // are dropped, so they are read as zeros.
+                for (int i = 0; i < alpha; i++) {
+                    for (int j = 0; j < alpha; j++) {
+                        _tiles[i * alpha + j][t] =
+                                i < rows && j < cols ? origin[i * a_width + j]
+                                                     : 0;
+                    }
+                }
+            }
+            winograd_transform_block(input_transform, alpha, alpha, tiles,
+                                     block_stride, &_transformed[0][d][0],
+                                     a_height * block_stride, block_size,
+                                     temp);
+        }
+
+        // The transformed filters of each position are read as the transpose
+        // of a channels x kernels matrix, and columns of it are adjacent, so
+        // they pack cheaply for every block.
+        winograd_positions:
+        for (int xi = 0; xi < alpha_sq; xi++) {
+            gemm_matrix_t filters_mat = gemm_col_major(
+                    kernels + xi * a_height * num_kerns, num_kerns);
+            gemm_matrix_t inputs_mat =
+                    gemm_row_major(&_transformed[xi][0][0], block_stride);
+            gemm_matrix_t products_mat =
+                    gemm_row_major(&_products[xi][0][0], block_stride);
+            cpu_gemm_with_bias(num_kerns, block_size, a_height, &filters_mat,
+                               &inputs_mat, NULL, NULL, &products_mat);
+        }
+
+        winograd_output_kernels:
+        for (int k = 0; k < num_kerns; k++) {
+            winograd_transform_block(output_transform, tile, alpha,
+                                     &_products[0][k][0],
+                                     num_kerns * block_stride, tiles,
+                                     block_stride, block_size, temp);
+            for (int t = 0; t < block_size; t++) {
+                const int rows = min2(tile, result_rows - tile_row0[t]);
+                const int cols = min2(tile, result_cols - tile_col0[t]);
+                float* origin =
+                        &_result[tile_img[t]][k][tile_row0[t]][tile_col0[t]];
+                for (int i = 0; i < rows; i++) {
+                    for (int j = 0; j < cols; j++)
+                        origin[i * result_width + j] = _tiles[i * tile + j][t];
+                }
+            }
+        }
+    }
+
+    arena_free(temp);
+    arena_free(tiles);
+    arena_free(products);
+    arena_free(transformed);
+}
@@ -0,0 +1,16 @@
+#ifndef _CORE_NATIVE_CPU_WINOGRAD_H_
+#define _CORE_NATIVE_CPU_WINOGRAD_H_
+
+#include "nnet_fwd.h"
+
+// Computes the same results as winograd_convolution3d_no_padding() in
+// core/ref, on the same layouts.
+void cpu_winograd_convolution3d_no_padding(float* a,
+                                           float* kernels,
+                                           layer_t curr_layer,
+                                           float* result);
+
+// Returns the bytes of activation arena scratch the convolution uses.
+size_t cpu_winograd_scratch_size(layer_t* curr_layer);
+
+#endif
@@ -237,6 +237,16 @@ typedef struct _layer_t {
 
   input_pp input_preprocessing;
 
+  // True if the host inputs of this layer are already fp16 NHWC, laid out as
+  // convert_nchw_to_nhwc() would produce them, so they are used in place. The
+  // camera pipeline can write the input of the first convolution this way.
+  bool host_inputs_nhwc;
+
+  // CONV_STANDARD layers only. If nonzero, the layer runs as Winograd
+  // F(m x m, 3 x 3) with this m, and its transformed filters follow its
+  // weights in host_weights.
+  int winograd_tile;
+
   io_req_t input_req;
   io_req_t weights_req;
   io_req_t output_req;
@@ -303,13 +313,15 @@ typedef struct _sampling_param_t {
 // This defines the structure of the nnet accelerator - whether it is a
 // monolithic block or a collection of multiple blocks.
 //
-// Allowed values are: MONOLITHIC, COMPOSABLE, EIGEN, MKLDNN, SMIV, SMV
+// Allowed values are: MONOLITHIC, COMPOSABLE, EIGEN, MKLDNN, SMIV, SMV,
+// NATIVE_CPU
 #define MONOLITHIC 0
 #define COMPOSABLE 1
 #define SMIV 2
 #define EIGEN 3
 #define MKLDNN 4
 #define SMV 5
+#define NATIVE_CPU 6
 
 // Possible values of SIGMOID_TABLE_IMPL
 #define EXP_UNIT 0
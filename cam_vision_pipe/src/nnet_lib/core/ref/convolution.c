@@ -1,3 +1,7 @@
+#include <assert.h>
+#include <float.h>
+
+#include "core/ref/activation_functions.h"
 #include "core/ref/convolution.h"
 #include "core/ref/pooling.h"
 #include "core/ref/zeropad.h"
@@ -165,6 +169,141 @@ void convolution3d_kernel_no_padding(float* a,
     }
 }
 
+// Perform a 3D convolution with all kernels, apply the activation function of
+// @conv_layer, and downsample the result with the pooling operation of
+// @pool_layer, which must directly follow the convolution.
+//
+// This computes the same values as convolution3d_no_padding(), then
+// activation_fun(), then max_pooling() or avg_pooling(), but the activations
+// before pooling never leave a buffer of a few rows. The result has the
+// dimensions of the outputs of @pool_layer.
+void convolution3d_act_pool_no_padding(float* a,
+                                       float* kernels,
+                                       layer_t conv_layer,
+                                       layer_t pool_layer,
+                                       float* result) {
+    conv_pool_per_image:
+    for (int ni = 0; ni < NUM_TEST_CASES; ni++) {
+        conv_pool_per_kernel:
+        for (int nk = 0; nk < conv_layer.outputs.height; nk++) {
+            convolution3d_act_pool_kernel(
+                    a, kernels, ni, nk, conv_layer, pool_layer, result);
+        }
+    }
+}
+
+// Compute one output row of the convolution of one 3D image with one 3D
+// kernel into @row, in the same order of operations as
+// convolution3d_kernel_no_padding().
+static void convolution3d_kernel_row(float* a,
+                                     float* kernels,
+                                     int img,
+                                     int kern,
+                                     int out_row,
+                                     layer_t curr_layer,
+                                     float* row) {
+    const int a_height = curr_layer.inputs.rows;
+    const int a_width = curr_layer.inputs.cols + curr_layer.inputs.align_pad;
+    const int k_rows = curr_layer.weights.rows;
+    const int k_cols = curr_layer.weights.cols;
+    const int k_height = curr_layer.inputs.height;
+    const int k_pad = curr_layer.weights.align_pad;
+    const int col_stride = curr_layer.stride.cols;
+    const int end_j = curr_layer.inputs.cols - k_cols + 1;
+    const int i = out_row * curr_layer.stride.rows;
+
+    ARRAY_4D(float, _a, a, k_height, a_height, a_width);
+    ARRAY_4D(float, _kernels, kernels, k_height, k_rows, k_cols + k_pad);
+
+    int out_j = 0;
+    conv_row_input_cols:
+    for (int j = 0; j < end_j; j += col_stride) {
+        float partial_sum = 0;
+        conv_row_kernel_height:
+        for (int d = 0; d < k_height; d++) {
+            conv_row_kernel_rows:
+            for (int k = 0; k < k_rows; k++) {
+                conv_row_kernel_cols:
+                for (int l = 0; l < k_cols; l++) {
+                    float a_val = conv_float2fixed(_a[img][d][i + k][j + l]);
+                    float kern_val =
+                            conv_float2fixed(_kernels[kern][d][k][l]);
+                    partial_sum += conv_float2fixed(a_val * kern_val);
+                }
+            }
+        }
+        row[out_j] = partial_sum;
+        out_j++;
+    }
+}
+
+// Convolve one 3D image with one 3D kernel, then activate and pool the output
+// feature map.
+//
+// The convolution rows go into a ring of as many rows as the pooling window
+// is tall, and each row of pooled outputs is produced as soon as its window
+// of rows is complete. Overlapping windows reuse the rows already in the
+// ring, and rows that no window covers are never computed.
+void convolution3d_act_pool_kernel(float* a,
+                                   float* kernels,
+                                   int img,
+                                   int kern,
+                                   layer_t conv_layer,
+                                   layer_t pool_layer,
+                                   float* result) {
+    const int conv_cols = conv_layer.outputs.cols;
+    const int pool_size = pool_layer.weights.cols;
+    const int pool_row_stride = pool_layer.stride.rows;
+    const int pool_col_stride = pool_layer.stride.cols;
+    const int result_rows = pool_layer.outputs.rows;
+    const int result_cols = pool_layer.outputs.cols;
+    const int result_pad = pool_layer.outputs.align_pad;
+    const float recip_total_size = 1.0 / (pool_size * pool_size);
+
+    assert(pool_size <= MAX_FUSED_POOL_SIZE &&
+           "Pooling window is too large to fuse with the convolution!");
+    assert(conv_cols <= MAX_FUSED_CONV_COLS &&
+           "Convolution output is too wide to fuse with the pooling!");
+    float conv_rows[MAX_FUSED_POOL_SIZE][MAX_FUSED_CONV_COLS];
+    ARRAY_4D(float, _result, result, pool_layer.outputs.height, result_rows,
+             result_cols + result_pad);
+
+    // The first convolution row that is not in the ring yet.
+    int next_row = 0;
+    conv_pool_output_rows:
+    for (int oi = 0; oi < result_rows; oi++) {
+        int first_row = oi * pool_row_stride;
+        next_row = max2(next_row, first_row);
+        conv_pool_fill_rows:
+        for (; next_row < first_row + pool_size; next_row++) {
+            float* row = conv_rows[next_row % pool_size];
+            convolution3d_kernel_row(
+                    a, kernels, img, kern, next_row, conv_layer, row);
+            activation_fun(row, 1, conv_cols, 0, conv_layer.activation);
+        }
+
+        conv_pool_output_cols:
+        for (int oj = 0; oj < result_cols; oj++) {
+            int first_col = oj * pool_col_stride;
+            float curr_max = -FLT_MAX;
+            float curr_sum = 0;
+            conv_pool_iter_outer:
+            for (int k = 0; k < pool_size; k++) {
+                float* row = conv_rows[(first_row + k) % pool_size];
+                conv_pool_iter_inner:
+                for (int l = 0; l < pool_size; l++) {
+                    float in_val = row[first_col + l];
+                    curr_max = max2(in_val, curr_max);
+                    curr_sum += in_val;
+                }
+            }
+            _result[img][kern][oi][oj] = pool_layer.pool == MAX
+                                                 ? curr_max
+                                                 : curr_sum * recip_total_size;
+        }
+    }
+}
+
 // Applies a 2D filter from weights channel @chan on inputs channel n.
 void convolution2d_depthwise_single_kernel(float* a,
                                            float* kernels,
@@ -3,6 +3,12 @@
 
 #include "nnet_fwd.h"
 
+// Bounds of the ring of convolution rows that convolution3d_act_pool_kernel()
+// keeps on the stack: the size of the pooling window, and the number of
+// output columns of the convolution.
+#define MAX_FUSED_POOL_SIZE 4
+#define MAX_FUSED_CONV_COLS 512
+
 void convolution3d_zeropad(float* input,
                            float* kernels,
                            layer_t* layers,
@@ -18,6 +24,18 @@ void convolution3d_kernel_no_padding(float* a,
                                      int kern,
                                      layer_t curr_layer,
                                      float* result);
+void convolution3d_act_pool_no_padding(float* a,
+                                       float* kernels,
+                                       layer_t conv_layer,
+                                       layer_t pool_layer,
+                                       float* result);
+void convolution3d_act_pool_kernel(float* a,
+                                   float* kernels,
+                                   int img,
+                                   int kern,
+                                   layer_t conv_layer,
+                                   layer_t pool_layer,
+                                   float* result);
 
 void convolution2d_depthwise_zeropad(
         float* input, float* kernels, layer_t* layers, int lnum, float* result);
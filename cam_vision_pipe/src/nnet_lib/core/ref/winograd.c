@@ -0,0 +1,241 @@
+#include "core/ref/winograd.h"
+#include "utility/utility.h"
+#include "nnet_fwd.h"
+
+// Transform matrices of F(2x2, 3x3).
+static const float kWinogradF2_BT[4][4] = {
+    { 1, 0, -1, 0 },
+    { 0, 1, 1, 0 },
+    { 0, -1, 1, 0 },
+    { 0, 1, 0, -1 },
+};
+static const float kWinogradF2_G[4][3] = {
+    { 1, 0, 0 },
+    { 0.5, 0.5, 0.5 },
+    { 0.5, -0.5, 0.5 },
+    { 0, 0, 1 },
+};
+static const float kWinogradF2_AT[2][4] = {
+    { 1, 1, 1, 0 },
+    { 0, 1, -1, -1 },
+};
+
+// Transform matrices of F(4x4, 3x3).
+static const float kWinogradF4_BT[6][6] = {
+    { 4, 0, -5, 0, 1, 0 },
+    { 0, -4, -4, 1, 1, 0 },
+    { 0, 4, -4, -1, 1, 0 },
+    { 0, -2, -1, 2, 1, 0 },
+    { 0, 2, -1, -2, 1, 0 },
+    { 0, 4, 0, -5, 0, 1 },
+};
+static const float kWinogradF4_G[6][3] = {
+    { 1.0 / 4, 0, 0 },
+    { -1.0 / 6, -1.0 / 6, -1.0 / 6 },
+    { -1.0 / 6, 1.0 / 6, -1.0 / 6 },
+    { 1.0 / 24, 1.0 / 12, 1.0 / 6 },
+    { 1.0 / 24, -1.0 / 12, 1.0 / 6 },
+    { 0, 0, 1 },
+};
+static const float kWinogradF4_AT[4][6] = {
+    { 1, 1, 1, 1, 1, 0 },
+    { 0, 1, -1, 2, -2, 0 },
+    { 0, 1, 1, 4, 4, 0 },
+    { 0, 1, -1, 8, -8, 1 },
+};
+
+// Compute L X L^T, where L is out_dim x in_dim and X is in_dim x in_dim.
+// Most entries of the transform matrices are zero, and are skipped.
+static void winograd_transform_2d(const float* left,
+                                  int out_dim,
+                                  int in_dim,
+                                  float* x,
+                                  float* result) {
+    float temp[WINOGRAD_MAX_ALPHA][WINOGRAD_MAX_ALPHA];
+    ARRAY_2D(const float, _left, left, in_dim);
+    ARRAY_2D(float, _x, x, in_dim);
+    ARRAY_2D(float, _result, result, out_dim);
+
+    // temp = L X.
+    winograd_left_rows:
+    for (int i = 0; i < out_dim; i++) {
+        for (int j = 0; j < in_dim; j++)
+            temp[i][j] = 0;
+        winograd_left_inner:
+        for (int k = 0; k < in_dim; k++) {
+            float coeff = _left[i][k];
+            if (coeff == 0)
+                continue;
+            for (int j = 0; j < in_dim; j++)
+                temp[i][j] += coeff * _x[k][j];
+        }
+    }
+    // result = temp L^T.
+    winograd_right_rows:
+    for (int i = 0; i < out_dim; i++) {
+        winograd_right_cols:
+        for (int j = 0; j < out_dim; j++) {
+            float sum = 0;
+            for (int k = 0; k < in_dim; k++) {
+                float coeff = _left[j][k];
+                if (coeff != 0)
+                    sum += temp[i][k] * coeff;
+            }
+            _result[i][j] = sum;
+        }
+    }
+}
+
+bool winograd_eligible(layer_t* curr_layer) {
+    return curr_layer->type == CONV_STANDARD &&
+           curr_layer->weights.rows == 3 && curr_layer->weights.cols == 3 &&
+           curr_layer->stride.rows == 1 && curr_layer->stride.cols == 1;
+}
+
+int get_num_winograd_weights(layer_t* curr_layer, int tile) {
+    const int alpha = WINOGRAD_ALPHA(tile);
+    return curr_layer->outputs.height * alpha * alpha *
+           curr_layer->inputs.height;
+}
+
+void winograd_transform_filters(float* kernels,
+                                layer_t curr_layer,
+                                int tile,
+                                float* result) {
+    const int alpha = WINOGRAD_ALPHA(tile);
+    const int num_kerns = curr_layer.outputs.height;
+    const int k_height = curr_layer.inputs.height;
+    const int k_pad = curr_layer.weights.align_pad;
+    const float* g = tile == 4 ? &kWinogradF4_G[0][0] : &kWinogradF2_G[0][0];
+
+    ARRAY_4D(float, _kernels, kernels, k_height, 3, 3 + k_pad);
+    ARRAY_3D(float, _result, result, k_height, num_kerns);
+
+    float filter[3][3];
+    float transformed[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA];
+    winograd_filter_kernels:
+    for (int k = 0; k < num_kerns; k++) {
+        winograd_filter_chans:
+        for (int d = 0; d < k_height; d++) {
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++)
+                    filter[i][j] = _kernels[k][d][i][j];
+            }
+            winograd_transform_2d(g, alpha, 3, &filter[0][0], transformed);
+            for (int xi = 0; xi < alpha * alpha; xi++)
+                _result[xi][d][k] = transformed[xi];
+        }
+    }
+}
+
+const float* get_winograd_input_transform(int tile) {
+    return tile == 4 ? &kWinogradF4_BT[0][0] : &kWinogradF2_BT[0][0];
+}
+
+const float* get_winograd_output_transform(int tile) {
+    return tile == 4 ? &kWinogradF4_AT[0][0] : &kWinogradF2_AT[0][0];
+}
+
+void winograd_transform_input_tile(float* tile_inputs,
+                                   int tile,
+                                   float* result) {
+    const int alpha = WINOGRAD_ALPHA(tile);
+    winograd_transform_2d(get_winograd_input_transform(tile), alpha, alpha,
+                          tile_inputs, result);
+}
+
+void winograd_transform_output_tile(float* products, int tile, float* result) {
+    winograd_transform_2d(get_winograd_output_transform(tile), tile,
+                          WINOGRAD_ALPHA(tile), products, result);
+}
+
+int get_winograd_scratch_size(layer_t* curr_layer) {
+    const int alpha = WINOGRAD_ALPHA(curr_layer->winograd_tile);
+    return alpha * alpha * curr_layer->inputs.height;
+}
+
+void winograd_convolution3d_no_padding(float* a,
+                                       float* kernels,
+                                       layer_t curr_layer,
+                                       float* scratch,
+                                       float* result) {
+    const int tile = curr_layer.winograd_tile;
+    const int alpha = WINOGRAD_ALPHA(tile);
+    const int alpha_sq = alpha * alpha;
+
+    const int a_height = curr_layer.inputs.height;
+    const int a_rows = curr_layer.inputs.rows;
+    const int a_cols = curr_layer.inputs.cols;
+    const int a_width = a_cols + curr_layer.inputs.align_pad;
+
+    const int num_kerns = curr_layer.outputs.height;
+    const int result_rows = curr_layer.outputs.rows;
+    const int result_cols = curr_layer.outputs.cols;
+    const int result_width = result_cols + curr_layer.outputs.align_pad;
+    const int tile_rows = FRAC_CEIL(result_rows, tile);
+    const int tile_cols = FRAC_CEIL(result_cols, tile);
+
+    ARRAY_4D(float, _a, a, a_height, a_rows, a_width);
+    ARRAY_3D(float, _kernels, kernels, a_height, num_kerns);
+    ARRAY_4D(float, _result, result, num_kerns, result_rows, result_width);
+
+    // The transformed inputs of one tile, for every channel.
+    ARRAY_2D(float, _transformed, scratch, a_height);
+    // Tiles are stored densely, alpha or tile values to a row.
+    float tile_inputs[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA];
+    float tile_transformed[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA];
+    float products[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA];
+    float tile_outputs[4 * 4];
+
+    winograd_per_image:
+    for (int img = 0; img < NUM_TEST_CASES; img++) {
+        winograd_tile_rows:
+        for (int tr = 0; tr < tile_rows; tr++) {
+            winograd_tile_cols:
+            for (int tc = 0; tc < tile_cols; tc++) {
+                const int row0 = tr * tile;
+                const int col0 = tc * tile;
+                winograd_input_chans:
+                for (int d = 0; d < a_height; d++) {
+                    // Inputs past the edge only feed outputs past the edge,
+                    // which are dropped, so they are read as zeros.
+                    for (int i = 0; i < alpha; i++) {
+                        for (int j = 0; j < alpha; j++) {
+                            bool inside =
+                                    row0 + i < a_rows && col0 + j < a_cols;
+                            tile_inputs[i * alpha + j] =
+                                    inside ? _a[img][d][row0 + i][col0 + j] : 0;
+                        }
+                    }
+                    winograd_transform_input_tile(
+                            tile_inputs, tile, tile_transformed);
+                    for (int xi = 0; xi < alpha_sq; xi++)
+                        _transformed[xi][d] = tile_transformed[xi];
+                }
+
+                winograd_kernels:
+                for (int k = 0; k < num_kerns; k++) {
+                    winograd_products:
+                    for (int xi = 0; xi < alpha_sq; xi++) {
+                        float partial_sum = 0;
+                        winograd_products_chans:
+                        for (int d = 0; d < a_height; d++) {
+                            partial_sum +=
+                                    _kernels[xi][d][k] * _transformed[xi][d];
+                        }
+                        products[xi] = partial_sum;
+                    }
+                    winograd_transform_output_tile(
+                            products, tile, tile_outputs);
+                    winograd_output_rows:
+                    for (int i = 0; i < tile && row0 + i < result_rows; i++) {
+                        winograd_output_cols:
+                        for (int j = 0; j < tile && col0 + j < result_cols; j++)
+                            _result[img][k][row0 + i][col0 + j] =
+                                    tile_outputs[i * tile + j];
+                    }
+                }
+            }
+        }
+    }
+}
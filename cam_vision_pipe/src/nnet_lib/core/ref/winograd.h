@@ -0,0 +1,69 @@
+#ifndef _WINOGRAD_H_
+#define _WINOGRAD_H_
+
+#include "nnet_fwd.h"
+
+// Winograd minimal filtering for 3x3, stride 1 standard convolutions.
+//
+// F(m x m, 3 x 3) computes an m x m tile of outputs from an alpha x alpha
+// tile of inputs, alpha = m + 2, with alpha^2 multiplies per input channel
+// instead of 9 m^2:
+//
+//   Y = A^T [(G g G^T) .* (B^T d B)] A
+//
+// where g is a 3x3 filter, d an input tile, and .* an elementwise product
+// that is summed over the input channels. F(2x2, 3x3) needs 2.25x fewer
+// multiplies than a direct convolution, and F(4x4, 3x3) 4x fewer, at the cost
+// of some accuracy.
+//
+// The filters are transformed once, ahead of the forward pass, and a layer
+// that runs this way has its tile size m in layer_t.winograd_tile.
+
+#define WINOGRAD_ALPHA(tile) ((tile) + 2)
+#define WINOGRAD_MAX_ALPHA 6
+
+// Returns true if the layer is a convolution that Winograd can run.
+bool winograd_eligible(layer_t* curr_layer);
+
+// Returns the number of elements of the transformed filters of a layer.
+int get_num_winograd_weights(layer_t* curr_layer, int tile);
+
+// Transform every filter of @kernels, which are laid out as for
+// convolution3d_no_padding().
+//
+// The result is stored as [alpha * alpha][channel][kernel], so that the
+// transformed filters of each tile position form a channels x kernels
+// matrix.
+void winograd_transform_filters(float* kernels,
+                                layer_t curr_layer,
+                                int tile,
+                                float* result);
+
+// Returns B^T, alpha x alpha, and A^T, tile x alpha, stored row major.
+const float* get_winograd_input_transform(int tile);
+const float* get_winograd_output_transform(int tile);
+
+// Compute B^T d B for one alpha x alpha tile of inputs. Tiles are stored
+// densely, row major.
+void winograd_transform_input_tile(float* tile_inputs, int tile, float* result);
+
+// Compute A^T M A for one alpha x alpha tile of products, giving a tile x tile
+// tile of outputs.
+void winograd_transform_output_tile(float* products, int tile, float* result);
+
+// Returns the number of elements of scratch that
+// winograd_convolution3d_no_padding() needs for a layer: the transformed
+// inputs of one tile, for every input channel.
+int get_winograd_scratch_size(layer_t* curr_layer);
+
+// Perform a 3D convolution over the data in @a with all kernels, like
+// convolution3d_no_padding(), using the filters transformed by
+// winograd_transform_filters() for curr_layer.winograd_tile. @scratch holds
+// get_winograd_scratch_size() elements.
+void winograd_convolution3d_no_padding(float* a,
+                                       float* kernels,
+                                       layer_t curr_layer,
+                                       float* scratch,
+                                       float* result);
+
+#endif
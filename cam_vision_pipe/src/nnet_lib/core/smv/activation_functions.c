@@ -7,6 +7,7 @@
 #include "core/ref/lookup_tables_ops.h"
 #include "core/smiv/params.h"
 #include "arch/smv/common.h"
+#include "utility/activation_arena.h"
 #include "utility/compression.h"
 #include "utility/utility.h"
 #include "nnet_fwd.h"
@@ -130,7 +131,7 @@ void activation_fun_simd128(packed_fp16* activations,
     packed_array.d = activations;
     packed_array.size = get_dims_size(input_dims) * batch_size / 2;
     begin_ignored_profiling(layer->num);
-    farray_t* unpacked_activations = unpack_data_fp16x4(&packed_array, NULL);
+    farray_t* unpacked_activations = arena_unpack_data_fp16x4(&packed_array);
     end_profiling();
 
 #ifdef __cplusplus
@@ -176,10 +177,8 @@ void activation_fun_simd128(packed_fp16* activations,
                    function);
 #endif
     begin_ignored_profiling(layer->num);
-    fp16array_t* packed_results = pack_data_fp16(unpacked_activations, results);
-    // This frees the malloc'ed pointer to the fp16array_t without freeing the
-    // buffer itself.
-    free(packed_results);
+    fp16array_t packed_results = { results, 0, false };
+    pack_data_fp16_into(unpacked_activations, &packed_results);
     free_farray(unpacked_activations);
     end_profiling();
 }
@@ -10,10 +10,12 @@
 #include "utility/compression.h"
 #include "utility/data_archive.h"
 #include "utility/data_archive_bin.h"
+#include "utility/fold_batch_norm.h"
 #include "utility/init_data.h"
 #include "utility/profiling.h"
 #include "utility/read_model_conf.h"
 #include "utility/utility.h"
+#include "utility/winograd_weights.h"
 
 #if ARCHITECTURE == EIGEN
 #include "utility/eigen/init_data.h"
@@ -195,40 +197,6 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
 
 static struct argp parser = {options, parse_opt, args_doc, prog_doc};
 
-size_t calc_layer_intermediate_memory(layer_t* layers, int lnum) {
-    size_t usage = 0, flattened_usage = 0;
-    layer_t layer = layers[lnum];
-
-    size_t inputs_size = layer.inputs.rows *
-                         (layer.inputs.cols + layer.inputs.align_pad) *
-                         layer.inputs.height;
-    size_t outputs_size = layer.outputs.rows *
-                          (layer.outputs.cols + layer.outputs.align_pad) *
-                          layer.outputs.height;
-
-    if (layer.type == INPUT) {
-        usage = inputs_size;
-    } else if (layer.type == FC) {
-        if (layer.input_preprocessing == FLATTEN) {
-            // Flattening the input will require the second buffer.
-            layer_t prev_layer = layers[lnum];
-            flattened_usage =
-                    prev_layer.outputs.rows *
-                    (prev_layer.outputs.cols + prev_layer.outputs.align_pad) *
-                    prev_layer.outputs.height;
-            usage = max2(outputs_size, flattened_usage);
-        } else {
-            usage = outputs_size;
-        }
-    } else if (layer.type == CONV_STANDARD || layer.type == CONV_DEPTHWISE ||
-               layer.type == CONV_POINTWISE || layer.type == POOLING) {
-        usage = max2(inputs_size, outputs_size);
-    } else {
-        usage = 0;
-    }
-    return usage * NUM_TEST_CASES;
-}
-
 void set_default_args(arguments* args) {
     args->num_inputs = 1;
     args->num_threads = 0;
@@ -426,8 +394,12 @@ int main(int argc, char* argv[]) {
 
     init_sigmoid_table(&sigmoid_table);
     init_exp_table(&exp_table);
+    fold_batch_norm_layers(
+            &network, &global_weights->data[0].dense, &compress_type);
     process_compressed_weights(
             &network, global_weights->data[0].dense, &compress_type);
+    transform_winograd_weights(&network);
+    init_nnet_fwd(inputs, outputs, &network, device);
     fflush(stdout);
 
     // Run a forward pass through the neural net
@@ -459,6 +431,7 @@ int main(int argc, char* argv[]) {
     printf("Fraction incorrect (over %d cases) = %f\n", NUM_TEST_CASES,
            error_fraction);
 
+    free_nnet_fwd(&network, device);
     if (sigmoid_table)
         free(sigmoid_table);
     if (exp_table)
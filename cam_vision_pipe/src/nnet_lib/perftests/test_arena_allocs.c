@@ -0,0 +1,162 @@
+// Checks that a forward pass does not touch the heap.
+//
+// Usage: test_arena_allocs [model.conf] [passes]
+//
+// The model defaults to $CAVA_HOME/sim/test.conf. The network is loaded and
+// init_nnet_fwd() plans its activation arena as in main(), and then nnet_fwd()
+// runs the given number of passes (two by default) on random inputs, without
+// sampling and without the profiling log. Every malloc(), calloc(), realloc()
+// and posix_memalign() the library makes during a pass is counted. This must
+// be linked with
+//   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=posix_memalign
+// and returns nonzero if any pass allocates.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/interface.h"
+#include "core/nnet_fwd_defs.h"
+#include "core/ref/lookup_tables.h"
+#include "utility/fold_batch_norm.h"
+#include "utility/init_data.h"
+#include "utility/read_model_conf.h"
+#include "utility/utility.h"
+#include "utility/winograd_weights.h"
+
+int INPUT_DIM;
+int NUM_CLASSES;
+int NUM_TEST_CASES = 2;
+int NUM_WORKER_THREADS = 0;
+float* sigmoid_table = NULL;
+float* exp_table = NULL;
+sigmoid_impl_t SIGMOID_IMPL = ExpUnit;
+
+static bool counting = false;
+static int num_allocs = 0;
+static size_t num_alloc_bytes = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+int __real_posix_memalign(void** ptr, size_t alignment, size_t size);
+
+static void count_alloc(size_t size) {
+    if (counting) {
+        num_allocs++;
+        num_alloc_bytes += size;
+    }
+}
+
+void* __wrap_malloc(size_t size) {
+    count_alloc(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size) {
+    count_alloc(nmemb * size);
+    return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    count_alloc(size);
+    return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void** ptr, size_t alignment, size_t size) {
+    count_alloc(size);
+    return __real_posix_memalign(ptr, alignment, size);
+}
+
+// Wrap the dense weights of each layer, as main() does for uncompressed
+// weights.
+static void init_host_weights(network_t* network, farray_t* weights) {
+    for (int i = 1; i < network->depth; i++) {
+        layer_t* layer = &network->layers[i];
+        farray_t* layer_weights = init_farray(0, false);
+        layer_weights->d =
+                weights->d + get_weights_loc_for_layer(network->layers, i);
+        layer_weights->size = get_num_weights_layer(layer, 0);
+        layer->host_weights = init_data_list(1);
+        layer->host_weights->data[0].dense = layer_weights;
+        layer->host_weights->type[0] = Uncompressed;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    char conf_path[256];
+    if (argc > 1) {
+        snprintf(conf_path, sizeof(conf_path), "%s", argv[1]);
+    } else {
+        const char* cava_home = getenv("CAVA_HOME");
+        if (cava_home == NULL) {
+            fprintf(stderr, "CAVA_HOME returned NULL\n");
+            exit(1);
+        }
+        snprintf(conf_path, sizeof(conf_path), "%s/sim/test.conf", cava_home);
+    }
+    int num_passes = argc > 2 ? atoi(argv[2]) : 2;
+    srand(1);
+
+    network_t network;
+    device_t* device;
+    sampling_param_t* sampling_param;
+    network.depth = configure_network_from_file(
+            conf_path, &network.layers, &device, &sampling_param);
+    // Run whole passes: sampled ones report to the profiling log, which
+    // allocates its entries as it goes.
+    memset(sampling_param, 0, sizeof(*sampling_param));
+
+    data_list* inputs = init_data_list(1);
+    data_list* outputs = init_data_list(1);
+    data_list* global_weights = init_data_list(1);
+    global_weights->data[0].dense = init_farray(
+            get_total_num_weights(network.layers, network.depth), false);
+    global_weights->type[0] = Uncompressed;
+    init_weights(global_weights->data[0].dense->d, network.layers,
+                 network.depth, RANDOM, TRANSPOSE_WEIGHTS);
+    inputs->data[0].dense = init_farray(
+            NUM_TEST_CASES * get_dims_size(&network.layers[0].inputs), true);
+    inputs->type[0] = Uncompressed;
+    init_data(inputs->data[0].dense->d, &network, NUM_TEST_CASES, RANDOM);
+    iarray_t compress_type = { NULL, (size_t)network.depth };
+    compress_type.d = (int*)calloc(compress_type.size, sizeof(int));
+
+    init_sigmoid_table(&sigmoid_table);
+    init_exp_table(&exp_table);
+    fold_batch_norm_layers(
+            &network, &global_weights->data[0].dense, &compress_type);
+    init_host_weights(&network, global_weights->data[0].dense);
+    transform_winograd_weights(&network);
+    init_nnet_fwd(inputs, outputs, &network, device);
+
+    int num_failed = 0;
+    for (int pass = 0; pass < num_passes; pass++) {
+        num_allocs = 0;
+        num_alloc_bytes = 0;
+        counting = true;
+        nnet_fwd(inputs, global_weights, outputs, &network, device,
+                 sampling_param);
+        counting = false;
+        bool passed = num_allocs == 0;
+        printf("%s, pass %d: %d heap allocations, %lu bytes %s\n",
+               ARCH_STR, pass, num_allocs, num_alloc_bytes,
+               passed ? "" : "FAILED");
+        num_failed += !passed;
+    }
+
+    free_nnet_fwd(&network, device);
+    free(sigmoid_table);
+    free(exp_table);
+    for (int i = 1; i < network.depth; i++)
+        free_data_list(network.layers[i].host_weights);
+    free_data_list(inputs);
+    free_data_list(outputs);
+    free_data_list(global_weights);
+    free(compress_type.d);
+    free(network.layers);
+    free(device);
+    free(sampling_param);
+    return num_failed > 0;
+}
@@ -0,0 +1,200 @@
+// Checks that nnet_fwd(), which runs each standard convolution that
+// can_fuse_conv_act_pool() accepts together with the pooling layer after it,
+// gives the same results as running every layer on its own.
+//
+// Usage: test_conv_pool_fusion [model.conf]
+//
+// The model defaults to $CAVA_HOME/sim/test.conf, and must have at least one
+// convolution that fuses with its pooling layer. The unfused pass calls
+// layer_dispatcher() and then activation_fun() for each layer, as the
+// reference backends do when a layer does not fuse. Winograd weights are not
+// set up, since a Winograd convolution never fuses. Returns nonzero if the
+// results differ.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/common.h"
+#include "arch/interface.h"
+#include "core/nnet_fwd_defs.h"
+#include "core/ref/activation_functions.h"
+#include "core/ref/lookup_tables.h"
+#include "utility/init_data.h"
+#include "utility/read_model_conf.h"
+#include "utility/utility.h"
+
+int INPUT_DIM;
+int NUM_CLASSES;
+int NUM_TEST_CASES = 2;
+int NUM_WORKER_THREADS = 0;
+float* sigmoid_table = NULL;
+float* exp_table = NULL;
+sigmoid_impl_t SIGMOID_IMPL = ExpUnit;
+
+#if ARCHITECTURE == MONOLITHIC || ARCHITECTURE == COMPOSABLE
+
+// Wrap the dense weights of each layer, as main() does for uncompressed
+// weights.
+static void init_host_weights(network_t* network, farray_t* weights) {
+    for (int i = 1; i < network->depth; i++) {
+        layer_t* layer = &network->layers[i];
+        farray_t* layer_weights = init_farray(0, false);
+        layer_weights->d =
+                weights->d + get_weights_loc_for_layer(network->layers, i);
+        layer_weights->size = get_num_weights_layer(layer, 0);
+        layer->host_weights = init_data_list(1);
+        layer->host_weights->data[0].dense = layer_weights;
+        layer->host_weights->type[0] = Uncompressed;
+    }
+}
+
+// Run every layer of network on its own, ping-ponging between two lists as
+// nnet_fwd() does. Returns the list that holds the result.
+static data_list* run_unfused(data_list* inputs,
+                              network_t* network,
+                              device_t* device,
+                              sampling_param_t* sampling_param,
+                              data_list* activations,
+                              data_list* results) {
+    layer_t* layers = network->layers;
+    farray_t* input_data = inputs->data[0].dense;
+    activations->data[0].dense = init_farray(input_data->size, false);
+    activations->type[0] = Uncompressed;
+    memcpy(activations->data[0].dense->d, input_data->d,
+           input_data->size * sizeof(float));
+
+    result_buf result_loc = activations;
+    for (int l = 1; l < network->depth; l++) {
+        if (result_loc == results)
+            SWAP_PTRS(activations, results);
+        result_loc = layer_dispatcher(activations, layers[l].host_weights,
+                                      layers, l, results, device,
+                                      sampling_param);
+        if (layers[l].activation != NO_ACTIVATION) {
+            activation_fun(result_loc->data[0].dense->d, NUM_TEST_CASES,
+                           get_dims_size(&layers[l].outputs),
+                           layers[l].outputs.align_pad, layers[l].activation);
+        }
+    }
+    return result_loc;
+}
+
+// Returns the largest difference between the outputs in results and
+// expected, relative to the largest expected value, ignoring the alignment
+// padding.
+static float max_rel_diff(float* results, float* expected, dims_t* dims) {
+    ARRAY_4D(float, _results, results, dims->height, dims->rows,
+             dims->cols + dims->align_pad);
+    ARRAY_4D(float, _expected, expected, dims->height, dims->rows,
+             dims->cols + dims->align_pad);
+    float max_diff = 0;
+    float max_val = 1e-6;
+    for (int n = 0; n < NUM_TEST_CASES; n++) {
+        for (int h = 0; h < dims->height; h++) {
+            for (int i = 0; i < dims->rows; i++) {
+                for (int j = 0; j < dims->cols; j++) {
+                    float val = _expected[n][h][i][j];
+                    max_diff = max2(max_diff,
+                                    fabsf(_results[n][h][i][j] - val));
+                    max_val = max2(max_val, fabsf(val));
+                }
+            }
+        }
+    }
+    return max_diff / max_val;
+}
+
+int main(int argc, char* argv[]) {
+    char conf_path[256];
+    if (argc > 1) {
+        snprintf(conf_path, sizeof(conf_path), "%s", argv[1]);
+    } else {
+        const char* cava_home = getenv("CAVA_HOME");
+        if (cava_home == NULL) {
+            fprintf(stderr, "CAVA_HOME returned NULL\n");
+            exit(1);
+        }
+        snprintf(conf_path, sizeof(conf_path), "%s/sim/test.conf", cava_home);
+    }
+    srand(1);
+
+    network_t network;
+    device_t* device;
+    sampling_param_t* sampling_param;
+    network.depth = configure_network_from_file(
+            conf_path, &network.layers, &device, &sampling_param);
+    memset(sampling_param, 0, sizeof(*sampling_param));
+
+    int num_fused = 0;
+    for (int l = 1; l < network.depth; l++) {
+        if (can_fuse_conv_act_pool(network.layers, l, network.depth)) {
+            printf("Layer %d is fused with pooling layer %d.\n", l, l + 1);
+            num_fused++;
+        }
+    }
+    if (num_fused == 0) {
+        fprintf(stderr, "%s has no convolution that fuses with pooling.\n",
+                conf_path);
+        return 1;
+    }
+
+    data_list* inputs = init_data_list(1);
+    data_list* outputs = init_data_list(1);
+    data_list* global_weights = init_data_list(1);
+    global_weights->data[0].dense = init_farray(
+            get_total_num_weights(network.layers, network.depth), false);
+    global_weights->type[0] = Uncompressed;
+    init_weights(global_weights->data[0].dense->d, network.layers,
+                 network.depth, RANDOM, TRANSPOSE_WEIGHTS);
+    inputs->data[0].dense = init_farray(
+            NUM_TEST_CASES * get_dims_size(&network.layers[0].inputs), true);
+    inputs->type[0] = Uncompressed;
+    init_data(inputs->data[0].dense->d, &network, NUM_TEST_CASES, RANDOM);
+
+    init_sigmoid_table(&sigmoid_table);
+    init_exp_table(&exp_table);
+    init_host_weights(&network, global_weights->data[0].dense);
+
+    data_list* activations = init_data_list(1);
+    data_list* results = init_data_list(1);
+    data_list* expected = run_unfused(inputs, &network, device, sampling_param,
+                                      activations, results);
+
+    init_nnet_fwd(inputs, outputs, &network, device);
+    nnet_fwd(inputs, global_weights, outputs, &network, device,
+             sampling_param);
+
+    dims_t* out_dims = &network.layers[network.depth - 1].outputs;
+    float diff = max_rel_diff(outputs->data[0].dense->d,
+                              expected->data[0].dense->d, out_dims);
+    bool passed = diff < 1e-5;
+    printf("%s, %d fused layers: rel diff %g %s\n", ARCH_STR, num_fused, diff,
+           passed ? "" : "FAILED");
+
+    free_nnet_fwd(&network, device);
+    free(sigmoid_table);
+    free(exp_table);
+    for (int i = 1; i < network.depth; i++)
+        free_data_list(network.layers[i].host_weights);
+    free_data_list(inputs);
+    free_data_list(outputs);
+    free_data_list(activations);
+    free_data_list(results);
+    free_data_list(global_weights);
+    free(network.layers);
+    free(device);
+    free(sampling_param);
+    return !passed;
+}
+
+#else
+
+int main(int argc, char* argv[]) {
+    printf("%s does not fuse convolutions with pooling.\n", ARCH_STR);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core/nnet_fwd_defs.h"
+#include "core/ref/batch_norm.h"
+#include "core/ref/convolution.h"
+#include "core/ref/matrix_multiply.h"
+#include "utility/fold_batch_norm.h"
+#include "utility/init_data.h"
+#include "utility/utility.h"
+
+// Checks that folding a batch norm layer into the FC or pointwise convolution
+// before it gives the same results as running batch_norm_fxp() on the outputs
+// of that layer, with transposed and untransposed FC weights, and with the
+// variance stored both as is and as 1/sqrt(var + eps). Also reports the time
+// the fold saves on each shape.
+
+int INPUT_DIM;
+int NUM_CLASSES;
+int NUM_TEST_CASES = 2;
+int NUM_WORKER_THREADS = 0;
+float* sigmoid_table = NULL;
+float* exp_table = NULL;
+sigmoid_impl_t SIGMOID_IMPL = ExpUnit;
+
+// Same epsilon that init_bn_weights() uses.
+#define BN_EPSILON 1e-5
+
+typedef struct _fold_shape {
+    layer_type type;
+    // Whether FC weights are stored transposed, as TRANSPOSE_WEIGHTS would
+    // set.
+    bool transpose;
+    int rows;
+    int cols;
+    int chans;
+    int kernels;
+    // Alignment of the activations and weights, as DATA_ALIGNMENT would set.
+    // The reference FC kernels do not handle padding.
+    int alignment;
+} fold_shape;
+
+// FC layers only use chans and kernels, as their inputs and outputs.
+static const fold_shape kFoldShapes[] = {
+    { FC, true, 1, 1, 100, 37, 0 },
+    { FC, true, 1, 1, 1024, 1000, 0 },
+    { FC, false, 1, 1, 100, 37, 0 },
+    { FC, false, 1, 1, 1024, 1000, 0 },
+    { CONV_POINTWISE, false, 17, 17, 7, 9, 8 },
+    { CONV_POINTWISE, false, 28, 28, 300, 64, 0 },
+};
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill_random(float* data, int size) {
+    for (int i = 0; i < size; i++)
+        data[i] = (float)rand() / RAND_MAX - 0.5;
+}
+
+// Returns the largest difference relative to the largest expected value.
+static float max_rel_diff(float* results, float* expected, int size) {
+    float max_diff = 0;
+    float max_val = 1e-6;
+    for (int i = 0; i < size; i++) {
+        max_diff = max2(max_diff, fabsf(results[i] - expected[i]));
+        max_val = max2(max_val, fabsf(expected[i]));
+    }
+    return max_diff / max_val;
+}
+
+// Build the layer and the batch norm after it with the dimensions that
+// read_model_conf would give them.
+static void make_layers(const fold_shape* shape,
+                        layer_t* layer,
+                        layer_t* bn_layer) {
+    memset(layer, 0, sizeof(layer_t));
+    memset(bn_layer, 0, sizeof(layer_t));
+    layer->type = shape->type;
+    layer->activation = NO_ACTIVATION;
+    bn_layer->type = BATCH_NORM;
+    bn_layer->activation = NO_ACTIVATION;
+    if (shape->type == FC) {
+        layer->inputs = (dims_t){ 1, shape->chans, 1, 0 };
+        layer->outputs = (dims_t){ 1, shape->kernels, 1, 0 };
+        layer->weights = (dims_t){ shape->chans, shape->kernels, 1, 0 };
+        layer->biases = (dims_t){ 1, shape->kernels, 1, 0 };
+        bn_layer->weights = (dims_t){ 4, shape->kernels, 1, 0 };
+    } else {
+        layer->inputs = (dims_t){ shape->rows, shape->cols, shape->chans,
+                                  calc_padding(shape->cols, shape->alignment) };
+        layer->outputs =
+                (dims_t){ shape->rows, shape->cols, shape->kernels,
+                          calc_padding(shape->cols, shape->alignment) };
+        layer->stride = (stride_dims){ 1, 1 };
+        layer->weights =
+                (dims_t){ shape->chans, shape->kernels, 1,
+                          calc_padding(shape->kernels, shape->alignment) };
+        layer->biases = (dims_t){ 1, shape->kernels, 1, 0 };
+        bn_layer->weights =
+                (dims_t){ 4, shape->kernels, 1,
+                          calc_padding(shape->kernels, shape->alignment) };
+    }
+    bn_layer->inputs = layer->outputs;
+    bn_layer->outputs = layer->outputs;
+}
+
+// Run the FC or pointwise convolution on inputs.
+static void run_layer(float* inputs,
+                      float* weights,
+                      const fold_shape* shape,
+                      layer_t* layer,
+                      float* results) {
+    if (shape->type == CONV_POINTWISE) {
+        convolution3d_pointwise_nopadding(inputs, weights, *layer, results);
+    } else if (shape->transpose) {
+        matrix_multiply_with_bias_transpose(inputs, weights, NUM_TEST_CASES,
+                                            shape->chans + 1, shape->kernels,
+                                            results);
+    } else {
+        matrix_multiply_with_bias(inputs, weights, NUM_TEST_CASES,
+                                  shape->chans + 1, shape->kernels, results);
+    }
+}
+
+static bool run_fold_test(const fold_shape* shape, bool precompute_variance) {
+    layer_t layer, bn_layer;
+    make_layers(shape, &layer, &bn_layer);
+    int weights_pad = layer.weights.align_pad;
+    int bn_pad = bn_layer.weights.align_pad;
+    int input_size = NUM_TEST_CASES * get_dims_size(&layer.inputs);
+    int result_size = NUM_TEST_CASES * get_dims_size(&layer.outputs);
+    // Both layouts take the same space: the weights, then a row of biases.
+    int weights_size = (shape->chans + 1) * (shape->kernels + weights_pad);
+    int bn_weights_size = 4 * (shape->kernels + bn_pad);
+    float* inputs = (float*)malloc_aligned(input_size * sizeof(float));
+    float* weights = (float*)malloc_aligned(weights_size * sizeof(float));
+    float* folded = (float*)malloc_aligned(weights_size * sizeof(float));
+    float* bn_weights = (float*)malloc_aligned(bn_weights_size * sizeof(float));
+    float* ref_bn_weights =
+            (float*)malloc_aligned(bn_weights_size * sizeof(float));
+    float* unnormalized = (float*)malloc_aligned(result_size * sizeof(float));
+    float* expected = (float*)malloc_aligned(result_size * sizeof(float));
+    float* results = (float*)malloc_aligned(result_size * sizeof(float));
+
+    fill_random(inputs, input_size);
+    memset(weights, 0, weights_size * sizeof(float));
+    if (shape->type == FC) {
+        init_fc_weights(weights, 1, shape->chans, shape->kernels, weights_pad,
+                        RANDOM, shape->transpose);
+    } else {
+        init_pointwise_conv_weights(weights, 1, shape->chans, shape->kernels,
+                                    weights_pad, RANDOM, false);
+    }
+    init_bn_weights(bn_weights, 1, 4, shape->kernels, bn_pad, RANDOM,
+                    precompute_variance);
+    // batch_norm_fxp() always expects 1/sqrt(var + eps).
+    memcpy(ref_bn_weights, bn_weights, bn_weights_size * sizeof(float));
+    if (!precompute_variance) {
+        float* var = ref_bn_weights + VarianceIndex * (shape->kernels + bn_pad);
+        for (int j = 0; j < shape->kernels; j++)
+            var[j] = 1.0 / sqrt(var[j] + BN_EPSILON);
+    }
+    // Only compare the outputs, not the alignment padding.
+    memset(unnormalized, 0, result_size * sizeof(float));
+    memset(expected, 0, result_size * sizeof(float));
+    memset(results, 0, result_size * sizeof(float));
+
+    double start = now();
+    run_layer(inputs, weights, shape, &layer, unnormalized);
+    batch_norm_fxp(unnormalized, ref_bn_weights, &bn_layer, NUM_TEST_CASES,
+                   expected);
+    double unfolded_time = now() - start;
+
+    memcpy(folded, weights, weights_size * sizeof(float));
+    fold_batch_norm_weights(&layer, &bn_layer, folded, bn_weights,
+                            shape->transpose, precompute_variance);
+    start = now();
+    run_layer(inputs, folded, shape, &layer, results);
+    double folded_time = now() - start;
+
+    float diff = max_rel_diff(results, expected, result_size);
+    bool passed = diff < 1e-5;
+    printf("%-9s %-12s %4dx%4dx%4d -> %4d, variance %-11s: "
+           "unfolded %8.3f ms, folded %8.3f ms, rel diff %g %s\n",
+           shape->type == FC ? "FC" : "POINTWISE",
+           shape->type == FC
+                   ? (shape->transpose ? "transposed" : "untransposed")
+                   : "",
+           shape->rows, shape->cols, shape->chans, shape->kernels,
+           precompute_variance ? "precomputed" : "as is",
+           unfolded_time * 1e3, folded_time * 1e3, diff,
+           passed ? "" : "FAILED");
+
+    free(inputs);
+    free(weights);
+    free(folded);
+    free(bn_weights);
+    free(ref_bn_weights);
+    free(unnormalized);
+    free(expected);
+    free(results);
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    srand(1);
+    int num_failed = 0;
+    int num_tests = 0;
+    int num_shapes = sizeof(kFoldShapes) / sizeof(kFoldShapes[0]);
+    for (int i = 0; i < num_shapes; i++) {
+        for (int precompute = 0; precompute <= 1; precompute++) {
+            num_failed += !run_fold_test(&kFoldShapes[i], precompute);
+            num_tests++;
+        }
+    }
+    printf("%d of %d tests failed.\n", num_failed, num_tests);
+    return num_failed > 0;
+}
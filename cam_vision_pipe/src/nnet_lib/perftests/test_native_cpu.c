@@ -0,0 +1,228 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core/native_cpu/convolution.h"
+#include "core/native_cpu/matrix_multiply.h"
+#include "core/nnet_fwd_defs.h"
+#include "core/ref/convolution.h"
+#include "core/ref/matrix_multiply.h"
+#include "utility/utility.h"
+
+// Checks the kernels of the NATIVE_CPU backend against the reference kernels
+// in core/ref, on shapes that exercise partial micro-kernel tiles, several KC
+// blocks, strides and alignment padding, and reports the throughput of each.
+
+int INPUT_DIM;
+int NUM_CLASSES;
+int NUM_TEST_CASES = 2;
+int NUM_WORKER_THREADS = 0;
+float* sigmoid_table = NULL;
+float* exp_table = NULL;
+sigmoid_impl_t SIGMOID_IMPL = ExpUnit;
+
+typedef struct _conv_shape {
+    layer_type type;
+    int rows;
+    int cols;
+    int chans;
+    int kernels;
+    int k_size;
+    int stride;
+    // Alignment of the activations and weights, as DATA_ALIGNMENT would set.
+    int alignment;
+} conv_shape;
+
+static const conv_shape kConvShapes[] = {
+    { CONV_STANDARD, 16, 16, 3, 4, 3, 1, 0 },
+    { CONV_STANDARD, 23, 19, 5, 13, 3, 2, 8 },
+    { CONV_STANDARD, 12, 12, 40, 20, 3, 1, 0 },  // Several KC blocks.
+    { CONV_STANDARD, 56, 56, 64, 64, 3, 1, 0 },
+    { CONV_POINTWISE, 17, 17, 7, 9, 1, 1, 8 },
+    { CONV_POINTWISE, 28, 28, 300, 64, 1, 1, 0 },
+    { CONV_POINTWISE, 16, 16, 8, 8, 1, 2, 0 },
+    { CONV_DEPTHWISE, 19, 21, 6, 6, 3, 1, 8 },
+    { CONV_DEPTHWISE, 56, 56, 64, 64, 3, 2, 0 },
+};
+
+typedef struct _fc_shape {
+    int batch;
+    int inputs;
+    int outputs;
+} fc_shape;
+
+static const fc_shape kFcShapes[] = {
+    { 1, 100, 37 },
+    { 2, 1024, 1000 },
+    { 7, 300, 45 },
+    { 64, 1024, 1024 },
+};
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill_random(float* data, int size) {
+    for (int i = 0; i < size; i++)
+        data[i] = (float)rand() / RAND_MAX - 0.5;
+}
+
+// Returns the largest difference relative to the largest expected value.
+static float max_rel_diff(float* results, float* expected, int size) {
+    float max_diff = 0;
+    float max_val = 1e-6;
+    for (int i = 0; i < size; i++) {
+        max_diff = max2(max_diff, fabsf(results[i] - expected[i]));
+        max_val = max2(max_val, fabsf(expected[i]));
+    }
+    return max_diff / max_val;
+}
+
+static layer_t make_conv_layer(const conv_shape* shape) {
+    layer_t layer;
+    memset(&layer, 0, sizeof(layer_t));
+    layer.type = shape->type;
+    layer.inputs = (dims_t){ shape->rows, shape->cols, shape->chans,
+                             calc_padding(shape->cols, shape->alignment) };
+    layer.stride = (stride_dims){ shape->stride, shape->stride };
+    int out_rows = (shape->rows - shape->k_size) / shape->stride + 1;
+    int out_cols = (shape->cols - shape->k_size) / shape->stride + 1;
+    layer.outputs = (dims_t){ out_rows, out_cols, shape->kernels,
+                              calc_padding(out_cols, shape->alignment) };
+    if (shape->type == CONV_POINTWISE) {
+        // One row of weights per input channel, then the biases.
+        layer.weights = (dims_t){ shape->chans + 1, shape->kernels, 1,
+                                  calc_padding(shape->kernels,
+                                               shape->alignment) };
+    } else {
+        int height = shape->type == CONV_DEPTHWISE ? 1 : shape->chans;
+        layer.weights =
+                (dims_t){ shape->k_size, shape->k_size, height,
+                          calc_padding(shape->k_size, shape->alignment) };
+    }
+    return layer;
+}
+
+static bool run_conv_test(const conv_shape* shape) {
+    layer_t layer = make_conv_layer(shape);
+    int input_size = NUM_TEST_CASES * get_dims_size(&layer.inputs);
+    int result_size = NUM_TEST_CASES * get_dims_size(&layer.outputs);
+    int weights_size = get_num_weights_layer(&layer, 0);
+    float* inputs = (float*)malloc_aligned(input_size * sizeof(float));
+    float* weights = (float*)malloc_aligned(weights_size * sizeof(float));
+    float* expected = (float*)malloc_aligned(result_size * sizeof(float));
+    float* results = (float*)malloc_aligned(result_size * sizeof(float));
+    fill_random(inputs, input_size);
+    fill_random(weights, weights_size);
+    // Only compare the outputs, not the alignment padding.
+    memset(expected, 0, result_size * sizeof(float));
+    memset(results, 0, result_size * sizeof(float));
+
+    double start = now();
+    if (shape->type == CONV_STANDARD)
+        convolution3d_no_padding(inputs, weights, layer, expected);
+    else if (shape->type == CONV_POINTWISE)
+        convolution3d_pointwise_nopadding(inputs, weights, layer, expected);
+    else
+        convolution2d_depthwise_nopadding(inputs, weights, layer, expected);
+    double ref_time = now() - start;
+
+    start = now();
+    if (shape->type == CONV_STANDARD)
+        cpu_convolution3d_no_padding(inputs, weights, layer, results);
+    else if (shape->type == CONV_POINTWISE)
+        cpu_convolution3d_pointwise_nopadding(inputs, weights, layer, results);
+    else
+        cpu_convolution2d_depthwise_nopadding(inputs, weights, layer, results);
+    double cpu_time = now() - start;
+
+    int window = shape->k_size * shape->k_size;
+    if (shape->type != CONV_DEPTHWISE)
+        window *= shape->chans;
+    double flops = 2.0 * NUM_TEST_CASES * layer.outputs.rows *
+                   layer.outputs.cols * layer.outputs.height * window;
+    float diff = max_rel_diff(results, expected, result_size);
+    bool passed = diff <= 1e-5;
+    printf("%-14s %3dx%3dx%3d -> %3d, %dx%d/%d: ref %7.2f GFLOPS, "
+           "native %7.2f GFLOPS, max rel difference %g %s\n",
+           LAYER_TYPE_STR(shape->type), shape->rows, shape->cols, shape->chans,
+           shape->kernels, shape->k_size, shape->k_size, shape->stride,
+           flops / ref_time * 1e-9, flops / cpu_time * 1e-9, diff,
+           passed ? "" : "FAILED");
+
+    free(inputs);
+    free(weights);
+    free(expected);
+    free(results);
+    return passed;
+}
+
+static bool run_fc_test(const fc_shape* shape, bool transpose) {
+    int input_size = shape->batch * shape->inputs;
+    int result_size = shape->batch * shape->outputs;
+    int weights_size = (shape->inputs + 1) * shape->outputs;
+    float* inputs = (float*)malloc_aligned(input_size * sizeof(float));
+    float* weights = (float*)malloc_aligned(weights_size * sizeof(float));
+    float* expected = (float*)malloc_aligned(result_size * sizeof(float));
+    float* results = (float*)malloc_aligned(result_size * sizeof(float));
+    fill_random(inputs, input_size);
+    fill_random(weights, weights_size);
+
+    double start = now();
+    if (transpose) {
+        matrix_multiply_with_bias_transpose(inputs, weights, shape->batch,
+                                            shape->inputs + 1, shape->outputs,
+                                            expected);
+    } else {
+        matrix_multiply_with_bias(inputs, weights, shape->batch,
+                                  shape->inputs + 1, shape->outputs, expected);
+    }
+    double ref_time = now() - start;
+
+    start = now();
+    if (transpose) {
+        cpu_matrix_multiply_with_bias_transpose(
+                inputs, weights, shape->batch, shape->inputs + 1,
+                shape->outputs, results);
+    } else {
+        cpu_matrix_multiply_with_bias(inputs, weights, shape->batch,
+                                      shape->inputs + 1, shape->outputs,
+                                      results);
+    }
+    double cpu_time = now() - start;
+
+    double flops = 2.0 * shape->batch * shape->inputs * shape->outputs;
+    float diff = max_rel_diff(results, expected, result_size);
+    bool passed = diff <= 1e-5;
+    printf("FC%-12s %3d x %4d -> %4d: ref %7.2f GFLOPS, "
+           "native %7.2f GFLOPS, max rel difference %g %s\n",
+           transpose ? " transposed" : "", shape->batch, shape->inputs,
+           shape->outputs, flops / ref_time * 1e-9, flops / cpu_time * 1e-9,
+           diff, passed ? "" : "FAILED");
+
+    free(inputs);
+    free(weights);
+    free(expected);
+    free(results);
+    return passed;
+}
+
+int main(int argc, const char* argv[]) {
+    const int num_conv_shapes = sizeof(kConvShapes) / sizeof(kConvShapes[0]);
+    const int num_fc_shapes = sizeof(kFcShapes) / sizeof(kFcShapes[0]);
+    int num_failed = 0;
+    srand(1);
+    for (int s = 0; s < num_conv_shapes; s++)
+        num_failed += !run_conv_test(&kConvShapes[s]);
+    for (int s = 0; s < num_fc_shapes; s++) {
+        num_failed += !run_fc_test(&kFcShapes[s], false);
+        num_failed += !run_fc_test(&kFcShapes[s], true);
+    }
+    printf("%d of %d tests failed.\n", num_failed,
+           num_conv_shapes + 2 * num_fc_shapes);
+    return num_failed > 0;
+}
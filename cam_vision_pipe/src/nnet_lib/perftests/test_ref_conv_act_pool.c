@@ -0,0 +1,205 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/nnet_fwd_defs.h"
+#include "core/ref/activation_functions.h"
+#include "core/ref/convolution.h"
+#include "core/ref/lookup_tables.h"
+#include "core/ref/pooling.h"
+#include "utility/utility.h"
+
+// Checks the fused convolution, activation function and pooling against the
+// reference convolution, activation_fun() and pooling, for every elementwise
+// activation function, for max and average pooling, and for pooling windows
+// that tile, overlap and skip the convolution outputs.
+//
+// The reference pooling functions only handle windows that tile their inputs
+// exactly, so overlapping and skipping windows are pooled here directly.
+
+int INPUT_DIM;
+int NUM_CLASSES;
+int NUM_TEST_CASES = 2;
+int NUM_WORKER_THREADS = 0;
+float* sigmoid_table = NULL;
+float* exp_table = NULL;
+sigmoid_impl_t SIGMOID_IMPL = ExpUnit;
+
+typedef struct _test_shape {
+    int rows;
+    int cols;
+    int chans;
+    int kernels;
+    int k_size;
+    int conv_stride;
+    int pool_size;
+    int pool_stride;
+} test_shape;
+
+static const test_shape kShapes[] = {
+    { 16, 16, 3, 4, 3, 1, 2, 2 },  // Tiling windows.
+    { 14, 11, 2, 3, 3, 1, 3, 3 },  // Tiling windows, odd sizes.
+    { 17, 17, 4, 2, 3, 1, 3, 2 },  // Overlapping windows.
+    { 20, 20, 2, 2, 2, 2, 2, 3 },  // Windows that skip rows.
+};
+
+static const char* kActivationNames[] = {
+    "none", "relu", "relu_thresh", "lrelu", "elu",
+    "selu", "tanh", "hard_tanh",   "sigmoid",
+};
+static const activation_type kActivations[] = {
+    NO_ACTIVATION, RELU, RELU_THRESHOLD, LRELU, ELU,
+    SELU,          TANH, HARD_TANH,      SIGMOID,
+};
+
+static void set_layers(const test_shape* shape,
+                       activation_type activation,
+                       pool_type pool,
+                       layer_t* conv_layer,
+                       layer_t* pool_layer) {
+    memset(conv_layer, 0, sizeof(layer_t));
+    conv_layer->type = CONV_STANDARD;
+    conv_layer->activation = activation;
+    conv_layer->inputs = (dims_t){ shape->rows, shape->cols, shape->chans,
+                                   calc_padding(shape->cols, DATA_ALIGNMENT) };
+    conv_layer->weights =
+            (dims_t){ shape->k_size, shape->k_size, shape->chans,
+                      calc_padding(shape->k_size, DATA_ALIGNMENT) };
+    conv_layer->stride = (stride_dims){ shape->conv_stride, shape->conv_stride };
+    int conv_rows = (shape->rows - shape->k_size) / shape->conv_stride + 1;
+    int conv_cols = (shape->cols - shape->k_size) / shape->conv_stride + 1;
+    conv_layer->outputs = (dims_t){ conv_rows, conv_cols, shape->kernels,
+                                    calc_padding(conv_cols, DATA_ALIGNMENT) };
+
+    memset(pool_layer, 0, sizeof(layer_t));
+    pool_layer->type = POOLING;
+    pool_layer->activation = NO_ACTIVATION;
+    pool_layer->pool = pool;
+    pool_layer->inputs = conv_layer->outputs;
+    pool_layer->weights = (dims_t){ shape->pool_size, shape->pool_size, 0, 0 };
+    pool_layer->stride = (stride_dims){ shape->pool_stride, shape->pool_stride };
+    int pool_rows = (conv_rows - shape->pool_size) / shape->pool_stride + 1;
+    int pool_cols = (conv_cols - shape->pool_size) / shape->pool_stride + 1;
+    pool_layer->outputs = (dims_t){ pool_rows, pool_cols, shape->kernels,
+                                    calc_padding(pool_cols, DATA_ALIGNMENT) };
+}
+
+static void pool_directly(float* input, layer_t pool_layer, float* result) {
+    const int size = pool_layer.weights.cols;
+    dims_t in = pool_layer.inputs;
+    dims_t out = pool_layer.outputs;
+    ARRAY_4D(float, _input, input, in.height, in.rows, in.cols + in.align_pad);
+    ARRAY_4D(float, _result, result, out.height, out.rows,
+             out.cols + out.align_pad);
+    for (int n = 0; n < NUM_TEST_CASES; n++) {
+        for (int h = 0; h < out.height; h++) {
+            for (int oi = 0; oi < out.rows; oi++) {
+                for (int oj = 0; oj < out.cols; oj++) {
+                    int i = oi * pool_layer.stride.rows;
+                    int j = oj * pool_layer.stride.cols;
+                    float curr_max = -INFINITY;
+                    float curr_sum = 0;
+                    for (int k = 0; k < size; k++) {
+                        for (int l = 0; l < size; l++) {
+                            float val = _input[n][h][i + k][j + l];
+                            curr_max = max2(curr_max, val);
+                            curr_sum += val;
+                        }
+                    }
+                    _result[n][h][oi][oj] =
+                            pool_layer.pool == MAX
+                                    ? curr_max
+                                    : curr_sum * (1.0 / (size * size));
+                }
+            }
+        }
+    }
+}
+
+// Returns the largest difference between the fused and unfused results.
+static float run_test(const test_shape* shape,
+                      activation_type activation,
+                      pool_type pool) {
+    layer_t conv_layer, pool_layer;
+    set_layers(shape, activation, pool, &conv_layer, &pool_layer);
+    layer_t layers[2] = { conv_layer, pool_layer };
+
+    int input_size = NUM_TEST_CASES * get_dims_size(&conv_layer.inputs);
+    int conv_size = NUM_TEST_CASES * get_dims_size(&conv_layer.outputs);
+    int result_size = NUM_TEST_CASES * get_dims_size(&pool_layer.outputs);
+    int weights_size = get_num_weights_layer(layers, 0);
+    float* inputs = (float*)malloc_aligned(input_size * sizeof(float));
+    float* weights = (float*)malloc_aligned(weights_size * sizeof(float));
+    float* conv_results = (float*)malloc_aligned(conv_size * sizeof(float));
+    float* expected = (float*)malloc_aligned(result_size * sizeof(float));
+    float* results = (float*)malloc_aligned(result_size * sizeof(float));
+    for (int i = 0; i < input_size; i++)
+        inputs[i] = (float)rand() / RAND_MAX - 0.5;
+    for (int i = 0; i < weights_size; i++)
+        weights[i] = (float)rand() / RAND_MAX - 0.5;
+    memset(expected, 0, result_size * sizeof(float));
+    memset(results, 0, result_size * sizeof(float));
+
+    convolution3d_no_padding(inputs, weights, conv_layer, conv_results);
+    activation_fun(conv_results, NUM_TEST_CASES,
+                   get_dims_size(&conv_layer.outputs),
+                   conv_layer.outputs.align_pad, activation);
+    if (shape->pool_size != shape->pool_stride)
+        pool_directly(conv_results, pool_layer, expected);
+    else if (pool == MAX)
+        max_pooling(conv_results, expected, pool_layer);
+    else
+        avg_pooling(conv_results, expected, pool_layer);
+
+    convolution3d_act_pool_no_padding(
+            inputs, weights, conv_layer, pool_layer, results);
+
+    dims_t out = pool_layer.outputs;
+    ARRAY_4D(float, _expected, expected, out.height, out.rows,
+             out.cols + out.align_pad);
+    ARRAY_4D(float, _results, results, out.height, out.rows,
+             out.cols + out.align_pad);
+    float max_diff = 0;
+    for (int n = 0; n < NUM_TEST_CASES; n++) {
+        for (int h = 0; h < out.height; h++) {
+            for (int i = 0; i < out.rows; i++) {
+                for (int j = 0; j < out.cols; j++) {
+                    max_diff = max2(max_diff, fabsf(_results[n][h][i][j] -
+                                                    _expected[n][h][i][j]));
+                }
+            }
+        }
+    }
+
+    free(inputs);
+    free(weights);
+    free(conv_results);
+    free(expected);
+    free(results);
+    return max_diff;
+}
+
+int main(int argc, const char* argv[]) {
+    const int num_shapes = sizeof(kShapes) / sizeof(kShapes[0]);
+    const int num_activations = sizeof(kActivations) / sizeof(kActivations[0]);
+    const pool_type pools[] = { MAX, AVG };
+    int num_failed = 0;
+    srand(1);
+    for (int s = 0; s < num_shapes; s++) {
+        for (int a = 0; a < num_activations; a++) {
+            for (int p = 0; p < 2; p++) {
+                float diff = run_test(&kShapes[s], kActivations[a], pools[p]);
+                bool passed = diff <= 1e-5;
+                if (!passed)
+                    num_failed++;
+                printf("Shape %d, %-11s %s pool: max difference %g %s\n", s,
+                       kActivationNames[a], pools[p] == MAX ? "max" : "avg",
+                       diff, passed ? "" : "FAILED");
+            }
+        }
+    }
+    printf("%d of %d tests failed.\n", num_failed,
+           num_shapes * num_activations * 2);
+    return num_failed > 0;
+}
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core/native_cpu/convolution.h"
+#include "core/native_cpu/winograd.h"
+#include "core/nnet_fwd_defs.h"
+#include "core/ref/convolution.h"
+#include "core/ref/winograd.h"
+#include "core/ref/zeropad.h"
+#include "utility/utility.h"
+
+// Checks the Winograd convolutions in core/ref and core/native_cpu against
+// convolution3d_zeropad(), for both tile sizes, on shapes whose outputs are
+// and are not a multiple of the tile, with and without zero and alignment
+// padding, and reports the throughput of the native one against the native
+// direct convolution.
+
+int INPUT_DIM;
+int NUM_CLASSES;
+int NUM_TEST_CASES = 2;
+int NUM_WORKER_THREADS = 0;
+float* sigmoid_table = NULL;
+float* exp_table = NULL;
+sigmoid_impl_t SIGMOID_IMPL = ExpUnit;
+
+typedef struct _winograd_shape {
+    // Dimensions before zero padding.
+    int rows;
+    int cols;
+    int chans;
+    int kernels;
+    // Zero padding on every side.
+    int pad;
+    int alignment;
+} winograd_shape;
+
+static const winograd_shape kShapes[] = {
+    { 8, 8, 3, 4, 1, 0 },
+    { 13, 11, 5, 7, 1, 8 },
+    { 7, 9, 16, 9, 0, 0 },
+    { 3, 3, 8, 8, 1, 0 },
+    { 28, 28, 64, 64, 1, 0 },
+    { 56, 56, 64, 64, 1, 0 },
+};
+
+static const int kTileSizes[] = { 2, 4 };
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill_random(float* data, int size) {
+    for (int i = 0; i < size; i++)
+        data[i] = (float)rand() / RAND_MAX - 0.5;
+}
+
+// Returns the largest difference relative to the largest expected value,
+// skipping the alignment padding at the end of each row.
+static float max_rel_diff(float* results,
+                          float* expected,
+                          int size,
+                          int cols,
+                          int width) {
+    float max_diff = 0;
+    float max_val = 1e-6;
+    for (int i = 0; i < size; i++) {
+        if (i % width >= cols)
+            continue;
+        max_diff = max2(max_diff, fabsf(results[i] - expected[i]));
+        max_val = max2(max_val, fabsf(expected[i]));
+    }
+    return max_diff / max_val;
+}
+
+// layers[0] produces the unpadded inputs and layers[1] is the convolution.
+static void make_layers(const winograd_shape* shape, layer_t* layers) {
+    memset(layers, 0, 2 * sizeof(layer_t));
+    layers[0].outputs = (dims_t){ shape->rows, shape->cols, shape->chans,
+                                  calc_padding(shape->cols, shape->alignment) };
+    layer_t* layer = &layers[1];
+    layer->type = CONV_STANDARD;
+    layer->pad = (padding){ shape->pad, shape->pad, shape->pad, shape->pad };
+    int in_rows = shape->rows + 2 * shape->pad;
+    int in_cols = shape->cols + 2 * shape->pad;
+    layer->inputs = (dims_t){ in_rows, in_cols, shape->chans,
+                              calc_padding(in_cols, shape->alignment) };
+    layer->stride = (stride_dims){ 1, 1 };
+    layer->outputs = (dims_t){ in_rows - 2, in_cols - 2, shape->kernels,
+                               calc_padding(in_cols - 2, shape->alignment) };
+    layer->weights = (dims_t){ 3, 3, shape->chans,
+                               calc_padding(3, shape->alignment) };
+}
+
+static bool run_test(const winograd_shape* shape, int tile) {
+    layer_t layers[2];
+    make_layers(shape, layers);
+    layer_t* layer = &layers[1];
+    layer->winograd_tile = tile;
+
+    int input_size = NUM_TEST_CASES * get_dims_size(&layers[0].outputs);
+    int padded_size = NUM_TEST_CASES * get_dims_size(&layer->inputs);
+    int result_size = NUM_TEST_CASES * get_dims_size(&layer->outputs);
+    int weights_size = get_num_weights_layer(layers, 1);
+    int transformed_size = get_num_winograd_weights(layer, tile);
+    float* inputs = (float*)malloc_aligned(input_size * sizeof(float));
+    float* padded = (float*)malloc_aligned(padded_size * sizeof(float));
+    float* weights = (float*)malloc_aligned(weights_size * sizeof(float));
+    float* transformed =
+            (float*)malloc_aligned(transformed_size * sizeof(float));
+    float* scratch = (float*)malloc_aligned(
+            get_winograd_scratch_size(layer) * sizeof(float));
+    // convolution3d_zeropad() leaves its outputs in its inputs.
+    float* expected = (float*)malloc_aligned(
+            max2(input_size, result_size) * sizeof(float));
+    float* ref_results = (float*)malloc_aligned(result_size * sizeof(float));
+    float* cpu_results = (float*)malloc_aligned(result_size * sizeof(float));
+    fill_random(inputs, input_size);
+    fill_random(weights, weights_size);
+    memcpy(expected, inputs, input_size * sizeof(float));
+    convolution3d_zeropad(expected, weights, layers, 1, padded);
+
+    winograd_transform_filters(weights, *layer, tile, transformed);
+    copy_zeropad(inputs, layers, 1, padded);
+    winograd_convolution3d_no_padding(padded, transformed, *layer, scratch,
+                                      ref_results);
+
+    double start = now();
+    cpu_convolution3d_no_padding(padded, weights, *layer, cpu_results);
+    double direct_time = now() - start;
+    start = now();
+    cpu_winograd_convolution3d_no_padding(padded, transformed, *layer,
+                                          cpu_results);
+    double winograd_time = now() - start;
+
+    int result_cols = layer->outputs.cols;
+    int result_width = result_cols + layer->outputs.align_pad;
+    float ref_diff = max_rel_diff(
+            ref_results, expected, result_size, result_cols, result_width);
+    float cpu_diff = max_rel_diff(
+            cpu_results, expected, result_size, result_cols, result_width);
+    // The same bound that transform_winograd_weights() accepts.
+    bool passed = ref_diff <= 1e-4 && cpu_diff <= 1e-4;
+    // Throughput in direct convolution FLOPs.
+    double flops = 2.0 * NUM_TEST_CASES * layer->outputs.rows *
+                   layer->outputs.cols * layer->outputs.height *
+                   layer->inputs.height * 9;
+    printf("F(%dx%d, 3x3) %3dx%3dx%3d -> %3d, pad %d: direct %7.2f GFLOPS, "
+           "winograd %7.2f GFLOPS, max rel difference ref %g, native %g %s\n",
+           tile, tile, shape->rows, shape->cols, shape->chans, shape->kernels,
+           shape->pad, flops / direct_time * 1e-9,
+           flops / winograd_time * 1e-9, ref_diff, cpu_diff,
+           passed ? "" : "FAILED");
+
+    free(inputs);
+    free(padded);
+    free(weights);
+    free(transformed);
+    free(scratch);
+    free(expected);
+    free(ref_results);
+    free(cpu_results);
+    return passed;
+}
+
+int main(int argc, const char* argv[]) {
+    const int num_shapes = sizeof(kShapes) / sizeof(kShapes[0]);
+    const int num_tiles = sizeof(kTileSizes) / sizeof(kTileSizes[0]);
+    int num_failed = 0;
+    srand(1);
+    for (int s = 0; s < num_shapes; s++) {
+        for (int t = 0; t < num_tiles; t++)
+            num_failed += !run_test(&kShapes[s], kTileSizes[t]);
+    }
+    printf("%d of %d tests failed.\n", num_failed, num_shapes * num_tiles);
+    return num_failed > 0;
+}
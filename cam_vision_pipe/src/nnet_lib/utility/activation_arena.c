@@ -0,0 +1,563 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "utility/activation_arena.h"
+#include "utility/compression.h"
+#include "utility/data_layout_conversion.h"
+#include "utility/utility.h"
+
+activation_arena_t* g_arena = NULL;
+
+size_t calc_layer_intermediate_memory(layer_t* layers, int lnum) {
+    size_t usage = 0, flattened_usage = 0;
+    layer_t layer = layers[lnum];
+
+    size_t inputs_size = layer.inputs.rows *
+                         (layer.inputs.cols + layer.inputs.align_pad) *
+                         layer.inputs.height;
+    size_t outputs_size = layer.outputs.rows *
+                          (layer.outputs.cols + layer.outputs.align_pad) *
+                          layer.outputs.height;
+
+    if (layer.type == INPUT) {
+        usage = inputs_size;
+    } else if (layer.type == FC) {
+        if (layer.input_preprocessing == FLATTEN) {
+            // Flattening the input will require the second buffer.
+            layer_t prev_layer = layers[lnum - 1];
+            flattened_usage =
+                    prev_layer.outputs.rows *
+                    (prev_layer.outputs.cols + prev_layer.outputs.align_pad) *
+                    prev_layer.outputs.height;
+            usage = max2(outputs_size, flattened_usage);
+        } else {
+            usage = outputs_size;
+        }
+    } else if (layer.type == CONV_STANDARD || layer.type == CONV_DEPTHWISE ||
+               layer.type == CONV_POINTWISE || layer.type == POOLING) {
+        usage = max2(inputs_size, outputs_size);
+    } else {
+        usage = 0;
+    }
+    return usage * NUM_TEST_CASES;
+}
+
+size_t calc_layer_output_memory(layer_t* layers, int lnum) {
+    if (layers[lnum].type == INPUT)
+        return get_dims_size(&layers[lnum].inputs) * NUM_TEST_CASES;
+    return get_dims_size(&layers[lnum].outputs) * NUM_TEST_CASES;
+}
+
+_Static_assert(sizeof(farray_t) <= ARENA_HEADER_BYTES &&
+                       sizeof(fp16array_t) <= ARENA_HEADER_BYTES,
+               "Array headers must fit in front of the arena data!");
+
+// Bytes of num_elems elements of each type, without a header.
+static size_t fp32_data_bytes(size_t num_elems) {
+    return next_multiple(num_elems * sizeof(float), ARENA_ALIGNMENT);
+}
+
+static size_t fp16_data_bytes(size_t num_elems) {
+    // Half-precision data is stored as packed pairs.
+    return next_multiple(FRAC_CEIL(num_elems, 2) * sizeof(packed_fp16),
+                         ARENA_ALIGNMENT);
+}
+
+size_t arena_fp32_bytes(size_t num_elems) {
+    return ARENA_HEADER_BYTES + fp32_data_bytes(num_elems);
+}
+
+size_t arena_fp16_bytes(size_t num_elems) {
+    return ARENA_HEADER_BYTES + fp16_data_bytes(num_elems);
+}
+
+size_t arena_buffer_bytes(size_t bytes) {
+    return next_multiple(max2(bytes, 1), ARENA_ALIGNMENT);
+}
+
+// The activations live in the two lists of the pass, whose headers are not
+// in the arena, so their buffers are data only.
+static size_t activation_bytes(data_storage_t fmt, size_t num_elems) {
+    return fmt == UncompressedHalfPrecision ? fp16_data_bytes(num_elems)
+                                            : fp32_data_bytes(num_elems);
+}
+
+// Returns true if layer lnum flattens its inputs into its results buffer, in
+// which case layer_dispatcher() runs the layer with the two buffers swapped,
+// and its result overwrites its inputs.
+static bool result_overwrites_inputs(layer_t* layers, int lnum) {
+    return layers[lnum].type == FC &&
+           layers[lnum].input_preprocessing == FLATTEN &&
+           (layers[lnum - 1].outputs.align_pad != 0 ||
+            layers[lnum].inputs.align_pad != 0);
+}
+
+static bool buffers_overlap_in_time(arena_buffer_t* a, arena_buffer_t* b) {
+    return a->first_use <= b->last_use && b->first_use <= a->last_use;
+}
+
+static int compare_buffer_size(const void* a, const void* b) {
+    const arena_buffer_t* buf_a = *(const arena_buffer_t**)a;
+    const arena_buffer_t* buf_b = *(const arena_buffer_t**)b;
+    if (buf_a->bytes != buf_b->bytes)
+        return buf_a->bytes < buf_b->bytes ? 1 : -1;
+    return buf_a->first_use - buf_b->first_use;
+}
+
+static int compare_buffer_offset(const void* a, const void* b) {
+    const arena_buffer_t* buf_a = *(const arena_buffer_t**)a;
+    const arena_buffer_t* buf_b = *(const arena_buffer_t**)b;
+    if (buf_a->offset == buf_b->offset)
+        return 0;
+    return buf_a->offset < buf_b->offset ? -1 : 1;
+}
+
+// Assign offsets, largest buffer first. Each buffer goes into the lowest gap
+// between the already placed buffers that are live at the same time. Returns
+// the total size.
+static size_t assign_offsets(arena_buffer_t** buffers, int num_buffers) {
+    qsort(buffers, num_buffers, sizeof(arena_buffer_t*), compare_buffer_size);
+    arena_buffer_t** live = (arena_buffer_t**)malloc(
+            sizeof(arena_buffer_t*) * (num_buffers + 1));
+    size_t total_size = 0;
+    for (int i = 0; i < num_buffers; i++) {
+        arena_buffer_t* buf = buffers[i];
+        int num_live = 0;
+        for (int j = 0; j < i; j++) {
+            if (buffers_overlap_in_time(buf, buffers[j]))
+                live[num_live++] = buffers[j];
+        }
+        qsort(live, num_live, sizeof(arena_buffer_t*), compare_buffer_offset);
+        size_t offset = 0;
+        for (int j = 0; j < num_live; j++) {
+            if (offset + buf->bytes <= live[j]->offset)
+                break;
+            offset = max2(offset, live[j]->offset + live[j]->bytes);
+        }
+        buf->offset = offset;
+        total_size = max2(total_size, offset + buf->bytes);
+    }
+    free(live);
+    return total_size;
+}
+
+// Map size bytes, on explicit huge pages if any are reserved, and otherwise
+// on regular pages that the kernel is asked to back with transparent huge
+// pages.
+static void map_arena(activation_arena_t* arena) {
+    arena->mapped_size = next_multiple(arena->size, ARENA_HUGEPAGE_SIZE);
+    void* addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    addr = mmap(NULL, arena->mapped_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    arena->explicit_hugepages = (addr != MAP_FAILED);
+    if (addr == MAP_FAILED) {
+        addr = mmap(NULL, arena->mapped_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(addr != MAP_FAILED && "Failed to map the activation arena!");
+#ifdef MADV_HUGEPAGE
+        madvise(addr, arena->mapped_size, MADV_HUGEPAGE);
+#endif
+    }
+    arena->base = (uint8_t*)addr;
+}
+
+// Returns the scratch of layer lnum: what scratch_fn reports, plus whatever
+// scratch_fn itself allocates with arena_malloc() to work it out, which is
+// the tiling descriptors the layer allocates the same way when it runs.
+static size_t measure_layer_scratch(activation_arena_t* arena,
+                                    layer_scratch_fn scratch_fn,
+                                    layer_t* layers,
+                                    int lnum,
+                                    device_t* device,
+                                    int* num_allocs) {
+    arena->measured_bytes = 0;
+    arena->measured_allocs = 0;
+    size_t bytes = scratch_fn(layers, lnum, device);
+    *num_allocs = arena->measured_allocs;
+    return bytes + arena->measured_bytes;
+}
+
+static size_t get_array_size(data_list* list) {
+    if (list->type[0] == UncompressedHalfPrecision)
+        return list->data[0].dense_hp->size;
+    return list->data[0].dense->size;
+}
+
+static void init_pass_lists(activation_arena_t* arena) {
+    for (int i = 0; i < 2; i++) {
+        arena->lists[i].data = &arena->list_data[i];
+        arena->lists[i].type = &arena->list_type[i];
+        arena->lists[i].len = 1;
+        arena->list_type[i] = arena->activation_fmt;
+        arena->list_fp32[i] = (farray_t){ NULL, 0, false };
+        arena->list_fp16[i] = (fp16array_t){ NULL, 0, false };
+        if (arena->activation_fmt == UncompressedHalfPrecision)
+            arena->list_data[i].dense_hp = &arena->list_fp16[i];
+        else
+            arena->list_data[i].dense = &arena->list_fp32[i];
+    }
+}
+
+activation_arena_t* plan_activation_arena(network_t* network,
+                                          data_list* inputs,
+                                          data_list* results,
+                                          data_storage_t activation_fmt,
+                                          layer_scratch_fn scratch_fn,
+                                          layer_fusion_fn fusion_fn,
+                                          device_t* device) {
+    assert(g_arena == NULL && "An activation arena is already in use!");
+    assert((inputs->type[0] == activation_fmt ||
+            inputs->type[0] == Uncompressed) &&
+           "The inputs must be fp32 or in the activation format!");
+    layer_t* layers = network->layers;
+    const int depth = network->depth;
+    activation_arena_t* arena =
+            (activation_arena_t*)calloc(1, sizeof(activation_arena_t));
+    arena->num_layers = depth;
+    arena->activation_fmt = activation_fmt;
+    arena->outputs = (arena_buffer_t*)calloc(depth, sizeof(arena_buffer_t));
+    arena->scratch = (arena_buffer_t*)calloc(depth, sizeof(arena_buffer_t));
+    arena->result_owner = (int*)malloc(sizeof(int) * depth);
+    arena->inputs_fmt = inputs->type[0];
+    arena->inputs_size = get_array_size(inputs);
+    init_pass_lists(arena);
+
+    // The scratch functions are measured with the arena installed, so that
+    // the tiling descriptors they compute are counted.
+    g_arena = arena;
+    arena->measuring = true;
+    int max_allocs = 0;
+    size_t fused_scratch = 0;
+    int fused_allocs = 0;
+
+    // Layer 0 holds the inputs. The layers only read them, so the pass runs
+    // on the caller's buffer, unless a layer writes its result over them.
+    arena->outputs[0] = (arena_buffer_t){ 0, 0, 0, 0 };
+    arena->result_owner[0] = 0;
+    for (int l = 1; l < depth; l++) {
+        int inputs_owner = arena->result_owner[l - 1];
+        arena_buffer_t* inputs = &arena->outputs[inputs_owner];
+        inputs->last_use = max2(inputs->last_use, l);
+        int num_allocs = 0;
+        size_t scratch_bytes = measure_layer_scratch(
+                arena, scratch_fn, layers, l, device, &num_allocs);
+        if (fusion_fn && fusion_fn(layers, l, depth)) {
+            // The fused layer runs as the next layer, with the scratch of
+            // both, and has no result of its own.
+            arena->outputs[l] = (arena_buffer_t){ 0, 0, l, l };
+            arena->scratch[l] = (arena_buffer_t){ 0, 0, l, l };
+            arena->result_owner[l] = inputs_owner;
+            fused_scratch = scratch_bytes;
+            fused_allocs = num_allocs;
+            continue;
+        }
+        size_t result_bytes = activation_bytes(
+                activation_fmt, calc_layer_output_memory(layers, l));
+        if (result_overwrites_inputs(layers, l)) {
+            // The buffer of this layer only holds the flattened inputs.
+            arena->outputs[l] = (arena_buffer_t){
+                0, activation_bytes(activation_fmt, im2row_size(layers, l)), l,
+                l
+            };
+            inputs->bytes = max2(inputs->bytes, result_bytes);
+            arena->result_owner[l] = inputs_owner;
+        } else {
+            arena->outputs[l] = (arena_buffer_t){ 0, result_bytes, l, l };
+            arena->result_owner[l] = l;
+        }
+        arena->scratch[l] =
+                (arena_buffer_t){ 0, scratch_bytes + fused_scratch, l, l };
+        max_allocs = max2(max_allocs, num_allocs + fused_allocs);
+        fused_scratch = 0;
+        fused_allocs = 0;
+    }
+    arena->measuring = false;
+    g_arena = NULL;
+
+    // The result of the last layer is read back after the pass.
+    arena_buffer_t* final_result = &arena->outputs[arena->result_owner[depth - 1]];
+    final_result->last_use = depth;
+    // The inputs are copied into the arena if they have to be converted, or
+    // if a layer writes over them.
+    size_t input_elems = arena->inputs_fmt == UncompressedHalfPrecision
+                                 ? 2 * arena->inputs_size
+                                 : arena->inputs_size;
+    bool copy_inputs = arena->inputs_fmt != activation_fmt;
+    for (int l = 1; l < depth; l++)
+        copy_inputs |= (arena->result_owner[l] == 0);
+    if (copy_inputs) {
+        arena->outputs[0].bytes =
+                max2(arena->outputs[0].bytes,
+                     activation_bytes(activation_fmt, max2(input_elems, 1)));
+    }
+
+    arena_buffer_t** buffers =
+            (arena_buffer_t**)malloc(sizeof(arena_buffer_t*) * 2 * depth);
+    int num_buffers = 0;
+    size_t total_bytes = 0;
+    for (int l = 0; l < depth; l++) {
+        if (arena->outputs[l].bytes > 0)
+            buffers[num_buffers++] = &arena->outputs[l];
+        if (arena->scratch[l].bytes > 0)
+            buffers[num_buffers++] = &arena->scratch[l];
+        total_bytes += arena->outputs[l].bytes + arena->scratch[l].bytes;
+    }
+    arena->size = max2(assign_offsets(buffers, num_buffers), ARENA_ALIGNMENT);
+    free(buffers);
+    map_arena(arena);
+    arena->scratch_capacity = ARENA_MAX_SCRATCH_DEPTH + max_allocs;
+    arena->scratch_stack = (arena_scratch_entry_t*)malloc(
+            sizeof(arena_scratch_entry_t) * arena->scratch_capacity);
+
+    // The result is handed back as fp32. The unpacking writes whole vectors.
+    size_t result_elems = calc_layer_output_memory(layers, depth - 1);
+    create_new_data_list_if_necessary(
+            results, next_multiple(result_elems, VECTOR_SIZE), Uncompressed);
+
+    size_t max_intermediate = 0;
+    for (int l = 0; l < depth; l++) {
+        max_intermediate = max2(max_intermediate,
+                                calc_layer_intermediate_memory(layers, l));
+    }
+    printf("Activation arena: %.1f KB peak for %d layers, %.1f KB without "
+           "reuse (the ping-pong buffers alone grow to %.1f KB), %s.\n",
+           arena->size / 1024.0, depth, total_bytes / 1024.0,
+           2 * activation_bytes(activation_fmt, max_intermediate) / 1024.0,
+           arena->explicit_hugepages ? "on huge pages"
+                                     : "transparent huge pages requested");
+    for (int l = 0; l < depth; l++) {
+        INFO_MSG("  Layer %d: output %lu bytes at %lu (live until layer %d), "
+                 "scratch %lu bytes at %lu.\n",
+                 l, arena->outputs[l].bytes, arena->outputs[l].offset,
+                 arena->outputs[l].last_use, arena->scratch[l].bytes,
+                 arena->scratch[l].offset);
+    }
+    return arena;
+}
+
+void free_activation_arena(activation_arena_t* arena) {
+    assert(g_arena != arena && "The arena is still in use by a pass!");
+    munmap(arena->base, arena->mapped_size);
+    free(arena->outputs);
+    free(arena->scratch);
+    free(arena->result_owner);
+    free(arena->scratch_stack);
+    free(arena);
+}
+
+bool arena_owns(void* ptr) {
+    return g_arena && (uint8_t*)ptr >= g_arena->base &&
+           (uint8_t*)ptr < g_arena->base + g_arena->size;
+}
+
+static uint8_t* output_buffer(int lnum) {
+    return g_arena->base + g_arena->outputs[lnum].offset;
+}
+
+// Point the array of one of the lists of the pass at buf.
+static void set_arena_array(data_list* list, uint8_t* buf, size_t bytes) {
+    int i = list - g_arena->lists;
+    assert((i == 0 || i == 1) && "Not a list of the activation arena!");
+    list->type[0] = g_arena->activation_fmt;
+    if (g_arena->activation_fmt == UncompressedHalfPrecision) {
+        list->data[0].dense_hp = &g_arena->list_fp16[i];
+        list->data[0].dense_hp->d = (packed_fp16*)buf;
+        list->data[0].dense_hp->size = bytes / sizeof(packed_fp16);
+    } else {
+        list->data[0].dense = &g_arena->list_fp32[i];
+        list->data[0].dense->d = (float*)buf;
+        list->data[0].dense->size = bytes / sizeof(float);
+    }
+}
+
+void arena_begin_pass(activation_arena_t* arena,
+                      data_list* inputs,
+                      data_list** activations,
+                      data_list** results) {
+    assert(g_arena == NULL && "A forward pass is already running!");
+    assert(inputs->type[0] == arena->inputs_fmt &&
+           get_array_size(inputs) == arena->inputs_size &&
+           "The inputs differ from the ones the arena was planned for!");
+    g_arena = arena;
+    arena->curr_layer = 0;
+    arena->scratch_used = 0;
+    arena->scratch_depth = 0;
+    data_list* list = &arena->lists[0];
+    if (arena->outputs[0].bytes == 0) {
+        if (inputs->type[0] == UncompressedHalfPrecision) {
+            set_arena_array(list, (uint8_t*)inputs->data[0].dense_hp->d,
+                            arena->inputs_size * sizeof(packed_fp16));
+        } else {
+            set_arena_array(list, (uint8_t*)inputs->data[0].dense->d,
+                            arena->inputs_size * sizeof(float));
+        }
+    } else if (inputs->type[0] == UncompressedHalfPrecision) {
+        size_t bytes = arena->inputs_size * sizeof(packed_fp16);
+        set_arena_array(list, output_buffer(0), bytes);
+        memcpy(output_buffer(0), inputs->data[0].dense_hp->d, bytes);
+    } else if (arena->activation_fmt == Uncompressed) {
+        size_t bytes = arena->inputs_size * sizeof(float);
+        set_arena_array(list, output_buffer(0), bytes);
+        memcpy(output_buffer(0), inputs->data[0].dense->d, bytes);
+    } else {
+        set_arena_array(list, output_buffer(0), 0);
+        pack_data_fp16_into(inputs->data[0].dense, list->data[0].dense_hp);
+    }
+    *activations = list;
+    *results = &arena->lists[1];
+}
+
+void arena_end_pass(data_list* result_loc, data_list* results) {
+    assert(g_arena && "No forward pass is running!");
+    assert(results->type[0] == Uncompressed &&
+           "The results were not sized by the plan!");
+    farray_t* dest = results->data[0].dense;
+    if (result_loc->type[0] == UncompressedHalfPrecision) {
+        fp16array_t* result = result_loc->data[0].dense_hp;
+        assert(result->size * 2 <= dest->size &&
+               "The result is larger than planned!");
+        // Unpack through a copy of the header, so the caller's array keeps
+        // its size.
+        farray_t unpacked = *dest;
+        unpack_data_fp16x4_into(result, &unpacked);
+    } else {
+        farray_t* result = result_loc->data[0].dense;
+        assert(result->size <= dest->size &&
+               "The result is larger than planned!");
+        memcpy(dest->d, result->d, result->size * sizeof(float));
+    }
+    g_arena = NULL;
+}
+
+void arena_begin_layer(int lnum, data_list* activations, data_list* results) {
+    g_arena->curr_layer = lnum;
+    g_arena->scratch_used = 0;
+    g_arena->scratch_depth = 0;
+    if (lnum == 0)
+        return;
+    set_arena_array(results, output_buffer(lnum),
+                    g_arena->outputs[lnum].bytes);
+    if (g_arena->result_owner[lnum] != lnum) {
+        int owner = g_arena->result_owner[lnum];
+        set_arena_array(activations, output_buffer(owner),
+                        g_arena->outputs[owner].bytes);
+    }
+}
+
+void arena_end_layer(int lnum, layer_t* layers, data_list* result_loc) {
+    if (lnum == 0 || result_loc->type[0] != g_arena->activation_fmt)
+        return;
+    size_t num_elems = calc_layer_output_memory(layers, lnum);
+    if (result_loc->type[0] == UncompressedHalfPrecision) {
+        fp16array_t* array = result_loc->data[0].dense_hp;
+        if (arena_owns(array->d))
+            array->size = FRAC_CEIL(num_elems, 2);
+    } else {
+        farray_t* array = result_loc->data[0].dense;
+        if (arena_owns(array->d))
+            array->size = num_elems;
+    }
+}
+
+void* arena_malloc(size_t bytes) {
+    bytes = arena_buffer_bytes(bytes);
+    if (!g_arena)
+        return malloc_aligned(bytes);
+    if (g_arena->measuring) {
+        g_arena->measured_bytes += bytes;
+        g_arena->measured_allocs++;
+        return malloc_aligned(bytes);
+    }
+    arena_buffer_t* scratch = &g_arena->scratch[g_arena->curr_layer];
+    if (g_arena->scratch_depth == g_arena->scratch_capacity ||
+        g_arena->scratch_used + bytes > scratch->bytes) {
+        printf("[ERROR]: Layer %d asked for %lu bytes of scratch on top of "
+               "%lu in %d buffers, but only %lu bytes were planned.\n",
+               g_arena->curr_layer, bytes, g_arena->scratch_used,
+               g_arena->scratch_depth, scratch->bytes);
+        assert(false && "The scratch function of the layer is out of date!");
+    }
+    arena_scratch_entry_t* entry =
+            &g_arena->scratch_stack[g_arena->scratch_depth++];
+    entry->offset = g_arena->scratch_used;
+    entry->freed = false;
+    g_arena->scratch_used += bytes;
+    return g_arena->base + scratch->offset + entry->offset;
+}
+
+void arena_release(void* ptr) {
+    if (!arena_owns(ptr))
+        return;
+    // Only scratch of the current layer is handed out as a stack; outputs
+    // stay where the plan put them.
+    size_t scratch_offset = g_arena->scratch[g_arena->curr_layer].offset;
+    uint8_t* scratch_base = g_arena->base + scratch_offset;
+    if ((uint8_t*)ptr < scratch_base ||
+        (uint8_t*)ptr >= scratch_base + g_arena->scratch_used)
+        return;
+    size_t offset = (uint8_t*)ptr - scratch_base;
+    for (int i = g_arena->scratch_depth - 1; i >= 0; i--) {
+        if (g_arena->scratch_stack[i].offset == offset) {
+            g_arena->scratch_stack[i].freed = true;
+            break;
+        }
+    }
+    while (g_arena->scratch_depth > 0 &&
+           g_arena->scratch_stack[g_arena->scratch_depth - 1].freed) {
+        g_arena->scratch_depth--;
+        g_arena->scratch_used =
+                g_arena->scratch_stack[g_arena->scratch_depth].offset;
+    }
+}
+
+void arena_free(void* ptr) {
+    if (arena_owns(ptr))
+        arena_release(ptr);
+    else
+        free(ptr);
+}
+
+static bool use_arena_arrays() {
+    return g_arena && !g_arena->measuring;
+}
+
+farray_t* arena_init_farray(int len, bool zero) {
+    if (!use_arena_arrays())
+        return init_farray(len, zero);
+    size_t data_bytes = max2(len, 0) * sizeof(float);
+    uint8_t* chunk = (uint8_t*)arena_malloc(ARENA_HEADER_BYTES + data_bytes);
+    farray_t* array = (farray_t*)chunk;
+    array->d = len > 0 ? (float*)(chunk + ARENA_HEADER_BYTES) : NULL;
+    array->size = max2(len, 0);
+    array->freeable = false;
+    if (zero && len > 0)
+        memset(array->d, 0, next_multiple(data_bytes, ARENA_ALIGNMENT));
+    return array;
+}
+
+fp16array_t* arena_init_fp16array(int num_elems, bool zero) {
+    if (!use_arena_arrays())
+        return init_fp16array(num_elems, zero);
+    size_t size = num_elems > 0 ? FRAC_CEIL(num_elems, 2) : 0;
+    size_t data_bytes = size * sizeof(packed_fp16);
+    uint8_t* chunk = (uint8_t*)arena_malloc(ARENA_HEADER_BYTES + data_bytes);
+    fp16array_t* array = (fp16array_t*)chunk;
+    array->d = size > 0 ? (packed_fp16*)(chunk + ARENA_HEADER_BYTES) : NULL;
+    array->size = size;
+    array->freeable = false;
+    if (zero && size > 0)
+        memset(array->d, 0, next_multiple(data_bytes, ARENA_ALIGNMENT));
+    return array;
+}
+
+farray_t* arena_unpack_data_fp16x4(fp16array_t* hp_data) {
+    if (!use_arena_arrays())
+        return unpack_data_fp16x4(hp_data, NULL);
+    farray_t* array = arena_init_farray(hp_data->size * 2, false);
+    unpack_data_fp16x4_into(hp_data, array);
+    return array;
+}
@@ -0,0 +1,194 @@
+#ifndef _UTILITY_ACTIVATION_ARENA_H_
+#define _UTILITY_ACTIVATION_ARENA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/nnet_fwd_defs.h"
+
+// A single preallocated block of memory for the activations of a forward
+// pass.
+//
+// When the network is loaded, plan_activation_arena() walks it and sizes
+// every buffer a pass will touch: the output of each layer, and the scratch
+// each layer uses internally (NHWC copies of its inputs, zeropadded inputs,
+// partial tile results, fp32 copies for the software fallbacks, and the
+// tiling descriptors of the accelerated layers). The output of a layer is
+// live from the layer that writes it until the layer that reads it, and the
+// scratch of a layer only while it runs, so buffers whose lifetimes do not
+// overlap share the same memory. Offsets are assigned greedily, largest
+// buffer first, and the whole plan is mapped once, on huge pages if the
+// system has them. The peak is printed when the plan is made.
+//
+// Every pass then runs between arena_begin_pass() and arena_end_pass().
+// arena_begin_layer() points the results of each layer at its planned
+// output, and the scratch allocators below hand out the scratch of the
+// current layer as a stack. Arrays from the arena carry their header in the
+// arena too, and free_farray() and free_fp16array() give them back to it, so
+// a pass does not touch the heap. A request the plan did not account for is
+// a bug in the scratch function of the backend, and fails an assertion.
+//
+// The arena is only used from the thread that runs the layers.
+
+// Alignment of every buffer in the arena.
+#define ARENA_ALIGNMENT CACHELINE_SIZE
+// Bytes reserved in front of the data of each array for its header.
+#define ARENA_HEADER_BYTES ARENA_ALIGNMENT
+// Size of a huge page, and the granularity at which the arena is mapped.
+#define ARENA_HUGEPAGE_SIZE (2 * 1024 * 1024)
+// The most scratch arrays a layer holds at once, on top of its tiling
+// descriptors.
+#define ARENA_MAX_SCRATCH_DEPTH 16
+
+// Returns the bytes of scratch a layer needs on top of its output, as a sum
+// of arena_fp32_bytes() and arena_fp16_bytes() of each array it allocates.
+// Tiling descriptors that the function computes with arena_malloc() are
+// measured by the planner and need not be counted.
+typedef size_t (*layer_scratch_fn)(layer_t* layers, int lnum, device_t* device);
+
+// Returns true if layer lnum runs fused with layer lnum + 1, writing the
+// output of lnum + 1 directly.
+typedef bool (*layer_fusion_fn)(layer_t* layers, int lnum, int num_layers);
+
+typedef struct _arena_buffer_t {
+    size_t offset;
+    size_t bytes;
+    // The first and last layers during which the buffer holds live data.
+    int first_use;
+    int last_use;
+} arena_buffer_t;
+
+typedef struct _arena_scratch_entry_t {
+    size_t offset;
+    bool freed;
+} arena_scratch_entry_t;
+
+typedef struct _activation_arena_t {
+    uint8_t* base;
+    // Bytes used by the plan, and bytes actually mapped.
+    size_t size;
+    size_t mapped_size;
+    bool explicit_hugepages;
+    int num_layers;
+    data_storage_t activation_fmt;
+    // Per layer: the buffer for its output, and the one for its scratch.
+    arena_buffer_t* outputs;
+    arena_buffer_t* scratch;
+    // The layer whose output buffer holds the result of each layer. This is
+    // the layer itself, unless it writes its result over its inputs (FC
+    // layers that flatten their inputs into their own buffer first), or runs
+    // fused with the next layer and has no result of its own.
+    int* result_owner;
+
+    // The two lists the layers ping-pong between. Their arrays always point
+    // into the arena.
+    data_list lists[2];
+    union DataFormat list_data[2];
+    data_storage_t list_type[2];
+    farray_t list_fp32[2];
+    fp16array_t list_fp16[2];
+    // Format and size of the inputs the plan was made for.
+    data_storage_t inputs_fmt;
+    size_t inputs_size;
+
+    // Scratch stack of the layer that is running.
+    int curr_layer;
+    size_t scratch_used;
+    arena_scratch_entry_t* scratch_stack;
+    int scratch_capacity;
+    int scratch_depth;
+
+    // Set while the scratch functions are measured. arena_malloc() then
+    // allocates on the heap and counts what it hands out.
+    bool measuring;
+    size_t measured_bytes;
+    int measured_allocs;
+} activation_arena_t;
+
+// The arena of the forward pass that is running, or NULL.
+extern activation_arena_t* g_arena;
+
+// Returns the number of elements needed for the larger of the input and the
+// output activations of a layer, which is what the ping-pong buffers grow to.
+size_t calc_layer_intermediate_memory(layer_t* layers, int lnum);
+
+// Returns the number of elements of the output activations of a layer.
+size_t calc_layer_output_memory(layer_t* layers, int lnum);
+
+// Size of an arena array of num_elems elements of each type, including its
+// header, rounded up to ARENA_ALIGNMENT.
+size_t arena_fp32_bytes(size_t num_elems);
+size_t arena_fp16_bytes(size_t num_elems);
+// Size of a raw buffer of the given bytes from arena_malloc().
+size_t arena_buffer_bytes(size_t bytes);
+
+// Plan the buffers of a forward pass over network and map the arena.
+//
+// Args:
+//   network: The network to plan for. Its weights must already be in the
+//     layout the pass uses, as the scratch of some layers depends on it.
+//   inputs: The inputs the pass will be run on. Every pass must be given
+//     inputs of the same format and size.
+//   results: Gets an fp32 array large enough for the result of the network,
+//     which arena_end_pass() fills in.
+//   activation_fmt: Storage format of the activations passed between layers.
+//   scratch_fn: Returns the scratch of each layer for this backend.
+//   fusion_fn: Returns which layers run fused with the next one, or NULL.
+//   device: Passed on to scratch_fn.
+activation_arena_t* plan_activation_arena(network_t* network,
+                                          data_list* inputs,
+                                          data_list* results,
+                                          data_storage_t activation_fmt,
+                                          layer_scratch_fn scratch_fn,
+                                          layer_fusion_fn fusion_fn,
+                                          device_t* device);
+
+// Unmap the arena.
+void free_activation_arena(activation_arena_t* arena);
+
+// Returns true if ptr points into g_arena.
+bool arena_owns(void* ptr);
+
+// Start a pass on arena, which becomes g_arena until arena_end_pass().
+//
+// activations is set to a list that refers to the inputs. This is the
+// caller's buffer itself, which the layers only read, unless the inputs need
+// converting to the activation format, or a layer writes its result over
+// them: then they are copied into the output buffer of layer 0. results is
+// set to the other list of the pass.
+void arena_begin_pass(activation_arena_t* arena,
+                      data_list* inputs,
+                      data_list** activations,
+                      data_list** results);
+
+// Copy the result of the last layer, which is in result_loc, to the results
+// list given to plan_activation_arena(), as fp32, and end the pass.
+void arena_end_pass(data_list* result_loc, data_list* results);
+
+// Start running layer lnum: drop any scratch left over from the previous
+// layer, and point results at the planned output of lnum. If lnum writes its
+// result over its inputs, the array in activations is grown to the buffer
+// that holds them, which the plan has sized for the result.
+void arena_begin_layer(int lnum, data_list* activations, data_list* results);
+
+// Finish layer lnum, whose result is in result_loc: the array is trimmed to
+// the size of the result, which is what the next layer expects to read.
+void arena_end_layer(int lnum, layer_t* layers, data_list* result_loc);
+
+// Scratch allocators. These draw from the scratch of the current layer, or
+// from the heap if no pass is running. Arrays are released with free_farray()
+// and free_fp16array(), and raw buffers with arena_free(). An array of zero
+// elements is a header only, for wrapping data that lives elsewhere.
+void* arena_malloc(size_t bytes);
+void arena_free(void* ptr);
+farray_t* arena_init_farray(int len, bool zero);
+fp16array_t* arena_init_fp16array(int num_elems, bool zero);
+// Unpack half-precision data into fp32 scratch.
+farray_t* arena_unpack_data_fp16x4(fp16array_t* hp_data);
+
+// Give a buffer from arena_malloc() back to the scratch stack. Buffers freed
+// out of order are reclaimed once everything above them is freed too.
+void arena_release(void* ptr);
+
+#endif
@@ -130,10 +130,8 @@ int compute_num_vectors_in_row(int num_elems_in_row) {
  * Returns a pointer to a malloc'ed fp16array_t object, whose size is equal to the
  * minimum number of 32-bit unsigned values required to store the packed data.
  * To use an existing buffer, pass its pointer to the dest_buf argument;
- * otherwise, pass NULL, and it will be autmoatically allocated.
- *
- * TODO: Make dest_buf a fp16array_t* pointer instead, so we don't have to
- * worry about memory leaks when we replace an existing fp16array_t object.
+ * otherwise, pass NULL, and it will be autmoatically allocated. To reuse an
+ * existing fp16array_t object as well, use pack_data_fp16_into().
  */
 fp16array_t* pack_data_fp16(farray_t* sp_data, packed_fp16* dest_buf) {
     fp16array_t* hp_data = (fp16array_t*)malloc(sizeof(fp16array_t));
@@ -146,6 +144,19 @@ fp16array_t* pack_data_fp16(farray_t* sp_data, packed_fp16* dest_buf) {
         hp_data->d = dest_buf;
         hp_data->freeable = false;
     }
+    pack_data_fp16_into(sp_data, hp_data);
+    return hp_data;
+}
+
+/* Compress an array of single-precision FP values into the buffer of an
+ * existing fp16array_t, which must be large enough to hold them.
+ *
+ * The size of hp_data is set to the size of the packed data. Nothing is
+ * allocated.
+ */
+void pack_data_fp16_into(farray_t* sp_data, fp16array_t* hp_data) {
+    size_t packed_size = (sp_data->size / 2) + (sp_data->size % 2);
+    hp_data->size = packed_size;
     if (hp_data->size * sizeof(packed_fp16) < CACHELINE_SIZE) {
         memset(hp_data->d, 0, hp_data->size * sizeof(packed_fp16));
     } else {
@@ -159,7 +170,6 @@ fp16array_t* pack_data_fp16(farray_t* sp_data, packed_fp16* dest_buf) {
         hp_data->d[i / 2] |= ((int)_CVT_SS_SH(sp_data->d[i], 0))
                              << (use_lo_half ? 0 : 16);
     }
-    return hp_data;
 }
 
 /* Decompress an array of half-precision FP values to single precision.
@@ -170,11 +180,10 @@ fp16array_t* pack_data_fp16(farray_t* sp_data, packed_fp16* dest_buf) {
  *
  * Returns a pointer to a malloc'ed farray_t object holding the decompressed
  * data.  To use an existing buffer, pass its pointer to the dest_buf argument;
- * otherwise, pass NULL, and it will be autmoatically allocated.
+ * otherwise, pass NULL, and it will be autmoatically allocated. To reuse an
+ * existing farray_t object as well, use unpack_data_fp16x4_into().
  */
 farray_t* unpack_data_fp16x4(fp16array_t* hp_data, float* dest_buf) {
-    assert(hp_data->size % 4 == 0 &&
-           "Half precision data size of must be a multiple of 4!");
     farray_t* sp_data = (farray_t*)malloc(sizeof(farray_t));
     sp_data->size = hp_data->size * 2;
     if (!dest_buf) {
@@ -184,6 +193,20 @@ farray_t* unpack_data_fp16x4(fp16array_t* hp_data, float* dest_buf) {
         sp_data->d = dest_buf;
         sp_data->freeable = false;
     }
+    unpack_data_fp16x4_into(hp_data, sp_data);
+    return sp_data;
+}
+
+/* Decompress an array of half-precision FP values into the buffer of an
+ * existing farray_t, which must be large enough to hold them.
+ *
+ * The size of sp_data is set to the size of the unpacked data. Nothing is
+ * allocated.
+ */
+void unpack_data_fp16x4_into(fp16array_t* hp_data, farray_t* sp_data) {
+    assert(hp_data->size % 4 == 0 &&
+           "Half precision data size of must be a multiple of 4!");
+    sp_data->size = hp_data->size * 2;
     memset(sp_data->d, 0,
            next_multiple(sp_data->size * sizeof(float), CACHELINE_SIZE));
 
@@ -195,7 +218,6 @@ farray_t* unpack_data_fp16x4(fp16array_t* hp_data, float* dest_buf) {
         *((v4fp_t*)&sp_data->d[i * 8 + 4]) =
                 (v4fp_t)_CVT_PH_PS_128(packed_data_hi);
     }
-    return sp_data;
 }
 
 /* Compress an uncompressed matrix into the modified CSR format.
@@ -17,6 +17,8 @@ Architecture str2arch(const char* arch_str, size_t len) {
         return Arch_Eigen;
     if (strncmp(arch_str, "MKLDNN", len) == 0)
         return Arch_MKLDNN;
+    if (strncmp(arch_str, "NATIVE_CPU", len) == 0)
+        return Arch_NativeCpu;
     return Arch_END;
 }
 
@@ -45,6 +47,9 @@ char* arch2str(Architecture arch) {
       case Arch_MKLDNN:
         snprintf(arch_str, 6, "%s", "MKLDNN");
         break;
+      case Arch_NativeCpu:
+        snprintf(arch_str, 11, "%s", "NATIVE_CPU");
+        break;
       default:
         snprintf(arch_str, 8, "%s", "UNKNOWN");
         break;
@@ -22,6 +22,7 @@ typedef enum _Architecture {
     Arch_Eigen = EIGEN,
     Arch_MKLDNN = MKLDNN,
     Arch_SMV = SMV,
+    Arch_NativeCpu = NATIVE_CPU,
     Arch_END
 } Architecture;
 
@@ -220,6 +220,8 @@ global_sec_header read_global_header_from_txt_file(const char* filename) {
         header.arch = Arch_Eigen;
     else if (strncmp(header.arch_str, "MKLDNN", line_len) == 0)
         header.arch = Arch_MKLDNN;
+    else if (strncmp(header.arch_str, "NATIVE_CPU", line_len) == 0)
+        header.arch = Arch_NativeCpu;
 
     ret = fscanf(fp, "# NUM_LAYERS = %d\n", &header.num_layers);
     if (ret != 1)
@@ -0,0 +1,107 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "core/nnet_fwd_defs.h"
+#include "utility/fold_batch_norm.h"
+#include "utility/utility.h"
+
+// Same epsilon that init_bn_weights() uses when it precomputes 1/sqrt(var +
+// eps).
+#define BN_EPSILON 1e-5
+
+// Returns true if bn_layer can be folded into prev_layer.
+static bool can_fold_batch_norm(layer_t* prev_layer, layer_t* bn_layer) {
+    if (bn_layer->type != BATCH_NORM)
+        return false;
+    if (prev_layer->type != FC && prev_layer->type != CONV_POINTWISE)
+        return false;
+    // The batch norm has to see the outputs of the previous layer exactly as
+    // its weights produce them.
+    return prev_layer->activation == NO_ACTIVATION &&
+           bn_layer->input_preprocessing == NO_PREPROCESSING;
+}
+
+void fold_batch_norm_weights(layer_t* prev_layer,
+                             layer_t* bn_layer,
+                             float* weights,
+                             float* bn_weights,
+                             bool transpose,
+                             bool precompute_variance) {
+    const int num_inputs = prev_layer->weights.rows;
+    const int num_outputs = prev_layer->weights.cols;
+    const int weights_pad = prev_layer->weights.align_pad;
+    // Both layer types store {mean, var, gamma, beta} one output to a column.
+    ARRAY_2D(float, _bn_weights, bn_weights,
+             bn_layer->weights.cols + bn_layer->weights.align_pad);
+    // With transposed weights, an FC layer stores each output as a row.
+    bool transposed = transpose && prev_layer->type == FC;
+    int input_stride = transposed ? 1 : num_outputs + weights_pad;
+    int output_stride = transposed ? num_inputs + weights_pad : 1;
+    int bias_offset = transposed ? num_outputs * (num_inputs + weights_pad)
+                                 : num_inputs * (num_outputs + weights_pad);
+    float* biases = weights + bias_offset;
+
+    for (int j = 0; j < num_outputs; j++) {
+        float mean = _bn_weights[MeanIndex][j];
+        float recip_sqrt_var = _bn_weights[VarianceIndex][j];
+        if (!precompute_variance)
+            recip_sqrt_var = 1.0 / sqrt(recip_sqrt_var + BN_EPSILON);
+        float scale = recip_sqrt_var * _bn_weights[GammaIndex][j];
+        float shift = _bn_weights[BetaIndex][j] - mean * scale;
+        for (int i = 0; i < num_inputs; i++)
+            weights[j * output_stride + i * input_stride] *= scale;
+        biases[j] = biases[j] * scale + shift;
+    }
+}
+
+int fold_batch_norm_layers(network_t* network,
+                           farray_t** weights,
+                           iarray_t* compress_type) {
+    layer_t* layers = network->layers;
+    bool found = false;
+    for (int l = 1; l < network->depth; l++)
+        found |= can_fold_batch_norm(&layers[l - 1], &layers[l]);
+    if (!found)
+        return 0;
+
+    // The original weights may be mapped read-only from the model file, so
+    // the folded weights go into a new array.
+    farray_t* folded_weights = init_farray(
+            get_total_num_weights(layers, network->depth), false);
+    float* src = (*weights)->d;
+    size_t dst_offset = 0;
+    size_t prev_offset = 0;
+    int depth = 0;
+    int num_folded = 0;
+    for (int l = 0; l < network->depth; l++) {
+        int num_weights = get_num_weights_layer(layers, l);
+        if (depth > 0 && can_fold_batch_norm(&layers[depth - 1], &layers[l])) {
+            layer_t* prev_layer = &layers[depth - 1];
+            fold_batch_norm_weights(prev_layer, &layers[l],
+                                    folded_weights->d + prev_offset, src,
+                                    TRANSPOSE_WEIGHTS, PRECOMPUTE_BN_VARIANCE);
+            prev_layer->activation = layers[l].activation;
+            num_folded++;
+            printf("Folded batch norm layer %d into layer %d.\n", l,
+                   prev_layer->num);
+        } else {
+            memcpy(folded_weights->d + dst_offset, src,
+                   num_weights * sizeof(float));
+            layers[depth] = layers[l];
+            compress_type->d[depth] = compress_type->d[l];
+            prev_offset = dst_offset;
+            dst_offset += num_weights;
+            depth++;
+        }
+        src += num_weights;
+    }
+    for (int l = 0; l < depth; l++)
+        layers[l].num = l;
+    folded_weights->size = dst_offset;
+    free_farray(*weights);
+    *weights = folded_weights;
+    network->depth = depth;
+    compress_type->size = depth;
+    return num_folded;
+}
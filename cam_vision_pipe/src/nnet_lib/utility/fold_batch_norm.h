@@ -0,0 +1,46 @@
+#ifndef _UTILITY_FOLD_BATCH_NORM_H_
+#define _UTILITY_FOLD_BATCH_NORM_H_
+
+#include <stdbool.h>
+
+#include "core/nnet_fwd_defs.h"
+
+// Fold batch norm layers into the layer before them.
+//
+// A batch norm layer that directly follows an FC or a pointwise convolution
+// with no activation function is an affine transform of each output:
+//
+//   scale = gamma / sqrt(var + eps)
+//   y = (x - mean) * scale + beta
+//
+// so it can be applied once to the weights and biases of that layer instead
+// of to every activation. The folded layer takes over the activation function
+// of the batch norm layer, and the batch norm layer is removed from the
+// network. Standard and depthwise convolutions have no biases to absorb the
+// shift, so batch norm layers after them are left alone.
+//
+// This must run after the weights are loaded and before
+// process_compressed_weights(). The weights are copied into a new array
+// without the removed layers, so that the weights of every layer are still
+// found at get_weights_loc_for_layer(), and the per-layer compression types
+// are compacted to match.
+//
+// Returns the number of batch norm layers folded.
+int fold_batch_norm_layers(network_t* network,
+                           farray_t** weights,
+                           iarray_t* compress_type);
+
+// Scale the weights and biases of each output of prev_layer, which are in
+// weights, by the batch norm parameters of bn_layer in bn_weights.
+//
+// transpose is whether FC weights are stored transposed, and
+// precompute_variance whether bn_weights holds 1/sqrt(var + eps) rather than
+// the variance, as for init_fc_weights() and init_bn_weights().
+void fold_batch_norm_weights(layer_t* prev_layer,
+                             layer_t* bn_layer,
+                             float* weights,
+                             float* bn_weights,
+                             bool transpose,
+                             bool precompute_variance);
+
+#endif
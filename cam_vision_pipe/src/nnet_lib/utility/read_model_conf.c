@@ -959,7 +959,11 @@ int configure_network_from_file(const char* cfg_file,
     // (CONV/INPUT to FC) or unflattened (FC to CONV).
 
     layers[0].input_preprocessing = NO_PREPROCESSING;
+    layers[0].host_inputs_nhwc = false;
+    layers[0].winograd_tile = 0;
     for (int i = 1; i < num_layers; i++) {
+        layers[i].host_inputs_nhwc = false;
+        layers[i].winograd_tile = 0;
         if (layers[i].type == FC && layers[i-1].type != FC) {
             layers[i].input_preprocessing = FLATTEN;
         } else if ((layers[i].type == CONV_STANDARD ||
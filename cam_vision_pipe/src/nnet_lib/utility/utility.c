@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <string.h>
 #include "nnet_fwd.h"
+#include "utility/activation_arena.h"
 #include "utility/compression.h"
 #include "utility/utility.h"
 
@@ -583,6 +584,12 @@ data_list* create_new_data_list_if_necessary(data_list* curr_data,
     bool needs_new_data_buffer = (curr_storage_fmt != tgt_storage_fmt) ||
                                  (size_in_bytes > curr_data_buffer_size);
     if (needs_new_data_buffer) {
+        // Buffers of the activation arena are sized by its plan up front.
+        assert(!(curr_storage_fmt == Uncompressed &&
+                 arena_owns(data.dense->d)) &&
+               !(curr_storage_fmt == UncompressedHalfPrecision &&
+                 arena_owns(data.dense_hp->d)) &&
+               "The activation arena planned a buffer that is too small!");
         switch (tgt_storage_fmt) {
             case Uncompressed:
                 if (has_existing_buffer)
@@ -680,7 +687,9 @@ data_list* copy_data_list(data_list* dest, data_list* source) {
 farray_t* init_farray(int len, bool zero) {
     farray_t* array = (farray_t*) malloc(sizeof(farray_t));
     if (len > 0) {
-        array->d = (float*)malloc_aligned(len * sizeof(float));
+        // Whole cache lines are allocated, since that is what gets zeroed.
+        array->d = (float*)malloc_aligned(
+                next_multiple(len * sizeof(float), CACHELINE_SIZE));
         array->size = len;
         array->freeable = true;
     } else {
@@ -725,7 +734,8 @@ farray_t* create_new_farray_if_necessary(farray_t* array,
     if (!array) {
         array = init_farray(num_elems, zero);
     } else if (array->d && array->size < num_elems) {
-        free(array->d);
+        if (!arena_owns(array->d))
+            free(array->d);
         array = init_farray(num_elems, zero);
     } else if (array->d == NULL) {
         array->d = (float*)malloc_aligned(num_elems * sizeof(float));
@@ -747,7 +757,8 @@ fp16array_t* create_new_fp16array_if_necessary(fp16array_t* array,
     if (!array) {
         array = init_fp16array(num_elems, zero);
     } else if (array->d && array->size * 2 < num_elems) {
-        free(array->d);
+        if (!arena_owns(array->d))
+            free(array->d);
         array = init_fp16array(num_elems, zero);
     } else if (array->d == NULL) {
         array->d = (packed_fp16*)malloc_aligned(num_elems * sizeof(float16));
@@ -762,7 +773,15 @@ fp16array_t* create_new_fp16array_if_necessary(fp16array_t* array,
 }
 
 void free_farray(farray_t* array) {
-    if (!array->freeable) {
+    if (arena_owns(array)) {
+        // Arrays from the activation arena keep their header in the arena.
+        arena_release(array);
+        return;
+    }
+    if (arena_owns(array->d)) {
+        // Scratch from the activation arena goes back to the arena.
+        arena_release(array->d);
+    } else if (!array->freeable) {
         INFO_MSG("[WARNING]: Got call to free_farray() for an array that was "
                  "not freeable! Ignoring this call.\n");
     } else if (array->size > 0) {
@@ -774,7 +793,13 @@ void free_farray(farray_t* array) {
 }
 
 void free_fp16array(fp16array_t* array) {
-    if (!array->freeable) {
+    if (arena_owns(array)) {
+        arena_release(array);
+        return;
+    }
+    if (arena_owns(array->d)) {
+        arena_release(array->d);
+    } else if (!array->freeable) {
         INFO_MSG("[WARNING]: Got call to free_fp16array() for an array that "
                  "was not freeable! Ignoring this call.\n");
     } else if (array->size > 0) {
@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/nnet_fwd_defs.h"
+#include "core/ref/convolution.h"
+#include "core/ref/winograd.h"
+#include "core/ref/zeropad.h"
+#include "utility/utility.h"
+#include "utility/winograd_weights.h"
+
+#if WINOGRAD_CONV == 1
+
+// Largest difference from the direct convolution, relative to its largest
+// output, that a Winograd tile is allowed.
+#define WINOGRAD_MAX_REL_ERROR 1e-4
+
+// Number of kernels that the accuracy check runs.
+#define WINOGRAD_CHECK_KERNELS 8
+
+// Fewest tiles along each dimension of the outputs that a layer needs to use
+// a tile size. With fewer, the partial tiles at the edges waste too much
+// work, and the transformed filters, which are larger than the original
+// ones, are not reused across enough tiles to pay for reading them.
+#define WINOGRAD_MIN_TILES 4
+
+// Returns the largest difference between the Winograd and the direct
+// convolution of a random patch of inputs with the first kernels of
+// curr_layer, relative to the largest direct output.
+static float winograd_rel_error(layer_t* curr_layer, float* kernels, int tile) {
+    // Two tiles and a partial one of outputs each way, so that tile edges and
+    // the edges of the layer are both covered.
+    const int patch_outputs = 2 * tile + 1;
+    padding pad = curr_layer->pad;
+
+    layer_t patch[2];
+    memset(patch, 0, sizeof(patch));
+    patch[0].outputs.rows = patch_outputs + 2 - pad.top - pad.bottom;
+    patch[0].outputs.cols = patch_outputs + 2 - pad.left - pad.right;
+    patch[0].outputs.height = curr_layer->inputs.height;
+    patch[0].outputs.align_pad =
+            calc_padding(patch[0].outputs.cols, DATA_ALIGNMENT);
+    patch[1] = *curr_layer;
+    patch[1].inputs.rows = patch_outputs + 2;
+    patch[1].inputs.cols = patch_outputs + 2;
+    patch[1].inputs.align_pad =
+            calc_padding(patch[1].inputs.cols, DATA_ALIGNMENT);
+    patch[1].outputs.rows = patch_outputs;
+    patch[1].outputs.cols = patch_outputs;
+    patch[1].outputs.height =
+            min2(curr_layer->outputs.height, WINOGRAD_CHECK_KERNELS);
+    patch[1].outputs.align_pad = calc_padding(patch_outputs, DATA_ALIGNMENT);
+    patch[1].winograd_tile = tile;
+
+    const int input_size = NUM_TEST_CASES * get_dims_size(&patch[0].outputs);
+    const int padded_size = NUM_TEST_CASES * get_dims_size(&patch[1].inputs);
+    const int result_size = NUM_TEST_CASES * get_dims_size(&patch[1].outputs);
+    const int transformed_size = get_num_winograd_weights(&patch[1], tile);
+    // convolution3d_zeropad() leaves its outputs in its inputs.
+    float* expected = (float*)malloc_aligned(
+            max2(input_size, result_size) * sizeof(float));
+    float* padded = (float*)malloc_aligned(padded_size * sizeof(float));
+    float* inputs = (float*)malloc_aligned(input_size * sizeof(float));
+    float* results = (float*)malloc_aligned(result_size * sizeof(float));
+    float* transformed =
+            (float*)malloc_aligned(transformed_size * sizeof(float));
+    float* scratch = (float*)malloc_aligned(
+            get_winograd_scratch_size(&patch[1]) * sizeof(float));
+
+    // A fixed sequence, so that the check does not disturb rand().
+    unsigned seed = 1;
+    for (int i = 0; i < input_size; i++) {
+        seed = seed * 1103515245 + 12345;
+        inputs[i] = (float)((seed >> 8) & 0xffff) / 0x8000 - 1;
+    }
+    memcpy(expected, inputs, input_size * sizeof(float));
+    convolution3d_zeropad(expected, kernels, patch, 1, padded);
+
+    // The first kernels are laid out as the kernels of a smaller layer.
+    winograd_transform_filters(kernels, patch[1], tile, transformed);
+    copy_zeropad(inputs, patch, 1, padded);
+    winograd_convolution3d_no_padding(
+            padded, transformed, patch[1], scratch, results);
+
+    // Only compare the outputs, not the alignment padding.
+    const int result_width = patch_outputs + patch[1].outputs.align_pad;
+    float max_diff = 0;
+    float max_val = 1e-6;
+    for (int i = 0; i < result_size; i++) {
+        if (i % result_width >= patch_outputs)
+            continue;
+        max_diff = max2(max_diff, fabsf(results[i] - expected[i]));
+        max_val = max2(max_val, fabsf(expected[i]));
+    }
+
+    free(expected);
+    free(padded);
+    free(inputs);
+    free(results);
+    free(transformed);
+    free(scratch);
+    return max_diff / max_val;
+}
+
+// Add the transformed filters of the layer to its host_weights.
+static void append_winograd_weights(layer_t* curr_layer,
+                                    farray_t* transformed,
+                                    int tile) {
+    data_list* host_weights = curr_layer->host_weights;
+    host_weights->data = (union DataFormat*)realloc(
+            host_weights->data, sizeof(union DataFormat) * 2);
+    host_weights->type = (data_storage_t*)realloc(
+            host_weights->type, sizeof(data_storage_t) * 2);
+    host_weights->data[1].dense = transformed;
+    host_weights->type[1] = Uncompressed;
+    host_weights->len = 2;
+    curr_layer->winograd_tile = tile;
+}
+
+#endif
+
+int transform_winograd_weights(network_t* network) {
+    int num_transformed = 0;
+#if WINOGRAD_CONV == 1
+    static const int kTileSizes[] = { 4, 2 };
+    const int num_tile_sizes = sizeof(kTileSizes) / sizeof(kTileSizes[0]);
+    for (int l = 1; l < network->depth; l++) {
+        layer_t* curr_layer = &network->layers[l];
+        if (!winograd_eligible(curr_layer) || !curr_layer->host_weights ||
+            curr_layer->host_weights->len != 1 ||
+            curr_layer->host_weights->type[0] != Uncompressed)
+            continue;
+        float* kernels = curr_layer->host_weights->data[0].dense->d;
+        for (int t = 0; t < num_tile_sizes; t++) {
+            int tile = kTileSizes[t];
+            if (curr_layer->outputs.rows < WINOGRAD_MIN_TILES * tile ||
+                curr_layer->outputs.cols < WINOGRAD_MIN_TILES * tile)
+                continue;
+            float error = winograd_rel_error(curr_layer, kernels, tile);
+            if (error > WINOGRAD_MAX_REL_ERROR) {
+                printf("Layer %d: Winograd F(%dx%d, 3x3) relative error %g is "
+                       "too large.\n", l, tile, tile, error);
+                continue;
+            }
+            farray_t* transformed = init_farray(
+                    get_num_winograd_weights(curr_layer, tile), false);
+            winograd_transform_filters(
+                    kernels, *curr_layer, tile, transformed->d);
+            append_winograd_weights(curr_layer, transformed, tile);
+            num_transformed++;
+            printf("Layer %d: using Winograd F(%dx%d, 3x3), relative error "
+                   "%g.\n", l, tile, tile, error);
+            break;
+        }
+    }
+#endif
+    return num_transformed;
+}
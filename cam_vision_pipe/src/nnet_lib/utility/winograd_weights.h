@@ -0,0 +1,24 @@
+#ifndef _UTILITY_WINOGRAD_WEIGHTS_H_
+#define _UTILITY_WINOGRAD_WEIGHTS_H_
+
+#include "core/nnet_fwd_defs.h"
+
+// Switch eligible convolutions to Winograd minimal filtering.
+//
+// Every uncompressed 3x3, stride 1 standard convolution gets its filters
+// transformed for F(4x4, 3x3), or for F(2x2, 3x3) if its outputs are too
+// small to hold WINOGRAD_MIN_TILES 4x4 tiles each way; with smaller outputs
+// still, it stays a direct convolution. The larger tile needs fewer
+// multiplies but is less accurate, so before a layer is switched, its first
+// few kernels are run both ways on a small random patch, and a tile is only
+// used if its outputs are within WINOGRAD_MAX_REL_ERROR of the direct
+// convolution. The transformed filters are appended to the host_weights of
+// the layer, and winograd_tile is set.
+//
+// This must run after process_compressed_weights(). Does nothing unless
+// WINOGRAD_CONV is 1.
+//
+// Returns the number of layers switched.
+int transform_winograd_weights(network_t* network);
+
+#endif
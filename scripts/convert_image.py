@@ -25,6 +25,20 @@ def convert_raw_to_binary(raw_name):
       bin_file.write(struct.pack('i', im.shape[2]))
       bin_file.write(im)
 
+def convert_raw_to_bayer(raw_name):
+  im = imageio.imread(raw_name)
+  print(im.shape)
+
+  # Keep the channel of each G R / B G Bayer site, as a headerless single-plane
+  # uint8 dump.
+  bayer = np.copy(im[:, :, 1])
+  bayer[0::2, 1::2] = im[0::2, 1::2, 0]
+  bayer[1::2, 0::2] = im[1::2, 0::2, 2]
+  bayer_name = raw_name.replace('png', 'bayer8')
+  with open(bayer_name, 'wb') as bayer_file:
+    bayer_file.write(bayer.astype(np.uint8).tobytes())
+  print("Run with --raw-format=bayer8 --raw-size=%dx%d" % bayer.shape)
+
 def convert_binary_to_image(bin_name):
     with open(bin_name, "r") as bin_file:
       shape = struct.unpack("iii", bin_file.read(12))
@@ -224,6 +238,8 @@ def main():
   parser = argparse.ArgumentParser()
   parser.add_argument("--raw", "-r",
       help="Convert a raw image to a binary file.")
+  parser.add_argument("--bayer", "-y",
+      help="Convert a raw image to a single-plane Bayer sensor dump.")
   parser.add_argument("--binary", "-b",
       help="Convert a binary file to a image.")
   parser.add_argument("--backward", "-B",
@@ -236,6 +252,8 @@ def main():
 
   if args.raw != None:
     convert_raw_to_binary(args.raw)
+  elif args.bayer != None:
+    convert_raw_to_bayer(args.bayer)
   elif args.binary != None:
     convert_binary_to_image(args.binary)
   elif args.backward != None:
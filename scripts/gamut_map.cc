@@ -1,25 +1,114 @@
 #include <iostream>
+#include <algorithm>
 #include <cmath>
+#include <thread>
+#include <vector>
+#include <x86intrin.h>
 
 #include "gamut_map.h"
 
-void gamut_map(float* input,
-               int row_size,
-               int col_size,
-               int chan_size,
-               float* result,
-               float* ctrl_pts,
-               float* weights,
-               float* coefs,
-               int num_cps) {
+// Pixels are mapped VECTOR_SIZE at a time, against blocks of CP_BLOCK control
+// points so that the block stays in L1 while a tile of pixels is swept over
+// it.
+#if defined(__AVX__)
+#define VECTOR_SIZE 8
+typedef float vec_t __attribute__((__vector_size__(VECTOR_SIZE * sizeof(float))));
+static inline vec_t vec_sqrt(vec_t x) { return (vec_t)_mm256_sqrt_ps((__m256)x); }
+#else
+#define VECTOR_SIZE 4
+typedef float vec_t __attribute__((__vector_size__(VECTOR_SIZE * sizeof(float))));
+static inline vec_t vec_sqrt(vec_t x) { return (vec_t)_mm_sqrt_ps((__m128)x); }
+#endif
+#define TILE_VECS 8
+#define TILE_SIZE (TILE_VECS * VECTOR_SIZE)
+#define CP_BLOCK 256
+#define MAX_CHANS 3
+
+// Gamut map pixels [start, end) of the flattened HWC image.
+static void gamut_map_range(float* input,
+                            int chan_size,
+                            float* result,
+                            float* ctrl_pts,
+                            float* weights,
+                            float* coefs,
+                            int num_cps,
+                            int start,
+                            int end) {
+    ARRAY_2D(float, _input, input, chan_size);
+    ARRAY_2D(float, _result, result, chan_size);
+    ARRAY_2D(float, _ctrl_pts, ctrl_pts, chan_size);
+    ARRAY_2D(float, _weights, weights, chan_size);
+    ARRAY_2D(float, _coefs, coefs, chan_size);
+
+    vec_t pixels[MAX_CHANS][TILE_VECS];
+    vec_t acc[MAX_CHANS][TILE_VECS];
+    for (int tile = start; tile < end; tile += TILE_SIZE) {
+        int tile_size = std::min(TILE_SIZE, end - tile);
+        int tile_vecs = (tile_size + VECTOR_SIZE - 1) / VECTOR_SIZE;
+        // Transpose the tile to planar vectors, padding with zeros.
+        for (int chan = 0; chan < MAX_CHANS; chan++) {
+            for (int i = 0; i < TILE_SIZE; i++) {
+                pixels[chan][i / VECTOR_SIZE][i % VECTOR_SIZE] =
+                        i < tile_size ? _input[tile + i][chan] : 0;
+            }
+            for (int v = 0; v < TILE_VECS; v++)
+                acc[chan][v] = vec_t{};
+        }
+
+        for (int block = 0; block < num_cps; block += CP_BLOCK) {
+            int block_end = std::min(block + CP_BLOCK, num_cps);
+            for (int v = 0; v < tile_vecs; v++) {
+                vec_t r = pixels[0][v], g = pixels[1][v], b = pixels[2][v];
+                vec_t acc0 = acc[0][v], acc1 = acc[1][v], acc2 = acc[2][v];
+                for (int cp = block; cp < block_end; cp++) {
+                    vec_t dr = r - _ctrl_pts[cp][0];
+                    vec_t dg = g - _ctrl_pts[cp][1];
+                    vec_t db = b - _ctrl_pts[cp][2];
+                    vec_t l2_dist = vec_sqrt(dr * dr + dg * dg + db * db);
+                    acc0 += l2_dist * _weights[cp][0];
+                    acc1 += l2_dist * _weights[cp][1];
+                    acc2 += l2_dist * _weights[cp][2];
+                }
+                acc[0][v] = acc0;
+                acc[1][v] = acc1;
+                acc[2][v] = acc2;
+            }
+        }
 
+        for (int chan = 0; chan < chan_size; chan++) {
+            for (int v = 0; v < tile_vecs; v++) {
+                // Add on the biases for the RBF
+                vec_t chan_val = acc[chan][v] +
+                                 (_coefs[0][chan] +
+                                  _coefs[1][chan] * pixels[0][v] +
+                                  _coefs[2][chan] * pixels[1][v] +
+                                  _coefs[3][chan] * pixels[2][v]);
+                acc[chan][v] = (chan_val > 0) ? chan_val : 0;
+            }
+            for (int i = 0; i < tile_size; i++)
+                _result[tile + i][chan] =
+                        acc[chan][i / VECTOR_SIZE][i % VECTOR_SIZE];
+        }
+    }
+}
+
+// The unvectorized gamut map, for images without exactly MAX_CHANS channels.
+static void gamut_map_generic(float* input,
+                              int row_size,
+                              int col_size,
+                              int chan_size,
+                              float* result,
+                              float* ctrl_pts,
+                              float* weights,
+                              float* coefs,
+                              int num_cps) {
     ARRAY_3D(float, _input, input, col_size, chan_size);
     ARRAY_3D(float, _result, result, col_size, chan_size);
     ARRAY_2D(float, _ctrl_pts, ctrl_pts, chan_size);
     ARRAY_2D(float, _weights, weights, chan_size);
     ARRAY_2D(float, _coefs, coefs, chan_size);
 
-    float* l2_dist = new float[num_cps];
+    std::vector<float> l2_dist(num_cps);
     for (int row = 0; row < row_size; row++) {
         for (int col = 0; col < col_size; col++) {
             for (int cp = 0; cp < num_cps; cp++) {
@@ -45,6 +134,36 @@ void gamut_map(float* input,
             }
         }
     }
-    delete l2_dist;
 }
 
+void gamut_map(float* input,
+               int row_size,
+               int col_size,
+               int chan_size,
+               float* result,
+               float* ctrl_pts,
+               float* weights,
+               float* coefs,
+               int num_cps) {
+    if (row_size <= 0 || col_size <= 0)
+        return;
+    if (chan_size != MAX_CHANS) {
+        gamut_map_generic(input, row_size, col_size, chan_size, result,
+                          ctrl_pts, weights, coefs, num_cps);
+        return;
+    }
+
+    // Split the rows evenly over the available cores.
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, row_size);
+    int rows_per_thread = (row_size + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (int row = 0; row < row_size; row += rows_per_thread) {
+        int start = row * col_size;
+        int end = std::min(row + rows_per_thread, row_size) * col_size;
+        threads.emplace_back(gamut_map_range, input, chan_size, result,
+                             ctrl_pts, weights, coefs, num_cps, start, end);
+    }
+    for (auto& thread : threads)
+        thread.join();
+}